@@ -0,0 +1,180 @@
+/*
+ * dm_crypt_bench - measure the read and write throughput of a block
+ * device with O_DIRECT I/O from several processes at once.
+ *
+ * Meant for a crypt device over a RAM disk, so that the cost of the
+ * encryption is all that is measured:
+ *
+ *   modprobe brd rd_nr=1 rd_size=262144
+ *   dmsetup create bench --table "0 524288 crypt aes-cbc-essiv:sha256 \
+ *	babebabebabebabebabebabebabebabe 0 /dev/ram0 0"
+ *   ./dm_crypt_bench -j 2 /dev/mapper/bench
+ *
+ * Append e.g. "1 sector_size:4096" or "1 cipher_driver:cbc-aes-tegra" to
+ * the table to compare crypto request sizes and engines, and run the
+ * same against /dev/ram0 itself for the unencrypted baseline. Each of the
+ * -j processes works on its own slice of the device; the throughput is
+ * that of all of them together.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <linux/fs.h>
+
+static void bail(const char *error)
+{
+	perror(error);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/* Read or write the slice [start, start + len) bs bytes at a time. */
+static void worker(const char *path, int writing, off_t start, off_t len,
+		   size_t bs, int passes)
+{
+	off_t off;
+	void *buf;
+	int fd, i;
+
+	fd = open(path, (writing ? O_WRONLY : O_RDONLY) | O_DIRECT);
+	if (fd < 0)
+		bail("open");
+	if (posix_memalign(&buf, 4096, bs))
+		bail("posix_memalign");
+	memset(buf, 0x5a, bs);
+
+	for (i = 0; i < passes; i++)
+		for (off = 0; off + (off_t)bs <= len; off += bs) {
+			ssize_t n;
+
+			if (writing)
+				n = pwrite(fd, buf, bs, start + off);
+			else
+				n = pread(fd, buf, bs, start + off);
+			if (n != (ssize_t)bs)
+				bail(writing ? "pwrite" : "pread");
+		}
+
+	if (writing && fsync(fd) < 0)
+		bail("fsync");
+	close(fd);
+	exit(0);
+}
+
+/* Runs jobs workers in parallel; returns the aggregate MB/s. */
+static double run(const char *path, int writing, off_t size, size_t bs,
+		  int jobs, int passes)
+{
+	off_t slice = size / jobs / bs * bs;
+	double start, secs;
+	int i, status, failed = 0;
+
+	start = now();
+	for (i = 0; i < jobs; i++) {
+		pid_t pid = fork();
+
+		if (pid < 0)
+			bail("fork");
+		if (pid == 0)
+			worker(path, writing, i * slice, slice, bs, passes);
+	}
+	for (i = 0; i < jobs; i++) {
+		if (wait(&status) < 0)
+			bail("wait");
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			failed = 1;
+	}
+	secs = now() - start;
+	if (failed) {
+		fprintf(stderr, "a worker failed\n");
+		exit(1);
+	}
+	return (double)slice * jobs * passes / secs / (1024 * 1024);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-j jobs] [-b block_bytes] [-s size_mb] "
+		"[-p passes] [-r|-w] device\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int jobs = 1, passes = 4, do_read = 1, do_write = 1, opt, fd;
+	size_t bs = 64 * 1024;
+	off_t size = 0;
+	unsigned long long dev_size;
+	const char *path;
+
+	while ((opt = getopt(argc, argv, "j:b:s:p:rw")) != -1) {
+		switch (opt) {
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		case 'b':
+			bs = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = (off_t)strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'p':
+			passes = atoi(optarg);
+			break;
+		case 'r':
+			do_write = 0;
+			break;
+		case 'w':
+			do_read = 0;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || jobs <= 0 || passes <= 0 ||
+	    bs < 512 || bs % 512)
+		usage(argv[0]);
+	path = argv[optind];
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		bail("open");
+	if (ioctl(fd, BLKGETSIZE64, &dev_size) < 0)
+		bail("BLKGETSIZE64");
+	close(fd);
+	if (!size || size > (off_t)dev_size)
+		size = dev_size;
+	if (size / jobs < (off_t)bs) {
+		fprintf(stderr, "device too small for %d jobs of %zu bytes\n",
+			jobs, bs);
+		return 1;
+	}
+
+	/* Write first so that the reads find initialised data. */
+	if (do_write)
+		printf("write: %d jobs, %zu byte blocks: %.1f MB/s\n", jobs, bs,
+		       run(path, 1, size, bs, jobs, passes));
+	if (do_read)
+		printf("read:  %d jobs, %zu byte blocks: %.1f MB/s\n", jobs, bs,
+		       run(path, 0, size, bs, jobs, passes));
+	return 0;
+}
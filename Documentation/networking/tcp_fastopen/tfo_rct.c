@@ -0,0 +1,217 @@
+/*
+ * tfo_rct - measure the completion time of short request/response
+ * transactions, each on a fresh TCP connection, with and without
+ * TCP Fast Open.
+ *
+ * Emulate a mobile path on the loopback device, e.g. 3G with 100 ms
+ * one-way delay (so 200 ms RTT):
+ *
+ *   tc qdisc add dev lo root netem delay 100ms
+ *
+ * Enable both sides of Fast Open and compare:
+ *
+ *   echo 3 > /proc/sys/net/ipv4/tcp_fastopen
+ *   ./tfo_rct -n 50
+ *   ./tfo_rct -n 50 -f
+ *
+ * Without Fast Open a transaction takes two round trips (handshake,
+ * then request/response); with Fast Open the request rides in the SYN
+ * and it takes one. The first Fast Open connection only fetches the
+ * cookie and is excluded from the statistics. The TCPFastOpen*
+ * counters in /proc/net/netstat show what happened.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/tcp.h>
+
+#ifndef MSG_FASTOPEN
+#define MSG_FASTOPEN	0x20000000
+#endif
+
+static void bail(const char *error)
+{
+	perror(error);
+	exit(1);
+}
+
+static double now_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int read_full(int fd, char *buf, int len)
+{
+	int done = 0, n;
+
+	while (done < len) {
+		n = read(fd, buf + done, len - done);
+		if (n <= 0)
+			return -1;
+		done += n;
+	}
+	return done;
+}
+
+/* Answer each request of req_len bytes with resp_len bytes. */
+static void server(int lfd, int req_len, int resp_len)
+{
+	char *req = malloc(req_len), *resp = malloc(resp_len);
+	int fd;
+
+	if (!req || !resp)
+		bail("malloc");
+	memset(resp, 'r', resp_len);
+	for (;;) {
+		fd = accept(lfd, NULL, NULL);
+		if (fd < 0)
+			bail("accept");
+		if (read_full(fd, req, req_len) == req_len)
+			if (write(fd, resp, resp_len) != resp_len)
+				perror("write");
+		close(fd);
+	}
+}
+
+/* One transaction on a new connection; returns its duration in ms. */
+static double transaction(const struct sockaddr_in *addr, int fastopen,
+			  char *req, int req_len, char *resp, int resp_len)
+{
+	double start = now_ms();
+	int fd, one = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		bail("socket");
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if (fastopen) {
+		if (sendto(fd, req, req_len, MSG_FASTOPEN,
+			   (const struct sockaddr *)addr, sizeof(*addr)) !=
+		    req_len)
+			bail("sendto(MSG_FASTOPEN)");
+	} else {
+		if (connect(fd, (const struct sockaddr *)addr,
+			    sizeof(*addr)) < 0)
+			bail("connect");
+		if (write(fd, req, req_len) != req_len)
+			bail("write");
+	}
+	if (read_full(fd, resp, resp_len) != resp_len)
+		bail("read");
+	close(fd);
+	return now_ms() - start;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-f] [-n transactions] "
+		"[-q request_bytes] [-r response_bytes]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int fastopen = 0, count = 20, req_len = 200, resp_len = 2000;
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int lfd, qlen = 16, one = 1, opt, i;
+	char *req, *resp;
+	double *rct, sum = 0;
+	pid_t pid;
+
+	while ((opt = getopt(argc, argv, "fn:q:r:")) != -1) {
+		switch (opt) {
+		case 'f':
+			fastopen = 1;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'q':
+			req_len = atoi(optarg);
+			break;
+		case 'r':
+			resp_len = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (count <= 0 || req_len <= 0 || resp_len <= 0)
+		usage(argv[0]);
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0)
+		bail("socket");
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (setsockopt(lfd, IPPROTO_TCP, TCP_FASTOPEN, &qlen,
+		       sizeof(qlen)) < 0)
+		perror("setsockopt(TCP_FASTOPEN)");
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		bail("bind");
+	if (listen(lfd, 64) < 0)
+		bail("listen");
+	if (getsockname(lfd, (struct sockaddr *)&addr, &len) < 0)
+		bail("getsockname");
+
+	pid = fork();
+	if (pid < 0)
+		bail("fork");
+	if (pid == 0)
+		server(lfd, req_len, resp_len);
+
+	req = malloc(req_len);
+	resp = malloc(resp_len);
+	rct = calloc(count, sizeof(*rct));
+	if (!req || !resp || !rct)
+		bail("malloc");
+	memset(req, 'q', req_len);
+
+	/* Warm up: fetches the Fast Open cookie and the route metrics. */
+	transaction(&addr, fastopen, req, req_len, resp, resp_len);
+
+	for (i = 0; i < count; i++) {
+		rct[i] = transaction(&addr, fastopen, req, req_len,
+				     resp, resp_len);
+		sum += rct[i];
+	}
+
+	qsort(rct, count, sizeof(*rct), cmp_double);
+	printf("%s: %d transactions, %d/%d bytes: completion ms "
+	       "min %.1f avg %.1f p50 %.1f p90 %.1f max %.1f\n",
+	       fastopen ? "fastopen" : "regular", count, req_len, resp_len,
+	       rct[0], sum / count, rct[count / 2], rct[count * 9 / 10],
+	       rct[count - 1]);
+
+	kill(pid, SIGTERM);
+	wait(NULL);
+	return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * tsq_latency - measure the latency an interactive TCP flow sees while
+ * bulk TCP uploads share the same (emulated) slow link.
+ *
+ * A slow mobile uplink is emulated on the loopback device with netem and
+ * a token bucket, for example ~1 Mbit/s 3G with 100 ms one-way delay:
+ *
+ *   tc qdisc add dev lo root handle 1: netem delay 100ms
+ *   tc qdisc add dev lo parent 1:1 handle 10: tbf rate 1mbit \
+ *	burst 10kb latency 2s
+ *
+ * Then compare runs with TCP small queues disabled and enabled:
+ *
+ *   echo 0 > /proc/sys/net/ipv4/tcp_limit_output_bytes
+ *   ./tsq_latency -b 2 -n 200
+ *   echo 131072 > /proc/sys/net/ipv4/tcp_limit_output_bytes
+ *   ./tsq_latency -b 2 -n 200
+ *
+ * The program prints request/response latency percentiles of the
+ * interactive flow and the small-queue statistics that the kernel
+ * reports for one of the bulk sockets via TCP_INFO (the same struct is
+ * exported by inet_diag, e.g. "ss -i").
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/tcp.h>
+
+#define BULK_CHUNK	65536
+
+static void bail(const char *error)
+{
+	perror(error);
+	exit(1);
+}
+
+static double now_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int listen_on(struct sockaddr_in *addr)
+{
+	socklen_t len = sizeof(*addr);
+	int one = 1;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		bail("socket");
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr->sin_port = 0;
+	if (bind(fd, (struct sockaddr *)addr, sizeof(*addr)) < 0)
+		bail("bind");
+	if (listen(fd, 16) < 0)
+		bail("listen");
+	if (getsockname(fd, (struct sockaddr *)addr, &len) < 0)
+		bail("getsockname");
+	return fd;
+}
+
+static int connect_to(const struct sockaddr_in *addr)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd < 0)
+		bail("socket");
+	if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0)
+		bail("connect");
+	return fd;
+}
+
+/* Sink: accept connections and discard or echo what is received. */
+static void server(int lfd, int echo)
+{
+	char buf[BULK_CHUNK];
+	int fd;
+
+	for (;;) {
+		fd = accept(lfd, NULL, NULL);
+		if (fd < 0)
+			bail("accept");
+		if (fork() == 0) {
+			int one = 1;
+			ssize_t n;
+
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one,
+				   sizeof(one));
+			while ((n = read(fd, buf, sizeof(buf))) > 0)
+				if (echo && write(fd, buf, n) != n)
+					break;
+			exit(0);
+		}
+		close(fd);
+	}
+}
+
+static void bulk_sender(int fd)
+{
+	static char buf[BULK_CHUNK];
+
+	memset(buf, 'x', sizeof(buf));
+	for (;;)
+		if (write(fd, buf, sizeof(buf)) < 0)
+			exit(0);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void show_tsq(int fd)
+{
+	struct tcp_info info;
+	socklen_t len = sizeof(info);
+
+	memset(&info, 0, sizeof(info));
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+		bail("getsockopt(TCP_INFO)");
+	if (len < sizeof(info)) {
+		printf("kernel does not report TCP small queue statistics\n");
+		return;
+	}
+	printf("bulk socket: rtt %u us cwnd %u tsq_limit %u bytes "
+	       "qdelay %u us (max %u us) throttled %u times\n",
+	       info.tcpi_rtt, info.tcpi_snd_cwnd, info.tcpi_tsq_limit,
+	       info.tcpi_tsq_qdelay, info.tcpi_tsq_qdelay_max,
+	       info.tcpi_tsq_throttled);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-b bulk_flows] [-n requests] "
+		"[-i interval_ms] [-w warmup_ms]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in sink_addr, echo_addr;
+	int bulk = 2, requests = 100, interval = 50, warmup = 2000;
+	int sink_fd, echo_fd, fd, first_bulk = -1;
+	pid_t pids[64];
+	int npids = 0;
+	double *lat;
+	char c = 'r';
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "b:n:i:w:")) != -1) {
+		switch (opt) {
+		case 'b':
+			bulk = atoi(optarg);
+			break;
+		case 'n':
+			requests = atoi(optarg);
+			break;
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'w':
+			warmup = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (bulk < 0 || bulk > 32 || requests <= 0)
+		usage(argv[0]);
+
+	sink_fd = listen_on(&sink_addr);
+	echo_fd = listen_on(&echo_addr);
+
+	pids[npids] = fork();
+	if (pids[npids++] == 0)
+		server(sink_fd, 0);
+	pids[npids] = fork();
+	if (pids[npids++] == 0)
+		server(echo_fd, 1);
+
+	for (i = 0; i < bulk; i++) {
+		fd = connect_to(&sink_addr);
+		if (first_bulk < 0)
+			first_bulk = fd;
+		pids[npids] = fork();
+		if (pids[npids++] == 0)
+			bulk_sender(fd);
+	}
+
+	usleep(warmup * 1000);
+
+	fd = connect_to(&echo_addr);
+	opt = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+	lat = calloc(requests, sizeof(*lat));
+	if (!lat)
+		bail("calloc");
+	for (i = 0; i < requests; i++) {
+		double start = now_ms();
+
+		if (write(fd, &c, 1) != 1 || read(fd, &c, 1) != 1)
+			bail("request");
+		lat[i] = now_ms() - start;
+		usleep(interval * 1000);
+	}
+
+	if (first_bulk >= 0)
+		show_tsq(first_bulk);
+
+	qsort(lat, requests, sizeof(*lat), cmp_double);
+	printf("%d bulk flows, %d requests: latency ms "
+	       "min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+	       bulk, requests, lat[0], lat[requests / 2],
+	       lat[requests * 9 / 10], lat[requests * 99 / 100],
+	       lat[requests - 1]);
+
+	for (i = 0; i < npids; i++)
+		kill(pids[i], SIGTERM);
+	while (wait(NULL) > 0)
+		;
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * udp_dns_bench - measure the cost of sending DNS-sized UDP queries.
+ *
+ * A child process drains the servers' sockets while the parent sends
+ * small datagrams in one of three modes:
+ *
+ *   -m same     sendto() from an unconnected socket, always to the same
+ *               server; the socket's cached route is reused
+ *   -m rotate   sendto() from an unconnected socket, cycling through
+ *               -s servers; every send looks the route up again
+ *   -m connect  send() on a connected socket
+ *
+ * With -f the route cache is flushed every given number of milliseconds
+ * while sending, as happens on WLAN/3G handovers:
+ *
+ *   ./udp_dns_bench -m same -n 1000000
+ *   ./udp_dns_bench -m rotate -s 4 -n 1000000
+ *   ./udp_dns_bench -m same -n 1000000 -f 10
+ *
+ * The servers listen on 127.0.0.1 .. 127.0.0.<servers>.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_SERVERS	64
+
+static void bail(const char *error)
+{
+	perror(error);
+	exit(1);
+}
+
+static double now_ns(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e9 + tv.tv_usec * 1e3;
+}
+
+/* Read and discard whatever arrives on the server sockets. */
+static void drain(int *fds, int n)
+{
+	struct pollfd pfd[MAX_SERVERS];
+	char buf[2048];
+	int i;
+
+	for (i = 0; i < n; i++) {
+		pfd[i].fd = fds[i];
+		pfd[i].events = POLLIN;
+	}
+	for (;;) {
+		if (poll(pfd, n, -1) < 0)
+			continue;
+		for (i = 0; i < n; i++)
+			if (pfd[i].revents & POLLIN)
+				while (recv(fds[i], buf, sizeof(buf),
+					    MSG_DONTWAIT) > 0)
+					;
+	}
+}
+
+/* Write to /proc/sys/net/ipv4/route/flush every ms milliseconds. */
+static void flusher(int ms)
+{
+	int fd;
+
+	for (;;) {
+		usleep(ms * 1000);
+		fd = open("/proc/sys/net/ipv4/route/flush", O_WRONLY);
+		if (fd < 0)
+			bail("open /proc/sys/net/ipv4/route/flush");
+		if (write(fd, "0\n", 2) != 2)
+			bail("route flush");
+		close(fd);
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-m same|rotate|connect] [-n sends] "
+		"[-s servers] [-l bytes] [-f flush_ms]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in addr[MAX_SERVERS];
+	int srv[MAX_SERVERS];
+	int servers = 4, count = 200000, len = 48, flush_ms = 0;
+	const char *mode = "same";
+	int fd, opt, i, rotate = 0, connected = 0;
+	pid_t drainer, flush_pid = 0;
+	socklen_t alen;
+	char query[512];
+	double start, ns;
+	long failed = 0;
+
+	while ((opt = getopt(argc, argv, "m:n:s:l:f:")) != -1) {
+		switch (opt) {
+		case 'm':
+			mode = optarg;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 's':
+			servers = atoi(optarg);
+			break;
+		case 'l':
+			len = atoi(optarg);
+			break;
+		case 'f':
+			flush_ms = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!strcmp(mode, "rotate"))
+		rotate = 1;
+	else if (!strcmp(mode, "connect"))
+		connected = 1;
+	else if (strcmp(mode, "same"))
+		usage(argv[0]);
+	if (count <= 0 || servers <= 0 || servers > MAX_SERVERS ||
+	    len <= 0 || len > (int)sizeof(query) || flush_ms < 0)
+		usage(argv[0]);
+	if (!rotate)
+		servers = 1;
+
+	for (i = 0; i < servers; i++) {
+		srv[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		if (srv[i] < 0)
+			bail("socket");
+		memset(&addr[i], 0, sizeof(addr[i]));
+		addr[i].sin_family = AF_INET;
+		addr[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK + i);
+		if (bind(srv[i], (struct sockaddr *)&addr[i],
+			 sizeof(addr[i])) < 0)
+			bail("bind");
+		alen = sizeof(addr[i]);
+		if (getsockname(srv[i], (struct sockaddr *)&addr[i],
+				&alen) < 0)
+			bail("getsockname");
+	}
+
+	drainer = fork();
+	if (drainer < 0)
+		bail("fork");
+	if (drainer == 0)
+		drain(srv, servers);
+
+	if (flush_ms) {
+		flush_pid = fork();
+		if (flush_pid < 0)
+			bail("fork");
+		if (flush_pid == 0)
+			flusher(flush_ms);
+	}
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		bail("socket");
+	if (connected && connect(fd, (struct sockaddr *)&addr[0],
+				 sizeof(addr[0])) < 0)
+		bail("connect");
+	memset(query, 'q', len);
+
+	start = now_ns();
+	for (i = 0; i < count; i++) {
+		ssize_t n;
+
+		if (connected)
+			n = send(fd, query, len, 0);
+		else
+			n = sendto(fd, query, len, 0,
+				   (struct sockaddr *)&addr[rotate ? i % servers : 0],
+				   sizeof(addr[0]));
+		if (n != len)
+			failed++;
+	}
+	ns = now_ns() - start;
+
+	printf("%s: %d sends of %d bytes to %d server(s)%s: "
+	       "%.0f sends/s, %.0f ns/send, %ld failed\n",
+	       mode, count, len, servers, flush_ms ? ", flushing" : "",
+	       count / (ns / 1e9), ns / count, failed);
+
+	kill(drainer, SIGTERM);
+	if (flush_pid)
+		kill(flush_pid, SIGTERM);
+	while (wait(NULL) > 0)
+		;
+	return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ *  arch/arm/include/asm/maint.h
+ *
+ *  Limits and counters of TLB and cache maintenance over ranges
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Maintenance by address costs one operation per page or cache line, so
+ * past some size it is cheaper to drop the whole address space from the
+ * TLB, or to clean and invalidate the whole cache.  The limits below are
+ * the largest ranges still done line by line or page by page; they can be
+ * tuned through debugfs, in arm_maint/.
+ */
+#ifndef __ASM_ARM_MAINT_H
+#define __ASM_ARM_MAINT_H
+
+#include <linux/percpu.h>
+#include <linux/types.h>
+
+enum arm_maint_item {
+	MAINT_TLB_RANGE,	/* user TLB ranges, by page */
+	MAINT_TLB_ASID,		/* user TLB ranges, by ASID */
+	MAINT_TLB_KERN_RANGE,	/* kernel TLB ranges, by page */
+	MAINT_TLB_KERN_ALL,	/* kernel TLB ranges, whole TLB */
+	MAINT_DMA_RANGE,	/* inner cache for DMA, by line */
+	MAINT_DMA_ALL,		/* inner cache for DMA, whole cache */
+	MAINT_OUTER_RANGE,	/* outer cache, by line */
+	MAINT_OUTER_ALL,	/* outer cache, by way */
+	NR_MAINT_ITEMS
+};
+
+struct arm_maint_state {
+	unsigned long count[NR_MAINT_ITEMS];
+};
+
+DECLARE_PER_CPU(struct arm_maint_state, arm_maint_states);
+
+static inline void count_maint(enum arm_maint_item item)
+{
+	this_cpu_inc(arm_maint_states.count[item]);
+}
+
+extern u32 tlb_range_max_pages;
+extern u32 dma_range_max_bytes;
+extern u32 outer_range_max_bytes;
+
+#endif
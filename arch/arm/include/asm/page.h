@@ -150,6 +150,10 @@ extern void __cpu_copy_user_highpage(struct page *to, struct page *from,
 
 #define clear_page(page)	memset((void *)(page), 0, PAGE_SIZE)
 extern void copy_page(void *to, const void *from);
+#ifdef CONFIG_CPU_COPY_A9
+extern void copy_page_generic(void *to, const void *from);
+extern void copy_page_a9(void *to, const void *from);
+#endif
 
 #undef STRICT_MM_TYPECHECKS
 
@@ -14,6 +14,10 @@ extern char * strchr(const char * s, int c);
 
 #define __HAVE_ARCH_MEMCPY
 extern void * memcpy(void *, const void *, __kernel_size_t);
+#ifdef CONFIG_CPU_COPY_A9
+extern void * memcpy_generic(void *, const void *, __kernel_size_t);
+extern void * memcpy_a9(void *, const void *, __kernel_size_t);
+#endif
 
 #define __HAVE_ARCH_MEMMOVE
 extern void * memmove(void *, const void *, __kernel_size_t);
@@ -97,6 +97,11 @@ extern void __show_regs(struct pt_regs *);
 
 extern int cpu_architecture(void);
 extern void cpu_init(void);
+#ifdef CONFIG_CPU_COPY_A9
+extern void copy_a9_init(void);
+#else
+static inline void copy_a9_init(void) { }
+#endif
 extern void cpu_idle_wait(void);
 extern void default_idle(void);
 
@@ -538,10 +538,11 @@ static inline void clean_pmd_entry(pmd_t *pmd)
 #undef possible_tlb_flags
 
 /*
- * Convert calls to our calling convention.
+ * These go to __cpu_flush_{user,kern}_tlb_range(), or flush the whole
+ * address space or TLB for large ranges; see arch/arm/mm/maint.c.
  */
-#define local_flush_tlb_range(vma,start,end)	__cpu_flush_user_tlb_range(start,end,vma)
-#define local_flush_tlb_kernel_range(s,e)	__cpu_flush_kern_tlb_range(s,e)
+extern void local_flush_tlb_range(struct vm_area_struct *vma, unsigned long start, unsigned long end);
+extern void local_flush_tlb_kernel_range(unsigned long start, unsigned long end);
 
 #ifndef CONFIG_SMP
 #define flush_tlb_all		local_flush_tlb_all
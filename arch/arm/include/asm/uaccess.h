@@ -392,6 +392,12 @@ extern unsigned long __must_check __copy_to_user(void __user *to, const void *fr
 extern unsigned long __must_check __copy_to_user_std(void __user *to, const void *from, unsigned long n);
 extern unsigned long __must_check __clear_user(void __user *addr, unsigned long n);
 extern unsigned long __must_check __clear_user_std(void __user *addr, unsigned long n);
+#ifdef CONFIG_CPU_COPY_A9
+extern unsigned long __must_check __copy_from_user_generic(void *to, const void __user *from, unsigned long n);
+extern unsigned long __must_check __copy_from_user_a9(void *to, const void __user *from, unsigned long n);
+extern unsigned long __must_check __copy_to_user_generic(void __user *to, const void *from, unsigned long n);
+extern unsigned long __must_check __copy_to_user_a9(void __user *to, const void *from, unsigned long n);
+#endif
 #else
 #define __copy_from_user(to,from,n)	(memcpy(to, (void __force *)from, n), 0)
 #define __copy_to_user(to,from,n)	(memcpy((void __force *)to, from, n), 0)
@@ -49,6 +49,8 @@ extern void __aeabi_ulcmp(void);
 
 extern void fpundefinstr(void);
 
+extern void crc32_le_arm(void);
+
 
 EXPORT_SYMBOL(__backtrace);
 
@@ -95,6 +97,11 @@ EXPORT_SYMBOL(__memzero);
 EXPORT_SYMBOL(__strnlen_user);
 EXPORT_SYMBOL(__strncpy_from_user);
 
+#ifdef CONFIG_CPU_COPY_A9
+EXPORT_SYMBOL(memcpy_generic);
+EXPORT_SYMBOL(memcpy_a9);
+#endif
+
 #ifdef CONFIG_MMU
 EXPORT_SYMBOL(copy_page);
 
@@ -110,11 +117,25 @@ EXPORT_SYMBOL(__put_user_1);
 EXPORT_SYMBOL(__put_user_2);
 EXPORT_SYMBOL(__put_user_4);
 EXPORT_SYMBOL(__put_user_8);
+
+#ifdef CONFIG_CPU_COPY_A9
+EXPORT_SYMBOL(copy_page_generic);
+EXPORT_SYMBOL(copy_page_a9);
+EXPORT_SYMBOL(__copy_from_user_generic);
+EXPORT_SYMBOL(__copy_from_user_a9);
+EXPORT_SYMBOL(__copy_to_user_generic);
+EXPORT_SYMBOL(__copy_to_user_a9);
+#endif
 #endif
 
 	/* crypto hash */
 EXPORT_SYMBOL(sha_transform);
 
+	/* crc32 */
+#ifdef CONFIG_CRC32_ARM
+EXPORT_SYMBOL(crc32_le_arm);
+#endif
+
 	/* gcc lib functions */
 EXPORT_SYMBOL(__ashldi3);
 EXPORT_SYMBOL(__ashrdi3);
@@ -818,6 +818,7 @@ void __init setup_arch(char **cmdline_p)
 	*cmdline_p = cmd_line;
 
 	parse_early_param();
+	copy_a9_init();
 
 	arm_memblock_init(&meminfo, mdesc);
 
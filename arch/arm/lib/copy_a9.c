@@ -0,0 +1,58 @@
+/*
+ *  linux/arch/arm/lib/copy_a9.c
+ *
+ *  Switches the copy routines over to their Cortex-A9 variants
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * memcpy(), copy_page(), __copy_from_user() and __copy_to_user() start
+ * with a nop, which is overwritten here with a branch to the A9 variant
+ * while only the boot CPU is running.  The generic code stays callable
+ * past the nop, as *_generic, for comparing the two.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#include <asm/cacheflush.h>
+#include <asm/cputype.h>
+#include <asm/page.h>
+#include <asm/system.h>
+#include <asm/uaccess.h>
+
+static int copy_a9_off __initdata;
+
+static int __init copy_a9_setup(char *str)
+{
+	copy_a9_off = 1;
+	return 0;
+}
+early_param("nocopya9", copy_a9_setup);
+
+static void __init copy_a9_patch(void *from, void *to)
+{
+	u32 *insn = from;
+	long offset = (long)to - ((long)from + 8);
+
+	*insn = 0xea000000 | ((offset >> 2) & 0x00ffffff);	/* b to */
+	flush_icache_range((unsigned long)insn, (unsigned long)(insn + 1));
+}
+
+void __init copy_a9_init(void)
+{
+	unsigned int id = read_cpuid_id();
+
+	/* ARM Ltd Cortex-A9, any revision */
+	if ((id & 0xff00fff0) != 0x4100c090 || copy_a9_off)
+		return;
+
+	copy_a9_patch(memcpy, memcpy_a9);
+	copy_a9_patch(copy_page, copy_page_a9);
+	copy_a9_patch(__copy_from_user, __copy_from_user_a9);
+	/* __copy_to_user may be uaccess_with_memcpy's, which calls this */
+	copy_a9_patch(__copy_to_user_std, __copy_to_user_a9);
+
+	printk(KERN_INFO "Using Cortex-A9 memory copy routines\n");
+}
@@ -0,0 +1,18 @@
+/*
+ *  linux/arch/arm/lib/copy_a9.h
+ *
+ *  Tuning of the Cortex-A9 variants of the copy routines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The A9 keeps several line fills in flight and a miss through the PL310
+ * to DRAM costs a couple of hundred cycles, so the source is preloaded
+ * six cache lines ahead rather than three.  Cache line aligned stores
+ * keep the eight word STMs from being split across lines.
+ */
+#define COPY_A9
+#define COPY_PLD_AHEAD		192
+#define COPY_CALGN
+#define COPY_PAGE_PLD_LINES	6
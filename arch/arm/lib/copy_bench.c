@@ -0,0 +1,297 @@
+/*
+ *  linux/arch/arm/lib/copy_bench.c
+ *
+ *  Self test and bandwidth benchmark for memcpy(), copy_page() and the
+ *  user copy routines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Each routine, and with CONFIG_CPU_COPY_A9 its generic and Cortex-A9
+ * variants, is first checked against a byte at a time copy for every
+ * length up to 256 bytes and a few larger ones, at all source and
+ * destination alignments.  Then each runs over buffers of each size in
+ * sizes at each pair of source and destination offsets until mbytes
+ * have been copied, once over the same buffers, which stay in the
+ * caches, and once walking through span_kb of memory, which doesn't:
+ *
+ *	modprobe copy_bench sizes=64,1024,4096,65536 offsets=0,1 mbytes=64
+ *
+ * The user copies run under KERNEL_DS on kernel buffers, which takes the
+ * same path through the ldrt/strt instructions.  Results go to the
+ * kernel log; the module does not stay loaded.
+ */
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/random.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
+
+static unsigned int mbytes = 16;
+module_param(mbytes, uint, 0);
+MODULE_PARM_DESC(mbytes, "megabytes to copy per run");
+
+static unsigned int sizes[8] = { 16, 64, 256, 1024, 4096, 65536 };
+static unsigned int nr_sizes = 6;
+module_param_array(sizes, uint, &nr_sizes, 0);
+MODULE_PARM_DESC(sizes, "copy sizes to run");
+
+static unsigned int offsets[4] = { 0, 1, 2, 3 };
+static unsigned int nr_offsets = 4;
+module_param_array(offsets, uint, &nr_offsets, 0);
+MODULE_PARM_DESC(offsets, "source and destination offsets to run");
+
+static unsigned int span_kb = 2048;
+module_param(span_kb, uint, 0);
+MODULE_PARM_DESC(span_kb, "memory walked through per buffer when cold, "
+			  "at least twice the L2 cache");
+
+typedef unsigned long (*copy_fn_t)(void *to, const void *from,
+				   unsigned long n);
+
+static void *(*memcpy_fn)(void *, const void *, __kernel_size_t);
+static void (*copy_page_fn)(void *to, const void *from);
+static unsigned long (*from_user_fn)(void *to, const void __user *from,
+				     unsigned long n);
+static unsigned long (*to_user_fn)(void __user *to, const void *from,
+				   unsigned long n);
+
+static unsigned long copy_memcpy(void *to, const void *from, unsigned long n)
+{
+	memcpy_fn(to, from, n);
+	return 0;
+}
+
+static unsigned long copy_copy_page(void *to, const void *from,
+				    unsigned long n)
+{
+	copy_page_fn(to, from);
+	return 0;
+}
+
+static unsigned long copy_from_user_k(void *to, const void *from,
+				      unsigned long n)
+{
+	return from_user_fn(to, (const void __user *)from, n);
+}
+
+static unsigned long copy_to_user_k(void *to, const void *from,
+				    unsigned long n)
+{
+	return to_user_fn((void __user *)to, from, n);
+}
+
+static const struct copy_bench_fn {
+	const char *name;
+	copy_fn_t copy;
+	void **fn;
+	void *impl;
+} copy_fns[] = {
+#define COPY_FN(wrap, ptr, impl)	\
+	{ #impl, wrap, (void **)&ptr, (void *)impl }
+	COPY_FN(copy_memcpy, memcpy_fn, memcpy),
+#ifdef CONFIG_CPU_COPY_A9
+	COPY_FN(copy_memcpy, memcpy_fn, memcpy_generic),
+	COPY_FN(copy_memcpy, memcpy_fn, memcpy_a9),
+#endif
+	COPY_FN(copy_from_user_k, from_user_fn, __copy_from_user),
+#ifdef CONFIG_CPU_COPY_A9
+	COPY_FN(copy_from_user_k, from_user_fn, __copy_from_user_generic),
+	COPY_FN(copy_from_user_k, from_user_fn, __copy_from_user_a9),
+#endif
+	COPY_FN(copy_to_user_k, to_user_fn, __copy_to_user),
+#ifdef CONFIG_CPU_COPY_A9
+	COPY_FN(copy_to_user_k, to_user_fn, __copy_to_user_generic),
+	COPY_FN(copy_to_user_k, to_user_fn, __copy_to_user_a9),
+#endif
+	COPY_FN(copy_copy_page, copy_page_fn, copy_page),
+#ifdef CONFIG_CPU_COPY_A9
+	COPY_FN(copy_copy_page, copy_page_fn, copy_page_generic),
+	COPY_FN(copy_copy_page, copy_page_fn, copy_page_a9),
+#endif
+#undef COPY_FN
+};
+
+static bool copy_is_page(const struct copy_bench_fn *f)
+{
+	return f->copy == copy_copy_page;
+}
+
+/* Copies of len bytes, with 16 guard bytes on each side of the copy. */
+static int __init copy_test_one(const struct copy_bench_fn *f, u8 *src,
+				u8 *dst, unsigned long len, unsigned int soff,
+				unsigned int doff)
+{
+	unsigned long left, i;
+
+	get_random_bytes(src, len + 40);
+	memset(dst, 0x5a, len + 40);
+
+	left = f->copy(dst + 16 + doff, src + 16 + soff, len);
+	for (i = 0; i < len + 40; i++) {
+		u8 want = 0x5a;
+
+		if (i >= 16 + doff && i < 16 + doff + len)
+			want = src[i - doff + soff];
+		if (dst[i] != want || left) {
+			printk(KERN_ERR "copy_bench: %s of %lu bytes from +%u "
+			       "to +%u: byte %lu is %02x, expected %02x, "
+			       "%lu left\n", f->name, len, soff, doff,
+			       i - 16 - doff, dst[i], want, left);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static int __init copy_test(const struct copy_bench_fn *f, u8 *src, u8 *dst)
+{
+	static const unsigned long big[] = { 511, 1000, 1500, 4096, 8191 };
+	unsigned long len;
+	unsigned int i, soff, doff;
+	int err;
+
+	if (copy_is_page(f))
+		return copy_test_one(f, src, dst, PAGE_SIZE, 0, 0);
+
+	for (i = 0; i <= 256 + ARRAY_SIZE(big); i++) {
+		len = i <= 256 ? i : big[i - 257];
+		for (soff = 0; soff < 8; soff++) {
+			for (doff = 0; doff < 8; doff++) {
+				err = copy_test_one(f, src, dst, len, soff,
+						    doff);
+				if (err)
+					return err;
+			}
+		}
+		cond_resched();
+	}
+	return 0;
+}
+
+static void __init copy_bench_one(const struct copy_bench_fn *f, u8 *src,
+				  u8 *dst, unsigned long span, size_t size,
+				  unsigned int soff, unsigned int doff)
+{
+	u64 total = (u64)mbytes << 20, done, ns;
+	unsigned long pos = 0, stride = ALIGN(size + 32, PAGE_SIZE);
+	ktime_t start;
+
+	start = ktime_get();
+	for (done = 0; done < total; done += size) {
+		f->copy(dst + pos + doff, src + pos + soff, size);
+		pos += stride;
+		if (pos + stride > span)
+			pos = 0;
+		if ((done & ((1 << 20) - 1)) < size)
+			cond_resched();
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (!ns)
+		ns = 1;
+
+	printk(KERN_INFO "copy_bench: %-24s %6zu bytes src+%u dst+%u %s: "
+	       "%llu MB/s\n", f->name, size, soff, doff,
+	       span > stride ? "cold" : "hot ",
+	       div64_u64(done * NSEC_PER_SEC, ns << 20));
+}
+
+static int __init copy_bench_init(void)
+{
+	unsigned long span = (unsigned long)span_kb << 10;
+	const struct copy_bench_fn *f;
+	unsigned int i, s, so, dof;
+	mm_segment_t fs;
+	u8 *src, *dst;
+	int err = 0;
+
+	if (!mbytes || span < 2 * PAGE_SIZE)
+		return -EINVAL;
+	for (i = 0; i < nr_sizes; i++)
+		if (!sizes[i] || ALIGN(sizes[i] + 32, PAGE_SIZE) > span)
+			return -EINVAL;
+	for (i = 0; i < nr_offsets; i++)
+		if (offsets[i] >= 32)
+			return -EINVAL;
+
+	/* The cold runs want the linear mapping, as the page cache has. */
+	src = alloc_pages_exact(span, GFP_KERNEL | __GFP_NOWARN);
+	dst = alloc_pages_exact(span, GFP_KERNEL | __GFP_NOWARN);
+	if (!src || !dst) {
+		if (src)
+			free_pages_exact(src, span);
+		if (dst)
+			free_pages_exact(dst, span);
+		printk(KERN_INFO "copy_bench: using vmalloc()ed buffers\n");
+		src = vmalloc(span);
+		dst = vmalloc(span);
+		if (!src || !dst) {
+			err = -ENOMEM;
+			goto out;
+		}
+	}
+
+	fs = get_fs();
+	set_fs(KERNEL_DS);
+
+	for (f = copy_fns; f < copy_fns + ARRAY_SIZE(copy_fns); f++) {
+		*f->fn = f->impl;
+		err = copy_test(f, src, dst);
+		if (err)
+			goto out_fs;
+	}
+	printk(KERN_INFO "copy_bench: self test passed\n");
+
+	for (f = copy_fns; f < copy_fns + ARRAY_SIZE(copy_fns); f++) {
+		*f->fn = f->impl;
+		if (copy_is_page(f)) {
+			copy_bench_one(f, src, dst, PAGE_SIZE, PAGE_SIZE, 0, 0);
+			copy_bench_one(f, src, dst, span, PAGE_SIZE, 0, 0);
+			continue;
+		}
+		for (s = 0; s < nr_sizes; s++) {
+			for (so = 0; so < nr_offsets; so++) {
+				for (dof = 0; dof < nr_offsets; dof++) {
+					copy_bench_one(f, src, dst, 0, sizes[s],
+						       offsets[so],
+						       offsets[dof]);
+					copy_bench_one(f, src, dst, span,
+						       sizes[s], offsets[so],
+						       offsets[dof]);
+				}
+			}
+		}
+	}
+
+	/* Nothing to keep loaded for. */
+	err = -EAGAIN;
+out_fs:
+	set_fs(fs);
+out:
+	if (src && is_vmalloc_addr(src))
+		vfree(src);
+	else if (src)
+		free_pages_exact(src, span);
+	if (dst && is_vmalloc_addr(dst))
+		vfree(dst);
+	else if (dst)
+		free_pages_exact(dst, span);
+	return err;
+}
+
+static void __exit copy_bench_exit(void)
+{
+}
+
+module_init(copy_bench_init);
+module_exit(copy_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("memcpy and user copy self test and bandwidth benchmark");
@@ -357,7 +357,11 @@ int tegra_dma_get_transfer_count(struct tegra_dma_channel *ch,
 		return req->bytes_transferred;
 	}
 
-	if (req->status != TEGRA_DMA_REQ_INFLIGHT) {
+	/* A continuous double buffer request past its half way mark is still
+	 * running, even if its status has already been set to success.
+	 */
+	if (req->status != TEGRA_DMA_REQ_INFLIGHT &&
+	    req->buffer_status != TEGRA_DMA_REQ_BUF_STATUS_HALF_FULL) {
 		spin_unlock_irqrestore(&ch->lock, irq_flags);
 		pr_debug("The dma request is not running\n");
 		return req->bytes_transferred;
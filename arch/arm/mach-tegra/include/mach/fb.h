@@ -21,6 +21,7 @@
 #define __MACH_TEGRA_FB_H
 
 #include <linux/fb.h>
+#include <linux/ktime.h>
 
 struct nvhost_device;
 struct tegra_dc;
@@ -39,6 +40,8 @@ void tegra_fb_update_monspecs(struct tegra_fb_info *fb_info,
 			      bool (*mode_filter)(struct fb_videomode *mode));
 /* called by display controller on suspend */
 void tegra_fb_suspend(struct tegra_fb_info *tegra_fb);
+/* called by display controller on vblank, from its interrupt */
+void tegra_fb_vblank(struct tegra_fb_info *tegra_fb, ktime_t timestamp);
 #if defined(CONFIG_MACH_N1)
 void tegra_fb_update_address(struct tegra_fb_info *fb_info, struct tegra_dc_win *win);
 #endif
@@ -68,6 +71,10 @@ static inline void tegra_fb_update_monspecs(struct tegra_fb_info *fb_info,
 static inline void tegra_fb_suspend(struct tegra_fb_info *tegra_fb)
 {
 }
+static inline void tegra_fb_vblank(struct tegra_fb_info *tegra_fb,
+				   ktime_t timestamp)
+{
+}
 #endif
 
 #endif
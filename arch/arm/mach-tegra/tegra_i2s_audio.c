@@ -49,6 +49,9 @@
 #include <linux/tegra_audio.h>
 #include <linux/pm.h>
 #include <linux/workqueue.h>
+#include <linux/poll.h>
+#include <linux/mm.h>
+#include <linux/seq_file.h>
 
 #include <mach/dma.h>
 #include <mach/iomap.h>
@@ -69,6 +72,12 @@
 #define I2S_DEFAULT_TX_NUM_BUFS 2
 #define I2S_DEFAULT_RX_NUM_BUFS 2
 
+/* Low-latency ring mode: periods in flight, and limits on the ring. */
+#define I2S_RING_REQS		2
+#define I2S_RING_MIN_PERIOD	128
+#define I2S_RING_MAX_PERIODS	32
+#define I2S_RING_MAX_SIZE	(64 * 1024)
+
 /* per stream (input/output) */
 struct audio_stream {
 	int opened;
@@ -92,6 +101,38 @@ struct audio_stream {
 	struct work_struct allow_suspend_work;
 	struct wake_lock wake_lock;
 	char wake_lock_name[100];
+
+	bool capture;
+
+	/* Low-latency ring mode.  The DMA runs over the ring one period at a
+	 * time, with I2S_RING_REQS periods queued, and each completion queues
+	 * the next period from the DMA callback.  ring_appl is how far
+	 * userspace has got, as of its last RING_SYNC.
+	 */
+	void *ring;
+	dma_addr_t ring_phys;
+	unsigned int ring_bytes;
+	unsigned int period_size;
+	unsigned int num_periods;
+	atomic_t ring_mapped;
+	bool ring_running;
+	bool ring_xrun;
+	struct tegra_dma_req ring_req[I2S_RING_REQS];
+	int ring_head;
+	int ring_tail;
+	unsigned int ring_next;
+	u64 ring_periods;
+	u64 ring_appl;
+	wait_queue_head_t ring_wait;
+
+	/* ring statistics, since RING_START */
+	unsigned int ring_xruns;
+	ktime_t ring_last;
+	u64 ring_intervals;
+	u64 ring_interval_ns;
+	u64 ring_interval_max_ns;
+	u64 ring_fill_last;
+	u64 ring_fill_max;
 };
 
 /* per i2s controller */
@@ -135,6 +176,11 @@ static inline int buf_size(struct audio_stream *s __attribute__((unused)))
 	return 1 << PCM_BUFFER_MAX_SIZE_ORDER;
 }
 
+static inline unsigned int ring_size(struct audio_stream *s)
+{
+	return s->period_size * s->num_periods;
+}
+
 static inline struct audio_driver_state *ads_from_misc_out(struct file *file)
 {
 	struct miscdevice *m = file->private_data;
@@ -996,6 +1042,296 @@ static void stop_dma_recording(struct audio_stream *ais)
 		pr_warn("%s: spinny\n", __func__);
 }
 
+/* Low-latency ring mode.  This mirrors what tegra_pcm does for ALSA: a
+ * write-combined buffer that userspace maps, split into periods that are
+ * queued to the DMA I2S_RING_REQS at a time, with the position read back
+ * from the DMA controller in between completions.
+ */
+
+/* Called with as->dma_req_lock taken. */
+static int ring_queue_period(struct audio_stream *as)
+{
+	struct tegra_dma_req *req;
+	dma_addr_t addr;
+
+	as->ring_tail = (as->ring_tail + 1) % I2S_RING_REQS;
+	req = &as->ring_req[as->ring_tail];
+	addr = as->ring_phys + as->ring_next * as->period_size;
+	if (as->capture)
+		req->dest_addr = addr;
+	else
+		req->source_addr = addr;
+	req->size = as->period_size;
+	as->ring_next = (as->ring_next + 1) % as->num_periods;
+	return tegra_dma_enqueue_req(as->dma_chan, req);
+}
+
+/* Called with as->dma_req_lock taken. */
+static u64 ring_hw_bytes(struct audio_stream *as)
+{
+	u64 hw = as->ring_periods * as->period_size;
+	int count;
+
+	if (as->ring_running) {
+		count = tegra_dma_get_transfer_count(as->dma_chan,
+				&as->ring_req[as->ring_head], false);
+		if (count > 0)
+			hw += min_t(unsigned int, count, as->period_size);
+	}
+	return hw;
+}
+
+static unsigned int ring_avail(struct audio_stream *as, u64 appl, u64 hw)
+{
+	if (as->capture)
+		return appl > hw ? 0 : min_t(u64, hw - appl, ring_size(as));
+	if (appl < hw)
+		return ring_size(as);
+	return appl - hw > ring_size(as) ? 0 : ring_size(as) - (appl - hw);
+}
+
+static void dma_ring_complete_callback(struct tegra_dma_req *req)
+{
+	struct audio_stream *as = req->dev;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	u64 hw, ns;
+	bool xrun;
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+
+	if (!as->ring_running || req->status != TEGRA_DMA_REQ_SUCCESS) {
+		spin_unlock_irqrestore(&as->dma_req_lock, flags);
+		return;
+	}
+
+	as->ring_head = (as->ring_head + 1) % I2S_RING_REQS;
+	if (as->ring_periods++) {
+		ns = ktime_to_ns(ktime_sub(now, as->ring_last));
+		as->ring_intervals++;
+		as->ring_interval_ns += ns;
+		if (ns > as->ring_interval_max_ns)
+			as->ring_interval_max_ns = ns;
+	}
+	as->ring_last = now;
+
+	hw = as->ring_periods * as->period_size;
+	if (as->capture)
+		xrun = hw - min(hw, as->ring_appl) > ring_size(as);
+	else
+		xrun = as->ring_appl < hw;
+	if (xrun && !as->ring_xrun) {
+		pr_debug("%s: %s\n", __func__,
+			as->capture ? "capture overflow" : "playback underflow");
+		as->ring_xruns++;
+	}
+	as->ring_xrun = xrun;
+
+	/* Rather than loop what is left in the ring, play silence until
+	 * userspace catches up.
+	 */
+	if (xrun && !as->capture)
+		memset(as->ring + as->ring_next * as->period_size, 0,
+			as->period_size);
+
+	if (ring_queue_period(as))
+		pr_err("%s: could not queue the next period\n", __func__);
+
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+
+	wake_up_interruptible(&as->ring_wait);
+}
+
+/* Called with as->lock taken. */
+static int ring_set_config(struct audio_driver_state *ads,
+		struct audio_stream *as, unsigned long arg)
+{
+	struct tegra_audio_ring_config cfg;
+
+	if (copy_from_user(&cfg, (const void __user *)arg, sizeof(cfg)))
+		return -EFAULT;
+
+	if (as->ring_running || as->active || pending_buffer_requests(as)) {
+		pr_err("%s: %s in progress\n", __func__,
+			as->capture ? "recording" : "playback");
+		return -EBUSY;
+	}
+	if (atomic_read(&as->ring_mapped)) {
+		pr_err("%s: ring is mapped\n", __func__);
+		return -EBUSY;
+	}
+	if (cfg.num_periods &&
+	    (cfg.num_periods < 2 || cfg.num_periods > I2S_RING_MAX_PERIODS ||
+	     cfg.period_size < I2S_RING_MIN_PERIOD ||
+	     !IS_ALIGNED(cfg.period_size, 4) ||
+	     cfg.period_size > I2S_RING_MAX_SIZE / cfg.num_periods)) {
+		pr_err("%s: invalid ring of %u periods of %u bytes\n",
+			__func__, cfg.num_periods, cfg.period_size);
+		return -EINVAL;
+	}
+
+	if (as->ring) {
+		dma_free_writecombine(&ads->pdev->dev, as->ring_bytes,
+				as->ring, as->ring_phys);
+		as->ring = NULL;
+		as->ring_bytes = 0;
+	}
+	as->num_periods = 0;
+	as->period_size = 0;
+	as->ring_appl = 0;
+
+	if (!cfg.num_periods)
+		return 0;
+
+	as->ring_bytes = PAGE_ALIGN(cfg.period_size * cfg.num_periods);
+	as->ring = dma_alloc_writecombine(&ads->pdev->dev, as->ring_bytes,
+			&as->ring_phys, GFP_KERNEL);
+	if (!as->ring) {
+		pr_err("%s: could not allocate %u byte ring\n", __func__,
+			as->ring_bytes);
+		as->ring_bytes = 0;
+		return -ENOMEM;
+	}
+	memset(as->ring, 0, as->ring_bytes);
+	as->period_size = cfg.period_size;
+	as->num_periods = cfg.num_periods;
+	pr_debug("%s: %u periods of %u bytes\n", __func__,
+		as->num_periods, as->period_size);
+	return 0;
+}
+
+static int ring_get_config(struct audio_stream *as, unsigned long arg)
+{
+	struct tegra_audio_ring_config cfg = {
+		.period_size = as->period_size,
+		.num_periods = as->num_periods,
+	};
+
+	if (copy_to_user((void __user *)arg, &cfg, sizeof(cfg)))
+		return -EFAULT;
+	return 0;
+}
+
+/* Called with as->lock taken. */
+static void ring_stop(struct audio_stream *as)
+{
+	unsigned long flags;
+
+	if (!as->ring_running)
+		return;
+
+	pr_debug("%s\n", __func__);
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	as->ring_running = false;
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+
+	tegra_dma_cancel(as->dma_chan);
+	if (as->capture)
+		sound_ops->stop_recording(as);
+	else {
+		spin_lock_irqsave(&as->dma_req_lock, flags);
+		sound_ops->stop_playback(as);
+		spin_unlock_irqrestore(&as->dma_req_lock, flags);
+	}
+	as->ring_appl = 0;
+	wake_up_interruptible(&as->ring_wait);
+	allow_suspend(as);
+}
+
+/* Called with as->lock taken. */
+static int ring_start(struct audio_driver_state *ads, struct audio_stream *as)
+{
+	unsigned long flags;
+	int rc = 0;
+	int i;
+
+	if (!as->num_periods)
+		return -EINVAL;
+	if (as->ring_running || as->active || pending_buffer_requests(as))
+		return -EBUSY;
+
+	for (i = 0; i < I2S_RING_REQS; i++) {
+		if (as->capture)
+			setup_dma_rx_request(&as->ring_req[i], as);
+		else
+			setup_dma_tx_request(&as->ring_req[i], as);
+		as->ring_req[i].complete = dma_ring_complete_callback;
+	}
+	as->ring_head = 0;
+	as->ring_tail = I2S_RING_REQS - 1;
+	as->ring_next = 0;
+	as->ring_periods = 0;
+	as->ring_xrun = false;
+	as->ring_xruns = 0;
+	as->ring_intervals = 0;
+	as->ring_interval_ns = 0;
+	as->ring_interval_max_ns = 0;
+	as->ring_fill_last = 0;
+	as->ring_fill_max = 0;
+	if (as->capture)
+		as->ring_appl = 0;
+
+	prevent_suspend(as);
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	as->ring_running = true;
+	if (!as->capture) {
+		i2s_fifo_set_attention_level(ads->i2s_base,
+				I2S_FIFO_TX, as->i2s_fifo_atn_level);
+		i2s_fifo_enable(ads->i2s_base, I2S_FIFO_TX, 1);
+	}
+	for (i = 0; i < I2S_RING_REQS && !rc; i++)
+		rc = ring_queue_period(as);
+	if (as->capture) {
+		i2s_fifo_set_attention_level(ads->i2s_base,
+				I2S_FIFO_RX, as->i2s_fifo_atn_level);
+		i2s_fifo_enable(ads->i2s_base, I2S_FIFO_RX, 1);
+	}
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+
+	if (rc) {
+		pr_err("%s: could not queue DMA: %d\n", __func__, rc);
+		ring_stop(as);
+	}
+	return rc;
+}
+
+/* Called with as->lock taken. */
+static int ring_sync(struct audio_stream *as, unsigned long arg)
+{
+	struct tegra_audio_ring_sync sync;
+	unsigned long flags;
+	u64 fill, pos;
+
+	if (copy_from_user(&sync, (const void __user *)arg, sizeof(sync)))
+		return -EFAULT;
+	if (!as->num_periods)
+		return -EINVAL;
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	as->ring_appl = sync.appl_bytes;
+	sync.hw_bytes = ring_hw_bytes(as);
+	sync.tstamp_ns = ktime_to_ns(ktime_get());
+	sync.xruns = as->ring_xruns;
+
+	if (as->capture)
+		fill = sync.hw_bytes - min(sync.hw_bytes, sync.appl_bytes);
+	else
+		fill = sync.appl_bytes - min(sync.hw_bytes, sync.appl_bytes);
+	as->ring_fill_last = fill;
+	if (as->ring_running && fill > as->ring_fill_max)
+		as->ring_fill_max = fill;
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+
+	pos = sync.hw_bytes;
+	sync.hw_ptr = do_div(pos, ring_size(as));
+	sync.avail = ring_avail(as, sync.appl_bytes, sync.hw_bytes);
+
+	if (copy_to_user((void __user *)arg, &sync, sizeof(sync)))
+		return -EFAULT;
+	return 0;
+}
+
 static irqreturn_t i2s_interrupt(int irq, void *data)
 {
 	struct audio_driver_state *ads = data;
@@ -1028,6 +1364,12 @@ static ssize_t tegra_audio_write(struct file *file,
 
 	pr_debug("%s: write %d bytes\n", __func__, size);
 
+	if (ads->out.ring_running) {
+		pr_err("%s: ring playback in progress\n", __func__);
+		rc = -EBUSY;
+		goto done;
+	}
+
 	if (ads->out.stop) {
 		pr_debug("%s: playback has been cancelled\n", __func__);
 		goto done;
@@ -1132,6 +1474,21 @@ static long tegra_audio_out_ioctl(struct file *file,
 				&aos->num_bufs, sizeof(aos->num_bufs)))
 			rc = -EFAULT;
 		break;
+	case TEGRA_AUDIO_OUT_SET_RING:
+		rc = ring_set_config(ads, aos, arg);
+		break;
+	case TEGRA_AUDIO_OUT_GET_RING:
+		rc = ring_get_config(aos, arg);
+		break;
+	case TEGRA_AUDIO_OUT_RING_START:
+		rc = ring_start(ads, aos);
+		break;
+	case TEGRA_AUDIO_OUT_RING_STOP:
+		ring_stop(aos);
+		break;
+	case TEGRA_AUDIO_OUT_RING_SYNC:
+		rc = ring_sync(aos, arg);
+		break;
 	default:
 		rc = -EINVAL;
 	}
@@ -1184,7 +1541,8 @@ static long tegra_audio_ioctl(struct file *file,
 	if (dma_restart) {
 		pr_debug("%s: Restarting DMA due to configuration change.\n",
 			__func__);
-		if (pending_buffer_requests(&ads->out) || ads->in.active) {
+		if (pending_buffer_requests(&ads->out) || ads->in.active ||
+				ads->out.ring_running || ads->in.ring_running) {
 			pr_err("%s: dma busy, cannot restart.\n", __func__);
 			rc = -EBUSY;
 			goto done;
@@ -1288,6 +1646,21 @@ static long tegra_audio_in_ioctl(struct file *file,
 				&ais->num_bufs, sizeof(ais->num_bufs)))
 			rc = -EFAULT;
 		break;
+	case TEGRA_AUDIO_IN_SET_RING:
+		rc = ring_set_config(ads, ais, arg);
+		break;
+	case TEGRA_AUDIO_IN_GET_RING:
+		rc = ring_get_config(ais, arg);
+		break;
+	case TEGRA_AUDIO_IN_RING_START:
+		rc = ring_start(ads, ais);
+		break;
+	case TEGRA_AUDIO_IN_RING_STOP:
+		ring_stop(ais);
+		break;
+	case TEGRA_AUDIO_IN_RING_SYNC:
+		rc = ring_sync(ais, arg);
+		break;
 	default:
 		rc = -EINVAL;
 	}
@@ -1315,6 +1688,12 @@ static ssize_t tegra_audio_read(struct file *file, char __user *buf,
 
 	pr_debug("%s: size %d\n", __func__, size);
 
+	if (ads->in.ring_running) {
+		pr_err("%s: ring recording in progress\n", __func__);
+		rc = -EBUSY;
+		goto done;
+	}
+
 	/* If we want recording to stop immediately after it gets cancelled,
 	 * then we do not want to wait for the fifo to get drained.
 	 */
@@ -1419,6 +1798,7 @@ static int tegra_audio_out_release(struct inode *inode, struct file *file)
 
 	mutex_lock(&ads->out.lock);
 	ads->out.opened = 0;
+	ring_stop(&ads->out);
 	request_stop_nosync(&ads->out);
 	if (stop_playback_if_necessary(&ads->out))
 		pr_debug("%s: done (stopped)\n", __func__);
@@ -1464,6 +1844,7 @@ static int tegra_audio_in_release(struct inode *inode, struct file *file)
 
 	mutex_lock(&ads->in.lock);
 	ads->in.opened = 0;
+	ring_stop(&ads->in);
 	if (ads->in.active) {
 		sound_ops->stop_recording(&ads->in);
 		complete(&ads->in.stop_completion);
@@ -1475,11 +1856,103 @@ static int tegra_audio_in_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static void tegra_audio_vm_open(struct vm_area_struct *vma)
+{
+	struct audio_stream *as = vma->vm_private_data;
+	atomic_inc(&as->ring_mapped);
+}
+
+static void tegra_audio_vm_close(struct vm_area_struct *vma)
+{
+	struct audio_stream *as = vma->vm_private_data;
+	atomic_dec(&as->ring_mapped);
+}
+
+static const struct vm_operations_struct tegra_audio_vm_ops = {
+	.open = tegra_audio_vm_open,
+	.close = tegra_audio_vm_close,
+};
+
+static int tegra_audio_ring_mmap(struct audio_driver_state *ads,
+		struct audio_stream *as, struct vm_area_struct *vma)
+{
+	int rc;
+
+	mutex_lock(&as->lock);
+	if (!as->ring) {
+		pr_err("%s: no ring configured\n", __func__);
+		rc = -EINVAL;
+		goto done;
+	}
+	rc = dma_mmap_writecombine(&ads->pdev->dev, vma, as->ring,
+			as->ring_phys, as->ring_bytes);
+	if (rc)
+		goto done;
+	vma->vm_ops = &tegra_audio_vm_ops;
+	vma->vm_private_data = as;
+	tegra_audio_vm_open(vma);
+done:
+	mutex_unlock(&as->lock);
+	return rc;
+}
+
+static unsigned int tegra_audio_ring_poll(struct audio_stream *as,
+		struct file *file, poll_table *wait)
+{
+	unsigned int ready = as->capture ? POLLIN | POLLRDNORM :
+					POLLOUT | POLLWRNORM;
+	unsigned long flags;
+	unsigned int avail;
+	bool running;
+
+	/* Without a ring, read() and write() block by themselves. */
+	if (!as->num_periods)
+		return ready;
+
+	poll_wait(file, &as->ring_wait, wait);
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	running = as->ring_running;
+	avail = ring_avail(as, as->ring_appl,
+			as->ring_periods * as->period_size);
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+
+	if (as->capture && !running)
+		return POLLERR;
+	return avail >= as->period_size ? ready : 0;
+}
+
+static int tegra_audio_out_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct audio_driver_state *ads = ads_from_misc_out(file);
+	return tegra_audio_ring_mmap(ads, &ads->out, vma);
+}
+
+static unsigned int tegra_audio_out_poll(struct file *file, poll_table *wait)
+{
+	struct audio_driver_state *ads = ads_from_misc_out(file);
+	return tegra_audio_ring_poll(&ads->out, file, wait);
+}
+
+static int tegra_audio_in_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct audio_driver_state *ads = ads_from_misc_in(file);
+	return tegra_audio_ring_mmap(ads, &ads->in, vma);
+}
+
+static unsigned int tegra_audio_in_poll(struct file *file, poll_table *wait)
+{
+	struct audio_driver_state *ads = ads_from_misc_in(file);
+	return tegra_audio_ring_poll(&ads->in, file, wait);
+}
+
 static const struct file_operations tegra_audio_out_fops = {
 	.owner = THIS_MODULE,
 	.open = tegra_audio_out_open,
 	.release = tegra_audio_out_release,
 	.write = tegra_audio_write,
+	.mmap = tegra_audio_out_mmap,
+	.poll = tegra_audio_out_poll,
 };
 
 static const struct file_operations tegra_audio_in_fops = {
@@ -1487,6 +1960,8 @@ static const struct file_operations tegra_audio_in_fops = {
 	.open = tegra_audio_in_open,
 	.read = tegra_audio_read,
 	.release = tegra_audio_in_release,
+	.mmap = tegra_audio_in_mmap,
+	.poll = tegra_audio_in_poll,
 };
 
 static int tegra_audio_ctl_open(struct inode *inode, struct file *file)
@@ -1718,6 +2193,89 @@ done:
 
 static DEVICE_ATTR(rx_fifo_atn, 0644, rx_fifo_atn_show, rx_fifo_atn_store);
 
+#ifdef CONFIG_DEBUG_FS
+static void ring_stats_show(struct seq_file *s, const char *name,
+		struct audio_stream *as)
+{
+	unsigned long flags;
+	unsigned int xruns, period_size, num_periods;
+	u64 periods, intervals, interval_ns, interval_max_ns;
+	u64 fill_last, fill_max, avg_ns;
+	bool running;
+
+	spin_lock_irqsave(&as->dma_req_lock, flags);
+	running = as->ring_running;
+	period_size = as->period_size;
+	num_periods = as->num_periods;
+	periods = as->ring_periods;
+	xruns = as->ring_xruns;
+	intervals = as->ring_intervals;
+	interval_ns = as->ring_interval_ns;
+	interval_max_ns = as->ring_interval_max_ns;
+	fill_last = as->ring_fill_last;
+	fill_max = as->ring_fill_max;
+	spin_unlock_irqrestore(&as->dma_req_lock, flags);
+
+	if (!num_periods) {
+		seq_printf(s, "%s: no ring\n", name);
+		return;
+	}
+
+	avg_ns = intervals ? div64_u64(interval_ns, intervals) : 0;
+	seq_printf(s, "%s: %u periods of %u bytes, %s\n", name,
+		num_periods, period_size, running ? "running" : "stopped");
+	seq_printf(s, "  periods %llu, xruns %u\n", periods, xruns);
+	seq_printf(s, "  period time avg %llu us, max %llu us\n",
+		div_u64(avg_ns, NSEC_PER_USEC),
+		div_u64(interval_max_ns, NSEC_PER_USEC));
+	seq_printf(s, "  ring latency %llu us\n",
+		div_u64(avg_ns * num_periods, NSEC_PER_USEC));
+	seq_printf(s, "  buffered %llu bytes (%llu us), max %llu bytes "
+		"(%llu us)\n", fill_last,
+		div_u64(div_u64(fill_last * avg_ns, period_size),
+			NSEC_PER_USEC),
+		fill_max,
+		div_u64(div_u64(fill_max * avg_ns, period_size),
+			NSEC_PER_USEC));
+}
+
+static int tegra_audio_stats_show(struct seq_file *s, void *unused)
+{
+	struct audio_driver_state *ads = s->private;
+
+	if (ads->pdata->mask & TEGRA_AUDIO_ENABLE_TX)
+		ring_stats_show(s, "out", &ads->out);
+	if (ads->pdata->mask & TEGRA_AUDIO_ENABLE_RX)
+		ring_stats_show(s, "in", &ads->in);
+	return 0;
+}
+
+static int tegra_audio_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_audio_stats_show, inode->i_private);
+}
+
+static const struct file_operations tegra_audio_stats_fops = {
+	.open = tegra_audio_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void tegra_audio_debugfs_init(struct audio_driver_state *ads)
+{
+	char name[16];
+
+	snprintf(name, sizeof(name), "tegra_audio%d", ads->pdev->id);
+	debugfs_create_file(name, S_IRUGO, NULL, ads,
+			&tegra_audio_stats_fops);
+}
+#else
+static inline void tegra_audio_debugfs_init(struct audio_driver_state *ads)
+{
+}
+#endif
+
 static int tegra_audio_probe(struct platform_device *pdev)
 {
 	int rc, i;
@@ -1802,6 +2360,10 @@ static int tegra_audio_probe(struct platform_device *pdev)
 	if (rc < 0)
 		return rc;
 
+	/* for the ring buffers */
+	if (!pdev->dev.coherent_dma_mask)
+		pdev->dev.coherent_dma_mask = DMA_BIT_MASK(32);
+
 	if ((state->pdata->mask & TEGRA_AUDIO_ENABLE_TX)) {
 		state->out.opened = 0;
 		state->out.active = false;
@@ -1819,6 +2381,8 @@ static int tegra_audio_probe(struct platform_device *pdev)
 			state->out.buf_phy[i] = 0;
 		}
 		state->out.last_queued = 0;
+		atomic_set(&state->out.ring_mapped, 0);
+		init_waitqueue_head(&state->out.ring_wait);
 		rc = init_stream_buffer(&state->out, state->out.num_bufs);
 		if (rc < 0)
 			return rc;
@@ -1861,6 +2425,9 @@ static int tegra_audio_probe(struct platform_device *pdev)
 			state->in.buf_phy[i] = 0;
 		}
 		state->in.last_queued = 0;
+		state->in.capture = true;
+		atomic_set(&state->in.ring_mapped, 0);
+		init_waitqueue_head(&state->in.ring_wait);
 		rc = init_stream_buffer(&state->in, state->in.num_bufs);
 		if (rc < 0)
 			return rc;
@@ -1926,6 +2493,8 @@ static int tegra_audio_probe(struct platform_device *pdev)
 	state->in_config.rate = 11025;
 	state->in_config.stereo = false;
 
+	tegra_audio_debugfs_init(state);
+
 	return 0;
 }
 
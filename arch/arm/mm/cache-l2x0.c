@@ -21,6 +21,8 @@
 #include <linux/io.h>
 
 #include <asm/cacheflush.h>
+#include <asm/maint.h>
+#include <asm/sizes.h>
 #include <asm/hardware/cache-l2x0.h>
 
 #ifdef CONFIG_TRUSTED_FOUNDATIONS
@@ -32,6 +34,8 @@ void callGenericSMC(u32 param0, u32 param1, u32 param2);
 
 static void __iomem *l2x0_base;
 static uint32_t l2x0_way_mask;	/* Bitmask of active ways */
+static uint32_t l2x0_size;
+static uint32_t l2x0_sets;
 bool l2x0_disabled;
 
 static inline void cache_wait_always(void __iomem *reg, unsigned long mask)
@@ -48,10 +52,18 @@ static inline void cache_wait(void __iomem *reg, unsigned long mask)
 	/* cache operations are atomic */
 }
 
-#define _l2x0_lock(lock, flags)		((void)(flags))
-#define _l2x0_unlock(lock, flags)	((void)(flags))
-
-#define block_end(start, end)		(end)
+/*
+ * Line operations and syncs need no serialising against each other, but
+ * no operation may be issued while one by way runs in the background.
+ * Readers keep interrupts off, as a handler doing maintenance past
+ * outer_range_max_bytes would otherwise spin on its own CPU's read lock,
+ * and let go of it every block so that the by-way operations get in.
+ */
+static DEFINE_RWLOCK(l2x0_lock);
+#define _l2x0_lock(lock, flags)		read_lock_irqsave(lock, flags)
+#define _l2x0_unlock(lock, flags)	read_unlock_irqrestore(lock, flags)
+#define _l2x0_lock_all(lock, flags)	write_lock_irqsave(lock, flags)
+#define _l2x0_unlock_all(lock, flags)	write_unlock_irqrestore(lock, flags)
 
 #define L2CC_TYPE			"PL310/L2C-310"
 
@@ -62,13 +74,15 @@ static inline void cache_wait(void __iomem *reg, unsigned long mask)
 static DEFINE_SPINLOCK(l2x0_lock);
 #define _l2x0_lock(lock, flags)		spin_lock_irqsave(lock, flags)
 #define _l2x0_unlock(lock, flags)	spin_unlock_irqrestore(lock, flags)
-
-#define block_end(start, end)		((start) + min((end) - (start), 4096UL))
+#define _l2x0_lock_all			_l2x0_lock
+#define _l2x0_unlock_all		_l2x0_unlock
 
 #define L2CC_TYPE			"L2x0"
 
 #endif	/* CONFIG_CACHE_PL310 */
 
+#define block_end(start, end)		((start) + min((end) - (start), 4096UL))
+
 static inline void cache_sync(void)
 {
 	void __iomem *base = l2x0_base;
@@ -141,11 +155,23 @@ static inline void l2x0_inv_all(void)
 	unsigned long flags;
 
 	/* invalidate all ways */
-	_l2x0_lock(&l2x0_lock, flags);
+	_l2x0_lock_all(&l2x0_lock, flags);
 	writel_relaxed(l2x0_way_mask, l2x0_base + L2X0_INV_WAY);
 	cache_wait_always(l2x0_base + L2X0_INV_WAY, l2x0_way_mask);
 	cache_sync();
-	_l2x0_unlock(&l2x0_lock, flags);
+	_l2x0_unlock_all(&l2x0_lock, flags);
+}
+
+static inline void l2x0_clean_all(void)
+{
+	unsigned long flags;
+
+	/* clean all ways */
+	_l2x0_lock_all(&l2x0_lock, flags);
+	writel_relaxed(l2x0_way_mask, l2x0_base + L2X0_CLEAN_WAY);
+	cache_wait_always(l2x0_base + L2X0_CLEAN_WAY, l2x0_way_mask);
+	cache_sync();
+	_l2x0_unlock_all(&l2x0_lock, flags);
 }
 
 static inline void l2x0_flush_all(void)
@@ -153,18 +179,62 @@ static inline void l2x0_flush_all(void)
 	unsigned long flags;
 
 	/* flush all ways */
+	_l2x0_lock_all(&l2x0_lock, flags);
+	writel(l2x0_way_mask, l2x0_base + L2X0_CLEAN_INV_WAY);
+	cache_wait_always(l2x0_base + L2X0_CLEAN_INV_WAY, l2x0_way_mask);
+	cache_sync();
+	_l2x0_unlock_all(&l2x0_lock, flags);
+}
+
+#ifdef CONFIG_CACHE_PL310
+/*
+ * Clean and invalidate every line by set and way.  Unlike the operation
+ * by way this doesn't run in the background, which the PL310 r2p0 can
+ * get wrong (erratum 727915), and it costs the same for any range.
+ */
+static void l2x0_flush_all_lines(void)
+{
+	void __iomem *base = l2x0_base;
+	unsigned long flags;
+	uint32_t way, set;
+
+	for (way = 0; l2x0_way_mask >> way; way++) {
+		for (set = 0; set < l2x0_sets; ) {
+			uint32_t blk_end = min(l2x0_sets,
+					       set + 4096 / CACHE_LINE_SIZE);
+
+			_l2x0_lock(&l2x0_lock, flags);
+			debug_writel(0x03);
+			for (; set < blk_end; set++)
+				writel_relaxed((way << 28) |
+					       (set * CACHE_LINE_SIZE),
+					       base + L2X0_CLEAN_INV_LINE_IDX);
+			debug_writel(0x00);
+			_l2x0_unlock(&l2x0_lock, flags);
+		}
+	}
+
 	_l2x0_lock(&l2x0_lock, flags);
-	writel(0xff, l2x0_base + L2X0_CLEAN_INV_WAY);
-	cache_wait_always(l2x0_base + L2X0_CLEAN_INV_WAY, 0xff);
 	cache_sync();
 	_l2x0_unlock(&l2x0_lock, flags);
 }
+#else
+#define l2x0_flush_all_lines	l2x0_flush_all
+#endif
 
 static void l2x0_inv_range(unsigned long start, unsigned long end)
 {
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
 
+	/* Lines dirty outside the range can't be dropped, so clean too. */
+	if (end - start > outer_range_max_bytes) {
+		count_maint(MAINT_OUTER_ALL);
+		l2x0_flush_all_lines();
+		return;
+	}
+	count_maint(MAINT_OUTER_RANGE);
+
 	_l2x0_lock(&l2x0_lock, flags);
 	if (start & (CACHE_LINE_SIZE - 1)) {
 		start &= ~(CACHE_LINE_SIZE - 1);
@@ -204,6 +274,13 @@ static void l2x0_clean_range(unsigned long start, unsigned long end)
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
 
+	if (end - start > outer_range_max_bytes) {
+		count_maint(MAINT_OUTER_ALL);
+		l2x0_clean_all();
+		return;
+	}
+	count_maint(MAINT_OUTER_RANGE);
+
 	_l2x0_lock(&l2x0_lock, flags);
 	start &= ~(CACHE_LINE_SIZE - 1);
 	while (start < end) {
@@ -229,6 +306,13 @@ static void l2x0_flush_range(unsigned long start, unsigned long end)
 	void __iomem *base = l2x0_base;
 	unsigned long flags;
 
+	if (end - start > outer_range_max_bytes) {
+		count_maint(MAINT_OUTER_ALL);
+		l2x0_flush_all_lines();
+		return;
+	}
+	count_maint(MAINT_OUTER_RANGE);
+
 	_l2x0_lock(&l2x0_lock, flags);
 	start &= ~(CACHE_LINE_SIZE - 1);
 	while (start < end) {
@@ -354,6 +438,10 @@ static void l2x0_enable(__u32 aux_val, __u32 aux_mask)
 
 	l2x0_way_mask = (1 << ways) - 1;
 
+	/* Way size in aux[19:17]: 1 is 16KB, 2 is 32KB and so on */
+	l2x0_size = ways * (SZ_8K << ((aux >> 17) & 7));
+	l2x0_sets = l2x0_size / ways / CACHE_LINE_SIZE;
+
 	/*
 	 * Check if l2x0 controller is already enabled.
 	 * If you are booting from non-secure mode
@@ -431,6 +519,9 @@ void __init l2x0_init(void __iomem *base, __u32 aux_val, __u32 aux_mask)
 	outer_cache.clean_range = l2x0_clean_range;
 	outer_cache.flush_range = l2x0_flush_range;
 	outer_cache.sync = l2x0_cache_sync;
+#ifndef CONFIG_TRUSTED_FOUNDATIONS
+	outer_range_max_bytes = l2x0_size;
+#endif
 #ifdef CONFIG_KERNEL_DEBUG_SEC
 	outer_cache.flush_all = l2x0_flush_all;
 #endif
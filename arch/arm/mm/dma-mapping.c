@@ -15,6 +15,7 @@
 #include <linux/errno.h>
 #include <linux/list.h>
 #include <linux/init.h>
+#include <linux/interrupt.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 
@@ -23,6 +24,7 @@
 #include <asm/cacheflush.h>
 #include <asm/tlbflush.h>
 #include <asm/sizes.h>
+#include <asm/maint.h>
 
 static u64 get_coherent_dma_mask(struct device *dev)
 {
@@ -410,6 +412,39 @@ void dma_free_coherent(struct device *dev, size_t size, void *cpu_addr, dma_addr
 }
 EXPORT_SYMBOL(dma_free_coherent);
 
+static void dma_flush_cache_all(void *unused)
+{
+	__cpuc_flush_kern_all();
+}
+
+/*
+ * Clean and invalidate the inner caches as a whole rather than the
+ * size bytes of a buffer, if that is cheaper.  Set/way operations only
+ * reach the caches of the CPU doing them, and drivers map and sync
+ * buffers under spinlocks, where an IPI to the other CPUs could wait
+ * forever on one spinning on that lock with interrupts off.  So this
+ * is only done while a single CPU is online; disabling preemption
+ * keeps another from coming up meanwhile.
+ */
+static bool dma_cache_maint_all(size_t size)
+{
+	bool all = false;
+
+	if (size <= dma_range_max_bytes)
+		return false;
+
+	preempt_disable();
+	if (num_online_cpus() == 1) {
+		dma_flush_cache_all(NULL);
+		all = true;
+	}
+	preempt_enable();
+
+	if (all)
+		count_maint(MAINT_DMA_ALL);
+	return all;
+}
+
 /*
  * Make an area consistent for devices.
  * Note: Drivers should NOT use this function directly, as it will break
@@ -423,7 +458,10 @@ void ___dma_single_cpu_to_dev(const void *kaddr, size_t size,
 
 	BUG_ON(!virt_addr_valid(kaddr) || !virt_addr_valid(kaddr + size - 1));
 
-	dmac_map_area(kaddr, size, dir);
+	if (!dma_cache_maint_all(size)) {
+		count_maint(MAINT_DMA_RANGE);
+		dmac_map_area(kaddr, size, dir);
+	}
 
 	paddr = __pa(kaddr);
 	if (dir == DMA_FROM_DEVICE) {
@@ -445,6 +483,10 @@ void ___dma_single_dev_to_cpu(const void *kaddr, size_t size,
 	if (dir != DMA_TO_DEVICE) {
 		unsigned long paddr = __pa(kaddr);
 		outer_inv_range(paddr, paddr + size);
+
+		if (dma_cache_maint_all(size))
+			return;
+		count_maint(MAINT_DMA_RANGE);
 	}
 
 	dmac_unmap_area(kaddr, size, dir);
@@ -462,6 +504,8 @@ static void dma_cache_maint_page(struct page *page, unsigned long offset,
 	 * optimized out.
 	 */
 	size_t left = size;
+
+	count_maint(MAINT_DMA_RANGE);
 	do {
 		size_t len = left;
 		void *vaddr;
@@ -500,7 +544,8 @@ void ___dma_page_cpu_to_dev(struct page *page, unsigned long off,
 {
 	unsigned long paddr;
 
-	dma_cache_maint_page(page, off, size, dir, dmac_map_area);
+	if (!dma_cache_maint_all(size))
+		dma_cache_maint_page(page, off, size, dir, dmac_map_area);
 
 	paddr = page_to_phys(page) + off;
 	if (dir == DMA_FROM_DEVICE) {
@@ -522,7 +567,8 @@ void ___dma_page_dev_to_cpu(struct page *page, unsigned long off,
 	if (dir != DMA_TO_DEVICE)
 		outer_inv_range(paddr, paddr + size);
 
-	dma_cache_maint_page(page, off, size, dir, dmac_unmap_area);
+	if (dir == DMA_TO_DEVICE || !dma_cache_maint_all(size))
+		dma_cache_maint_page(page, off, size, dir, dmac_unmap_area);
 
 	/*
 	 * Mark the D-cache clean for this page to avoid extra flushing.
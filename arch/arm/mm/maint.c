@@ -0,0 +1,132 @@
+/*
+ *  linux/arch/arm/mm/maint.c
+ *
+ *  Whole TLB and cache fallbacks for large maintenance ranges
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Unmapping a multi-megabyte buffer invalidates its TLB entries a page
+ * at a time, although the main TLB only holds a few dozen of them, and
+ * mapping it for DMA cleans it a cache line at a time.  Ranges over the
+ * limits here take the whole address space or cache instead; the limits
+ * and how often each path was taken are in debugfs:
+ *
+ *	/sys/kernel/debug/arm_maint/stats
+ *	/sys/kernel/debug/arm_maint/tlb_range_max_pages
+ *	/sys/kernel/debug/arm_maint/dma_range_max_bytes
+ *	/sys/kernel/debug/arm_maint/outer_range_max_bytes
+ */
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <asm/maint.h>
+#include <asm/sizes.h>
+#include <asm/tlbflush.h>
+
+DEFINE_PER_CPU(struct arm_maint_state, arm_maint_states);
+
+/* The size of the Cortex-A9 main TLB */
+u32 tlb_range_max_pages = 64;
+EXPORT_SYMBOL_GPL(tlb_range_max_pages);
+
+/*
+ * Past this the inner caches are cleaned and invalidated by set/way,
+ * as long as only one CPU is online; with more, buffers are always
+ * maintained by line.
+ */
+u32 dma_range_max_bytes = SZ_256K;
+EXPORT_SYMBOL_GPL(dma_range_max_bytes);
+
+/* Set to the cache size by outer cache drivers with way operations. */
+u32 outer_range_max_bytes = ~0U;
+EXPORT_SYMBOL_GPL(outer_range_max_bytes);
+
+#ifdef CONFIG_MMU
+void local_flush_tlb_range(struct vm_area_struct *vma, unsigned long start,
+			   unsigned long end)
+{
+	if ((end - start) >> PAGE_SHIFT > tlb_range_max_pages) {
+		count_maint(MAINT_TLB_ASID);
+		local_flush_tlb_mm(vma->vm_mm);
+		return;
+	}
+
+	count_maint(MAINT_TLB_RANGE);
+	__cpu_flush_user_tlb_range(start, end, vma);
+}
+
+void local_flush_tlb_kernel_range(unsigned long start, unsigned long end)
+{
+	if ((end - start) >> PAGE_SHIFT > tlb_range_max_pages) {
+		count_maint(MAINT_TLB_KERN_ALL);
+		local_flush_tlb_all();
+		return;
+	}
+
+	count_maint(MAINT_TLB_KERN_RANGE);
+	__cpu_flush_kern_tlb_range(start, end);
+}
+#endif
+
+#ifdef CONFIG_DEBUG_FS
+static const char *const maint_item_names[NR_MAINT_ITEMS] = {
+	[MAINT_TLB_RANGE]	= "tlb_range",
+	[MAINT_TLB_ASID]	= "tlb_asid",
+	[MAINT_TLB_KERN_RANGE]	= "tlb_kern_range",
+	[MAINT_TLB_KERN_ALL]	= "tlb_kern_all",
+	[MAINT_DMA_RANGE]	= "dma_range",
+	[MAINT_DMA_ALL]		= "dma_all",
+	[MAINT_OUTER_RANGE]	= "outer_range",
+	[MAINT_OUTER_ALL]	= "outer_all",
+};
+
+static int maint_stats_show(struct seq_file *s, void *unused)
+{
+	unsigned long sum;
+	int i, cpu;
+
+	for (i = 0; i < NR_MAINT_ITEMS; i++) {
+		sum = 0;
+		for_each_possible_cpu(cpu)
+			sum += per_cpu(arm_maint_states, cpu).count[i];
+		seq_printf(s, "%-16s %lu\n", maint_item_names[i], sum);
+	}
+	return 0;
+}
+
+static int maint_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, maint_stats_show, NULL);
+}
+
+static const struct file_operations maint_stats_fops = {
+	.open		= maint_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init maint_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("arm_maint", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("stats", S_IRUGO, dir, NULL, &maint_stats_fops);
+	debugfs_create_u32("tlb_range_max_pages", S_IRUGO | S_IWUSR, dir,
+			   &tlb_range_max_pages);
+	debugfs_create_u32("dma_range_max_bytes", S_IRUGO | S_IWUSR, dir,
+			   &dma_range_max_bytes);
+	debugfs_create_u32("outer_range_max_bytes", S_IRUGO | S_IWUSR, dir,
+			   &outer_range_max_bytes);
+	return 0;
+}
+late_initcall(maint_debugfs_init);
+#endif
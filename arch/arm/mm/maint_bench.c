@@ -0,0 +1,188 @@
+/*
+ *  linux/arch/arm/mm/maint_bench.c
+ *
+ *  Cost of munmap() and dma_map_single() by size
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * For each size in sizes (in KB), an anonymous mapping of the loading
+ * process is faulted in and unmapped, and a dirty kernel buffer is
+ * mapped and unmapped for DMA to and from the device, runs times over.
+ * That is done three times: with all TLB and cache maintenance done by
+ * page or line, with all of it done on the whole TLB or cache, and with
+ * the limits as they were, which are restored afterwards:
+ *
+ *	modprobe maint_bench sizes=16,256,4096 runs=16
+ *
+ * While it runs other DMA in the system sees the same limits.  Results
+ * go to the kernel log; the module does not stay loaded.
+ */
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/mman.h>
+#include <linux/gfp.h>
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
+
+#include <asm/maint.h>
+
+static unsigned int sizes[8] = { 4, 16, 64, 256, 1024, 4096 };
+static unsigned int nr_sizes = 6;
+module_param_array(sizes, uint, &nr_sizes, 0);
+MODULE_PARM_DESC(sizes, "sizes to run, in KB");
+
+static unsigned int runs = 8;
+module_param(runs, uint, 0);
+MODULE_PARM_DESC(runs, "unmaps of each size to average over");
+
+static u64 maint_bench_dma_mask = DMA_BIT_MASK(32);
+
+static struct device maint_bench_dev = {
+	.init_name		= "maint_bench",
+	.dma_mask		= &maint_bench_dma_mask,
+	.coherent_dma_mask	= DMA_BIT_MASK(32),
+};
+
+struct maint_limits {
+	const char *name;
+	u32 tlb_pages;
+	u32 dma_bytes;
+	u32 outer_bytes;
+};
+
+static void maint_set_limits(const struct maint_limits *l)
+{
+	tlb_range_max_pages = l->tlb_pages;
+	dma_range_max_bytes = l->dma_bytes;
+	outer_range_max_bytes = l->outer_bytes;
+}
+
+/* Time to unmap size bytes of faulted in anonymous memory, in ns. */
+static s64 __init maint_bench_munmap(size_t size)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long addr, left;
+	ktime_t start;
+	int ret;
+
+	down_write(&mm->mmap_sem);
+	addr = do_mmap(NULL, 0, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, 0);
+	up_write(&mm->mmap_sem);
+	if (IS_ERR_VALUE(addr))
+		return addr;
+
+	left = clear_user((void __user *)addr, size);
+
+	start = ktime_get();
+	down_write(&mm->mmap_sem);
+	ret = do_munmap(mm, addr, size);
+	up_write(&mm->mmap_sem);
+	if (left)
+		return -EFAULT;
+	if (ret)
+		return ret;
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+/* Time to map and unmap a dirty buffer of size bytes for DMA, in ns. */
+static s64 __init maint_bench_dma(void *buf, size_t size,
+				  enum dma_data_direction dir)
+{
+	dma_addr_t handle;
+	ktime_t start;
+
+	memset(buf, 0x5a, size);
+
+	start = ktime_get();
+	handle = dma_map_single(&maint_bench_dev, buf, size, dir);
+	dma_unmap_single(&maint_bench_dev, handle, size, dir);
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int __init maint_bench_one(const struct maint_limits *l, size_t size)
+{
+	s64 unmap = 0, to_dev = 0, from_dev = 0, ns;
+	void *buf;
+	unsigned int i;
+
+	buf = alloc_pages_exact(size, GFP_KERNEL | __GFP_NOWARN);
+
+	maint_set_limits(l);
+	for (i = 0; i < runs; i++) {
+		ns = maint_bench_munmap(size);
+		if (ns < 0) {
+			if (buf)
+				free_pages_exact(buf, size);
+			return ns;
+		}
+		unmap += ns;
+
+		if (buf) {
+			to_dev += maint_bench_dma(buf, size, DMA_TO_DEVICE);
+			from_dev += maint_bench_dma(buf, size,
+						    DMA_FROM_DEVICE);
+		}
+		cond_resched();
+	}
+
+	if (buf) {
+		free_pages_exact(buf, size);
+		printk(KERN_INFO "maint_bench: %-7s %6zuKB: munmap %llu us, "
+		       "dma to device %llu us, from device %llu us\n", l->name,
+		       size >> 10, div64_u64(unmap, runs * NSEC_PER_USEC),
+		       div64_u64(to_dev, runs * NSEC_PER_USEC),
+		       div64_u64(from_dev, runs * NSEC_PER_USEC));
+	} else {
+		printk(KERN_INFO "maint_bench: %-7s %6zuKB: munmap %llu us, "
+		       "no buffer for dma\n", l->name, size >> 10,
+		       div64_u64(unmap, runs * NSEC_PER_USEC));
+	}
+	return 0;
+}
+
+static int __init maint_bench_init(void)
+{
+	struct maint_limits limits[] = {
+		{ "range", ~0U, ~0U, ~0U },
+		{ "whole", 0, 0, 0 },
+		{ "current", tlb_range_max_pages, dma_range_max_bytes,
+		  outer_range_max_bytes },
+	};
+	unsigned int i, s;
+	int err = 0;
+
+	if (!current->mm || !runs)
+		return -EINVAL;
+	for (s = 0; s < nr_sizes; s++)
+		if (!sizes[s] || sizes[s] > (64 << 10))
+			return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(limits) && !err; i++)
+		for (s = 0; s < nr_sizes && !err; s++)
+			err = maint_bench_one(&limits[i],
+					      (size_t)sizes[s] << 10);
+	maint_set_limits(&limits[ARRAY_SIZE(limits) - 1]);
+	if (err)
+		return err;
+
+	/* Nothing to keep loaded for. */
+	return -EAGAIN;
+}
+
+static void __exit maint_bench_exit(void)
+{
+}
+
+module_init(maint_bench_init);
+module_exit(maint_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("munmap and DMA mapping cost benchmark");
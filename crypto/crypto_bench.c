@@ -0,0 +1,617 @@
+/*
+ * Crypto API benchmark.
+ *
+ * Runs every registered implementation of an algorithm, or the drivers
+ * named, over each of a set of block sizes, thread counts and numbers of
+ * requests kept in flight per thread, and reports for each run the
+ * throughput, the distribution of request latencies and the CPU time
+ * spent per byte on all CPUs, interrupts and worker threads included:
+ *
+ *	modprobe crypto_bench alg="cbc(aes)" sizes=64,1024,8192 \
+ *		threads=1,0 inflight=1,8
+ *
+ * Block ciphers are run through the ablkcipher interface, encrypting
+ * and decrypting; hashes through the ahash interface, digesting.  When
+ * alg is a template, it is also instantiated on top of every
+ * implementation of the algorithm inside, so that cbc(aes) covers
+ * cbc(aes-generic) and cbc(aes-asm) as well as cbc-aes-tegra.  Drivers
+ * that complete requests synchronously are run with one request in
+ * flight only, since more could not overlap.
+ *
+ * Each run prints one line of key=value pairs to the kernel log:
+ *
+ *	crypto_bench: driver=cbc-aes-tegra alg=cbc(aes) async=1 op=enc
+ *		size=1024 threads=1 inflight=8 ops=... bytes=... ns=...
+ *		kBps=... lat_min_ns=... lat_p50_ns=... lat_p90_ns=...
+ *		lat_p99_ns=... lat_max_ns=... cpu_us=... cpu_ns_per_kB=...
+ *
+ * Latency percentiles are taken over a uniform sample of at most
+ * samples requests per thread.  The module does not stay loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <crypto/hash.h>
+#include <linux/crypto.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/kernel_stat.h>
+#include <linux/random.h>
+#include <linux/rwsem.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/tick.h>
+#include <linux/vmalloc.h>
+#include "internal.h"
+
+#define BENCH_MAX_DRIVERS	16
+#define BENCH_MAX_INFLIGHT	16
+
+static char *alg = "cbc(aes)";
+module_param(alg, charp, 0);
+MODULE_PARM_DESC(alg, "algorithm to benchmark the implementations of");
+
+static char *drivers = "";
+module_param(drivers, charp, 0);
+MODULE_PARM_DESC(drivers, "comma separated drivers to run instead of "
+			  "all implementations of alg");
+
+static unsigned int sizes[8] = { 16, 64, 256, 1024, 8192 };
+static unsigned int nr_sizes = 5;
+module_param_array(sizes, uint, &nr_sizes, 0);
+MODULE_PARM_DESC(sizes, "block sizes to run");
+
+static unsigned int threads[4] = { 1, 0 };
+static unsigned int nr_thread_counts = 2;
+module_param_array(threads, uint, &nr_thread_counts, 0);
+MODULE_PARM_DESC(threads, "thread counts to run, 0 for one per online CPU");
+
+static unsigned int inflight[4] = { 1, 8 };
+static unsigned int nr_inflight = 2;
+module_param_array(inflight, uint, &nr_inflight, 0);
+MODULE_PARM_DESC(inflight, "requests in flight per thread to run");
+
+static unsigned int msecs = 500;
+module_param(msecs, uint, 0);
+MODULE_PARM_DESC(msecs, "length of each run in milliseconds");
+
+static unsigned int keylen = 16;
+module_param(keylen, uint, 0);
+MODULE_PARM_DESC(keylen, "key length in bytes");
+
+static unsigned int samples = 4096;
+module_param(samples, uint, 0);
+MODULE_PARM_DESC(samples, "latencies sampled per thread");
+
+enum bench_op {
+	BENCH_ENCRYPT,
+	BENCH_DECRYPT,
+	BENCH_DIGEST,
+};
+
+static const char *const bench_op_names[] = { "enc", "dec", "digest" };
+
+struct bench_run {
+	const char *driver;
+	bool hash;
+	enum bench_op op;
+	unsigned int size;
+	unsigned int inflight;
+	struct completion go;
+	u64 end_ns;
+};
+
+struct bench_req {
+	union {
+		struct ablkcipher_request *creq;
+		struct ahash_request *hreq;
+	};
+	struct completion done;
+	ktime_t start, end;
+	int err;
+	bool pending;
+	struct scatterlist sg;
+	u8 iv[32];
+	u8 out[64];
+};
+
+struct bench_thread {
+	struct bench_run *run;
+	struct completion done;
+	unsigned long ops;
+	u32 *lat;
+	unsigned int nlat;
+	u64 lat_max;
+	int err;
+};
+
+static void bench_complete(struct crypto_async_request *base, int err)
+{
+	struct bench_req *r = base->data;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	r->end = ktime_get();
+	r->err = err;
+	complete(&r->done);
+}
+
+/* Keeps a uniform sample of the latencies: reservoir sampling. */
+static void bench_record(struct bench_thread *t, struct bench_req *r)
+{
+	u64 ns = ktime_to_ns(ktime_sub(r->end, r->start));
+	unsigned long slot;
+
+	if (r->err && !t->err)
+		t->err = r->err;
+
+	t->ops++;
+	if (ns > t->lat_max)
+		t->lat_max = ns;
+
+	if (t->nlat < samples) {
+		slot = t->nlat++;
+	} else {
+		slot = random32() % t->ops;
+		if (slot >= samples)
+			return;
+	}
+	t->lat[slot] = min_t(u64, ns, ~0U);
+}
+
+static void bench_submit(struct bench_thread *t, struct bench_req *r)
+{
+	int ret;
+
+	r->start = ktime_get();
+	switch (t->run->op) {
+	case BENCH_ENCRYPT:
+		ret = crypto_ablkcipher_encrypt(r->creq);
+		break;
+	case BENCH_DECRYPT:
+		ret = crypto_ablkcipher_decrypt(r->creq);
+		break;
+	default:
+		ret = crypto_ahash_digest(r->hreq);
+		break;
+	}
+
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		r->pending = true;
+		return;
+	}
+
+	r->end = ktime_get();
+	r->err = ret;
+	bench_record(t, r);
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	struct bench_run *run = t->run;
+	struct crypto_ablkcipher *ctfm = NULL;
+	struct crypto_ahash *htfm = NULL;
+	struct bench_req *reqs = NULL;
+	u8 key[64], *buf = NULL;
+	unsigned int n = 0, i;
+	bool stop = false;
+	int err;
+
+	memset(key, 0x5a, sizeof(key));
+
+	err = -ENOMEM;
+	buf = kmalloc(run->size * run->inflight, GFP_KERNEL);
+	reqs = kcalloc(run->inflight, sizeof(*reqs), GFP_KERNEL);
+	if (!buf || !reqs)
+		goto out;
+	memset(buf, 0xff, run->size * run->inflight);
+
+	if (run->hash) {
+		htfm = crypto_alloc_ahash(run->driver, 0, 0);
+		err = PTR_ERR(htfm);
+		if (IS_ERR(htfm)) {
+			htfm = NULL;
+			goto out;
+		}
+		err = crypto_ahash_setkey(htfm, key, keylen);
+		if (err && err != -ENOSYS)
+			goto out;
+	} else {
+		ctfm = crypto_alloc_ablkcipher(run->driver, 0, 0);
+		err = PTR_ERR(ctfm);
+		if (IS_ERR(ctfm)) {
+			ctfm = NULL;
+			goto out;
+		}
+		err = crypto_ablkcipher_setkey(ctfm, key, keylen);
+		if (err)
+			goto out;
+	}
+
+	err = -ENOMEM;
+	for (n = 0; n < run->inflight; n++) {
+		struct bench_req *r = &reqs[n];
+
+		init_completion(&r->done);
+		memset(r->iv, 0xff, sizeof(r->iv));
+		sg_init_one(&r->sg, buf + n * run->size, run->size);
+		if (htfm) {
+			r->hreq = ahash_request_alloc(htfm, GFP_KERNEL);
+			if (!r->hreq)
+				goto out;
+			ahash_request_set_callback(r->hreq,
+						   CRYPTO_TFM_REQ_MAY_BACKLOG,
+						   bench_complete, r);
+			ahash_request_set_crypt(r->hreq, &r->sg, r->out,
+						run->size);
+		} else {
+			r->creq = ablkcipher_request_alloc(ctfm, GFP_KERNEL);
+			if (!r->creq)
+				goto out;
+			ablkcipher_request_set_callback(r->creq,
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						bench_complete, r);
+			ablkcipher_request_set_crypt(r->creq, &r->sg, &r->sg,
+						     run->size, r->iv);
+		}
+	}
+
+	err = 0;
+	wait_for_completion(&run->go);
+
+	/*
+	 * Each request is resubmitted as soon as it completes, so that
+	 * inflight of them stay queued; after the deadline the last pass
+	 * only collects them.
+	 */
+	for (;;) {
+		for (i = 0; i < n; i++) {
+			struct bench_req *r = &reqs[i];
+
+			if (r->pending) {
+				wait_for_completion(&r->done);
+				INIT_COMPLETION(r->done);
+				r->pending = false;
+				bench_record(t, r);
+			}
+			if (!stop && !t->err)
+				bench_submit(t, r);
+		}
+		if (stop)
+			break;
+		stop = t->err || ktime_to_ns(ktime_get()) >= run->end_ns;
+		cond_resched();
+	}
+	err = t->err;
+
+out:
+	while (n--) {
+		if (htfm)
+			ahash_request_free(reqs[n].hreq);
+		else
+			ablkcipher_request_free(reqs[n].creq);
+	}
+	if (htfm)
+		crypto_free_ahash(htfm);
+	if (ctfm)
+		crypto_free_ablkcipher(ctfm);
+	kfree(reqs);
+	kfree(buf);
+
+	t->err = err;
+	complete(&t->done);
+	return 0;
+}
+
+/*
+ * Busy time of the online CPUs, from the NOHZ idle accounting where there
+ * is one, else from the tick based cpustat counters.
+ */
+static u64 bench_cpu_busy_us(void)
+{
+	u64 busy = 0, idle, now;
+	cputime64_t ticks;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		idle = get_cpu_idle_time_us(cpu, &now);
+		if (idle != -1ULL) {
+			busy += now - idle;
+			continue;
+		}
+
+		ticks = cputime64_add(kstat_cpu(cpu).cpustat.user,
+				      kstat_cpu(cpu).cpustat.nice);
+		ticks = cputime64_add(ticks, kstat_cpu(cpu).cpustat.system);
+		ticks = cputime64_add(ticks, kstat_cpu(cpu).cpustat.irq);
+		ticks = cputime64_add(ticks, kstat_cpu(cpu).cpustat.softirq);
+		busy += div_u64(cputime64_to_jiffies64(ticks) * USEC_PER_SEC,
+				HZ);
+	}
+	return busy;
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 bench_percentile(const u32 *lat, unsigned int n, unsigned int pct)
+{
+	return n ? lat[(u64)(n - 1) * pct / 100] : 0;
+}
+
+static int bench_run_one(const char *name, bool hash, bool async,
+			 enum bench_op op, unsigned int size,
+			 unsigned int nthreads, unsigned int nreq)
+{
+	struct bench_run run = {
+		.driver = name,
+		.hash = hash,
+		.op = op,
+		.size = size,
+		.inflight = nreq,
+	};
+	struct bench_thread *t;
+	struct task_struct *task;
+	unsigned int i, started, nlat = 0;
+	unsigned long ops = 0;
+	u64 start_ns, ns, busy, bytes, lat_max = 0;
+	u32 *lat;
+	int err = 0;
+
+	t = kcalloc(nthreads, sizeof(*t), GFP_KERNEL);
+	lat = vmalloc(nthreads * samples * sizeof(*lat));
+	if (!t || !lat) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	init_completion(&run.go);
+	for (started = 0; started < nthreads; started++) {
+		t[started].run = &run;
+		t[started].lat = lat + started * samples;
+		init_completion(&t[started].done);
+		task = kthread_run(bench_thread_fn, &t[started],
+				   "crypto_bench/%u", started);
+		if (IS_ERR(task)) {
+			err = PTR_ERR(task);
+			break;
+		}
+	}
+
+	busy = bench_cpu_busy_us();
+	start_ns = ktime_to_ns(ktime_get());
+	run.end_ns = start_ns + (u64)msecs * NSEC_PER_MSEC;
+	complete_all(&run.go);
+
+	for (i = 0; i < started; i++) {
+		wait_for_completion(&t[i].done);
+		if (t[i].err && !err)
+			err = t[i].err;
+	}
+
+	ns = ktime_to_ns(ktime_get()) - start_ns;
+	busy = bench_cpu_busy_us() - busy;
+	if (err)
+		goto out;
+
+	/* Pack the samples of all threads together. */
+	for (i = 0; i < started; i++) {
+		memmove(lat + nlat, t[i].lat, t[i].nlat * sizeof(*lat));
+		nlat += t[i].nlat;
+		ops += t[i].ops;
+		lat_max = max(lat_max, t[i].lat_max);
+	}
+	sort(lat, nlat, sizeof(*lat), bench_cmp_u32, NULL);
+
+	bytes = (u64)ops * size;
+	printk(KERN_INFO "crypto_bench: driver=%s alg=%s async=%d op=%s "
+	       "size=%u threads=%u inflight=%u ops=%lu bytes=%llu ns=%llu "
+	       "kBps=%llu lat_min_ns=%u lat_p50_ns=%u lat_p90_ns=%u "
+	       "lat_p99_ns=%u lat_max_ns=%llu cpu_us=%llu "
+	       "cpu_ns_per_kB=%llu\n",
+	       name, alg, async, bench_op_names[op], size, nthreads, nreq,
+	       ops, bytes, ns, div64_u64(bytes * NSEC_PER_SEC, ns << 10),
+	       bench_percentile(lat, nlat, 0), bench_percentile(lat, nlat, 50),
+	       bench_percentile(lat, nlat, 90), bench_percentile(lat, nlat, 99),
+	       lat_max, busy,
+	       bytes ? div64_u64(busy * NSEC_PER_USEC << 10, bytes) : 0);
+
+out:
+	vfree(lat);
+	kfree(t);
+	if (err)
+		printk(KERN_ERR "crypto_bench: driver=%s op=%s size=%u "
+		       "threads=%u inflight=%u error=%d\n", name,
+		       bench_op_names[op], size, nthreads, nreq, err);
+	return err;
+}
+
+/* cra_name of q, without the prefix tegra-aes registers under. */
+static bool bench_alg_matches(struct crypto_alg *q, const char *name)
+{
+	const char *p = q->cra_name;
+
+	if (crypto_is_larval(q) || crypto_is_moribund(q))
+		return false;
+	if (!strncmp(p, "disabled_", 9))
+		p += 9;
+	return !strcmp(p, name);
+}
+
+/* Collects the drivers implementing name; returns how many there are. */
+static int bench_list_drivers(const char *name,
+			      char (*names)[CRYPTO_MAX_ALG_NAME], int n)
+{
+	struct crypto_alg *q;
+
+	down_read(&crypto_alg_sem);
+	list_for_each_entry(q, &crypto_alg_list, cra_list) {
+		if (n < BENCH_MAX_DRIVERS && bench_alg_matches(q, name))
+			strlcpy(names[n++], q->cra_driver_name,
+				CRYPTO_MAX_ALG_NAME);
+	}
+	up_read(&crypto_alg_sem);
+
+	return n;
+}
+
+/*
+ * Instantiates tmpl(inner) over every implementation of inner, when alg
+ * is of that form, so that the list of alg has them all.
+ */
+static void bench_instantiate(char (*names)[CRYPTO_MAX_ALG_NAME])
+{
+	char name[CRYPTO_MAX_ALG_NAME];
+	const char *open = strchr(alg, '(');
+	size_t len = strlen(alg);
+	int i, n;
+
+	crypto_has_alg(alg, 0, 0);
+
+	if (!open || alg[len - 1] != ')' || len >= CRYPTO_MAX_ALG_NAME)
+		return;
+
+	memcpy(name, open + 1, len - (open - alg) - 2);
+	name[len - (open - alg) - 2] = 0;
+	n = bench_list_drivers(name, names, 0);
+
+	for (i = 0; i < n; i++) {
+		if (snprintf(name, sizeof(name), "%.*s(%s)", (int)(open - alg),
+			     alg, names[i]) < sizeof(name))
+			crypto_has_alg(name, 0, 0);
+	}
+}
+
+static int bench_find_drivers(char (*names)[CRYPTO_MAX_ALG_NAME])
+{
+	const char *p = drivers, *start;
+	int n = 0, len;
+
+	if (!*drivers) {
+		bench_instantiate(names);
+		return bench_list_drivers(alg, names, 0);
+	}
+
+	while (*p && n < BENCH_MAX_DRIVERS) {
+		int depth = 0;
+
+		for (start = p; *p && (*p != ',' || depth); p++) {
+			if (*p == '(')
+				depth++;
+			else if (*p == ')' && depth)
+				depth--;
+		}
+		len = min_t(int, p - start, CRYPTO_MAX_ALG_NAME - 1);
+		if (*p)
+			p++;
+		if (len) {
+			memcpy(names[n], start, len);
+			names[n++][len] = 0;
+		}
+	}
+	return n;
+}
+
+static void bench_driver(const char *name)
+{
+	struct crypto_ablkcipher *ctfm;
+	struct crypto_ahash *htfm;
+	struct crypto_tfm *tfm;
+	enum bench_op op, last;
+	unsigned int s, th, in, nthreads, nreq;
+	bool hash, async;
+
+	/* Also keeps the driver loaded for the runs. */
+	ctfm = crypto_alloc_ablkcipher(name, 0, 0);
+	if (!IS_ERR(ctfm)) {
+		hash = false;
+		tfm = crypto_ablkcipher_tfm(ctfm);
+		op = BENCH_ENCRYPT;
+		last = BENCH_DECRYPT;
+	} else {
+		htfm = crypto_alloc_ahash(name, 0, 0);
+		if (IS_ERR(htfm)) {
+			printk(KERN_ERR "crypto_bench: driver=%s error=%ld\n",
+			       name, PTR_ERR(htfm));
+			return;
+		}
+		hash = true;
+		tfm = crypto_ahash_tfm(htfm);
+		op = last = BENCH_DIGEST;
+	}
+	async = tfm->__crt_alg->cra_flags & CRYPTO_ALG_ASYNC;
+
+	for (; op <= last; op++) {
+		for (s = 0; s < nr_sizes; s++) {
+			for (th = 0; th < nr_thread_counts; th++) {
+				nthreads = threads[th] ?: num_online_cpus();
+				for (in = 0; in < nr_inflight; in++) {
+					nreq = async ? inflight[in] : 1;
+					if (bench_run_one(name, hash, async, op,
+							  sizes[s], nthreads,
+							  nreq) || !async)
+						break;
+				}
+			}
+		}
+	}
+
+	if (hash)
+		crypto_free_ahash(htfm);
+	else
+		crypto_free_ablkcipher(ctfm);
+}
+
+static int __init crypto_bench_init(void)
+{
+	char (*names)[CRYPTO_MAX_ALG_NAME];
+	unsigned int i;
+	int n;
+
+	if (!msecs || !samples || keylen > 64 || !nr_inflight)
+		return -EINVAL;
+	for (i = 0; i < nr_sizes; i++)
+		if (!sizes[i] || sizes[i] > (1 << 20))
+			return -EINVAL;
+	for (i = 0; i < nr_inflight; i++)
+		if (!inflight[i] || inflight[i] > BENCH_MAX_INFLIGHT)
+			return -EINVAL;
+
+	names = kcalloc(BENCH_MAX_DRIVERS, sizeof(*names), GFP_KERNEL);
+	if (!names)
+		return -ENOMEM;
+
+	n = bench_find_drivers(names);
+	if (!n)
+		printk(KERN_ERR "crypto_bench: no implementations of %s\n",
+		       alg);
+
+	for (i = 0; i < n; i++)
+		bench_driver(names[i]);
+
+	kfree(names);
+
+	/* Nothing to keep loaded for. */
+	return -EAGAIN;
+}
+
+static void __exit crypto_bench_exit(void)
+{
+}
+
+module_init(crypto_bench_init);
+module_exit(crypto_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Crypto API throughput, latency and CPU cost benchmark");
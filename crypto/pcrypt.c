@@ -20,6 +20,8 @@
 
 #include <crypto/algapi.h>
 #include <crypto/internal/aead.h>
+#include <crypto/internal/hash.h>
+#include <crypto/internal/skcipher.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/module.h>
@@ -27,8 +29,27 @@
 #include <linux/notifier.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/workqueue.h>
 #include <crypto/pcrypt.h>
 
+/*
+ * Algorithms to instantiate pcrypt for when the module is loaded, so that
+ * their users get the parallel version without setting it up through the
+ * crypto user interface first.
+ */
+static char *aead_algs = "authenc(hmac(sha1),cbc(aes)),"
+			 "authenc(hmac(sha256),cbc(aes))";
+module_param(aead_algs, charp, 0444);
+MODULE_PARM_DESC(aead_algs, "AEADs to parallelize on load (IPsec ESP)");
+
+static char *skcipher_algs = "";
+module_param(skcipher_algs, charp, 0444);
+MODULE_PARM_DESC(skcipher_algs, "block ciphers to parallelize on load");
+
+static char *ahash_algs = "";
+module_param(ahash_algs, charp, 0444);
+MODULE_PARM_DESC(ahash_algs, "hashes to parallelize on load (IPsec AH)");
+
 struct padata_pcrypt {
 	struct padata_instance *pinst;
 	struct workqueue_struct *wq;
@@ -53,22 +74,81 @@ struct padata_pcrypt {
 		cpumask_var_t mask;
 	} *cb_cpumask;
 	struct notifier_block nblock;
+
+	/*
+	 * CPUs in the parallel cpumask.  With just one, as when the second
+	 * core of a dual core system is unplugged while idle, padata only
+	 * adds a round trip through its workqueues, so requests for
+	 * synchronous algorithms are run directly in the caller instead.
+	 */
+	unsigned int parallel_cpus;
 };
 
 static struct padata_pcrypt pencrypt;
 static struct padata_pcrypt pdecrypt;
 static struct kset           *pcrypt_kset;
 
+static void pcrypt_auto_instantiate(struct work_struct *work);
+static DECLARE_WORK(pcrypt_auto_work, pcrypt_auto_instantiate);
+
 struct pcrypt_instance_ctx {
-	struct crypto_spawn spawn;
+	union {
+		struct crypto_spawn spawn;
+		struct crypto_skcipher_spawn skcipher_spawn;
+		struct crypto_ahash_spawn ahash_spawn;
+	};
 	unsigned int tfm_count;
 };
 
 struct pcrypt_aead_ctx {
 	struct crypto_aead *child;
 	unsigned int cb_cpu;
+	bool child_sync;
 };
 
+struct pcrypt_ablkcipher_ctx {
+	struct crypto_ablkcipher *child;
+	unsigned int cb_cpu;
+	bool child_sync;
+};
+
+struct pcrypt_ahash_ctx {
+	struct crypto_ahash *child;
+	unsigned int cb_cpu;
+	bool child_sync;
+};
+
+/*
+ * Whether to run a request directly: only when the algorithm below us
+ * completes it before returning, so that the order of the requests is
+ * kept without padata.
+ */
+static inline bool pcrypt_bypass(struct padata_pcrypt *pcrypt, bool child_sync)
+{
+	return child_sync && ACCESS_ONCE(pcrypt->parallel_cpus) < 2;
+}
+
+static inline bool pcrypt_tfm_sync(struct crypto_tfm *tfm)
+{
+	return !(tfm->__crt_alg->cra_flags & CRYPTO_ALG_ASYNC);
+}
+
+/* Spreads the callbacks of the tfms of an instance over the serial CPUs. */
+static unsigned int pcrypt_pick_cb_cpu(struct pcrypt_instance_ctx *ictx)
+{
+	unsigned int cpu, cpu_index, i;
+
+	ictx->tfm_count++;
+
+	cpu_index = ictx->tfm_count % cpumask_weight(cpu_active_mask);
+
+	cpu = cpumask_first(cpu_active_mask);
+	for (i = 0; i < cpu_index; i++)
+		cpu = cpumask_next(cpu, cpu_active_mask);
+
+	return cpu;
+}
+
 static int pcrypt_do_parallel(struct padata_priv *padata, unsigned int *cb_cpu,
 			      struct padata_pcrypt *pcrypt)
 {
@@ -177,6 +257,11 @@ static int pcrypt_aead_encrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_assoc(creq, req->assoc, req->assoclen);
 
+	if (pcrypt_bypass(&pencrypt, ctx->child_sync)) {
+		creq->base.flags = flags;
+		return crypto_aead_encrypt(creq);
+	}
+
 	err = pcrypt_do_parallel(padata, &ctx->cb_cpu, &pencrypt);
 	if (!err)
 		return -EINPROGRESS;
@@ -219,6 +304,11 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_assoc(creq, req->assoc, req->assoclen);
 
+	if (pcrypt_bypass(&pdecrypt, ctx->child_sync)) {
+		creq->base.flags = flags;
+		return crypto_aead_decrypt(creq);
+	}
+
 	err = pcrypt_do_parallel(padata, &ctx->cb_cpu, &pdecrypt);
 	if (!err)
 		return -EINPROGRESS;
@@ -263,6 +353,11 @@ static int pcrypt_aead_givencrypt(struct aead_givcrypt_request *req)
 	aead_givcrypt_set_assoc(creq, areq->assoc, areq->assoclen);
 	aead_givcrypt_set_giv(creq, req->giv, req->seq);
 
+	if (pcrypt_bypass(&pencrypt, ctx->child_sync)) {
+		creq->areq.base.flags = flags;
+		return crypto_aead_givencrypt(creq);
+	}
+
 	err = pcrypt_do_parallel(padata, &ctx->cb_cpu, &pencrypt);
 	if (!err)
 		return -EINPROGRESS;
@@ -272,19 +367,12 @@ static int pcrypt_aead_givencrypt(struct aead_givcrypt_request *req)
 
 static int pcrypt_aead_init_tfm(struct crypto_tfm *tfm)
 {
-	int cpu, cpu_index;
 	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
 	struct pcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
 	struct pcrypt_aead_ctx *ctx = crypto_tfm_ctx(tfm);
 	struct crypto_aead *cipher;
 
-	ictx->tfm_count++;
-
-	cpu_index = ictx->tfm_count % cpumask_weight(cpu_active_mask);
-
-	ctx->cb_cpu = cpumask_first(cpu_active_mask);
-	for (cpu = 0; cpu < cpu_index; cpu++)
-		ctx->cb_cpu = cpumask_next(ctx->cb_cpu, cpu_active_mask);
+	ctx->cb_cpu = pcrypt_pick_cb_cpu(ictx);
 
 	cipher = crypto_spawn_aead(crypto_instance_ctx(inst));
 
@@ -292,6 +380,7 @@ static int pcrypt_aead_init_tfm(struct crypto_tfm *tfm)
 		return PTR_ERR(cipher);
 
 	ctx->child = cipher;
+	ctx->child_sync = pcrypt_tfm_sync(crypto_aead_tfm(cipher));
 	tfm->crt_aead.reqsize = sizeof(struct pcrypt_request)
 		+ sizeof(struct aead_givcrypt_request)
 		+ crypto_aead_reqsize(cipher);
@@ -306,18 +395,369 @@ static void pcrypt_aead_exit_tfm(struct crypto_tfm *tfm)
 	crypto_free_aead(ctx->child);
 }
 
-static struct crypto_instance *pcrypt_alloc_instance(struct crypto_alg *alg)
+static int pcrypt_ablkcipher_setkey(struct crypto_ablkcipher *parent,
+				    const u8 *key, unsigned int keylen)
+{
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_ablkcipher_ctx(parent);
+	struct crypto_ablkcipher *child = ctx->child;
+	int err;
+
+	crypto_ablkcipher_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_ablkcipher_set_flags(child, crypto_ablkcipher_get_flags(parent) &
+					   CRYPTO_TFM_REQ_MASK);
+	err = crypto_ablkcipher_setkey(child, key, keylen);
+	crypto_ablkcipher_set_flags(parent, crypto_ablkcipher_get_flags(child) &
+					    CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static void pcrypt_ablkcipher_serial(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+
+	ablkcipher_request_complete(req->base.data, padata->info);
+}
+
+static void pcrypt_ablkcipher_done(struct crypto_async_request *areq, int err)
+{
+	struct ablkcipher_request *req = areq->data;
+	struct pcrypt_request *preq = ablkcipher_request_ctx(req);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+
+	padata->info = err;
+	req->base.flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ablkcipher_enc(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ablkcipher_encrypt(req);
+
+	if (padata->info == -EINPROGRESS)
+		return;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ablkcipher_dec(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ablkcipher_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ablkcipher_decrypt(req);
+
+	if (padata->info == -EINPROGRESS)
+		return;
+
+	padata_do_serial(padata);
+}
+
+static int pcrypt_ablkcipher_crypt(struct ablkcipher_request *req, int enc)
+{
+	int err;
+	struct pcrypt_request *preq = ablkcipher_request_ctx(req);
+	struct ablkcipher_request *creq = pcrypt_request_ctx(preq);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_ablkcipher_ctx(tfm);
+	struct padata_pcrypt *pcrypt = enc ? &pencrypt : &pdecrypt;
+	u32 flags = ablkcipher_request_flags(req);
+
+	ablkcipher_request_set_tfm(creq, ctx->child);
+	ablkcipher_request_set_crypt(creq, req->src, req->dst,
+				     req->nbytes, req->info);
+
+	if (pcrypt_bypass(pcrypt, ctx->child_sync)) {
+		ablkcipher_request_set_callback(creq, flags, NULL, NULL);
+		return enc ? crypto_ablkcipher_encrypt(creq) :
+			     crypto_ablkcipher_decrypt(creq);
+	}
+
+	memset(padata, 0, sizeof(struct padata_priv));
+
+	padata->parallel = enc ? pcrypt_ablkcipher_enc : pcrypt_ablkcipher_dec;
+	padata->serial = pcrypt_ablkcipher_serial;
+
+	ablkcipher_request_set_callback(creq, flags & ~CRYPTO_TFM_REQ_MAY_SLEEP,
+					pcrypt_ablkcipher_done, req);
+
+	err = pcrypt_do_parallel(padata, &ctx->cb_cpu, pcrypt);
+	if (!err)
+		return -EINPROGRESS;
+
+	return err;
+}
+
+static int pcrypt_ablkcipher_encrypt(struct ablkcipher_request *req)
+{
+	return pcrypt_ablkcipher_crypt(req, 1);
+}
+
+static int pcrypt_ablkcipher_decrypt(struct ablkcipher_request *req)
+{
+	return pcrypt_ablkcipher_crypt(req, 0);
+}
+
+static int pcrypt_ablkcipher_init_tfm(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
+	struct pcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_ablkcipher *cipher;
+
+	ctx->cb_cpu = pcrypt_pick_cb_cpu(ictx);
+
+	cipher = crypto_spawn_skcipher(&ictx->skcipher_spawn);
+	if (IS_ERR(cipher))
+		return PTR_ERR(cipher);
+
+	ctx->child = cipher;
+	ctx->child_sync = pcrypt_tfm_sync(crypto_ablkcipher_tfm(cipher));
+	tfm->crt_ablkcipher.reqsize = sizeof(struct pcrypt_request)
+		+ sizeof(struct ablkcipher_request)
+		+ crypto_ablkcipher_reqsize(cipher);
+
+	return 0;
+}
+
+static void pcrypt_ablkcipher_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct pcrypt_ablkcipher_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_ablkcipher(ctx->child);
+}
+
+/*
+ * Only the requests that carry data go through padata.  init, final,
+ * export and import are cheap and are passed to the child request, which
+ * also holds the hash state, directly.
+ */
+static struct ahash_request *pcrypt_ahash_child_req(struct ahash_request *req)
+{
+	struct pcrypt_request *preq = ahash_request_ctx(req);
+	struct ahash_request *creq = pcrypt_request_ctx(preq);
+	struct pcrypt_ahash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+
+	ahash_request_set_tfm(creq, ctx->child);
+	ahash_request_set_crypt(creq, req->src, req->result, req->nbytes);
+	return creq;
+}
+
+static void pcrypt_ahash_complete(struct crypto_async_request *areq, int err)
+{
+	struct ahash_request *req = areq->data;
+
+	req->base.complete(&req->base, err);
+}
+
+static int pcrypt_ahash_setkey(struct crypto_ahash *parent, const u8 *key,
+			       unsigned int keylen)
+{
+	struct pcrypt_ahash_ctx *ctx = crypto_ahash_ctx(parent);
+	struct crypto_ahash *child = ctx->child;
+	int err;
+
+	crypto_ahash_clear_flags(child, CRYPTO_TFM_REQ_MASK);
+	crypto_ahash_set_flags(child, crypto_ahash_get_flags(parent) &
+				      CRYPTO_TFM_REQ_MASK);
+	err = crypto_ahash_setkey(child, key, keylen);
+	crypto_ahash_set_flags(parent, crypto_ahash_get_flags(child) &
+				       CRYPTO_TFM_RES_MASK);
+	return err;
+}
+
+static int pcrypt_ahash_init(struct ahash_request *req)
+{
+	struct ahash_request *creq = pcrypt_ahash_child_req(req);
+
+	ahash_request_set_callback(creq, req->base.flags,
+				   pcrypt_ahash_complete, req);
+	return crypto_ahash_init(creq);
+}
+
+static int pcrypt_ahash_final(struct ahash_request *req)
+{
+	struct ahash_request *creq = pcrypt_ahash_child_req(req);
+
+	ahash_request_set_callback(creq, req->base.flags,
+				   pcrypt_ahash_complete, req);
+	return crypto_ahash_final(creq);
+}
+
+static int pcrypt_ahash_export(struct ahash_request *req, void *out)
+{
+	return crypto_ahash_export(pcrypt_ahash_child_req(req), out);
+}
+
+static int pcrypt_ahash_import(struct ahash_request *req, const void *in)
+{
+	return crypto_ahash_import(pcrypt_ahash_child_req(req), in);
+}
+
+static void pcrypt_ahash_serial(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ahash_request *req = pcrypt_request_ctx(preq);
+	struct crypto_async_request *areq = req->base.data;
+
+	areq->complete(areq, padata->info);
+}
+
+static void pcrypt_ahash_done(struct crypto_async_request *areq, int err)
+{
+	struct ahash_request *req = areq->data;
+	struct pcrypt_request *preq = ahash_request_ctx(req);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+
+	padata->info = err;
+	req->base.flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ahash_update_parallel(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ahash_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ahash_update(req);
+	if (padata->info == -EINPROGRESS)
+		return;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ahash_finup_parallel(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ahash_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ahash_finup(req);
+	if (padata->info == -EINPROGRESS)
+		return;
+
+	padata_do_serial(padata);
+}
+
+static void pcrypt_ahash_digest_parallel(struct padata_priv *padata)
+{
+	struct pcrypt_request *preq = pcrypt_padata_request(padata);
+	struct ahash_request *req = pcrypt_request_ctx(preq);
+
+	padata->info = crypto_ahash_digest(req);
+	if (padata->info == -EINPROGRESS)
+		return;
+
+	padata_do_serial(padata);
+}
+
+static int pcrypt_ahash_parallel(struct ahash_request *req,
+				 void (*parallel)(struct padata_priv *padata),
+				 int (*direct)(struct ahash_request *req))
+{
+	int err;
+	struct pcrypt_request *preq = ahash_request_ctx(req);
+	struct ahash_request *creq = pcrypt_ahash_child_req(req);
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+	struct pcrypt_ahash_ctx *ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	u32 flags = req->base.flags;
+
+	if (pcrypt_bypass(&pencrypt, ctx->child_sync)) {
+		ahash_request_set_callback(creq, flags, NULL, NULL);
+		return direct(creq);
+	}
+
+	memset(padata, 0, sizeof(struct padata_priv));
+
+	padata->parallel = parallel;
+	padata->serial = pcrypt_ahash_serial;
+
+	ahash_request_set_callback(creq, flags & ~CRYPTO_TFM_REQ_MAY_SLEEP,
+				   pcrypt_ahash_done, req);
+
+	err = pcrypt_do_parallel(padata, &ctx->cb_cpu, &pencrypt);
+	if (!err)
+		return -EINPROGRESS;
+
+	return err;
+}
+
+static int pcrypt_ahash_update(struct ahash_request *req)
+{
+	return pcrypt_ahash_parallel(req, pcrypt_ahash_update_parallel,
+				     crypto_ahash_update);
+}
+
+static int pcrypt_ahash_finup(struct ahash_request *req)
+{
+	return pcrypt_ahash_parallel(req, pcrypt_ahash_finup_parallel,
+				     crypto_ahash_finup);
+}
+
+static int pcrypt_ahash_digest(struct ahash_request *req)
+{
+	return pcrypt_ahash_parallel(req, pcrypt_ahash_digest_parallel,
+				     crypto_ahash_digest);
+}
+
+static int pcrypt_ahash_init_tfm(struct crypto_tfm *tfm)
+{
+	struct crypto_instance *inst = crypto_tfm_alg_instance(tfm);
+	struct pcrypt_instance_ctx *ictx = crypto_instance_ctx(inst);
+	struct pcrypt_ahash_ctx *ctx = crypto_tfm_ctx(tfm);
+	struct crypto_ahash *hash;
+
+	ctx->cb_cpu = pcrypt_pick_cb_cpu(ictx);
+
+	hash = crypto_spawn_ahash(&ictx->ahash_spawn);
+	if (IS_ERR(hash))
+		return PTR_ERR(hash);
+
+	ctx->child = hash;
+	ctx->child_sync = pcrypt_tfm_sync(crypto_ahash_tfm(hash));
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+				 sizeof(struct pcrypt_request) +
+				 sizeof(struct ahash_request) +
+				 crypto_ahash_reqsize(hash));
+	return 0;
+}
+
+static void pcrypt_ahash_exit_tfm(struct crypto_tfm *tfm)
+{
+	struct pcrypt_ahash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_ahash(ctx->child);
+}
+
+/*
+ * Allocates an instance for alg with head bytes in front of it, for the
+ * ahash_alg that the crypto_alg of a hash is embedded into.
+ */
+static struct crypto_instance *pcrypt_alloc_instance(struct crypto_alg *alg,
+						     unsigned int head)
 {
 	struct crypto_instance *inst;
 	struct pcrypt_instance_ctx *ctx;
+	char *p;
 	int err;
 
-	inst = kzalloc(sizeof(*inst) + sizeof(*ctx), GFP_KERNEL);
-	if (!inst) {
+	/* A second layer of parallelization only adds overhead. */
+	if (!strncmp(alg->cra_driver_name, "pcrypt(", 7))
+		return ERR_PTR(-EEXIST);
+
+	p = kzalloc(head + sizeof(*inst) + sizeof(*ctx), GFP_KERNEL);
+	if (!p) {
 		inst = ERR_PTR(-ENOMEM);
 		goto out;
 	}
 
+	inst = (void *)(p + head);
+
 	err = -ENAMETOOLONG;
 	if (snprintf(inst->alg.cra_driver_name, CRYPTO_MAX_ALG_NAME,
 		     "pcrypt(%s)", alg->cra_driver_name) >= CRYPTO_MAX_ALG_NAME)
@@ -325,12 +765,6 @@ static struct crypto_instance *pcrypt_alloc_instance(struct crypto_alg *alg)
 
 	memcpy(inst->alg.cra_name, alg->cra_name, CRYPTO_MAX_ALG_NAME);
 
-	ctx = crypto_instance_ctx(inst);
-	err = crypto_init_spawn(&ctx->spawn, alg, inst,
-				CRYPTO_ALG_TYPE_MASK);
-	if (err)
-		goto out_free_inst;
-
 	inst->alg.cra_priority = alg->cra_priority + 100;
 	inst->alg.cra_blocksize = alg->cra_blocksize;
 	inst->alg.cra_alignmask = alg->cra_alignmask;
@@ -339,25 +773,34 @@ out:
 	return inst;
 
 out_free_inst:
-	kfree(inst);
+	kfree(p);
 	inst = ERR_PTR(err);
 	goto out;
 }
 
-static struct crypto_instance *pcrypt_alloc_aead(struct rtattr **tb,
-						 u32 type, u32 mask)
+static int pcrypt_create_aead(struct crypto_template *tmpl, struct rtattr **tb,
+			      u32 type, u32 mask)
 {
+	struct pcrypt_instance_ctx *ctx;
 	struct crypto_instance *inst;
 	struct crypto_alg *alg;
+	int err;
 
 	alg = crypto_get_attr_alg(tb, type, (mask & CRYPTO_ALG_TYPE_MASK));
 	if (IS_ERR(alg))
-		return ERR_CAST(alg);
+		return PTR_ERR(alg);
 
-	inst = pcrypt_alloc_instance(alg);
+	inst = pcrypt_alloc_instance(alg, 0);
+	err = PTR_ERR(inst);
 	if (IS_ERR(inst))
 		goto out_put_alg;
 
+	ctx = crypto_instance_ctx(inst);
+	err = crypto_init_spawn(&ctx->spawn, alg, inst,
+				CRYPTO_ALG_TYPE_MASK);
+	if (err)
+		goto out_free_inst;
+
 	inst->alg.cra_flags = CRYPTO_ALG_TYPE_AEAD | CRYPTO_ALG_ASYNC;
 	inst->alg.cra_type = &crypto_aead_type;
 
@@ -376,31 +819,177 @@ static struct crypto_instance *pcrypt_alloc_aead(struct rtattr **tb,
 	inst->alg.cra_aead.decrypt = pcrypt_aead_decrypt;
 	inst->alg.cra_aead.givencrypt = pcrypt_aead_givencrypt;
 
+	err = crypto_register_instance(tmpl, inst);
+	if (err) {
+		crypto_drop_spawn(&ctx->spawn);
+out_free_inst:
+		kfree(inst);
+	}
+
 out_put_alg:
 	crypto_mod_put(alg);
-	return inst;
+	return err;
+}
+
+/* Block ciphers, synchronous or not, become asynchronous block ciphers. */
+static int pcrypt_create_ablkcipher(struct crypto_template *tmpl,
+				    struct rtattr **tb, u32 type, u32 mask)
+{
+	struct pcrypt_instance_ctx *ctx;
+	struct crypto_instance *inst;
+	struct crypto_alg *alg;
+	int err;
+
+	alg = crypto_get_attr_alg(tb, CRYPTO_ALG_TYPE_BLKCIPHER,
+				  CRYPTO_ALG_TYPE_BLKCIPHER_MASK |
+				  crypto_requires_sync(type, mask));
+	if (IS_ERR(alg))
+		return PTR_ERR(alg);
+
+	inst = pcrypt_alloc_instance(alg, 0);
+	err = PTR_ERR(inst);
+	if (IS_ERR(inst))
+		goto out_put_alg;
+
+	ctx = crypto_instance_ctx(inst);
+	err = crypto_init_spawn(&ctx->skcipher_spawn.base, alg, inst,
+				CRYPTO_ALG_TYPE_MASK);
+	if (err)
+		goto out_free_inst;
+
+	inst->alg.cra_flags = CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC;
+	inst->alg.cra_type = &crypto_ablkcipher_type;
+
+	if ((alg->cra_flags & CRYPTO_ALG_TYPE_MASK) ==
+	    CRYPTO_ALG_TYPE_BLKCIPHER) {
+		inst->alg.cra_ablkcipher.ivsize = alg->cra_blkcipher.ivsize;
+		inst->alg.cra_ablkcipher.min_keysize =
+			alg->cra_blkcipher.min_keysize;
+		inst->alg.cra_ablkcipher.max_keysize =
+			alg->cra_blkcipher.max_keysize;
+		inst->alg.cra_ablkcipher.geniv = alg->cra_blkcipher.geniv;
+	} else {
+		inst->alg.cra_ablkcipher.ivsize = alg->cra_ablkcipher.ivsize;
+		inst->alg.cra_ablkcipher.min_keysize =
+			alg->cra_ablkcipher.min_keysize;
+		inst->alg.cra_ablkcipher.max_keysize =
+			alg->cra_ablkcipher.max_keysize;
+		inst->alg.cra_ablkcipher.geniv = alg->cra_ablkcipher.geniv;
+	}
+
+	inst->alg.cra_ctxsize = sizeof(struct pcrypt_ablkcipher_ctx);
+
+	inst->alg.cra_init = pcrypt_ablkcipher_init_tfm;
+	inst->alg.cra_exit = pcrypt_ablkcipher_exit_tfm;
+
+	inst->alg.cra_ablkcipher.setkey = pcrypt_ablkcipher_setkey;
+	inst->alg.cra_ablkcipher.encrypt = pcrypt_ablkcipher_encrypt;
+	inst->alg.cra_ablkcipher.decrypt = pcrypt_ablkcipher_decrypt;
+
+	err = crypto_register_instance(tmpl, inst);
+	if (err) {
+		crypto_drop_skcipher(&ctx->skcipher_spawn);
+out_free_inst:
+		kfree(inst);
+	}
+
+out_put_alg:
+	crypto_mod_put(alg);
+	return err;
 }
 
-static struct crypto_instance *pcrypt_alloc(struct rtattr **tb)
+static int pcrypt_create_ahash(struct crypto_template *tmpl,
+			       struct rtattr **tb, u32 type, u32 mask)
+{
+	struct pcrypt_instance_ctx *ctx;
+	struct ahash_instance *inst;
+	struct crypto_instance *cinst;
+	struct hash_alg_common *halg;
+	struct crypto_alg *alg;
+	int err;
+
+	halg = ahash_attr_alg(tb[1], type, mask);
+	if (IS_ERR(halg))
+		return PTR_ERR(halg);
+
+	alg = &halg->base;
+	cinst = pcrypt_alloc_instance(alg, ahash_instance_headroom());
+	err = PTR_ERR(cinst);
+	if (IS_ERR(cinst))
+		goto out_put_alg;
+
+	inst = ahash_instance(cinst);
+	ctx = ahash_instance_ctx(inst);
+	err = crypto_init_ahash_spawn(&ctx->ahash_spawn, halg, cinst);
+	if (err)
+		goto out_free_inst;
+
+	inst->alg.halg.base.cra_flags = CRYPTO_ALG_ASYNC;
+
+	inst->alg.halg.digestsize = halg->digestsize;
+	inst->alg.halg.statesize = halg->statesize;
+	inst->alg.halg.base.cra_ctxsize = sizeof(struct pcrypt_ahash_ctx);
+
+	inst->alg.halg.base.cra_init = pcrypt_ahash_init_tfm;
+	inst->alg.halg.base.cra_exit = pcrypt_ahash_exit_tfm;
+
+	inst->alg.init   = pcrypt_ahash_init;
+	inst->alg.update = pcrypt_ahash_update;
+	inst->alg.final  = pcrypt_ahash_final;
+	inst->alg.finup  = pcrypt_ahash_finup;
+	inst->alg.export = pcrypt_ahash_export;
+	inst->alg.import = pcrypt_ahash_import;
+	inst->alg.setkey = pcrypt_ahash_setkey;
+	inst->alg.digest = pcrypt_ahash_digest;
+
+	err = ahash_register_instance(tmpl, inst);
+	if (err) {
+		crypto_drop_ahash(&ctx->ahash_spawn);
+out_free_inst:
+		kfree(inst);
+	}
+
+out_put_alg:
+	crypto_mod_put(alg);
+	return err;
+}
+
+static int pcrypt_create(struct crypto_template *tmpl, struct rtattr **tb)
 {
 	struct crypto_attr_type *algt;
 
 	algt = crypto_get_attr_type(tb);
 	if (IS_ERR(algt))
-		return ERR_CAST(algt);
+		return PTR_ERR(algt);
 
 	switch (algt->type & algt->mask & CRYPTO_ALG_TYPE_MASK) {
 	case CRYPTO_ALG_TYPE_AEAD:
-		return pcrypt_alloc_aead(tb, algt->type, algt->mask);
+		return pcrypt_create_aead(tmpl, tb, algt->type, algt->mask);
+	case CRYPTO_ALG_TYPE_BLKCIPHER:
+		return pcrypt_create_ablkcipher(tmpl, tb, algt->type,
+						algt->mask);
+	case CRYPTO_ALG_TYPE_DIGEST:
+		return pcrypt_create_ahash(tmpl, tb, algt->type, algt->mask);
 	}
 
-	return ERR_PTR(-EINVAL);
+	return -EINVAL;
 }
 
 static void pcrypt_free(struct crypto_instance *inst)
 {
 	struct pcrypt_instance_ctx *ctx = crypto_instance_ctx(inst);
 
+	switch (inst->alg.cra_flags & CRYPTO_ALG_TYPE_MASK) {
+	case CRYPTO_ALG_TYPE_AHASH:
+		crypto_drop_ahash(&ctx->ahash_spawn);
+		kfree(ahash_instance(inst));
+		return;
+	case CRYPTO_ALG_TYPE_ABLKCIPHER:
+		crypto_drop_skcipher(&ctx->skcipher_spawn);
+		kfree(inst);
+		return;
+	}
+
 	crypto_drop_spawn(&ctx->spawn);
 	kfree(inst);
 }
@@ -412,10 +1001,14 @@ static int pcrypt_cpumask_change_notify(struct notifier_block *self,
 	struct pcrypt_cpumask *new_mask, *old_mask;
 	struct padata_cpumask *cpumask = (struct padata_cpumask *)data;
 
+	pcrypt = container_of(self, struct padata_pcrypt, nblock);
+
+	if (val & PADATA_CPU_PARALLEL)
+		pcrypt->parallel_cpus = cpumask_weight(cpumask->pcpu);
+
 	if (!(val & PADATA_CPU_SERIAL))
 		return 0;
 
-	pcrypt = container_of(self, struct padata_pcrypt, nblock);
 	new_mask = kmalloc(sizeof(*new_mask), GFP_KERNEL);
 	if (!new_mask)
 		return -ENOMEM;
@@ -473,6 +1066,7 @@ static int pcrypt_init_padata(struct padata_pcrypt *pcrypt,
 
 	cpumask_and(mask->mask, cpu_possible_mask, cpu_active_mask);
 	rcu_assign_pointer(pcrypt->cb_cpumask, mask);
+	pcrypt->parallel_cpus = cpumask_weight(mask->mask);
 
 	pcrypt->nblock.notifier_call = pcrypt_cpumask_change_notify;
 	ret = padata_register_cpumask_notifier(pcrypt->pinst, &pcrypt->nblock);
@@ -514,9 +1108,55 @@ static void pcrypt_fini_padata(struct padata_pcrypt *pcrypt)
 	padata_free(pcrypt->pinst);
 }
 
+/*
+ * Instantiates pcrypt(name) for each name of a comma separated list.
+ * Names may contain commas of their own inside parentheses.
+ */
+static void pcrypt_instantiate_list(const char *list, u32 type, u32 mask)
+{
+	char name[CRYPTO_MAX_ALG_NAME];
+	const char *p = list, *start;
+	int depth, len;
+
+	while (*p) {
+		start = p;
+		for (depth = 0; *p && (*p != ',' || depth); p++) {
+			if (*p == '(')
+				depth++;
+			else if (*p == ')' && depth)
+				depth--;
+		}
+
+		len = p - start;
+		if (*p)
+			p++;
+		if (!len)
+			continue;
+
+		if (snprintf(name, sizeof(name), "pcrypt(%.*s)", len, start) >=
+		    sizeof(name)) {
+			pr_info("pcrypt: %.*s: name too long\n", len, start);
+			continue;
+		}
+
+		if (!crypto_has_alg(name, type, mask))
+			pr_info("pcrypt: cannot instantiate %s\n", name);
+	}
+}
+
+static void pcrypt_auto_instantiate(struct work_struct *work)
+{
+	pcrypt_instantiate_list(aead_algs, CRYPTO_ALG_TYPE_AEAD,
+				CRYPTO_ALG_TYPE_MASK);
+	pcrypt_instantiate_list(skcipher_algs, CRYPTO_ALG_TYPE_BLKCIPHER,
+				CRYPTO_ALG_TYPE_BLKCIPHER_MASK);
+	pcrypt_instantiate_list(ahash_algs, CRYPTO_ALG_TYPE_AHASH,
+				CRYPTO_ALG_TYPE_AHASH_MASK);
+}
+
 static struct crypto_template pcrypt_tmpl = {
 	.name = "pcrypt",
-	.alloc = pcrypt_alloc,
+	.create = pcrypt_create,
 	.free = pcrypt_free,
 	.module = THIS_MODULE,
 };
@@ -540,7 +1180,20 @@ static int __init pcrypt_init(void)
 	padata_start(pencrypt.pinst);
 	padata_start(pdecrypt.pinst);
 
-	return crypto_register_template(&pcrypt_tmpl);
+	err = crypto_register_template(&pcrypt_tmpl);
+	if (err)
+		goto err_deinit_pdecrypt;
+
+	/*
+	 * Instantiating goes through the crypto manager, which may need to
+	 * load modules; don't do it from our own module init.
+	 */
+	schedule_work(&pcrypt_auto_work);
+
+	return 0;
+
+err_deinit_pdecrypt:
+	pcrypt_fini_padata(&pdecrypt);
 
 err_deinit_pencrypt:
 	pcrypt_fini_padata(&pencrypt);
@@ -552,6 +1205,8 @@ err:
 
 static void __exit pcrypt_exit(void)
 {
+	flush_work(&pcrypt_auto_work);
+
 	pcrypt_fini_padata(&pencrypt);
 	pcrypt_fini_padata(&pdecrypt);
 
@@ -26,6 +26,8 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/kthread.h>
+#include <linux/slab.h>
 #include "tcrypt.h"
 #include "internal.h"
 
@@ -45,6 +47,11 @@
  */
 static unsigned int sec;
 
+/*
+ * Used by test_mt_speed(): 0 for one thread per online CPU
+ */
+static unsigned int threads;
+
 static char *alg = NULL;
 static u32 type;
 static u32 mask;
@@ -711,6 +718,445 @@ out:
 	crypto_free_ahash(tfm);
 }
 
+/*
+ * Used by test_acipher_speed(): the most requests kept in flight at once,
+ * for drivers that batch them.
+ */
+#define ACIPHER_MAX_INFLIGHT	8
+
+static inline int do_one_acipher_op(struct ablkcipher_request *req, int ret)
+{
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		struct tcrypt_result *tr = req->base.data;
+
+		ret = wait_for_completion_interruptible(&tr->completion);
+		if (!ret)
+			ret = tr->err;
+		INIT_COMPLETION(tr->completion);
+	}
+	return ret;
+}
+
+/* Starts all of the nreq requests, then waits for each of them. */
+static int do_acipher_ops(struct ablkcipher_request **reqs, int nreq, int enc)
+{
+	int rets[ACIPHER_MAX_INFLIGHT];
+	int i, ret = 0;
+
+	for (i = 0; i < nreq; i++)
+		rets[i] = enc ? crypto_ablkcipher_encrypt(reqs[i]) :
+				crypto_ablkcipher_decrypt(reqs[i]);
+
+	for (i = 0; i < nreq; i++) {
+		rets[i] = do_one_acipher_op(reqs[i], rets[i]);
+		if (rets[i] && !ret)
+			ret = rets[i];
+	}
+
+	return ret;
+}
+
+static int test_acipher_jiffies(struct ablkcipher_request **reqs, int nreq,
+				int enc, int blen, int sec)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount += nreq) {
+		ret = do_acipher_ops(reqs, nreq, enc);
+		if (ret)
+			return ret;
+	}
+
+	pr_cont("%d operations in %d seconds (%ld bytes)\n",
+		bcount, sec, (long)bcount * blen);
+	return 0;
+}
+
+static int test_acipher_cycles(struct ablkcipher_request **reqs, int nreq,
+			       int enc, int blen)
+{
+	unsigned long cycles = 0;
+	int ret = 0;
+	int i;
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = do_acipher_ops(reqs, nreq, enc);
+		if (ret)
+			goto out;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = do_acipher_ops(reqs, nreq, enc);
+		end = get_cycles();
+
+		if (ret)
+			goto out;
+
+		cycles += end - start;
+	}
+
+out:
+	if (ret == 0)
+		pr_cont("1 operation in %lu cycles (%d bytes)\n",
+			(cycles + 4) / (8 * nreq), blen);
+
+	return ret;
+}
+
+/*
+ * Like test_cipher_speed(), for asynchronous drivers too, with nreq
+ * requests kept in flight at once.  The requests all work in place on the
+ * same buffer: only the time they take matters here.
+ */
+static void test_acipher_speed(const char *algo, int enc, unsigned int sec,
+			       struct cipher_speed_template *template,
+			       unsigned int tcount, u8 *keysize, int nreq)
+{
+	unsigned int ret, i, j, iv_len;
+	struct tcrypt_result tresult[ACIPHER_MAX_INFLIGHT];
+	struct ablkcipher_request *reqs[ACIPHER_MAX_INFLIGHT];
+	struct crypto_ablkcipher *tfm;
+	struct scatterlist sg[TVMEMSIZE];
+	const char *key;
+	char iv[128];
+	const char *e;
+	u32 *b_size;
+	int n;
+
+	if (enc == ENCRYPT)
+		e = "encryption";
+	else
+		e = "decryption";
+
+	nreq = clamp(nreq, 1, ACIPHER_MAX_INFLIGHT);
+
+	pr_info("\ntesting speed of async %s %s, %d in flight\n", algo, e,
+		nreq);
+
+	tfm = crypto_alloc_ablkcipher(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+	pr_info("driver %s\n",
+		crypto_tfm_alg_driver_name(crypto_ablkcipher_tfm(tfm)));
+
+	for (n = 0; n < nreq; n++) {
+		reqs[n] = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!reqs[n]) {
+			pr_err("ablkcipher request allocation failure\n");
+			goto out;
+		}
+		init_completion(&tresult[n].completion);
+		ablkcipher_request_set_callback(reqs[n],
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						tcrypt_complete, &tresult[n]);
+	}
+
+	i = 0;
+	do {
+		b_size = block_sizes;
+
+		do {
+			if ((*keysize + *b_size) > TVMEMSIZE * PAGE_SIZE) {
+				pr_err("template (%u) too big for "
+				       "tvmem (%lu)\n", *keysize + *b_size,
+				       TVMEMSIZE * PAGE_SIZE);
+				goto out;
+			}
+
+			pr_info("test %u (%d bit key, %d byte blocks): ", i,
+				*keysize * 8, *b_size);
+
+			memset(tvmem[0], 0xff, PAGE_SIZE);
+
+			/* set key, plain text and IV */
+			key = tvmem[0];
+			for (j = 0; j < tcount; j++) {
+				if (template[j].klen == *keysize) {
+					key = template[j].key;
+					break;
+				}
+			}
+
+			crypto_ablkcipher_clear_flags(tfm, ~0);
+			ret = crypto_ablkcipher_setkey(tfm, key, *keysize);
+			if (ret) {
+				pr_err("setkey() failed flags=%x\n",
+					crypto_ablkcipher_get_flags(tfm));
+				goto out;
+			}
+
+			sg_init_table(sg, TVMEMSIZE);
+			sg_set_buf(sg, tvmem[0] + *keysize,
+				   PAGE_SIZE - *keysize);
+			for (j = 1; j < TVMEMSIZE; j++) {
+				sg_set_buf(sg + j, tvmem[j], PAGE_SIZE);
+				memset(tvmem[j], 0xff, PAGE_SIZE);
+			}
+
+			iv_len = crypto_ablkcipher_ivsize(tfm);
+			if (iv_len)
+				memset(&iv, 0xff, iv_len);
+
+			for (j = 0; j < nreq; j++)
+				ablkcipher_request_set_crypt(reqs[j], sg, sg,
+							     *b_size, iv);
+
+			if (sec)
+				ret = test_acipher_jiffies(reqs, nreq, enc,
+							   *b_size, sec);
+			else
+				ret = test_acipher_cycles(reqs, nreq, enc,
+							  *b_size);
+
+			if (ret) {
+				pr_err("%s() failed flags=%x\n", e,
+					crypto_ablkcipher_get_flags(tfm));
+				break;
+			}
+			b_size++;
+			i++;
+		} while (*b_size);
+		keysize++;
+	} while (*keysize);
+
+out:
+	while (n--)
+		ablkcipher_request_free(reqs[n]);
+	crypto_free_ablkcipher(tfm);
+}
+
+/*
+ * Used by test_mt_speed(): one thread of several running the same
+ * algorithm, each with a tfm, a buffer and ACIPHER_MAX_INFLIGHT requests
+ * of its own.  enc is -1 for hashes.
+ */
+struct tcrypt_mt_thread {
+	const char *algo;
+	int enc;
+	unsigned int blen;
+	struct completion *go;
+	unsigned long *end;
+	struct completion done;
+	unsigned long ops;
+	int err;
+};
+
+static int tcrypt_mt_wait(struct crypto_async_request *base, int ret)
+{
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		struct tcrypt_result *tr = base->data;
+
+		wait_for_completion(&tr->completion);
+		ret = tr->err;
+		INIT_COMPLETION(tr->completion);
+	}
+	return ret;
+}
+
+static int tcrypt_mt_thread_fn(void *data)
+{
+	struct tcrypt_mt_thread *t = data;
+	struct tcrypt_result tresult[ACIPHER_MAX_INFLIGHT];
+	struct scatterlist sg[ACIPHER_MAX_INFLIGHT];
+	struct ablkcipher_request *creqs[ACIPHER_MAX_INFLIGHT];
+	struct ahash_request *hreqs[ACIPHER_MAX_INFLIGHT];
+	struct crypto_ablkcipher *ctfm = NULL;
+	struct crypto_ahash *htfm = NULL;
+	static const u8 key[16] = { [0 ... 15] = 0xff };
+	u8 iv[ACIPHER_MAX_INFLIGHT][16];
+	u8 out[ACIPHER_MAX_INFLIGHT][64];
+	int rets[ACIPHER_MAX_INFLIGHT];
+	int n = 0, i, err;
+	u8 *buf;
+
+	err = -ENOMEM;
+	buf = kmalloc(t->blen * ACIPHER_MAX_INFLIGHT, GFP_KERNEL);
+	if (!buf)
+		goto out;
+	memset(buf, 0xff, t->blen * ACIPHER_MAX_INFLIGHT);
+	memset(iv, 0xff, sizeof(iv));
+
+	if (t->enc < 0) {
+		htfm = crypto_alloc_ahash(t->algo, 0, 0);
+		err = PTR_ERR(htfm);
+		if (IS_ERR(htfm)) {
+			htfm = NULL;
+			goto out;
+		}
+		err = -EINVAL;
+		if (crypto_ahash_digestsize(htfm) > sizeof(out[0]))
+			goto out;
+	} else {
+		ctfm = crypto_alloc_ablkcipher(t->algo, 0, 0);
+		err = PTR_ERR(ctfm);
+		if (IS_ERR(ctfm)) {
+			ctfm = NULL;
+			goto out;
+		}
+		err = -EINVAL;
+		if (crypto_ablkcipher_ivsize(ctfm) > sizeof(iv[0]))
+			goto out;
+		err = crypto_ablkcipher_setkey(ctfm, key, sizeof(key));
+		if (err)
+			goto out;
+	}
+
+	err = -ENOMEM;
+	for (n = 0; n < ACIPHER_MAX_INFLIGHT; n++) {
+		init_completion(&tresult[n].completion);
+		sg_init_one(&sg[n], buf + n * t->blen, t->blen);
+		if (htfm) {
+			hreqs[n] = ahash_request_alloc(htfm, GFP_KERNEL);
+			if (!hreqs[n])
+				goto out;
+			ahash_request_set_callback(hreqs[n],
+						   CRYPTO_TFM_REQ_MAY_BACKLOG,
+						   tcrypt_complete,
+						   &tresult[n]);
+			ahash_request_set_crypt(hreqs[n], &sg[n], out[n],
+						t->blen);
+		} else {
+			creqs[n] = ablkcipher_request_alloc(ctfm, GFP_KERNEL);
+			if (!creqs[n])
+				goto out;
+			ablkcipher_request_set_callback(creqs[n],
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						tcrypt_complete, &tresult[n]);
+			ablkcipher_request_set_crypt(creqs[n], &sg[n], &sg[n],
+						     t->blen, iv[n]);
+		}
+	}
+
+	err = 0;
+	wait_for_completion(t->go);
+
+	while (!err && time_before(jiffies, *t->end)) {
+		for (i = 0; i < n; i++) {
+			if (htfm)
+				rets[i] = crypto_ahash_digest(hreqs[i]);
+			else if (t->enc)
+				rets[i] = crypto_ablkcipher_encrypt(creqs[i]);
+			else
+				rets[i] = crypto_ablkcipher_decrypt(creqs[i]);
+		}
+		for (i = 0; i < n; i++) {
+			rets[i] = tcrypt_mt_wait(htfm ? &hreqs[i]->base :
+						 &creqs[i]->base, rets[i]);
+			if (rets[i] && !err)
+				err = rets[i];
+		}
+		t->ops += n;
+	}
+
+out:
+	while (n--) {
+		if (htfm)
+			ahash_request_free(hreqs[n]);
+		else
+			ablkcipher_request_free(creqs[n]);
+	}
+	if (htfm)
+		crypto_free_ahash(htfm);
+	if (ctfm)
+		crypto_free_ablkcipher(ctfm);
+	kfree(buf);
+
+	t->err = err;
+	complete(&t->done);
+	return 0;
+}
+
+/*
+ * Aggregate throughput of algo with nthreads threads hammering it at
+ * once, for the parallel wrappers such as pcrypt: compare algo with
+ * pcrypt(algo).  enc is ENCRYPT or DECRYPT for block ciphers, -1 for
+ * hashes.  Block ciphers get a 128 bit key.
+ */
+static void test_mt_speed(const char *algo, int enc, unsigned int sec,
+			  unsigned int nthreads)
+{
+	static const unsigned int mt_block_sizes[] = { 64, 256, 1024, 8192, 0 };
+	struct tcrypt_mt_thread *t;
+	struct completion go;
+	struct task_struct *task;
+	unsigned long end, ops;
+	const unsigned int *b_size;
+	unsigned int i, started;
+	u64 bytes;
+	int err;
+
+	if (!sec)
+		sec = 1;
+	if (!nthreads)
+		nthreads = num_online_cpus();
+
+	pr_info("\ntesting speed of %s %s with %u threads\n", algo,
+		enc < 0 ? "digest" : enc ? "encryption" : "decryption",
+		nthreads);
+
+	t = kcalloc(nthreads, sizeof(*t), GFP_KERNEL);
+	if (!t) {
+		pr_err("thread allocation failure\n");
+		return;
+	}
+
+	for (b_size = mt_block_sizes; *b_size; b_size++) {
+		init_completion(&go);
+		for (started = 0; started < nthreads; started++) {
+			memset(&t[started], 0, sizeof(t[started]));
+			t[started].algo = algo;
+			t[started].enc = enc;
+			t[started].blen = *b_size;
+			t[started].go = &go;
+			t[started].end = &end;
+			init_completion(&t[started].done);
+			task = kthread_run(tcrypt_mt_thread_fn, &t[started],
+					   "tcrypt/%u", started);
+			if (IS_ERR(task)) {
+				pr_err("failed to start thread: %ld\n",
+				       PTR_ERR(task));
+				break;
+			}
+		}
+
+		end = jiffies + sec * HZ;
+		complete_all(&go);
+
+		err = 0;
+		ops = 0;
+		for (i = 0; i < started; i++) {
+			wait_for_completion(&t[i].done);
+			ops += t[i].ops;
+			if (t[i].err && !err)
+				err = t[i].err;
+		}
+
+		if (err || started < nthreads) {
+			pr_err("%s failed: %d\n", algo, err);
+			break;
+		}
+
+		bytes = (u64)ops * *b_size;
+		pr_info("%u byte blocks: %lu operations in %u seconds "
+			"(%llu bytes, %llu MB/s)\n", *b_size, ops, sec,
+			(unsigned long long)bytes,
+			(unsigned long long)div_u64(bytes, sec << 20));
+	}
+
+	kfree(t);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1063,6 +1509,93 @@ static int do_test(int m)
 				  speed_template_16_32);
 		break;
 
+	case 207:
+		/* The generic C against the assembler AES, where there is one. */
+		test_cipher_speed("ecb(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ecb(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes-generic)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes-generic)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ecb(aes-asm)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ecb(aes-asm)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-asm)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("cbc(aes-asm)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes-asm)", ENCRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		test_cipher_speed("ctr(aes-asm)", DECRYPT, sec, NULL, 0,
+				speed_template_16_24_32);
+		break;
+
+	case 208:
+		/*
+		 * The tegra engine against the software cipher, one request
+		 * at a time: where the two cross is the fallback_bytes of
+		 * tegra-aes.  Set it to 0 first to time only the engine.
+		 */
+		test_acipher_speed("ecb-aes-tegra", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32, 1);
+		test_acipher_speed("ecb-aes-tegra", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32, 1);
+		test_acipher_speed("cbc-aes-tegra", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32, 1);
+		test_acipher_speed("cbc-aes-tegra", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32, 1);
+		test_acipher_speed("ecb(aes)", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32, 1);
+		test_acipher_speed("ecb(aes)", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32, 1);
+		test_acipher_speed("cbc(aes)", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32, 1);
+		test_acipher_speed("cbc(aes)", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32, 1);
+		break;
+
+	case 209:
+		/* As 208, with requests batched by keeping several queued. */
+		test_acipher_speed("ecb-aes-tegra", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32,
+				   ACIPHER_MAX_INFLIGHT);
+		test_acipher_speed("ecb-aes-tegra", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32,
+				   ACIPHER_MAX_INFLIGHT);
+		test_acipher_speed("cbc-aes-tegra", ENCRYPT, sec, NULL, 0,
+				   speed_template_16_24_32,
+				   ACIPHER_MAX_INFLIGHT);
+		test_acipher_speed("cbc-aes-tegra", DECRYPT, sec, NULL, 0,
+				   speed_template_16_24_32,
+				   ACIPHER_MAX_INFLIGHT);
+		break;
+
+	case 210:
+		/*
+		 * One thread per CPU (or threads=), without and with pcrypt:
+		 * a single stream of requests uses one CPU at most without.
+		 */
+		test_mt_speed("cbc(aes)", ENCRYPT, sec, threads);
+		test_mt_speed("pcrypt(cbc(aes))", ENCRYPT, sec, threads);
+		test_mt_speed("cbc(aes)", DECRYPT, sec, threads);
+		test_mt_speed("pcrypt(cbc(aes))", DECRYPT, sec, threads);
+		break;
+
+	case 211:
+		/* As 210, for hashes. */
+		test_mt_speed("sha1", -1, sec, threads);
+		test_mt_speed("pcrypt(sha1)", -1, sec, threads);
+		test_mt_speed("hmac(sha1)", -1, sec, threads);
+		test_mt_speed("pcrypt(hmac(sha1))", -1, sec, threads);
+		break;
+
 	case 300:
 		/* fall through */
 
@@ -1138,6 +1671,15 @@ static int do_test(int m)
 		test_hash_speed("ghash-generic", sec, hash_speed_template_16);
 		if (mode > 300 && mode < 400) break;
 
+	case 319:
+		/* The generic C against the assembler SHA, where there is one. */
+		test_hash_speed("sha1-generic", sec, generic_hash_speed_template);
+		test_hash_speed("sha1-asm", sec, generic_hash_speed_template);
+		test_hash_speed("sha256-generic", sec,
+				generic_hash_speed_template);
+		test_hash_speed("sha256-asm", sec, generic_hash_speed_template);
+		if (mode > 300 && mode < 400) break;
+
 	case 399:
 		break;
 
@@ -1283,6 +1825,9 @@ module_param(mode, int, 0);
 module_param(sec, uint, 0);
 MODULE_PARM_DESC(sec, "Length in seconds of speed tests "
 		      "(defaults to zero which uses CPU cycles instead)");
+module_param(threads, uint, 0);
+MODULE_PARM_DESC(threads, "Threads of multi-threaded speed tests "
+			  "(defaults to zero for one per online CPU)");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
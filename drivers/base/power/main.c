@@ -58,6 +58,17 @@ struct dpm_drv_wd_data {
  */
 static bool transition_started;
 
+/*
+ * Async suspends and resumes of childless devices that did not ask for them.
+ * Those may depend on devices before them in dpm_list, so the devices that
+ * are handled synchronously wait for all of these first.
+ */
+static LIST_HEAD(dpm_leaf_domain);
+
+/* The leaf that finished resuming last since dpm_resume() last took it */
+static DEFINE_SPINLOCK(dpm_leaf_lock);
+static struct device *dpm_leaf_last;
+
 /**
  * device_pm_init - Initialize the PM-related part of a device object.
  * @dev: Device object being initialized.
@@ -120,13 +131,18 @@ void device_pm_add(struct device *dev)
  */
 void device_pm_remove(struct device *dev)
 {
+	struct device *prev;
+
 	pr_debug("PM: Removing info for %s:%s\n",
 		 dev->bus ? dev->bus->name : "No Bus",
 		 kobject_name(&dev->kobj));
 	complete_all(&dev->power.completion);
 	mutex_lock(&dpm_list_mtx);
 	list_del_init(&dev->power.entry);
+	prev = dev->power.resume_prev;
+	dev->power.resume_prev = NULL;
 	mutex_unlock(&dpm_list_mtx);
+	put_device(prev);
 	pm_runtime_remove(dev);
 }
 
@@ -210,7 +226,8 @@ static void dpm_wait(struct device *dev, bool async)
 	if (!dev)
 		return;
 
-	if (async || (pm_async_enabled && dev->power.async_suspend))
+	if (async || (pm_async_enabled && dev->power.async_suspend) ||
+	    dev->power.async_leaf)
 		wait_for_completion(&dev->power.completion);
 }
 
@@ -537,6 +554,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	device_lock(dev);
 
 	dev->power.status = DPM_RESUMING;
+	dev->power.resume_start = ktime_get();
 
 	if (dev->bus) {
 		if (dev->bus->pm) {
@@ -569,6 +587,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 		}
 	}
  End:
+	dev->power.resume_end = ktime_get();
 	device_unlock(dev);
 	complete_all(&dev->power.completion);
 
@@ -576,6 +595,35 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	return error;
 }
 
+/*
+ * Keep a reference to the leaf that finished resuming last, for the next
+ * synchronous device to record as the one it waited for.
+ */
+static void dpm_leaf_resumed(struct device *dev)
+{
+	struct device *old;
+
+	spin_lock(&dpm_leaf_lock);
+	old = dpm_leaf_last;
+	if (!old || dev->power.resume_end.tv64 > old->power.resume_end.tv64)
+		dpm_leaf_last = get_device(dev);
+	else
+		old = NULL;
+	spin_unlock(&dpm_leaf_lock);
+	put_device(old);
+}
+
+static struct device *dpm_take_leaf_last(void)
+{
+	struct device *dev;
+
+	spin_lock(&dpm_leaf_lock);
+	dev = dpm_leaf_last;
+	dpm_leaf_last = NULL;
+	spin_unlock(&dpm_leaf_lock);
+	return dev;
+}
+
 static void async_resume(void *data, async_cookie_t cookie)
 {
 	struct device *dev = (struct device *)data;
@@ -584,6 +632,8 @@ static void async_resume(void *data, async_cookie_t cookie)
 	error = device_resume(dev, pm_transition, true);
 	if (error)
 		pm_dev_err(dev, pm_transition, " async", error);
+	if (dev->power.async_leaf)
+		dpm_leaf_resumed(dev);
 	put_device(dev);
 }
 
@@ -593,6 +643,122 @@ static bool is_async(struct device *dev)
 		&& !pm_trace_is_enabled();
 }
 
+static int dpm_has_child(struct device *dev, void *unused)
+{
+	return 1;
+}
+
+/**
+ * is_async_leaf - Check if a device is to be handled with its neighbours.
+ * @dev: Device to check.
+ *
+ * Devices with a driver and no children are suspended and resumed
+ * asynchronously even if their drivers have not set async_suspend, but only
+ * alongside the other such devices next to them in dpm_list.  Decided when the
+ * device is prepared, as no children can be added to it after that.
+ */
+static bool is_async_leaf(struct device *dev)
+{
+	return pm_async_enabled && pm_async_leaves_enabled
+		&& !pm_trace_is_enabled() && !dev->power.async_suspend
+		&& dev->driver && !device_for_each_child(dev, NULL, dpm_has_child);
+}
+
+#define DPM_PATH_MAX		32
+#define DPM_PATH_MIN_USECS	1000
+
+static bool dpm_resumed_since(struct device *dev, ktime_t starttime)
+{
+	return dev->power.resume_start.tv64 >= starttime.tv64 &&
+		dev->power.resume_end.tv64 >= dev->power.resume_start.tv64;
+}
+
+/*
+ * Whether @d finished resuming before @dev started.  Also requires it to have
+ * finished before @dev did, so that following these never goes round in
+ * circles with devices that took no measurable time.
+ */
+static bool dpm_resume_before(struct device *d, struct device *dev,
+			      ktime_t starttime)
+{
+	return dpm_resumed_since(d, starttime) &&
+		d->power.resume_end.tv64 <= dev->power.resume_start.tv64 &&
+		d->power.resume_end.tv64 < dev->power.resume_end.tv64;
+}
+
+/*
+ * The device @dev had to wait for: whichever of its parent and the device
+ * dpm_resume() recorded for it finished last before @dev started.  The latter
+ * is the synchronous device before it, or the last of the leaves in between,
+ * and for leaves it is the synchronous device that let their batch start.
+ */
+static struct device *dpm_resume_waited_for(struct device *dev,
+					    ktime_t starttime)
+{
+	struct device *d, *found = NULL;
+
+	d = dev->parent;
+	if (d && dpm_resume_before(d, dev, starttime))
+		found = d;
+	d = dev->power.resume_prev;
+	if (d && dpm_resume_before(d, dev, starttime) && (!found ||
+	    d->power.resume_end.tv64 > found->power.resume_end.tv64))
+		found = d;
+	return found;
+}
+
+/**
+ * dpm_show_critical_path - Report the chain of devices resume waited on.
+ * @starttime: When resume started.
+ *
+ * Starting from the device that finished resuming last, follow the devices each
+ * one had to wait for back to the start of resume.  The time taken by the
+ * devices on that path is the time resume takes, however many others run
+ * alongside them, so print the path with what each device on it took.
+ * Called with dpm_list_mtx held.
+ */
+static void dpm_show_critical_path(ktime_t starttime)
+{
+	struct device *path[DPM_PATH_MAX], *dev, *last = NULL;
+	int usecs, busy = 0, start;
+	int n = 0, i;
+
+	list_for_each_entry(dev, &dpm_list, power.entry)
+		if (dpm_resumed_since(dev, starttime) && (!last ||
+		    dev->power.resume_end.tv64 > last->power.resume_end.tv64))
+			last = dev;
+	if (!last)
+		return;
+
+	usecs = ktime_us_delta(last->power.resume_end, starttime);
+	for (dev = last; dev; dev = dpm_resume_waited_for(dev, starttime)) {
+		if (n < DPM_PATH_MAX)
+			path[n] = dev;
+		n++;
+		busy += ktime_us_delta(dev->power.resume_end,
+				       dev->power.resume_start);
+	}
+
+	pr_info("PM: resume critical path %ld.%03ld msecs, %ld.%03ld in "
+		"callbacks of %d devices\n", usecs / USEC_PER_MSEC,
+		usecs % USEC_PER_MSEC, busy / USEC_PER_MSEC,
+		busy % USEC_PER_MSEC, n);
+	for (i = min(n, DPM_PATH_MAX) - 1; i >= 0; i--) {
+		dev = path[i];
+		usecs = ktime_us_delta(dev->power.resume_end,
+				       dev->power.resume_start);
+		if (usecs < DPM_PATH_MIN_USECS)
+			continue;
+		start = ktime_us_delta(dev->power.resume_start, starttime);
+		pr_info("PM:   at %ld.%03ld took %ld.%03ld msecs: %s%s%s%s\n",
+			start / USEC_PER_MSEC, start % USEC_PER_MSEC,
+			usecs / USEC_PER_MSEC, usecs % USEC_PER_MSEC,
+			dev_name(dev), dev->driver ? " (" : "",
+			dev->driver ? dev->driver->name : "",
+			dev->driver ? ")" : "");
+	}
+}
+
 /**
  *	dpm_drv_timeout - Driver suspend / resume watchdog handler
  *	@data: struct device which timed out
@@ -627,7 +793,7 @@ static void dpm_drv_timeout(unsigned long data)
 static void dpm_resume(pm_message_t state)
 {
 	struct list_head list;
-	struct device *dev;
+	struct device *dev, *prev = NULL, *leaf;
 	ktime_t starttime = ktime_get();
 
 	INIT_LIST_HEAD(&list);
@@ -648,16 +814,39 @@ static void dpm_resume(pm_message_t state)
 	while (!list_empty(&dpm_list)) {
 		dev = to_device(dpm_list.next);
 		get_device(dev);
-		if (dev->power.status >= DPM_OFF && !is_async(dev)) {
+		if (dev->power.status >= DPM_OFF && dev->power.async_leaf) {
+			dev->power.resume_prev = get_device(prev);
+			get_device(dev);
+			mutex_unlock(&dpm_list_mtx);
+
+			async_schedule_domain(async_resume, dev,
+					      &dpm_leaf_domain);
+
+			mutex_lock(&dpm_list_mtx);
+		} else if (dev->power.status >= DPM_OFF && !is_async(dev)) {
 			int error;
 
 			mutex_unlock(&dpm_list_mtx);
 
+			async_synchronize_full_domain(&dpm_leaf_domain);
 			error = device_resume(dev, state, false);
 
 			mutex_lock(&dpm_list_mtx);
 			if (error)
 				pm_dev_err(dev, state, "", error);
+
+			leaf = dpm_take_leaf_last();
+			if (!leaf || (prev && leaf->power.resume_end.tv64 <=
+					      prev->power.resume_end.tv64)) {
+				put_device(leaf);
+				leaf = get_device(prev);
+			}
+			if (!list_empty(&dev->power.entry))
+				dev->power.resume_prev = leaf;
+			else
+				put_device(leaf);
+			put_device(prev);
+			prev = get_device(dev);
 		} else if (dev->power.status == DPM_SUSPENDING) {
 			/* Allow new children of the device to be registered */
 			dev->power.status = DPM_RESUMING;
@@ -668,8 +857,19 @@ static void dpm_resume(pm_message_t state)
 	}
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full_domain(&dpm_leaf_domain);
 	async_synchronize_full();
 	dpm_show_time(starttime, state, NULL);
+
+	mutex_lock(&dpm_list_mtx);
+	dpm_show_critical_path(starttime);
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		put_device(dev->power.resume_prev);
+		dev->power.resume_prev = NULL;
+	}
+	mutex_unlock(&dpm_list_mtx);
+	put_device(dpm_take_leaf_last());
+	put_device(prev);
 }
 
 /**
@@ -719,6 +919,7 @@ static void dpm_complete(pm_message_t state)
 		get_device(dev);
 		if (dev->power.status > DPM_ON) {
 			dev->power.status = DPM_ON;
+			dev->power.async_leaf = false;
 			mutex_unlock(&dpm_list_mtx);
 
 			device_complete(dev, state);
@@ -960,6 +1161,14 @@ static int device_suspend(struct device *dev)
 		return 0;
 	}
 
+	if (dev->power.async_leaf) {
+		get_device(dev);
+		async_schedule_domain(async_suspend, dev, &dpm_leaf_domain);
+		return 0;
+	}
+
+	/* The devices after this one in dpm_list may depend on it. */
+	async_synchronize_full_domain(&dpm_leaf_domain);
 	return __device_suspend(dev, pm_transition, false);
 }
 
@@ -999,6 +1208,7 @@ static int dpm_suspend(pm_message_t state)
 	}
 	list_splice(&list, dpm_list.prev);
 	mutex_unlock(&dpm_list_mtx);
+	async_synchronize_full_domain(&dpm_leaf_domain);
 	async_synchronize_full();
 	if (!error)
 		error = async_error;
@@ -1093,6 +1303,7 @@ static int dpm_prepare(pm_message_t state)
 			break;
 		}
 		dev->power.status = DPM_SUSPENDING;
+		dev->power.async_leaf = is_async_leaf(dev);
 		if (!list_empty(&dev->power.entry))
 			list_move_tail(&dev->power.entry, &list);
 		put_device(dev);
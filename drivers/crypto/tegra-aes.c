@@ -33,6 +33,8 @@
 #include <linux/interrupt.h>
 #include <linux/completion.h>
 #include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <mach/arb_sema.h>
 #include <mach/clk.h>
@@ -130,10 +132,18 @@ enum {
 #define AES_NR_KEYSLOTS	8
 #define SSK_SLOT_NUM	4
 
+/*
+ * The cipher contexts share the key slots: a context gets a slot when one
+ * of its requests is handled and keeps it, with its key loaded, until the
+ * least recently used slot is needed for another context.  Slots in use
+ * are kept on dev_list in LRU order; the rng takes its slot off the list
+ * so that it is never evicted.
+ */
 struct tegra_aes_slot {
 	struct list_head node;
 	int slot_num;
 	bool available;
+	struct tegra_aes_ctx *owner;
 };
 
 static struct tegra_aes_slot ssk = {
@@ -146,6 +156,36 @@ struct tegra_aes_reqctx {
 };
 
 #define TEGRA_AES_QUEUE_LENGTH 50
+#define TEGRA_AES_MAX_BATCH	16
+
+/*
+ * Requests handled per hold of the arbitration semaphore and the clocks.
+ * Consecutive ecb requests of a context are also chained into one run of
+ * the engine through the dma buffers.
+ */
+static unsigned int batch_size = 8;
+module_param(batch_size, uint, 0644);
+MODULE_PARM_DESC(batch_size, "requests handled per hold of the engine (1-16)");
+
+/*
+ * Requests smaller than this are done by the software cipher in the
+ * context of the caller: below it the workqueue and interrupt round trip
+ * costs more than the encryption itself.  Find the crossover for a board
+ * with tcrypt modes 208 and 209.
+ */
+static unsigned int fallback_bytes = 256;
+module_param(fallback_bytes, uint, 0644);
+MODULE_PARM_DESC(fallback_bytes, "requests smaller than this run on the CPU");
+
+struct tegra_aes_stats {
+	unsigned long requests;
+	unsigned long fallbacks;
+	unsigned long batches;
+	unsigned long chained;
+	unsigned long runs;
+	unsigned long key_loads;
+	unsigned long key_hits;
+};
 
 struct tegra_aes_dev {
 	struct device *dev;
@@ -170,12 +210,8 @@ struct tegra_aes_dev {
 	spinlock_t lock;
 	struct crypto_queue queue;
 	struct tegra_aes_slot *slots;
-	struct ablkcipher_request *req;
-	size_t total;
-	struct scatterlist *in_sg;
-	size_t in_offset;
-	struct scatterlist *out_sg;
-	size_t out_offset;
+	struct tegra_aes_stats stats;
+	struct dentry *debugfs;
 };
 
 static struct tegra_aes_dev *aes_dev;
@@ -186,6 +222,7 @@ struct tegra_aes_ctx {
 	struct tegra_aes_slot *slot;
 	u8 key[AES_MAX_KEY_SIZE];
 	int keylen;
+	struct crypto_blkcipher *fallback;
 };
 
 static struct tegra_aes_ctx rng_ctx = {
@@ -342,29 +379,85 @@ static int aes_start_crypt(struct tegra_aes_dev *dd, u32 in_addr, u32 out_addr,
 
 static void aes_release_key_slot(struct tegra_aes_ctx *ctx)
 {
+	struct tegra_aes_slot *slot;
+
 	spin_lock(&list_lock);
-	ctx->slot->available = true;
+	slot = ctx->slot;
+	if (slot && slot != &ssk) {
+		slot->available = true;
+		slot->owner = NULL;
+		/* a free slot goes to the front, to be taken first */
+		if (list_empty(&slot->node))
+			list_add(&slot->node, &dev_list);
+		else
+			list_move(&slot->node, &dev_list);
+	}
 	ctx->slot = NULL;
 	spin_unlock(&list_lock);
 }
 
-static struct tegra_aes_slot *aes_find_key_slot(struct tegra_aes_dev *dd)
+/* Takes a free slot, or the least recently used one; list_lock held. */
+static struct tegra_aes_slot *aes_grab_key_slot(struct tegra_aes_dev *dd,
+	struct tegra_aes_ctx *ctx)
 {
-	struct tegra_aes_slot *slot = NULL;
-	bool found = false;
+	struct tegra_aes_slot *slot;
+
+	if (list_empty(&dev_list))
+		return NULL;
 
-	spin_lock(&list_lock);
 	list_for_each_entry(slot, &dev_list, node) {
 		dev_dbg(dd->dev, "empty:%d, num:%d\n", slot->available,
 			slot->slot_num);
-		if (slot->available) {
-			slot->available = false;
-			found = true;
-			break;
-		}
+		if (slot->available)
+			goto found;
 	}
+
+	slot = list_first_entry(&dev_list, struct tegra_aes_slot, node);
+	dev_dbg(dd->dev, "evicting slot %d\n", slot->slot_num);
+	if (slot->owner)
+		slot->owner->slot = NULL;
+
+found:
+	slot->available = false;
+	slot->owner = ctx;
+	return slot;
+}
+
+/* Takes a slot for the rng, which keeps it until it is freed. */
+static struct tegra_aes_slot *aes_find_key_slot(struct tegra_aes_dev *dd)
+{
+	struct tegra_aes_slot *slot;
+
+	spin_lock(&list_lock);
+	slot = aes_grab_key_slot(dd, NULL);
+	if (slot)
+		list_del_init(&slot->node);
 	spin_unlock(&list_lock);
-	return found ? slot : NULL;
+	return slot;
+}
+
+/*
+ * Binds a slot to the cipher context ctx; returns true if the slot still
+ * holds the key of ctx from an earlier request.
+ */
+static bool aes_get_key_slot(struct tegra_aes_dev *dd,
+	struct tegra_aes_ctx *ctx)
+{
+	struct tegra_aes_slot *slot;
+	bool cached = false;
+
+	spin_lock(&list_lock);
+	slot = ctx->slot;
+	if (slot && slot->owner == ctx) {
+		cached = true;
+	} else {
+		slot = aes_grab_key_slot(dd, ctx);
+		ctx->slot = slot;
+	}
+	if (slot)
+		list_move_tail(&slot->node, &dev_list);
+	spin_unlock(&list_lock);
+	return cached;
 }
 
 static int aes_set_key(struct tegra_aes_dev *dd)
@@ -436,79 +529,114 @@ out:
 	return 0;
 }
 
-static int tegra_aes_handle_req(struct tegra_aes_dev *dd)
+static void aes_load_key(struct tegra_aes_dev *dd, struct tegra_aes_ctx *ctx)
 {
-	struct crypto_async_request *async_req, *backlog;
-	struct tegra_aes_ctx *ctx;
-	struct tegra_aes_reqctx *rctx;
-	struct ablkcipher_request *req;
-	unsigned long flags;
-	int dma_max = AES_HW_DMA_BUFFER_SIZE_BYTES;
-	int ret = 0, nblocks, total;
-	int count = 0;
-	dma_addr_t addr_in, addr_out;
-	struct scatterlist *in_sg, *out_sg;
+	if (aes_get_key_slot(dd, ctx) && !(ctx->flags & FLAGS_NEW_KEY)) {
+		dd->stats.key_hits++;
+		return;
+	}
 
-	if (!dd)
-		return -EINVAL;
+	/* copy the key */
+	memset(dd->ivkey_base, 0, AES_HW_KEY_TABLE_LENGTH_BYTES);
+	memcpy(dd->ivkey_base, ctx->key, ctx->keylen);
+	aes_set_key(dd);
+	ctx->flags &= ~FLAGS_NEW_KEY;
+	dd->stats.key_loads++;
+}
 
-	spin_lock_irqsave(&dd->lock, flags);
-	backlog = crypto_get_backlog(&dd->queue);
-	async_req = crypto_dequeue_request(&dd->queue);
-	if (!async_req)
-		clear_bit(FLAGS_BUSY, &dd->flags);
-	spin_unlock_irqrestore(&dd->lock, flags);
+/* Runs nbytes at the dma addresses in and out through the engine. */
+static int aes_crypt_dma(struct tegra_aes_dev *dd, dma_addr_t in,
+	dma_addr_t out, size_t nbytes)
+{
+	size_t count;
+	int ret;
 
-	if (!async_req)
-		return -ENODATA;
+	while (nbytes) {
+		count = min_t(size_t, nbytes, AES_HW_DMA_BUFFER_SIZE_BYTES);
+		ret = aes_start_crypt(dd, (u32)in, (u32)out,
+			DIV_ROUND_UP(count, AES_BLOCK_SIZE), dd->flags, true);
+		if (ret < 0) {
+			dev_err(dd->dev, "aes_start_crypt fail(%d)\n", ret);
+			return ret;
+		}
+		dd->stats.runs++;
 
-	if (backlog)
-		backlog->complete(backlog, -EINPROGRESS);
+		dev_dbg(dd->dev, "out: copied %zu\n", count);
+		in += count;
+		out += count;
+		nbytes -= count;
+	}
 
-	req = ablkcipher_request_cast(async_req);
+	return 0;
+}
 
-	dev_dbg(dd->dev, "%s: get new req\n", __func__);
+/*
+ * Whether the engine can work on the buffers of req in place: each of
+ * src and dst must be a single aligned scatterlist entry.
+ */
+static bool aes_can_map(struct ablkcipher_request *req)
+{
+	return req->src->length >= req->nbytes &&
+		req->dst->length >= req->nbytes &&
+		IS_ALIGNED(req->src->offset, sizeof(u32)) &&
+		IS_ALIGNED(req->dst->offset, sizeof(u32)) &&
+		IS_ALIGNED(req->nbytes, AES_BLOCK_SIZE);
+}
 
-	if (!req->src || !req->dst)
+static int aes_crypt_mapped(struct tegra_aes_dev *dd,
+	struct ablkcipher_request *req)
+{
+	int ret;
+
+	ret = dma_map_sg(dd->dev, req->src, 1, DMA_TO_DEVICE);
+	if (!ret) {
+		dev_err(dd->dev, "dma_map_sg() error\n");
 		return -EINVAL;
+	}
 
-	/* take the hardware semaphore */
-	if (tegra_arb_mutex_lock_timeout(dd->res_id, ARB_SEMA_TIMEOUT) < 0) {
-		dev_err(dd->dev, "aes hardware not available\n");
-		return -EBUSY;
+	ret = dma_map_sg(dd->dev, req->dst, 1, DMA_FROM_DEVICE);
+	if (!ret) {
+		dev_err(dd->dev, "dma_map_sg() error\n");
+		dma_unmap_sg(dd->dev, req->src, 1, DMA_TO_DEVICE);
+		return -EINVAL;
 	}
 
-	/* assign new request to device */
-	dd->req = req;
-	dd->total = req->nbytes;
-	dd->in_offset = 0;
-	dd->in_sg = req->src;
-	dd->out_offset = 0;
-	dd->out_sg = req->dst;
+	dd->flags |= FLAGS_FAST;
+	ret = aes_crypt_dma(dd, sg_dma_address(req->src),
+		sg_dma_address(req->dst), req->nbytes);
+	dd->flags &= ~FLAGS_FAST;
 
-	in_sg = dd->in_sg;
-	out_sg = dd->out_sg;
+	dma_unmap_sg(dd->dev, req->dst, 1, DMA_FROM_DEVICE);
+	dma_unmap_sg(dd->dev, req->src, 1, DMA_TO_DEVICE);
+	return ret;
+}
 
-	total = dd->total;
-	rctx = ablkcipher_request_ctx(req);
-	ctx = crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
-	rctx->mode &= FLAGS_MODE_MASK;
-	dd->flags = (dd->flags & ~FLAGS_MODE_MASK) | rctx->mode;
+/* Goes through the dma buffers, for scattered or unaligned requests. */
+static int aes_crypt_bounce(struct tegra_aes_dev *dd,
+	struct ablkcipher_request *req)
+{
+	size_t off, count;
+	int ret = 0;
 
-	dd->iv = (u8 *)req->info;
-	dd->ivlen = AES_BLOCK_SIZE;
+	for (off = 0; off < req->nbytes; off += count) {
+		count = min_t(size_t, req->nbytes - off,
+			AES_HW_DMA_BUFFER_SIZE_BYTES);
+		scatterwalk_map_and_copy(dd->buf_in, req->src, off, count, 0);
+		ret = aes_crypt_dma(dd, dd->dma_buf_in, dd->dma_buf_out, count);
+		if (ret < 0)
+			break;
+		scatterwalk_map_and_copy(dd->buf_out, req->dst, off, count, 1);
+	}
 
-	/* assign new context to device */
-	ctx->dd = dd;
-	dd->ctx = ctx;
+	return ret;
+}
 
-	if (ctx->flags & FLAGS_NEW_KEY) {
-		/* copy the key */
-		memset(dd->ivkey_base, 0, AES_HW_KEY_TABLE_LENGTH_BYTES);
-		memcpy(dd->ivkey_base, ctx->key, ctx->keylen);
-		aes_set_key(dd);
-		ctx->flags &= ~FLAGS_NEW_KEY;
-	}
+static int aes_crypt_req(struct tegra_aes_dev *dd,
+	struct ablkcipher_request *req)
+{
+	u8 next_iv[AES_BLOCK_SIZE];
+	bool cbc = (dd->flags & FLAGS_CBC) && dd->iv;
+	int ret;
 
 	if (((dd->flags & FLAGS_CBC) || (dd->flags & FLAGS_OFB)) && dd->iv) {
 		/* set iv to the aes hw slot
@@ -521,63 +649,189 @@ static int tegra_aes_handle_req(struct tegra_aes_dev *dd)
 		  (u32)dd->dma_buf_out, 1, FLAGS_CBC, false);
 		if (ret < 0) {
 			dev_err(dd->dev, "aes_start_crypt fail(%d)\n", ret);
-			goto out;
+			return ret;
 		}
 	}
 
-	while (total) {
-		dev_dbg(dd->dev, "remain: %d\n", total);
-		ret = dma_map_sg(dd->dev, in_sg, 1, DMA_TO_DEVICE);
-		if (!ret) {
-			dev_err(dd->dev, "dma_map_sg() error\n");
-			goto out;
-		}
+	/* the last ciphertext block is the iv of the request that follows */
+	if (cbc && !(dd->flags & FLAGS_ENCRYPT))
+		scatterwalk_map_and_copy(next_iv, req->src,
+			req->nbytes - AES_BLOCK_SIZE, AES_BLOCK_SIZE, 0);
+
+	if (aes_can_map(req))
+		ret = aes_crypt_mapped(dd, req);
+	else
+		ret = aes_crypt_bounce(dd, req);
+
+	if (!ret && cbc) {
+		if (dd->flags & FLAGS_ENCRYPT)
+			scatterwalk_map_and_copy(dd->iv, req->dst,
+				req->nbytes - AES_BLOCK_SIZE, AES_BLOCK_SIZE, 0);
+		else
+			memcpy(dd->iv, next_iv, AES_BLOCK_SIZE);
+	}
 
-		ret = dma_map_sg(dd->dev, out_sg, 1, DMA_FROM_DEVICE);
-		if (!ret) {
-			dev_err(dd->dev, "dma_map_sg() error\n");
-			dma_unmap_sg(dd->dev, dd->in_sg,
-				1, DMA_TO_DEVICE);
-			goto out;
-		}
+	return ret;
+}
 
-		addr_in = sg_dma_address(in_sg);
-		addr_out = sg_dma_address(out_sg);
-		dd->flags |= FLAGS_FAST;
-		count = min((int)sg_dma_len(in_sg), (int)dma_max);
-		WARN_ON(sg_dma_len(in_sg) != sg_dma_len(out_sg));
-		nblocks = DIV_ROUND_UP(count, AES_BLOCK_SIZE);
+/*
+ * Counts how many of the n requests from reqs[0] on can be chained into
+ * a single run of the engine: ecb requests of the same context and
+ * direction whose data fits the dma buffers together.  Each cbc or ofb
+ * request starts from its own iv, so those are never chained.
+ */
+static int aes_chain_len(struct ablkcipher_request **reqs, int n)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(reqs[0]);
+	struct tegra_aes_reqctx *rctx = ablkcipher_request_ctx(reqs[0]);
+	size_t total = reqs[0]->nbytes;
+	int i;
 
-		ret = aes_start_crypt(dd, addr_in, addr_out, nblocks,
-			dd->flags, true);
+	if (rctx->mode & (FLAGS_CBC | FLAGS_OFB))
+		return 1;
 
-		dma_unmap_sg(dd->dev, out_sg, 1, DMA_FROM_DEVICE);
-		dma_unmap_sg(dd->dev, in_sg, 1, DMA_TO_DEVICE);
+	for (i = 1; i < n; i++) {
+		struct tegra_aes_reqctx *next = ablkcipher_request_ctx(reqs[i]);
 
-		if (ret < 0) {
-			dev_err(dd->dev, "aes_start_crypt fail(%d)\n", ret);
-			goto out;
-		}
-		dd->flags &= ~FLAGS_FAST;
+		if (crypto_ablkcipher_reqtfm(reqs[i]) != tfm ||
+		    next->mode != rctx->mode ||
+		    total + reqs[i]->nbytes > AES_HW_DMA_BUFFER_SIZE_BYTES)
+			break;
+		total += reqs[i]->nbytes;
+	}
+
+	return i;
+}
+
+static int aes_crypt_chain(struct tegra_aes_dev *dd,
+	struct ablkcipher_request **reqs, int n)
+{
+	u8 *buf_in = (u8 *)dd->buf_in, *buf_out = (u8 *)dd->buf_out;
+	size_t off = 0;
+	int i, ret;
+
+	for (i = 0; i < n; i++) {
+		scatterwalk_map_and_copy(buf_in + off, reqs[i]->src, 0,
+			reqs[i]->nbytes, 0);
+		off += reqs[i]->nbytes;
+	}
+
+	ret = aes_crypt_dma(dd, dd->dma_buf_in, dd->dma_buf_out, off);
+	if (ret < 0)
+		return ret;
 
-		dev_dbg(dd->dev, "out: copied %d\n", count);
-		total -= count;
-		in_sg = sg_next(in_sg);
-		out_sg = sg_next(out_sg);
-		WARN_ON(((total != 0) && (!in_sg || !out_sg)));
+	for (i = 0, off = 0; i < n; i++) {
+		scatterwalk_map_and_copy(buf_out + off, reqs[i]->dst, 0,
+			reqs[i]->nbytes, 1);
+		off += reqs[i]->nbytes;
 	}
 
-out:
-	/* release the hardware semaphore */
-	tegra_arb_mutex_unlock(dd->res_id);
+	dd->stats.chained += n;
+	return 0;
+}
 
-	dd->total = total;
+/*
+ * Handles reqs[0] together with the requests after it that can share its
+ * run of the engine; returns the number of requests completed.
+ */
+static int tegra_aes_process(struct tegra_aes_dev *dd,
+	struct ablkcipher_request **reqs, int n)
+{
+	struct ablkcipher_request *req = reqs[0];
+	struct tegra_aes_reqctx *rctx = ablkcipher_request_ctx(req);
+	struct tegra_aes_ctx *ctx;
+	int i, ret;
 
-	if (dd->req->base.complete)
-		dd->req->base.complete(&dd->req->base, ret);
+	dev_dbg(dd->dev, "%s: get new req\n", __func__);
 
-	dev_dbg(dd->dev, "%s: exit\n", __func__);
-	return ret;
+	n = aes_chain_len(reqs, n);
+
+	ctx = crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+	rctx->mode &= FLAGS_MODE_MASK;
+	dd->flags = (dd->flags & ~FLAGS_MODE_MASK) | rctx->mode;
+
+	dd->iv = (u8 *)req->info;
+	dd->ivlen = AES_BLOCK_SIZE;
+
+	/* assign new context to device */
+	ctx->dd = dd;
+	dd->ctx = ctx;
+
+	aes_load_key(dd, ctx);
+
+	if (n > 1)
+		ret = aes_crypt_chain(dd, reqs, n);
+	else
+		ret = aes_crypt_req(dd, req);
+
+	for (i = 0; i < n; i++)
+		if (reqs[i]->base.complete)
+			reqs[i]->base.complete(&reqs[i]->base, ret);
+
+	dd->stats.requests += n;
+	return n;
+}
+
+/* Takes up to batch_size requests off the queue. */
+static int tegra_aes_dequeue(struct tegra_aes_dev *dd,
+	struct ablkcipher_request **reqs)
+{
+	struct crypto_async_request *async_req, *backlog;
+	unsigned int max = clamp_t(unsigned int, batch_size, 1,
+		TEGRA_AES_MAX_BATCH);
+	unsigned long flags;
+	int n;
+
+	for (n = 0; n < max; n++) {
+		spin_lock_irqsave(&dd->lock, flags);
+		backlog = crypto_get_backlog(&dd->queue);
+		async_req = crypto_dequeue_request(&dd->queue);
+		if (!async_req && !n)
+			clear_bit(FLAGS_BUSY, &dd->flags);
+		spin_unlock_irqrestore(&dd->lock, flags);
+
+		if (!async_req)
+			break;
+
+		if (backlog)
+			backlog->complete(backlog, -EINPROGRESS);
+
+		reqs[n] = ablkcipher_request_cast(async_req);
+	}
+
+	return n;
+}
+
+static int tegra_aes_handle_batch(struct tegra_aes_dev *dd)
+{
+	struct ablkcipher_request *reqs[TEGRA_AES_MAX_BATCH];
+	int i, n;
+
+	if (!dd)
+		return -EINVAL;
+
+	n = tegra_aes_dequeue(dd, reqs);
+	if (!n)
+		return -ENODATA;
+
+	/* take the hardware semaphore, once for the whole batch */
+	if (tegra_arb_mutex_lock_timeout(dd->res_id, ARB_SEMA_TIMEOUT) < 0) {
+		dev_err(dd->dev, "aes hardware not available\n");
+		for (i = 0; i < n; i++)
+			if (reqs[i]->base.complete)
+				reqs[i]->base.complete(&reqs[i]->base, -EBUSY);
+		return 0;
+	}
+
+	for (i = 0; i < n; )
+		i += tegra_aes_process(dd, reqs + i, n - i);
+
+	/* release the hardware semaphore */
+	tegra_arb_mutex_unlock(dd->res_id);
+
+	dd->stats.batches++;
+	dev_dbg(dd->dev, "%s: exit, %d requests\n", __func__, n);
+	return 0;
 }
 
 static int tegra_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
@@ -585,7 +839,7 @@ static int tegra_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 {
 	struct tegra_aes_ctx *ctx = crypto_ablkcipher_ctx(tfm);
 	struct tegra_aes_dev *dd = aes_dev;
-	struct tegra_aes_slot *key_slot;
+	int ret;
 
 	if (!ctx || !dd) {
 		dev_err(dd->dev, "ctx=0x%x, dd=0x%x\n",
@@ -604,18 +858,24 @@ static int tegra_aes_setkey(struct crypto_ablkcipher *tfm, const u8 *key,
 	ctx->dd = dd;
 
 	if (key) {
-		if (!ctx->slot) {
-			key_slot = aes_find_key_slot(dd);
-			if (!key_slot) {
-				dev_err(dd->dev, "no empty slot\n");
-				return -ENOMEM;
-			}
-
-			ctx->slot = key_slot;
-		}
-
+		/* the key slot is bound when the first request is handled */
 		memcpy(ctx->key, key, keylen);
 		ctx->keylen = keylen;
+
+		if (ctx->fallback) {
+			crypto_blkcipher_clear_flags(ctx->fallback,
+				CRYPTO_TFM_REQ_MASK);
+			crypto_blkcipher_set_flags(ctx->fallback,
+				crypto_ablkcipher_get_flags(tfm) &
+				CRYPTO_TFM_REQ_MASK);
+			ret = crypto_blkcipher_setkey(ctx->fallback, key,
+				keylen);
+			if (ret) {
+				dev_err(dd->dev, "fallback setkey fail(%d)\n",
+					ret);
+				return ret;
+			}
+		}
 	}
 
 	ctx->flags |= FLAGS_NEW_KEY;
@@ -632,7 +892,7 @@ static void aes_workqueue_handler(struct work_struct *work)
 
 	/* empty the crypto queue and then return */
 	do {
-		ret = tegra_aes_handle_req(dd);
+		ret = tegra_aes_handle_batch(dd);
 	} while (!ret);
 
 	aes_hw_deinit(dd);
@@ -650,9 +910,28 @@ static irqreturn_t aes_irq(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/* Does a small request synchronously with the software cipher. */
+static int tegra_aes_crypt_fallback(struct tegra_aes_ctx *ctx,
+	struct ablkcipher_request *req, unsigned long mode)
+{
+	struct blkcipher_desc desc = {
+		.tfm = ctx->fallback,
+		.info = req->info,
+		.flags = req->base.flags,
+	};
+
+	if (mode & FLAGS_ENCRYPT)
+		return crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+			req->nbytes);
+	return crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+		req->nbytes);
+}
+
 static int tegra_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 {
 	struct tegra_aes_reqctx *rctx = ablkcipher_request_ctx(req);
+	struct tegra_aes_ctx *ctx =
+		crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
 	struct tegra_aes_dev *dd = aes_dev;
 	unsigned long flags;
 	int err = 0;
@@ -662,6 +941,20 @@ static int tegra_aes_crypt(struct ablkcipher_request *req, unsigned long mode)
 		!!(mode & FLAGS_ENCRYPT),
 		!!(mode & FLAGS_CBC));
 
+	if (!req->src || !req->dst)
+		return -EINVAL;
+
+	if (!(mode & FLAGS_OFB) && !IS_ALIGNED(req->nbytes, AES_BLOCK_SIZE))
+		return -EINVAL;
+
+	if (!req->nbytes)
+		return 0;
+
+	if (ctx->fallback && req->nbytes < fallback_bytes) {
+		dd->stats.fallbacks++;
+		return tegra_aes_crypt_fallback(ctx, req, mode);
+	}
+
 	rctx->mode = mode;
 
 	spin_lock_irqsave(&dd->lock, flags);
@@ -871,12 +1164,46 @@ static int tegra_aes_cra_init(struct crypto_tfm *tfm)
 	return 0;
 }
 
+/*
+ * The software fallback is optional: without it all requests go to the
+ * hardware, as they did before.
+ */
+static int tegra_aes_cra_init_fallback(struct crypto_tfm *tfm,
+	const char *name)
+{
+	struct tegra_aes_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->fallback = crypto_alloc_blkcipher(name, 0,
+		CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		pr_warning("tegra-aes: no %s fallback (%ld)\n", name,
+			PTR_ERR(ctx->fallback));
+		ctx->fallback = NULL;
+	}
+
+	return tegra_aes_cra_init(tfm);
+}
+
+static int tegra_aes_ecb_cra_init(struct crypto_tfm *tfm)
+{
+	return tegra_aes_cra_init_fallback(tfm, "ecb(aes)");
+}
+
+static int tegra_aes_cbc_cra_init(struct crypto_tfm *tfm)
+{
+	return tegra_aes_cra_init_fallback(tfm, "cbc(aes)");
+}
+
 void tegra_aes_cra_exit(struct crypto_tfm *tfm)
 {
 	struct tegra_aes_ctx *ctx = crypto_ablkcipher_ctx((struct crypto_ablkcipher *)tfm);
 
-	if (ctx && ctx->slot)
-		aes_release_key_slot(ctx);
+	if (!ctx)
+		return;
+
+	aes_release_key_slot(ctx);
+	if (ctx->fallback)
+		crypto_free_blkcipher(ctx->fallback);
 }
 
 static struct crypto_alg algs[] = {
@@ -890,7 +1217,7 @@ static struct crypto_alg algs[] = {
 		.cra_alignmask = 3,
 		.cra_type = &crypto_ablkcipher_type,
 		.cra_module = THIS_MODULE,
-		.cra_init = tegra_aes_cra_init,
+		.cra_init = tegra_aes_ecb_cra_init,
 		.cra_exit = tegra_aes_cra_exit,
 		.cra_u.ablkcipher = {
 			.min_keysize = AES_MIN_KEY_SIZE,
@@ -909,7 +1236,7 @@ static struct crypto_alg algs[] = {
 		.cra_alignmask = 3,
 		.cra_type = &crypto_ablkcipher_type,
 		.cra_module = THIS_MODULE,
-		.cra_init = tegra_aes_cra_init,
+		.cra_init = tegra_aes_cbc_cra_init,
 		.cra_exit = tegra_aes_cra_exit,
 		.cra_u.ablkcipher = {
 			.min_keysize = AES_MIN_KEY_SIZE,
@@ -957,6 +1284,49 @@ static struct crypto_alg algs[] = {
 	}
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int tegra_aes_stats_show(struct seq_file *s, void *data)
+{
+	struct tegra_aes_dev *dd = s->private;
+	struct tegra_aes_stats *st = &dd->stats;
+
+	seq_printf(s, "requests:  %lu\n", st->requests);
+	seq_printf(s, "fallbacks: %lu\n", st->fallbacks);
+	seq_printf(s, "batches:   %lu\n", st->batches);
+	seq_printf(s, "chained:   %lu\n", st->chained);
+	seq_printf(s, "runs:      %lu\n", st->runs);
+	seq_printf(s, "key_loads: %lu\n", st->key_loads);
+	seq_printf(s, "key_hits:  %lu\n", st->key_hits);
+	return 0;
+}
+
+static int tegra_aes_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_aes_stats_show, inode->i_private);
+}
+
+static const struct file_operations tegra_aes_stats_fops = {
+	.open		= tegra_aes_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_aes_debugfs_init(struct tegra_aes_dev *dd)
+{
+	dd->debugfs = debugfs_create_file("tegra-aes", S_IRUGO, NULL, dd,
+		&tegra_aes_stats_fops);
+}
+
+static void tegra_aes_debugfs_exit(struct tegra_aes_dev *dd)
+{
+	debugfs_remove(dd->debugfs);
+}
+#else
+static inline void tegra_aes_debugfs_init(struct tegra_aes_dev *dd) { }
+static inline void tegra_aes_debugfs_exit(struct tegra_aes_dev *dd) { }
+#endif
+
 static int tegra_aes_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -1090,6 +1460,8 @@ static int tegra_aes_probe(struct platform_device *pdev)
 			goto out;
 	}
 
+	tegra_aes_debugfs_init(dd);
+
 	dev_info(dev, "registered");
 	return 0;
 
@@ -1134,6 +1506,7 @@ static int __devexit tegra_aes_remove(struct platform_device *pdev)
 	if (!dd)
 		return -ENODEV;
 
+	tegra_aes_debugfs_exit(dd);
 	cancel_work_sync(&aes_work);
 	destroy_workqueue(aes_wq);
 	free_irq(INT_VDE_BSE_V, dd);
@@ -5024,6 +5024,7 @@ param_check_ok:
 	mxt->early_suspend.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN + 1;
 	mxt->early_suspend.suspend = mxt_early_suspend;
 	mxt->early_suspend.resume = mxt_late_resume;
+	mxt->early_suspend.async = true;
 	register_early_suspend(&mxt->early_suspend);
 #endif	/* CONFIG_HAS_EARLYSUSPEND */
 
@@ -18,6 +18,7 @@
 #include <linux/crypto.h>
 #include <linux/workqueue.h>
 #include <linux/backing-dev.h>
+#include <linux/percpu.h>
 #include <asm/atomic.h>
 #include <linux/scatterlist.h>
 #include <asm/page.h>
@@ -57,6 +58,7 @@ struct dm_crypt_io {
 	int error;
 	sector_t sector;
 	struct dm_crypt_io *base_io;
+	int cpu;
 };
 
 struct dm_crypt_request {
@@ -65,6 +67,16 @@ struct dm_crypt_request {
 	struct scatterlist sg_out;
 };
 
+/*
+ * Clone bios are allocated with this in front of them, so that
+ * encrypted writes can be queued for submission in order.
+ */
+struct dm_crypt_clone {
+	struct list_head list;
+	int ready;
+	struct bio bio;
+};
+
 struct crypt_config;
 
 struct crypt_iv_operations {
@@ -86,11 +98,19 @@ struct iv_benbi_private {
 	int shift;
 };
 
+/*
+ * Duplicated per CPU state for cipher.
+ */
+struct crypt_cpu {
+	struct ablkcipher_request *req;
+};
+
 /*
  * Crypt: maps a linear range of a block device
  * and encrypts / decrypts at the same time.
  */
-enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID };
+enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
+	     DM_CRYPT_IV_LARGE_SECTORS };
 struct crypt_config {
 	struct dm_dev *dev;
 	sector_t start;
@@ -107,8 +127,18 @@ struct crypt_config {
 	struct workqueue_struct *io_queue;
 	struct workqueue_struct *crypt_queue;
 
+	/*
+	 * Encrypted writes waiting to be submitted, in the order their
+	 * encryption was started.
+	 */
+	spinlock_t write_lock;
+	struct list_head write_list;
+	int write_submitting;
+	struct work_struct write_work;
+
 	char *cipher;
 	char *cipher_mode;
+	char *cipher_driver;
 
 	struct crypt_iv_operations *iv_gen_ops;
 	union {
@@ -117,6 +147,8 @@ struct crypt_config {
 	} iv_gen_private;
 	sector_t iv_offset;
 	unsigned int iv_size;
+	unsigned short sector_size;
+	unsigned char sector_shift;
 
 	/*
 	 * Layout of each crypto request:
@@ -132,7 +164,12 @@ struct crypt_config {
 	 * correctly aligned.
 	 */
 	unsigned int dmreq_start;
-	struct ablkcipher_request *req;
+
+	/*
+	 * Each kcryptd worker runs on its own CPU and keeps the
+	 * request it is filling in here.
+	 */
+	struct crypt_cpu __percpu *cpu;
 
 	struct crypto_ablkcipher *tfm;
 	unsigned long flags;
@@ -146,6 +183,11 @@ struct crypt_config {
 
 static struct kmem_cache *_crypt_io_pool;
 
+static struct crypt_cpu *this_crypt_config(struct crypt_config *cc)
+{
+	return this_cpu_ptr(cc->cpu);
+}
+
 static void clone_init(struct dm_crypt_io *, struct bio *);
 static void kcryptd_queue_crypt(struct dm_crypt_io *io);
 
@@ -407,42 +449,54 @@ static int crypt_convert_block(struct crypt_config *cc,
 	struct bio_vec *bv_in = bio_iovec_idx(ctx->bio_in, ctx->idx_in);
 	struct bio_vec *bv_out = bio_iovec_idx(ctx->bio_out, ctx->idx_out);
 	struct dm_crypt_request *dmreq;
+	sector_t iv_sector = ctx->sector;
 	u8 *iv;
 	int r = 0;
 
+	/*
+	 * One request covers one crypt sector, which has to lie within
+	 * a single page of both bios.
+	 */
+	if (unlikely(bv_in->bv_len - ctx->offset_in < cc->sector_size ||
+		     bv_out->bv_len - ctx->offset_out < cc->sector_size))
+		return -EIO;
+
 	dmreq = dmreq_of_req(cc, req);
 	iv = (u8 *)ALIGN((unsigned long)(dmreq + 1),
 			 crypto_ablkcipher_alignmask(cc->tfm) + 1);
 
 	dmreq->ctx = ctx;
 	sg_init_table(&dmreq->sg_in, 1);
-	sg_set_page(&dmreq->sg_in, bv_in->bv_page, 1 << SECTOR_SHIFT,
+	sg_set_page(&dmreq->sg_in, bv_in->bv_page, cc->sector_size,
 		    bv_in->bv_offset + ctx->offset_in);
 
 	sg_init_table(&dmreq->sg_out, 1);
-	sg_set_page(&dmreq->sg_out, bv_out->bv_page, 1 << SECTOR_SHIFT,
+	sg_set_page(&dmreq->sg_out, bv_out->bv_page, cc->sector_size,
 		    bv_out->bv_offset + ctx->offset_out);
 
-	ctx->offset_in += 1 << SECTOR_SHIFT;
+	ctx->offset_in += cc->sector_size;
 	if (ctx->offset_in >= bv_in->bv_len) {
 		ctx->offset_in = 0;
 		ctx->idx_in++;
 	}
 
-	ctx->offset_out += 1 << SECTOR_SHIFT;
+	ctx->offset_out += cc->sector_size;
 	if (ctx->offset_out >= bv_out->bv_len) {
 		ctx->offset_out = 0;
 		ctx->idx_out++;
 	}
 
+	if (test_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags))
+		iv_sector >>= cc->sector_shift;
+
 	if (cc->iv_gen_ops) {
-		r = cc->iv_gen_ops->generator(cc, iv, ctx->sector);
+		r = cc->iv_gen_ops->generator(cc, iv, iv_sector);
 		if (r < 0)
 			return r;
 	}
 
 	ablkcipher_request_set_crypt(req, &dmreq->sg_in, &dmreq->sg_out,
-				     1 << SECTOR_SHIFT, iv);
+				     cc->sector_size, iv);
 
 	if (bio_data_dir(ctx->bio_in) == WRITE)
 		r = crypto_ablkcipher_encrypt(req);
@@ -457,13 +511,16 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 static void crypt_alloc_req(struct crypt_config *cc,
 			    struct convert_context *ctx)
 {
-	if (!cc->req)
-		cc->req = mempool_alloc(cc->req_pool, GFP_NOIO);
-	ablkcipher_request_set_tfm(cc->req, cc->tfm);
-	ablkcipher_request_set_callback(cc->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+	struct crypt_cpu *this_cc = this_crypt_config(cc);
+
+	if (!this_cc->req)
+		this_cc->req = mempool_alloc(cc->req_pool, GFP_NOIO);
+	ablkcipher_request_set_tfm(this_cc->req, cc->tfm);
+	ablkcipher_request_set_callback(this_cc->req,
+					CRYPTO_TFM_REQ_MAY_BACKLOG |
 					CRYPTO_TFM_REQ_MAY_SLEEP,
 					kcryptd_async_done,
-					dmreq_of_req(cc, cc->req));
+					dmreq_of_req(cc, this_cc->req));
 }
 
 /*
@@ -472,6 +529,8 @@ static void crypt_alloc_req(struct crypt_config *cc,
 static int crypt_convert(struct crypt_config *cc,
 			 struct convert_context *ctx)
 {
+	struct crypt_cpu *this_cc = this_crypt_config(cc);
+	unsigned int sectors = cc->sector_size >> SECTOR_SHIFT;
 	int r;
 
 	atomic_set(&ctx->pending, 1);
@@ -483,7 +542,7 @@ static int crypt_convert(struct crypt_config *cc,
 
 		atomic_inc(&ctx->pending);
 
-		r = crypt_convert_block(cc, ctx, cc->req);
+		r = crypt_convert_block(cc, ctx, this_cc->req);
 
 		switch (r) {
 		/* async */
@@ -492,14 +551,14 @@ static int crypt_convert(struct crypt_config *cc,
 			INIT_COMPLETION(ctx->restart);
 			/* fall through*/
 		case -EINPROGRESS:
-			cc->req = NULL;
-			ctx->sector++;
+			this_cc->req = NULL;
+			ctx->sector += sectors;
 			continue;
 
 		/* sync */
 		case 0:
 			atomic_dec(&ctx->pending);
-			ctx->sector++;
+			ctx->sector += sectors;
 			cond_resched();
 			continue;
 
@@ -602,6 +661,7 @@ static struct dm_crypt_io *crypt_io_alloc(struct dm_target *ti,
 	io->sector = sector;
 	io->error = 0;
 	io->base_io = NULL;
+	io->cpu = raw_smp_processor_id();
 	atomic_set(&io->pending, 0);
 
 	return io;
@@ -644,7 +704,8 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
  * Needed because it would be very unwise to do decryption in an
  * interrupt context.
  *
- * kcryptd performs the actual encryption or decryption.
+ * kcryptd performs the actual encryption or decryption.  It has a worker
+ * on each CPU and a bio is converted on the CPU it was submitted from.
  *
  * kcryptd_io performs the IO submission.
  *
@@ -722,20 +783,11 @@ static void kcryptd_io_read(struct dm_crypt_io *io)
 	generic_make_request(clone);
 }
 
-static void kcryptd_io_write(struct dm_crypt_io *io)
-{
-	struct bio *clone = io->ctx.bio_out;
-	generic_make_request(clone);
-}
-
 static void kcryptd_io(struct work_struct *work)
 {
 	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
 
-	if (bio_data_dir(io->base_bio) == READ)
-		kcryptd_io_read(io);
-	else
-		kcryptd_io_write(io);
+	kcryptd_io_read(io);
 }
 
 static void kcryptd_queue_io(struct dm_crypt_io *io)
@@ -746,6 +798,85 @@ static void kcryptd_queue_io(struct dm_crypt_io *io)
 	queue_work(cc->io_queue, &io->work);
 }
 
+/*
+ * Write clones are put on cc->write_list when their encryption starts
+ * and leave it in that order, whichever CPU or crypto engine finishes
+ * them first.  A clone is only queued once it has all its pages, so a
+ * clone waiting for an earlier one never holds up that one.
+ */
+static struct dm_crypt_clone *dm_crypt_clone(struct bio *clone)
+{
+	return container_of(clone, struct dm_crypt_clone, bio);
+}
+
+static void crypt_write_queue(struct crypt_config *cc, struct bio *clone)
+{
+	struct dm_crypt_clone *dc = dm_crypt_clone(clone);
+	unsigned long flags;
+
+	dc->ready = 0;
+	spin_lock_irqsave(&cc->write_lock, flags);
+	list_add_tail(&dc->list, &cc->write_list);
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+}
+
+static void crypt_write_unqueue(struct crypt_config *cc, struct bio *clone)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cc->write_lock, flags);
+	list_del(&dm_crypt_clone(clone)->list);
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+}
+
+/*
+ * Mark clone (if any) as encrypted and submit the clones at the head
+ * of the list which are.  Only one caller submits at a time; the others
+ * leave their clones to it.  Crypto completions run in interrupt
+ * context and pass async to hand the submission to kcryptd_io.
+ */
+static void crypt_write_submit(struct crypt_config *cc, struct bio *clone,
+			       int async)
+{
+	struct dm_crypt_clone *dc;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cc->write_lock, flags);
+	if (clone)
+		dm_crypt_clone(clone)->ready = 1;
+
+	if (async || cc->write_submitting) {
+		spin_unlock_irqrestore(&cc->write_lock, flags);
+		if (async)
+			queue_work(cc->io_queue, &cc->write_work);
+		return;
+	}
+
+	cc->write_submitting = 1;
+	while (!list_empty(&cc->write_list)) {
+		dc = list_first_entry(&cc->write_list,
+				      struct dm_crypt_clone, list);
+		if (!dc->ready)
+			break;
+		list_del(&dc->list);
+		spin_unlock_irqrestore(&cc->write_lock, flags);
+
+		generic_make_request(&dc->bio);
+
+		spin_lock_irqsave(&cc->write_lock, flags);
+	}
+	cc->write_submitting = 0;
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+}
+
+static void kcryptd_io_write(struct work_struct *work)
+{
+	struct crypt_config *cc = container_of(work, struct crypt_config,
+					       write_work);
+
+	crypt_write_submit(cc, NULL, 0);
+}
+
 static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io,
 					  int error, int async)
 {
@@ -753,10 +884,14 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io,
 	struct crypt_config *cc = io->target->private;
 
 	if (unlikely(error < 0)) {
+		crypt_write_unqueue(cc, clone);
 		crypt_free_buffer_pages(cc, clone);
 		bio_put(clone);
 		io->error = -EIO;
 		crypt_dec_pending(io);
+
+		/* Clones behind this one may be ready to go. */
+		crypt_write_submit(cc, NULL, async);
 		return;
 	}
 
@@ -765,10 +900,7 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io,
 
 	clone->bi_sector = cc->start + io->sector;
 
-	if (async)
-		kcryptd_queue_io(io);
-	else
-		generic_make_request(clone);
+	crypt_write_submit(cc, clone, async);
 }
 
 static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
@@ -801,6 +933,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 
 		io->ctx.bio_out = clone;
 		io->ctx.idx_out = 0;
+		crypt_write_queue(cc, clone);
 
 		remaining -= clone->bi_size;
 		sector += bio_sectors(clone);
@@ -922,12 +1055,20 @@ static void kcryptd_crypt(struct work_struct *work)
 		kcryptd_crypt_write_convert(io);
 }
 
+/*
+ * Read completions tend to arrive on one CPU, so send the decryption
+ * back to the CPU the bio came from to spread it like the writes.
+ */
 static void kcryptd_queue_crypt(struct dm_crypt_io *io)
 {
 	struct crypt_config *cc = io->target->private;
+	int cpu = io->cpu;
 
 	INIT_WORK(&io->work, kcryptd_crypt);
-	queue_work(cc->crypt_queue, &io->work);
+	if (bio_data_dir(io->base_bio) == READ && cpu_online(cpu))
+		queue_work_on(cpu, cc->crypt_queue, &io->work);
+	else
+		queue_work(cc->crypt_queue, &io->work);
 }
 
 /*
@@ -999,6 +1140,8 @@ static int crypt_wipe_key(struct crypt_config *cc)
 static void crypt_dtr(struct dm_target *ti)
 {
 	struct crypt_config *cc = ti->private;
+	struct crypt_cpu *cpu_cc;
+	int cpu;
 
 	ti->private = NULL;
 
@@ -1013,6 +1156,13 @@ static void crypt_dtr(struct dm_target *ti)
 	if (cc->bs)
 		bioset_free(cc->bs);
 
+	if (cc->cpu)
+		for_each_possible_cpu(cpu) {
+			cpu_cc = per_cpu_ptr(cc->cpu, cpu);
+			if (cpu_cc->req)
+				mempool_free(cpu_cc->req, cc->req_pool);
+		}
+
 	if (cc->page_pool)
 		mempool_destroy(cc->page_pool);
 	if (cc->req_pool)
@@ -1029,8 +1179,12 @@ static void crypt_dtr(struct dm_target *ti)
 	if (cc->dev)
 		dm_put_device(ti, cc->dev);
 
+	if (cc->cpu)
+		free_percpu(cc->cpu);
+
 	kzfree(cc->cipher);
 	kzfree(cc->cipher_mode);
+	kzfree(cc->cipher_driver);
 
 	/* Must zero key material before freeing */
 	kzfree(cc);
@@ -1098,14 +1252,27 @@ static int crypt_ctr_cipher(struct dm_target *ti,
 		goto bad_mem;
 	}
 
-	/* Allocate cipher */
-	cc->tfm = crypto_alloc_ablkcipher(cipher_api, 0, 0);
+	/*
+	 * Allocate cipher, from the given implementation if any.  That
+	 * may be one like the Tegra AES engine which is not registered
+	 * under the generic name so as not to be picked by default.
+	 */
+	if (cc->cipher_driver)
+		cc->tfm = crypto_alloc_ablkcipher(cc->cipher_driver, 0, 0);
+	else
+		cc->tfm = crypto_alloc_ablkcipher(cipher_api, 0, 0);
 	if (IS_ERR(cc->tfm)) {
 		ret = PTR_ERR(cc->tfm);
 		ti->error = "Error allocating crypto tfm";
 		goto bad;
 	}
 
+	if (cc->sector_size % crypto_ablkcipher_blocksize(cc->tfm)) {
+		ret = -EINVAL;
+		ti->error = "Sector size is not a multiple of the cipher block";
+		goto bad;
+	}
+
 	/* Initialize and set key */
 	ret = crypt_set_key(cc, key);
 	if (ret < 0) {
@@ -1171,9 +1338,59 @@ bad_mem:
 	return -ENOMEM;
 }
 
+/*
+ * Optional parameters:
+ *	sector_size:<bytes>	encrypt in units of this power of two
+ *	iv_large_sectors	count IVs in those units, not 512 bytes
+ *	cipher_driver:<name>	use this crypto driver for the cipher
+ */
+static int crypt_ctr_optional(struct dm_target *ti, unsigned int argc,
+			      char **argv)
+{
+	struct crypt_config *cc = ti->private;
+	unsigned int opt_params, sector_size;
+	char dummy;
+
+	if (sscanf(argv[0], "%u%c", &opt_params, &dummy) != 1 ||
+	    opt_params != argc - 1) {
+		ti->error = "Invalid number of feature arguments";
+		return -EINVAL;
+	}
+
+	while (opt_params--) {
+		argv++;
+		if (!strcmp(*argv, "iv_large_sectors"))
+			set_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags);
+		else if (sscanf(*argv, "sector_size:%u%c",
+				&sector_size, &dummy) == 1) {
+			if (sector_size < (1 << SECTOR_SHIFT) ||
+			    sector_size > PAGE_SIZE ||
+			    !is_power_of_2(sector_size)) {
+				ti->error = "Invalid sector_size";
+				return -EINVAL;
+			}
+			cc->sector_size = sector_size;
+			cc->sector_shift = __ffs(sector_size) - SECTOR_SHIFT;
+		} else if (!strncmp(*argv, "cipher_driver:", 14) &&
+			   (*argv)[14]) {
+			kfree(cc->cipher_driver);
+			cc->cipher_driver = kstrdup(*argv + 14, GFP_KERNEL);
+			if (!cc->cipher_driver) {
+				ti->error = "Cannot allocate cipher strings";
+				return -ENOMEM;
+			}
+		} else {
+			ti->error = "Invalid feature arguments";
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
 /*
  * Construct an encryption mapping:
- * <cipher> <key> <iv_offset> <dev_path> <start>
+ * <cipher> <key> <iv_offset> <dev_path> <start> [<#opt_params> <opt_params>]
  */
 static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 {
@@ -1182,7 +1399,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	unsigned long long tmpll;
 	int ret;
 
-	if (argc != 5) {
+	if (argc < 5) {
 		ti->error = "Not enough arguments";
 		return -EINVAL;
 	}
@@ -1196,6 +1413,24 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	}
 
 	ti->private = cc;
+	cc->sector_size = 1 << SECTOR_SHIFT;
+	cc->sector_shift = 0;
+	spin_lock_init(&cc->write_lock);
+	INIT_LIST_HEAD(&cc->write_list);
+	INIT_WORK(&cc->write_work, kcryptd_io_write);
+
+	if (argc > 5) {
+		ret = crypt_ctr_optional(ti, argc - 5, argv + 5);
+		if (ret < 0)
+			goto bad;
+	}
+
+	ret = -EINVAL;
+	if (ti->len & ((cc->sector_size >> SECTOR_SHIFT) - 1)) {
+		ti->error = "Device size is not a multiple of sector_size";
+		goto bad;
+	}
+
 	ret = crypt_ctr_cipher(ti, argv[0], argv[1]);
 	if (ret < 0)
 		goto bad;
@@ -1219,7 +1454,12 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		ti->error = "Cannot allocate crypt request mempool";
 		goto bad;
 	}
-	cc->req = NULL;
+
+	cc->cpu = alloc_percpu(struct crypt_cpu);
+	if (!cc->cpu) {
+		ti->error = "Cannot allocate per cpu state";
+		goto bad;
+	}
 
 	cc->page_pool = mempool_create_page_pool(MIN_POOL_PAGES, 0);
 	if (!cc->page_pool) {
@@ -1227,7 +1467,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
-	cc->bs = bioset_create(MIN_IOS, 0);
+	cc->bs = bioset_create(MIN_IOS, offsetof(struct dm_crypt_clone, bio));
 	if (!cc->bs) {
 		ti->error = "Cannot allocate crypt bioset";
 		goto bad;
@@ -1240,6 +1480,12 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	}
 	cc->iv_offset = tmpll;
 
+	if (test_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags) &&
+	    (cc->iv_offset & ((cc->sector_size >> SECTOR_SHIFT) - 1))) {
+		ti->error = "iv_offset is not a multiple of sector_size";
+		goto bad;
+	}
+
 	if (dm_get_device(ti, argv[3], dm_table_get_mode(ti->table), &cc->dev)) {
 		ti->error = "Device lookup failed";
 		goto bad;
@@ -1258,7 +1504,11 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
-	cc->crypt_queue = create_singlethread_workqueue("kcryptd");
+	cc->crypt_queue = alloc_workqueue("kcryptd",
+					  WQ_NON_REENTRANT |
+					  WQ_CPU_INTENSIVE |
+					  WQ_RESCUER,
+					  1);
 	if (!cc->crypt_queue) {
 		ti->error = "Couldn't create kcryptd queue";
 		goto bad;
@@ -1275,16 +1525,22 @@ bad:
 static int crypt_map(struct dm_target *ti, struct bio *bio,
 		     union map_info *map_context)
 {
+	struct crypt_config *cc = ti->private;
 	struct dm_crypt_io *io;
-	struct crypt_config *cc;
+	sector_t sector;
 
 	if (unlikely(bio_empty_barrier(bio))) {
-		cc = ti->private;
 		bio->bi_bdev = cc->dev->bdev;
 		return DM_MAPIO_REMAPPED;
 	}
 
-	io = crypt_io_alloc(ti, bio, dm_target_offset(ti, bio->bi_sector));
+	/* Bios have to cover whole crypt sectors. */
+	sector = dm_target_offset(ti, bio->bi_sector);
+	if (unlikely((sector | bio_sectors(bio)) &
+		     ((cc->sector_size >> SECTOR_SHIFT) - 1)))
+		return -EIO;
+
+	io = crypt_io_alloc(ti, bio, sector);
 
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_queue_io(io);
@@ -1299,6 +1555,7 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 {
 	struct crypt_config *cc = ti->private;
 	unsigned int sz = 0;
+	int num_feature_args;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -1325,6 +1582,19 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
+
+		num_feature_args = (cc->sector_size != (1 << SECTOR_SHIFT)) +
+			test_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags) +
+			(cc->cipher_driver != NULL);
+		if (num_feature_args) {
+			DMEMIT(" %d", num_feature_args);
+			if (cc->sector_size != (1 << SECTOR_SHIFT))
+				DMEMIT(" sector_size:%u", cc->sector_size);
+			if (test_bit(DM_CRYPT_IV_LARGE_SECTORS, &cc->flags))
+				DMEMIT(" iv_large_sectors");
+			if (cc->cipher_driver)
+				DMEMIT(" cipher_driver:%s", cc->cipher_driver);
+		}
 		break;
 	}
 	return 0;
@@ -1419,9 +1689,23 @@ static int crypt_iterate_devices(struct dm_target *ti,
 	return fn(ti, cc->dev, cc->start, ti->len, data);
 }
 
+static void crypt_io_hints(struct dm_target *ti, struct queue_limits *limits)
+{
+	struct crypt_config *cc = ti->private;
+
+	limits->logical_block_size = max_t(unsigned short,
+					   limits->logical_block_size,
+					   cc->sector_size);
+	limits->physical_block_size = max_t(unsigned int,
+					    limits->physical_block_size,
+					    cc->sector_size);
+	blk_limits_io_min(limits, max_t(unsigned int, limits->io_min,
+					cc->sector_size));
+}
+
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 7, 0},
+	.version = {1, 8, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -1433,6 +1717,7 @@ static struct target_type crypt_target = {
 	.message = crypt_message,
 	.merge  = crypt_merge,
 	.iterate_devices = crypt_iterate_devices,
+	.io_hints = crypt_io_hints,
 };
 
 static int __init dm_crypt_init(void)
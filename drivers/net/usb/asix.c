@@ -35,6 +35,7 @@
 #include <linux/crc32.h>
 #include <linux/usb/usbnet.h>
 #include <linux/slab.h>
+#include <linux/skb_pool.h>
 
 #define DRIVER_VERSION "14-Jun-2006"
 static const char driver_name [] = "asix";
@@ -349,8 +350,16 @@ static int asix_rx_fixup(struct usbnet *dev, struct sk_buff *skb)
 				   size);
 			return 0;
 		}
-		ax_skb = skb_clone(skb, GFP_ATOMIC);
-		if (ax_skb) {
+		if (dev->rx_pool) {
+			/* copy rather than clone, so the urb buffer can be
+			 * recycled once all its packets are out
+			 */
+			ax_skb = skb_pool_copy(dev->rx_pool, packet, size,
+					       GFP_ATOMIC);
+			if (!ax_skb)
+				return 0;
+			usbnet_skb_return(dev, ax_skb);
+		} else if ((ax_skb = skb_clone(skb, GFP_ATOMIC)) != NULL) {
 			u8 alignment = (unsigned long)packet & 0x3;
 			ax_skb->len = size;
 
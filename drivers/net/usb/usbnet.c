@@ -47,6 +47,7 @@
 #include <linux/slab.h>
 #include <linux/kernel.h>
 #include <linux/pm_runtime.h>
+#include <linux/skb_pool.h>
 
 #define DRIVER_VERSION		"22-Aug-2005"
 
@@ -322,6 +323,24 @@ EXPORT_SYMBOL_GPL(usbnet_defer_kevent);
 
 static void rx_complete (struct urb *urb);
 
+/* rx buffers come from the pool while they fit; the mtu may have grown */
+static struct sk_buff *rx_alloc_skb (struct usbnet *dev, size_t size,
+				     gfp_t flags)
+{
+	if (dev->rx_pool && size + NET_IP_ALIGN <= dev->rx_pool->size)
+		return skb_pool_alloc (dev->rx_pool, flags);
+	return alloc_skb (size + NET_IP_ALIGN, flags);
+}
+
+/* only rx buffers go back to the pool; tx skbs are the stack's */
+static void usbnet_free_skb (struct usbnet *dev, struct sk_buff *skb)
+{
+	if (dev->rx_pool)
+		skb_pool_free (dev->rx_pool, skb);
+	else
+		dev_kfree_skb (skb);
+}
+
 static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 {
 	struct sk_buff		*skb;
@@ -330,7 +349,7 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 	unsigned long		lockflags;
 	size_t			size = dev->rx_urb_size;
 
-	if ((skb = alloc_skb (size + NET_IP_ALIGN, flags)) == NULL) {
+	if ((skb = rx_alloc_skb (dev, size, flags)) == NULL) {
 		netif_dbg(dev, rx_err, dev->net, "no rx skb\n");
 		usbnet_defer_kevent (dev, EVENT_RX_MEMORY);
 		usb_free_urb (urb);
@@ -392,11 +411,28 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 
 static inline void rx_process (struct usbnet *dev, struct sk_buff *skb)
 {
+	struct sk_buff		*copy;
+
 	if (dev->driver_info->rx_fixup &&
 	    !dev->driver_info->rx_fixup (dev, skb))
 		goto error;
 	// else network stack removes extra byte if we forced a short packet
 
+	/* a frame using less than half of the urb buffer is copied out,
+	 * so the buffer goes back to the pool and the stack isn't charged
+	 * for the whole of it
+	 */
+	if (skb->len && dev->rx_pool && !skb_cloned (skb) &&
+	    skb->len <= dev->rx_urb_size / 2) {
+		copy = skb_pool_copy (dev->rx_pool, skb->data, skb->len,
+				      GFP_ATOMIC);
+		if (copy) {
+			usbnet_skb_return (dev, copy);
+			usbnet_free_skb (dev, skb);
+			return;
+		}
+	}
+
 	if (skb->len)
 		usbnet_skb_return (dev, skb);
 	else {
@@ -1164,9 +1200,12 @@ static void usbnet_bh (unsigned long param)
 			rx_process (dev, skb);
 			continue;
 		case tx_done:
+			usb_free_urb (entry->urb);
+			dev_kfree_skb_any (skb);
+			continue;
 		case rx_cleanup:
 			usb_free_urb (entry->urb);
-			dev_kfree_skb (skb);
+			usbnet_free_skb (dev, skb);
 			continue;
 		default:
 			netdev_dbg(dev->net, "bogus skb state %d\n", entry->state);
@@ -1248,6 +1287,8 @@ void usbnet_disconnect (struct usb_interface *intf)
 	if (dev->driver_info->unbind)
 		dev->driver_info->unbind (dev, intf);
 
+	if (dev->rx_pool)
+		skb_pool_destroy (dev->rx_pool);
 	free_netdev(net);
 	usb_put_dev (xdev);
 }
@@ -1411,6 +1452,10 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	status = register_netdev (net);
 	if (status)
 		goto out3;
+
+	/* without a pool rx buffers just come from the slab */
+	dev->rx_pool = skb_pool_create (net, dev->rx_urb_size + NET_IP_ALIGN,
+					RX_QLEN (dev));
 	netif_info(dev, probe, dev->net,
 		   "register '%s' at usb-%s-%s, %s, %pM\n",
 		   udev->dev.driver->name,
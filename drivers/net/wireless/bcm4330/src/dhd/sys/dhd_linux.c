@@ -373,6 +373,12 @@ extern int net_os_send_hang_message(struct net_device *dev);
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27))
 struct semaphore dhd_registration_sem;
 #define DHD_REGISTRATION_TIMEOUT  12000  /* msec : allowed time to finished dhd registration */
+
+#ifdef DHD_USE_SKB_POOL
+/* Large enough for a full SDIO rx read (MAX_RX_DATASZ plus alignment) */
+#define DHD_SKB_POOL_SIZE	(2048 + 64)
+#define DHD_SKB_POOL_DEPTH	64
+#endif /* DHD_USE_SKB_POOL */
 #endif /* (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)) */
 
 /* Spawn a thread for system ioctls (set mac, set mcast) */
@@ -2944,6 +2950,11 @@ dhd_net_attach(dhd_pub_t *dhdp, int ifidx)
 		goto fail;
 	}
 
+#ifdef DHD_USE_SKB_POOL
+	if (ifidx == 0)
+		osl_skb_pool_attach(dhdp->osh, net, DHD_SKB_POOL_SIZE,
+			DHD_SKB_POOL_DEPTH);
+#endif /* DHD_USE_SKB_POOL */
 
 /*
 	printf("%s: Broadcom Dongle Host Driver MAC=%.2X:%.2X:%.2X:%.2X:%.2X:%.2X\n", net->name,
@@ -3113,6 +3124,9 @@ dhd_detach(dhd_pub_t *dhdp)
 		if (dhdp->prot)
 			dhd_prot_detach(dhdp);
 	}
+#ifdef DHD_USE_SKB_POOL
+	osl_skb_pool_detach(dhdp->osh);
+#endif /* DHD_USE_SKB_POOL */
 #ifdef CONFIG_CFG80211
 	if (dhd->dhd_state & DHD_ATTACH_STATE_CFG80211) {
 		if (IS_CFG80211_FAVORITE()) {
@@ -360,6 +360,11 @@ extern void osl_pktfree_static(osl_t *osh, void *skb, bool send);
 
 extern void *osl_pktget(osl_t *osh, uint len);
 extern void *osl_pktdup(osl_t *osh, void *skb);
+#ifdef DHD_USE_SKB_POOL
+struct net_device;
+extern void osl_skb_pool_attach(osl_t *osh, struct net_device *dev, uint size, uint depth);
+extern void osl_skb_pool_detach(osl_t *osh);
+#endif /* DHD_USE_SKB_POOL */
 
 /* Convert a native(OS) packet to driver packet.
  * In the process, native packet is destroyed, there is no copying
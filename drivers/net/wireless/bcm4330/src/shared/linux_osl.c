@@ -49,6 +49,9 @@
 #endif
 
 #include <linux/fs.h>
+#ifdef DHD_USE_SKB_POOL
+#include <linux/skb_pool.h>
+#endif
 
 #define PCI_CFG_RETRY 		10
 
@@ -111,6 +114,9 @@ struct osl_info {
 	uint failed;
 	uint bustype;
 	bcm_mem_link_t *dbgmem_list;
+#ifdef DHD_USE_SKB_POOL
+	struct skb_pool *skb_pool;
+#endif
 };
 
 /* PCMCIA attribute space access macros */
@@ -463,6 +469,36 @@ osl_pktfastget(osl_t *osh, uint len)
 }
 #endif /* CTFPOOL */
 
+#ifdef DHD_USE_SKB_POOL
+/* Recycle rx buffers of the primary interface through a pool */
+void
+osl_skb_pool_attach(osl_t *osh, struct net_device *dev, uint size, uint depth)
+{
+	osh->skb_pool = skb_pool_create(dev, size, depth);
+}
+
+/* The bus must be stopped: no more packets are allocated or freed */
+void
+osl_skb_pool_detach(osl_t *osh)
+{
+	struct skb_pool *pool = osh->skb_pool;
+
+	osh->skb_pool = NULL;
+	if (pool)
+		skb_pool_destroy(pool);
+}
+#endif /* DHD_USE_SKB_POOL */
+
+static inline struct sk_buff *
+osl_pktalloc(osl_t *osh, uint len)
+{
+#ifdef DHD_USE_SKB_POOL
+	if (osh->skb_pool && len <= osh->skb_pool->size)
+		return skb_pool_alloc(osh->skb_pool, GFP_ATOMIC);
+#endif /* DHD_USE_SKB_POOL */
+	return dev_alloc_skb(len);
+}
+
 /* Return a new packet. zero out pkttag */
 void * BCMFASTPATH
 osl_pktget(osl_t *osh, uint len)
@@ -472,9 +508,9 @@ osl_pktget(osl_t *osh, uint len)
 #ifdef CTFPOOL
 	/* Allocate from local pool */
 	skb = osl_pktfastget(osh, len);
-	if ((skb != NULL) || ((skb = dev_alloc_skb(len)) != NULL)) {
+	if ((skb != NULL) || ((skb = osl_pktalloc(osh, len)) != NULL)) {
 #else /* CTFPOOL */
-	if ((skb = dev_alloc_skb(len))) {
+	if ((skb = osl_pktalloc(osh, len))) {
 #endif /* CTFPOOL */
 		skb_put(skb, len);
 		skb->priority = 0;
@@ -537,6 +573,15 @@ osl_pktfree(osl_t *osh, void *p, bool send)
 		nskb = skb->next;
 		skb->next = NULL;
 
+#ifdef DHD_USE_SKB_POOL
+		/* sent packets mostly come from the stack, cloned */
+		if (!send && osh->skb_pool &&
+		    skb_pool_recycle(osh->skb_pool, skb)) {
+			osh->pub.pktalloced--;
+			skb = nskb;
+			continue;
+		}
+#endif /* DHD_USE_SKB_POOL */
 
 #ifdef CTFPOOL
 		if (PKTISFAST(osh, skb))
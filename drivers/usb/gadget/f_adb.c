@@ -34,8 +34,27 @@
 
 #define BULK_BUFFER_SIZE           4096
 
-/* number of tx requests to allocate */
-#define TX_REQ_MAX 4
+/* most tx requests to allocate */
+#define TX_REQ_MAX 16
+
+/*
+ * Pushing and pulling files goes no faster than requests of
+ * BULK_BUFFER_SIZE can be turned around, so by default there are more
+ * and larger ones.  If the buffers cannot be had, BULK_BUFFER_SIZE is used
+ * instead.  There is only ever one rx request, as adbd reads a message
+ * header and then its payload.
+ */
+static unsigned int adb_tx_req_len = 16384;
+module_param(adb_tx_req_len, uint, S_IRUGO);
+MODULE_PARM_DESC(adb_tx_req_len, "size of each tx request, in bytes");
+
+static unsigned int adb_tx_reqs = 8;
+module_param(adb_tx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(adb_tx_reqs, "number of tx requests");
+
+static unsigned int adb_rx_req_len = 16384;
+module_param(adb_rx_req_len, uint, S_IRUGO);
+MODULE_PARM_DESC(adb_rx_req_len, "size of the rx request, in bytes");
 
 static const char shortname[] = "android_adb";
 
@@ -55,10 +74,13 @@ struct adb_dev {
 	atomic_t open_excl;
 
 	struct list_head tx_idle;
+	unsigned int tx_reqs;
+	unsigned int tx_req_len;
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
 	struct usb_request *rx_req;
+	unsigned int rx_req_len;
 	int rx_done;
 };
 
@@ -222,6 +244,16 @@ static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->read_wq);
 }
 
+static void adb_free_requests(struct adb_dev *dev)
+{
+	struct usb_request *req;
+
+	adb_request_free(dev->rx_req, dev->ep_out);
+	dev->rx_req = NULL;
+	while ((req = req_get(dev, &dev->tx_idle)))
+		adb_request_free(req, dev->ep_in);
+}
+
 static int __init create_bulk_endpoints(struct adb_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc)
@@ -252,14 +284,18 @@ static int __init create_bulk_endpoints(struct adb_dev *dev,
 	dev->ep_out = ep;
 
 	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, BULK_BUFFER_SIZE);
+	dev->tx_reqs = clamp_t(unsigned int, adb_tx_reqs, 1, TX_REQ_MAX);
+	dev->tx_req_len = max_t(unsigned int, adb_tx_req_len, BULK_BUFFER_SIZE);
+	dev->rx_req_len = max_t(unsigned int, adb_rx_req_len, BULK_BUFFER_SIZE);
+retry:
+	req = adb_request_new(dev->ep_out, dev->rx_req_len);
 	if (!req)
 		goto fail;
 	req->complete = adb_complete_out;
 	dev->rx_req = req;
 
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = adb_request_new(dev->ep_in, BULK_BUFFER_SIZE);
+	for (i = 0; i < dev->tx_reqs; i++) {
+		req = adb_request_new(dev->ep_in, dev->tx_req_len);
 		if (!req)
 			goto fail;
 		req->complete = adb_complete_in;
@@ -269,6 +305,15 @@ static int __init create_bulk_endpoints(struct adb_dev *dev,
 	return 0;
 
 fail:
+	adb_free_requests(dev);
+	if (dev->tx_req_len > BULK_BUFFER_SIZE ||
+	    dev->rx_req_len > BULK_BUFFER_SIZE) {
+		printk(KERN_WARNING "adb_bind() falling back to %d byte "
+			"requests\n", BULK_BUFFER_SIZE);
+		dev->tx_req_len = BULK_BUFFER_SIZE;
+		dev->rx_req_len = BULK_BUFFER_SIZE;
+		goto retry;
+	}
 	printk(KERN_ERR "adb_bind() could not allocate requests\n");
 	return -1;
 }
@@ -284,7 +329,7 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "adb_read(%d)\n", count);
 
-	if (count > BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	if (_lock(&dev->read_excl))
@@ -377,8 +422,8 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 		}
 
 		if (req != 0) {
-			if (count > BULK_BUFFER_SIZE)
-				xfer = BULK_BUFFER_SIZE;
+			if (count > dev->tx_req_len)
+				xfer = dev->tx_req_len;
 			else
 				xfer = count;
 			if (copy_from_user(req->buf, buf, xfer)) {
@@ -549,13 +594,10 @@ static void
 adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct adb_dev	*dev = func_to_dev(f);
-	struct usb_request *req;
 
 	spin_lock_irq(&dev->lock);
 
-	adb_request_free(dev->rx_req, dev->ep_out);
-	while ((req = req_get(dev, &dev->tx_idle)))
-		adb_request_free(req, dev->ep_in);
+	adb_free_requests(dev);
 
 	dev->online = 0;
 	dev->error = 1;
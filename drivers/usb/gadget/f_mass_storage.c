@@ -314,10 +314,36 @@ static const char fsg_string_interface[] = "Mass Storage";
 #define FSG_NO_DEVICE_STRINGS    1
 #define FSG_NO_OTG               1
 #define FSG_NO_INTR_EP           1
+#define FSG_DIRECT_IO            1
 
 #include "storage_common.c"
 
 
+/*-------------------------------------------------------------------------*/
+
+/*
+ * With FSG_NUM_BUFFERS buffers of FSG_BUFLEN the medium sits idle while a
+ * buffer goes over the bus and the bus while one is read, so by default
+ * there are more and larger ones.  If the buffers cannot be had, they are
+ * FSG_BUFLEN long instead.
+ */
+#define FSG_MAX_NUM_BUFFERS	32
+#define FSG_MAX_BUFLEN		((u32)BIO_MAX_SIZE)
+
+static unsigned int fsg_num_buffers = 8;
+module_param(fsg_num_buffers, uint, S_IRUGO);
+MODULE_PARM_DESC(fsg_num_buffers, "number of I/O buffers");
+
+static unsigned int fsg_buflen = 32768;
+module_param(fsg_buflen, uint, S_IRUGO);
+MODULE_PARM_DESC(fsg_buflen, "size of each I/O buffer, in bytes");
+
+static int fsg_direct_io = 1;
+module_param(fsg_direct_io, bool, S_IRUGO);
+MODULE_PARM_DESC(fsg_direct_io,
+		 "true to read and write block devices past the page cache");
+
+
 /*-------------------------------------------------------------------------*/
 
 struct fsg_dev;
@@ -362,7 +388,15 @@ struct fsg_common {
 
 	struct fsg_buffhd	*next_buffhd_to_fill;
 	struct fsg_buffhd	*next_buffhd_to_drain;
-	struct fsg_buffhd	buffhds[FSG_NUM_BUFFERS];
+	struct fsg_buffhd	*buffhds;
+	unsigned int		num_buffers;
+	u32			buflen;
+
+	/* Direct medium I/O in flight, and the first write to fail */
+	atomic_t		direct_pending;
+	wait_queue_head_t	direct_wait;
+	int			direct_error;
+	loff_t			direct_error_offset;
 
 	int			cmnd_size;
 	u8			cmnd[MAX_COMMAND_SIZE];
@@ -732,6 +766,221 @@ static int sleep_thread(struct fsg_common *common)
 
 /*-------------------------------------------------------------------------*/
 
+/*
+ * A LUN backed by a block device is read and written with bios straight
+ * into and out of the buffers.  While that is going on the buffer is
+ * BUF_STATE_BUSY, and it becomes BUF_STATE_FULL once read, or
+ * BUF_STATE_EMPTY once written.
+ */
+
+static inline int fsg_lun_direct(struct fsg_lun *curlun)
+{
+	return fsg_direct_io && curlun->bdev;
+}
+
+/* Drops a reference to the buffer's bios, finishing them with the last. */
+static void fsg_direct_put(struct fsg_buffhd *bh, int rw)
+{
+	struct fsg_common	*common = bh->common;
+	unsigned long		flags;
+
+	if (!atomic_dec_and_test(&bh->bios))
+		return;
+
+	if (rw == WRITE && bh->bio_error && !common->direct_error) {
+		common->direct_error = bh->bio_error;
+		common->direct_error_offset = bh->bio_offset;
+	}
+
+	/* Hold the lock while we update the buffer state */
+	smp_wmb();
+	spin_lock_irqsave(&common->lock, flags);
+	bh->state = rw == WRITE ? BUF_STATE_EMPTY : BUF_STATE_FULL;
+	wakeup_thread(common);
+	spin_unlock_irqrestore(&common->lock, flags);
+
+	if (atomic_dec_and_test(&common->direct_pending))
+		wake_up(&common->direct_wait);
+}
+
+static void fsg_direct_end_io(struct bio *bio, int error)
+{
+	struct fsg_buffhd	*bh = bio->bi_private;
+	int			rw = bio_data_dir(bio);
+
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags) && !error)
+		error = -EIO;
+	if (error)
+		bh->bio_error = error;
+	bio_put(bio);
+	fsg_direct_put(bh, rw);
+}
+
+/* Start reading or writing amount bytes of the medium at offset */
+static void fsg_direct_submit(struct fsg_common *common,
+		struct fsg_buffhd *bh, int rw, loff_t offset,
+		unsigned int amount)
+{
+	struct bio	*bio = NULL;
+	void		*buf = bh->buf;
+	unsigned int	len;
+
+	bh->bio_error = 0;
+	bh->bio_offset = offset;
+	atomic_set(&bh->bios, 1);
+	atomic_inc(&common->direct_pending);
+	if (rw == READ)
+		bh->inreq->length = amount;
+	spin_lock_irq(&common->lock);
+	bh->state = BUF_STATE_BUSY;
+	spin_unlock_irq(&common->lock);
+
+	while (amount) {
+		len = min_t(unsigned int, amount,
+			    PAGE_SIZE - offset_in_page(buf));
+		if (bio && bio_add_page(bio, virt_to_page(buf), len,
+					offset_in_page(buf)) == len) {
+			buf += len;
+			offset += len;
+			amount -= len;
+			continue;
+		}
+
+		/* Full, or the first: on to a new bio */
+		if (bio) {
+			atomic_inc(&bh->bios);
+			submit_bio(rw | REQ_SYNC | REQ_UNPLUG, bio);
+		}
+		bio = bio_alloc(GFP_NOIO, min_t(unsigned int, BIO_MAX_PAGES,
+					DIV_ROUND_UP(amount, PAGE_SIZE) + 1));
+		bio->bi_sector = offset >> 9;
+		bio->bi_bdev = common->curlun->bdev;
+		bio->bi_end_io = fsg_direct_end_io;
+		bio->bi_private = bh;
+	}
+	if (bio) {
+		atomic_inc(&bh->bios);
+		submit_bio(rw | REQ_SYNC | REQ_UNPLUG, bio);
+	}
+	fsg_direct_put(bh, rw);
+}
+
+/* Writes whole blocks of the buffer, returning how much is being written */
+static ssize_t fsg_direct_write(struct fsg_common *common,
+		struct fsg_buffhd *bh, loff_t offset, unsigned int amount)
+{
+	amount -= amount & 511;
+	if (amount)
+		fsg_direct_submit(common, bh, WRITE, offset, amount);
+	return amount;
+}
+
+static void fsg_direct_wait(struct fsg_common *common)
+{
+	wait_event(common->direct_wait, !atomic_read(&common->direct_pending));
+}
+
+
+/*-------------------------------------------------------------------------*/
+
+/*
+ * Reads from a block device: every free buffer has a read going, and each
+ * is sent as soon as its read completes, so that the medium and the bus
+ * are kept busy together.
+ */
+static int do_read_direct(struct fsg_common *common, loff_t file_offset,
+			  u32 amount_left)
+{
+	struct fsg_lun		*curlun = common->curlun;
+	struct fsg_buffhd	*bh, *bh_read = common->next_buffhd_to_fill;
+	loff_t			read_offset = file_offset;
+	u32			read_left = amount_left;
+	unsigned int		amount, issued = 0;
+	int			eof = 0, rc = 0;
+
+	for (;;) {
+
+		/* Start reading into the free buffers, as far as we may:
+		 * not past the end of the file, and in whole blocks. */
+		while (read_left > 0 && !eof &&
+		       bh_read->state == BUF_STATE_EMPTY) {
+			amount = min(read_left, common->buflen);
+			amount = min((loff_t) amount,
+					curlun->file_length - read_offset);
+			amount -= (amount & 511);
+			if (amount == 0) {
+				eof = 1;
+				break;
+			}
+			fsg_direct_submit(common, bh_read, READ, read_offset,
+					  amount);
+			read_offset += amount;
+			read_left -= amount;
+			bh_read = bh_read->next;
+			++issued;
+		}
+
+		/* If we were asked to read past the end of file,
+		 * end with an empty buffer. */
+		bh = common->next_buffhd_to_fill;
+		if (!issued && eof && bh->state == BUF_STATE_EMPTY) {
+			curlun->sense_data =
+					SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+			curlun->sense_data_info = file_offset >> 9;
+			curlun->info_valid = 1;
+			bh->inreq->length = 0;
+			bh->state = BUF_STATE_FULL;
+			break;
+		}
+
+		/* Wait for the oldest read, or for a buffer to read into */
+		if (!issued || bh->state != BUF_STATE_FULL) {
+			rc = sleep_thread(common);
+			if (rc)
+				break;
+			continue;
+		}
+		smp_rmb();
+		--issued;
+
+		/* If an error occurred, report it and its position */
+		if (bh->bio_error) {
+			LDBG(curlun, "error in file read: %d\n",
+					bh->bio_error);
+			curlun->sense_data = SS_UNRECOVERED_READ_ERROR;
+			curlun->sense_data_info = file_offset >> 9;
+			curlun->info_valid = 1;
+			bh->inreq->length = 0;
+			break;
+		}
+		VLDBG(curlun, "direct read %u @ %llu\n", bh->inreq->length,
+				(unsigned long long) file_offset);
+		file_offset  += bh->inreq->length;
+		amount_left  -= bh->inreq->length;
+		common->residue -= bh->inreq->length;
+
+		if (amount_left == 0)
+			break;		/* No more left to read */
+
+		/* Send this buffer and go on with the next */
+		bh->inreq->zero = 0;
+		START_TRANSFER_OR(common, bulk_in, bh->inreq,
+			       &bh->inreq_busy, &bh->state)
+			/* Don't know what to do if
+			 * common->fsg is NULL */
+			break;
+		common->next_buffhd_to_fill = bh->next;
+	}
+
+	/* What was read past an error is not sent */
+	fsg_direct_wait(common);
+	for (bh = common->next_buffhd_to_fill; issued; --issued) {
+		bh = bh->next;
+		bh->state = BUF_STATE_EMPTY;
+	}
+	return rc ? rc : -EIO;	/* No default reply */
+}
+
 static int do_read(struct fsg_common *common)
 {
 	struct fsg_lun		*curlun = common->curlun;
@@ -770,6 +1019,9 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	if (fsg_lun_direct(curlun))
+		return do_read_direct(common, file_offset, amount_left);
+
 	for (;;) {
 
 		/* Figure out how much we need to read:
@@ -780,7 +1032,7 @@ static int do_read(struct fsg_common *common)
 		 *	the next page.
 		 * If this means reading 0 then we were asked to read past
 		 *	the end of file. */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t) amount,
 				curlun->file_length - file_offset);
 		partial_page = file_offset & (PAGE_CACHE_SIZE - 1);
@@ -912,6 +1164,7 @@ static int do_write(struct fsg_common *common)
 
 	/* Carry out the file writes */
 	get_some_more = 1;
+	common->direct_error = 0;
 	file_offset = usb_offset = ((loff_t) lba) << 9;
 	amount_left_to_req = common->data_size_from_cmnd;
 	amount_left_to_write = common->data_size_from_cmnd;
@@ -931,7 +1184,7 @@ static int do_write(struct fsg_common *common)
 			 * If this means getting 0, then we were asked
 			 *	to write past the end of file.
 			 * Finally, round down to a block boundary. */
-			amount = min(amount_left_to_req, FSG_BUFLEN);
+			amount = min(amount_left_to_req, common->buflen);
 			amount = min((loff_t) amount, curlun->file_length -
 					usb_offset);
 			partial_page = usb_offset & (PAGE_CACHE_SIZE - 1);
@@ -969,10 +1222,12 @@ static int do_write(struct fsg_common *common)
 			bh->bulk_out_intended_length = amount;
 			bh->outreq->short_not_ok = 1;
 			START_TRANSFER_OR(common, bulk_out, bh->outreq,
-					  &bh->outreq_busy, &bh->state)
+					  &bh->outreq_busy, &bh->state) {
 				/* Don't know what to do if
 				 * common->fsg is NULL */
-				return -EIO;
+				rc = -EIO;
+				goto out;
+			}
 			common->next_buffhd_to_fill = bh->next;
 			continue;
 		}
@@ -1003,16 +1258,23 @@ static int do_write(struct fsg_common *common)
 				amount = curlun->file_length - file_offset;
 			}
 
-			/* Perform the write */
+			/* Perform the write, leaving a block device's in
+			 * flight while we go on */
 			file_offset_tmp = file_offset;
-			nwritten = vfs_write(curlun->filp,
-					(char __user *) bh->buf,
-					amount, &file_offset_tmp);
+			if (fsg_lun_direct(curlun))
+				nwritten = fsg_direct_write(common, bh,
+						file_offset, amount);
+			else
+				nwritten = vfs_write(curlun->filp,
+						(char __user *) bh->buf,
+						amount, &file_offset_tmp);
 			VLDBG(curlun, "file write %u @ %llu -> %d\n", amount,
 					(unsigned long long) file_offset,
 					(int) nwritten);
-			if (signal_pending(current))
-				return -EINTR;		/* Interrupted! */
+			if (signal_pending(current)) {
+				rc = -EINTR;		/* Interrupted! */
+				goto out;
+			}
 
 			if (nwritten < 0) {
 				LDBG(curlun, "error in file write: %d\n",
@@ -1047,10 +1309,29 @@ static int do_write(struct fsg_common *common)
 		/* Wait for something to happen */
 		rc = sleep_thread(common);
 		if (rc)
-			return rc;
+			goto out;
+	}
+	rc = -EIO;		/* No default reply */
+
+out:
+	/* The status must not be sent before the data is on the medium,
+	 * and nothing in the page cache may be older than it */
+	if (fsg_lun_direct(curlun)) {
+		fsg_direct_wait(common);
+		if (common->direct_error) {
+			LDBG(curlun, "error in file write: %d\n",
+					common->direct_error);
+			curlun->sense_data = SS_WRITE_ERROR;
+			curlun->sense_data_info =
+					common->direct_error_offset >> 9;
+			curlun->info_valid = 1;
+		}
+		if (usb_offset > ((loff_t) lba) << 9)
+			invalidate_mapping_pages(curlun->filp->f_mapping,
+				(((loff_t) lba) << 9) >> PAGE_CACHE_SHIFT,
+				(usb_offset - 1) >> PAGE_CACHE_SHIFT);
 	}
-
-	return -EIO;		/* No default reply */
+	return rc;
 }
 
 
@@ -1134,7 +1415,7 @@ static int do_verify(struct fsg_common *common)
 		 * And don't try to read past the end of the file.
 		 * If this means reading 0 then we were asked to read
 		 * past the end of file. */
-		amount = min(amount_left, FSG_BUFLEN);
+		amount = min(amount_left, common->buflen);
 		amount = min((loff_t) amount,
 				curlun->file_length - file_offset);
 		if (amount == 0) {
@@ -1593,7 +1874,8 @@ static int pad_with_zeros(struct fsg_dev *fsg)
 				return rc;
 		}
 
-		nsend = min(fsg->common->usb_amount_left, FSG_BUFLEN);
+		nsend = min(fsg->common->usb_amount_left,
+			    fsg->common->buflen);
 		memset(bh->buf + nkeep, 0, nsend - nkeep);
 		bh->inreq->length = nsend;
 		bh->inreq->zero = 0;
@@ -1636,7 +1918,8 @@ static int throw_away_data(struct fsg_common *common)
 		bh = common->next_buffhd_to_fill;
 		if (bh->state == BUF_STATE_EMPTY
 		 && common->usb_amount_left > 0) {
-			amount = min(common->usb_amount_left, FSG_BUFLEN);
+			amount = min(common->usb_amount_left,
+				     common->buflen);
 
 			/* amount is always divisible by 512, hence by
 			 * the bulk-out maxpacket size */
@@ -2356,7 +2639,7 @@ reset:
 	if (common->fsg) {
 		fsg = common->fsg;
 
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			struct fsg_buffhd *bh = &common->buffhds[i];
 
 			if (bh->inreq) {
@@ -2408,7 +2691,7 @@ reset:
 	clear_bit(IGNORE_BULK_OUT, &fsg->atomic_bitflags);
 
 	/* Allocate the requests */
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		struct fsg_buffhd	*bh = &common->buffhds[i];
 
 		rc = alloc_request(common, fsg->bulk_in, &bh->inreq);
@@ -2478,7 +2761,7 @@ static void handle_exception(struct fsg_common *common)
 
 	/* Cancel all the pending transfers */
 	if (likely(common->fsg)) {
-		for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+		for (i = 0; i < common->num_buffers; ++i) {
 			bh = &common->buffhds[i];
 			if (bh->inreq_busy)
 				usb_ep_dequeue(common->fsg->bulk_in, bh->inreq);
@@ -2490,7 +2773,7 @@ static void handle_exception(struct fsg_common *common)
 		/* Wait until everything is idle */
 		for (;;) {
 			int num_active = 0;
-			for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+			for (i = 0; i < common->num_buffers; ++i) {
 				bh = &common->buffhds[i];
 				num_active += bh->inreq_busy + bh->outreq_busy;
 			}
@@ -2507,11 +2790,15 @@ static void handle_exception(struct fsg_common *common)
 			usb_ep_fifo_flush(common->fsg->bulk_out);
 	}
 
+	/* Medium I/O cannot be cancelled, but must not change the
+	 * buffers behind our back */
+	fsg_direct_wait(common);
+
 	/* Reset the I/O buffer states and pointers, the SCSI
 	 * state, and the exception.  Then invoke the handler. */
 	spin_lock_irq(&common->lock);
 
-	for (i = 0; i < FSG_NUM_BUFFERS; ++i) {
+	for (i = 0; i < common->num_buffers; ++i) {
 		bh = &common->buffhds[i];
 		bh->state = BUF_STATE_EMPTY;
 	}
@@ -2701,12 +2988,63 @@ static inline void fsg_common_put(struct fsg_common *common)
 }
 
 
+static void fsg_free_buffhds(struct fsg_common *common)
+{
+	unsigned i;
+
+	if (!common->buffhds)
+		return;
+	for (i = 0; i < common->num_buffers; ++i)
+		kfree(common->buffhds[i].buf);
+	kfree(common->buffhds);
+	common->buffhds = NULL;
+}
+
+static int fsg_alloc_buffhds(struct fsg_common *common)
+{
+	struct fsg_buffhd *bh;
+	unsigned i;
+
+	common->num_buffers = clamp_t(unsigned, fsg_num_buffers, 2,
+				      FSG_MAX_NUM_BUFFERS);
+	common->buflen = clamp_t(u32, fsg_buflen & PAGE_MASK, FSG_BUFLEN,
+				 FSG_MAX_BUFLEN);
+	common->buffhds = kcalloc(common->num_buffers, sizeof *bh,
+				  GFP_KERNEL);
+	if (unlikely(!common->buffhds))
+		return -ENOMEM;
+
+retry:
+	for (i = 0, bh = common->buffhds; i < common->num_buffers; ++i, ++bh) {
+		bh->next = bh + 1;
+		bh->common = common;
+		bh->buf = kmalloc(common->buflen, GFP_KERNEL);
+		if (unlikely(!bh->buf))
+			goto fail;
+	}
+	common->buffhds[common->num_buffers - 1].next = common->buffhds;
+	return 0;
+
+fail:
+	while (i--) {
+		kfree(common->buffhds[i].buf);
+		common->buffhds[i].buf = NULL;
+	}
+	if (common->buflen > FSG_BUFLEN) {
+		WARNING(common, "falling back to %u byte buffers\n",
+			FSG_BUFLEN);
+		common->buflen = FSG_BUFLEN;
+		goto retry;
+	}
+	fsg_free_buffhds(common);
+	return -ENOMEM;
+}
+
 static struct fsg_common *fsg_common_init(struct fsg_common *common,
 					  struct usb_composite_dev *cdev,
 					  struct fsg_config *cfg)
 {
 	struct usb_gadget *gadget = cdev->gadget;
-	struct fsg_buffhd *bh;
 	struct fsg_lun *curlun;
 	struct fsg_lun_config *lcfg;
 	int nluns, i, rc;
@@ -2805,20 +3143,9 @@ static struct fsg_common *fsg_common_init(struct fsg_common *common,
 
 
 	/* Data buffers cyclic list */
-	bh = common->buffhds;
-	i = FSG_NUM_BUFFERS;
-	goto buffhds_first_it;
-	do {
-		bh->next = bh + 1;
-		++bh;
-buffhds_first_it:
-		bh->buf = kmalloc(FSG_BUFLEN, GFP_KERNEL);
-		if (unlikely(!bh->buf)) {
-			rc = -ENOMEM;
-			goto error_release;
-		}
-	} while (--i);
-	bh->next = common->buffhds;
+	rc = fsg_alloc_buffhds(common);
+	if (unlikely(rc))
+		goto error_release;
 
 
 	/* Prepare inquiryString */
@@ -2867,12 +3194,15 @@ buffhds_first_it:
 	}
 	init_completion(&common->thread_notifier);
 	init_waitqueue_head(&common->fsg_wait);
+	init_waitqueue_head(&common->direct_wait);
 #undef OR
 
 
 	/* Information */
 	INFO(common, FSG_DRIVER_DESC ", version: " FSG_DRIVER_VERSION "\n");
 	INFO(common, "Number of LUNs=%d\n", common->nluns);
+	INFO(common, "%u buffers of %u bytes\n", common->num_buffers,
+	     common->buflen);
 
 	pathbuf = kmalloc(PATH_MAX, GFP_KERNEL);
 	for (i = 0, nluns = common->nluns, curlun = common->luns;
@@ -2942,13 +3272,7 @@ static void fsg_common_release(struct kref *ref)
 		kfree(common->luns);
 	}
 
-	{
-		struct fsg_buffhd *bh = common->buffhds;
-		unsigned i = FSG_NUM_BUFFERS;
-		do {
-			kfree(bh->buf);
-		} while (++bh, --i);
-	}
+	fsg_free_buffhds(common);
 
 	if (common->free_storage_on_release)
 		kfree(common);
@@ -30,6 +30,10 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -50,9 +54,31 @@
 #define STATE_CANCELED              3   /* transaction canceled by host */
 #define STATE_ERROR                 4   /* error from completion routine */
 
-/* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+/* most tx and rx requests to allocate */
+#define TX_REQ_MAX 16
+#define RX_REQ_MAX 8
+
+/*
+ * Requests of BULK_BUFFER_SIZE complete too often to keep the bus busy,
+ * and too few of them leave it idle while the next one is being filled,
+ * so by default there are more and larger ones.  If the buffers cannot
+ * be had, BULK_BUFFER_SIZE is used instead.
+ */
+static unsigned int mtp_tx_req_len = 65536;
+module_param(mtp_tx_req_len, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_tx_req_len, "size of each tx request, in bytes");
+
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_tx_reqs, "number of tx requests");
+
+static unsigned int mtp_rx_req_len = 65536;
+module_param(mtp_rx_req_len, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_rx_req_len, "size of each rx request, in bytes");
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(mtp_rx_reqs, "number of rx requests");
 
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
@@ -89,13 +115,19 @@ struct mtp_dev {
 	atomic_t ioctl_excl;
 
 	struct list_head tx_idle;
+	unsigned int tx_reqs;
+	unsigned int tx_req_len;
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
+	unsigned int rx_reqs;
+	unsigned int rx_req_len;
 	struct usb_request *intr_req;
 	int rx_done;
+	/* rx requests completed, in order, since receive_file_work started */
+	unsigned int rx_completed;
 	/* true if interrupt endpoint is busy */
 	int intr_busy;
 
@@ -363,7 +395,9 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 	struct mtp_dev *dev = _mtp_dev;
 
 	dev->rx_done = 1;
-	if (req->status != 0)
+	dev->rx_completed++;
+	/* reads queued past a short packet are dequeued */
+	if (req->status != 0 && req->status != -ECONNRESET)
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -381,6 +415,21 @@ static void mtp_complete_intr(struct usb_ep *ep, struct usb_request *req)
 	wake_up(&dev->intr_wq);
 }
 
+static void mtp_free_requests(struct mtp_dev *dev)
+{
+	struct usb_request *req;
+	int i;
+
+	while ((req = req_get(dev, &dev->tx_idle)))
+		mtp_request_free(req, dev->ep_in);
+	for (i = 0; i < RX_REQ_MAX; i++) {
+		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
+	mtp_request_free(dev->intr_req, dev->ep_intr);
+	dev->intr_req = NULL;
+}
+
 static int __init create_bulk_endpoints(struct mtp_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc,
@@ -430,15 +479,22 @@ static int __init create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, BULK_BUFFER_SIZE);
+	dev->tx_reqs = clamp_t(unsigned int, mtp_tx_reqs, 1, TX_REQ_MAX);
+	dev->tx_req_len = max_t(unsigned int, mtp_tx_req_len & PAGE_MASK,
+				PAGE_SIZE);
+	dev->rx_reqs = clamp_t(unsigned int, mtp_rx_reqs, 1, RX_REQ_MAX);
+	dev->rx_req_len = max_t(unsigned int, mtp_rx_req_len & PAGE_MASK,
+				PAGE_SIZE);
+retry:
+	for (i = 0; i < dev->tx_reqs; i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
 		if (!req)
 			goto fail;
 		req->complete = mtp_complete_in;
 		req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, BULK_BUFFER_SIZE);
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
 		if (!req)
 			goto fail;
 		req->complete = mtp_complete_out;
@@ -453,6 +509,15 @@ static int __init create_bulk_endpoints(struct mtp_dev *dev,
 	return 0;
 
 fail:
+	mtp_free_requests(dev);
+	if (dev->tx_req_len > BULK_BUFFER_SIZE ||
+	    dev->rx_req_len > BULK_BUFFER_SIZE) {
+		printk(KERN_WARNING "mtp_bind() falling back to %d byte "
+			"requests\n", BULK_BUFFER_SIZE);
+		dev->tx_req_len = BULK_BUFFER_SIZE;
+		dev->rx_req_len = BULK_BUFFER_SIZE;
+		goto retry;
+	}
 	printk(KERN_ERR "mtp_bind() could not allocate requests\n");
 	return -1;
 }
@@ -468,7 +533,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%d)\n", count);
 
-	if (count > BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -587,8 +652,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > BULK_BUFFER_SIZE)
-			xfer = BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -625,76 +690,172 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/* send_file_work state, passed to the splice actors */
+struct mtp_splice {
+	struct mtp_dev *dev;
+	struct file *filp;
+	struct usb_request *req;	/* being filled, not yet queued */
+	loff_t end;			/* of the range being sent */
+	loff_t ra_pos;			/* read ahead up to here */
+};
+
+/*
+ * Have the part of the file that the tx requests after the one starting at
+ * @pos will take read from the disk while those before it are on the bus.
+ */
+static void mtp_read_ahead(struct mtp_splice *ms, loff_t pos)
+{
+	struct mtp_dev *dev = ms->dev;
+	loff_t end = min_t(loff_t, ms->end,
+			   pos + (loff_t)dev->tx_reqs * dev->tx_req_len);
+	pgoff_t index;
+
+	if (ms->ra_pos < pos)
+		ms->ra_pos = pos;
+	if (end - ms->ra_pos < dev->tx_req_len && end < ms->end)
+		return;
+	if (end <= ms->ra_pos)
+		return;
+
+	index = ms->ra_pos >> PAGE_CACHE_SHIFT;
+	force_page_cache_readahead(ms->filp->f_mapping, ms->filp, index,
+			((end - 1) >> PAGE_CACHE_SHIFT) - index + 1);
+	ms->ra_pos = end;
+}
+
+static int mtp_queue_in(struct mtp_dev *dev, struct usb_request *req)
+{
+	int ret;
+
+	ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
+	if (ret < 0) {
+		DBG(dev->cdev, "send_file_work: xfer error %d\n", ret);
+		dev->state = STATE_ERROR;
+		req_put(dev, &dev->tx_idle, req);
+		return -EIO;
+	}
+	return 0;
+}
+
+static struct usb_request *mtp_get_tx_req(struct mtp_dev *dev, int *err)
+{
+	struct usb_request *req = NULL;
+	int ret;
+
+	ret = wait_event_interruptible(dev->write_wq,
+		(req = req_get(dev, &dev->tx_idle))
+		|| dev->state != STATE_BUSY);
+	if (!req)
+		*err = ret ? ret : -EIO;
+	return req;
+}
+
+/*
+ * Copies page cache pages the file was spliced into straight into the tx
+ * requests, queueing each one as soon as it is full.
+ */
+static int mtp_splice_actor(struct pipe_inode_info *pipe,
+			    struct pipe_buffer *buf, struct splice_desc *sd)
+{
+	struct mtp_splice *ms = sd->u.data;
+	struct mtp_dev *dev = ms->dev;
+	struct usb_request *req = ms->req;
+	unsigned int len;
+	void *src;
+	int ret;
+
+	ret = buf->ops->confirm(pipe, buf);
+	if (unlikely(ret))
+		return ret;
+
+	if (!req) {
+		req = mtp_get_tx_req(dev, &ret);
+		if (!req)
+			return ret;
+		req->length = 0;
+		ms->req = req;
+		mtp_read_ahead(ms, sd->pos);
+	}
+
+	len = min(sd->len, dev->tx_req_len - req->length);
+	src = buf->ops->map(pipe, buf, 0);
+	memcpy(req->buf + req->length, src + buf->offset, len);
+	buf->ops->unmap(pipe, buf, src);
+	req->length += len;
+
+	if (req->length == dev->tx_req_len) {
+		ms->req = NULL;
+		ret = mtp_queue_in(dev, req);
+		if (ret)
+			return ret;
+	}
+	return len;
+}
+
+static int mtp_splice_direct(struct pipe_inode_info *pipe,
+			     struct splice_desc *sd)
+{
+	return __splice_from_pipe(pipe, sd, mtp_splice_actor);
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data) {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, send_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *req = 0;
-	struct file *filp;
+	struct usb_request *req;
+	struct mtp_splice ms;
+	struct splice_desc sd;
 	loff_t offset;
 	int64_t count;
-	int xfer, ret;
+	long ret;
 	int r = 0;
-	int sendZLP = 0;
 
 	/* read our parameters */
 	smp_rmb();
-	filp = dev->xfer_file;
 	offset = dev->xfer_file_offset;
 	count = dev->xfer_file_length;
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
-	/* we need to send a zero length packet to signal the end of transfer
-	 * if the transfer size is aligned to a packet boundary.
-	 */
-	if ((dev->xfer_file_length & (dev->ep_in->maxpacket - 1)) == 0) {
-		sendZLP = 1;
-	}
-
-	while (count > 0 || sendZLP) {
-		/* so we exit after sending ZLP */
-		if (count == 0)
-			sendZLP = 0;
-
-		/* get an idle tx request to use */
-		req = 0;
-		ret = wait_event_interruptible(dev->write_wq,
-			(req = req_get(dev, &dev->tx_idle))
-			|| dev->state != STATE_BUSY);
-		if (!req) {
-			r = ret;
+	ms.dev = dev;
+	ms.filp = dev->xfer_file;
+	ms.req = NULL;
+	ms.end = offset + count;
+	ms.ra_pos = offset;
+	mtp_read_ahead(&ms, offset);
+
+	while (count > 0) {
+		memset(&sd, 0, sizeof(sd));
+		sd.total_len = min_t(int64_t, count, INT_MAX & PAGE_MASK);
+		sd.pos = offset;
+		sd.u.data = &ms;
+
+		ret = splice_direct_to_actor(ms.filp, &sd, mtp_splice_direct);
+		if (ret <= 0) {
+			/* the file ends before the range does */
+			r = ret ? ret : -EIO;
 			break;
 		}
-
-		if (count > BULK_BUFFER_SIZE)
-			xfer = BULK_BUFFER_SIZE;
-		else
-			xfer = count;
-		ret = vfs_read(filp, req->buf, xfer, &offset);
-		if (ret < 0) {
-			r = ret;
-			break;
-		}
-		xfer = ret;
-
-		req->length = xfer;
-		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
-		if (ret < 0) {
-			DBG(cdev, "send_file_work: xfer error %d\n", ret);
-			dev->state = STATE_ERROR;
-			r = -EIO;
-			break;
-		}
-
-		count -= xfer;
-
-		/* zero this so we don't try to free it on error exit */
-		req = 0;
+		offset += ret;
+		count -= ret;
 	}
 
-	if (req)
+	/* queue what is left over, then a zero length packet to signal the
+	 * end of transfer if the transfer size is aligned to a packet
+	 * boundary.
+	 */
+	req = ms.req;
+	if (!r && req)
+		r = mtp_queue_in(dev, req);
+	else if (req)
 		req_put(dev, &dev->tx_idle, req);
+	if (!r && (dev->xfer_file_length & (dev->ep_in->maxpacket - 1)) == 0) {
+		req = mtp_get_tx_req(dev, &r);
+		if (req) {
+			req->length = 0;
+			r = mtp_queue_in(dev, req);
+		}
+	}
 
 	DBG(cdev, "send_file_work returning %d\n", r);
 	/* write the result */
@@ -707,11 +868,12 @@ static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev	*dev = container_of(data, struct mtp_dev, receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
 	int64_t count;
-	int ret, cur_buf = 0;
+	unsigned int queued = 0, done = 0, depth;
+	int ret;
 	int r = 0;
 
 	/* read our parameters */
@@ -722,62 +884,67 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
-
-			read_req->length = (count > BULK_BUFFER_SIZE
-					? BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+	/* if xfer_file_length is 0xFFFFFFFF, then we read until we get a
+	 * short packet, and a read queued behind it would take the start
+	 * of the next transfer, so those go one at a time.
+	 */
+	depth = count == 0xFFFFFFFF ? 1 : dev->rx_reqs;
+	dev->rx_completed = 0;
+
+	while (count > 0 || done != queued) {
+		/* keep the host sending while we write to the file */
+		while (count > 0 && queued - done < depth) {
+			req = dev->rx_req[queued % dev->rx_reqs];
+			req->length = min_t(int64_t, count, dev->rx_req_len);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			if (count != 0xFFFFFFFF)
+				count -= req->length;
+			queued++;
 		}
 
-		if (write_req) {
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
-			}
-			write_req = NULL;
+		/* wait for the oldest read to complete */
+		req = dev->rx_req[done % dev->rx_reqs];
+		ret = wait_event_interruptible(dev->read_wq,
+			dev->rx_completed != done || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			goto out;
+		}
+		if (ret < 0 || dev->state != STATE_BUSY) {
+			r = ret < 0 ? ret : -EIO;
+			goto out;
+		}
+		done++;
+
+		if (req->actual < req->length) {
+			/* short packet is used to signal EOF for sizes > 4 gig */
+			DBG(cdev, "got short packet\n");
+			count = 0;
+			while (done != queued)
+				usb_ep_dequeue(dev->ep_out,
+					dev->rx_req[--queued % dev->rx_reqs]);
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/* short packet is used to signal EOF for sizes > 4 gig */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
-
-			write_req = read_req;
-			read_req = NULL;
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto out;
 		}
 	}
 
+out:
+	/* do not leave reads queued into buffers we may hand out again */
+	while (done != queued)
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[done++ % dev->rx_reqs]);
+
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
 	dev->xfer_result = r;
@@ -1001,15 +1168,9 @@ static void
 mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 {
 	struct mtp_dev	*dev = func_to_dev(f);
-	struct usb_request *req;
-	int i;
 
 	spin_lock_irq(&dev->lock);
-	while ((req = req_get(dev, &dev->tx_idle)))
-		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
-		mtp_request_free(dev->rx_req[i], dev->ep_out);
-	mtp_request_free(dev->intr_req, dev->ep_intr);
+	mtp_free_requests(dev);
 	dev->state = STATE_OFFLINE;
 	spin_unlock_irq(&dev->lock);
 	wake_up(&dev->intr_wq);
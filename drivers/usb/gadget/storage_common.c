@@ -53,6 +53,15 @@
  * characters rather then a pointer to void.
  */
 
+/*
+ * When FSG_DIRECT_IO is defined when this file is included, a LUN backed
+ * by a block device remembers it in its bdev field, so that the medium
+ * can be read and written with bios straight into and out of the
+ * fsg_buffhd buffers, and the fsg_buffhd structure carries what is needed
+ * to do that.  The page cache is written back when such a LUN is opened,
+ * and dropped when it is closed.
+ */
+
 
 #include <asm/unaligned.h>
 
@@ -286,6 +295,10 @@ struct fsg_lun {
 	unsigned int	info_valid:1;
 	unsigned int	nofua:1;
 
+#ifdef FSG_DIRECT_IO
+	struct block_device	*bdev;
+#endif
+
 	u32		sense_data;
 	u32		sense_data_info;
 	u32		unit_attention_data;
@@ -340,6 +353,14 @@ struct fsg_buffhd {
 	int				inreq_busy;
 	struct usb_request		*outreq;
 	int				outreq_busy;
+
+#ifdef FSG_DIRECT_IO
+	/* Medium I/O on buf */
+	struct fsg_common		*common;
+	atomic_t			bios;
+	int				bio_error;
+	loff_t				bio_offset;
+#endif
 };
 
 enum fsg_state {
@@ -644,6 +665,19 @@ static int fsg_lun_open(struct fsg_lun *curlun, const char *filename)
 		goto out;
 	}
 
+#ifdef FSG_DIRECT_IO
+	curlun->bdev = NULL;
+	if (S_ISBLK(inode->i_mode) &&
+	    bdev_logical_block_size(inode->i_bdev) <= 512) {
+		rc = filemap_write_and_wait(inode->i_mapping);
+		if (rc) {
+			LINFO(curlun, "unable to write back: %s\n", filename);
+			goto out;
+		}
+		curlun->bdev = inode->i_bdev;
+	}
+#endif
+
 	get_file(filp);
 	curlun->ro = ro;
 	curlun->filp = filp;
@@ -662,6 +696,13 @@ static void fsg_lun_close(struct fsg_lun *curlun)
 {
 	if (curlun->filp) {
 		LDBG(curlun, "close backing file\n");
+#ifdef FSG_DIRECT_IO
+		/* Whoever opens the device next must not see stale pages */
+		if (curlun->bdev)
+			invalidate_mapping_pages(curlun->filp->f_mapping,
+						 0, -1);
+		curlun->bdev = NULL;
+#endif
 		fput(curlun->filp);
 		curlun->filp = NULL;
 	}
@@ -717,6 +717,33 @@ void tegra_dc_incr_syncpt_min(struct tegra_dc *dc, u32 val)
 	mutex_unlock(&dc->lock);
 }
 
+static void tegra_dc_vblank_user(struct tegra_dc *dc, bool *user, bool enable)
+{
+	unsigned long val;
+
+	mutex_lock(&dc->lock);
+	*user = enable;
+	/* the interrupt turns it off again once nobody wants it */
+	if (enable && dc->enabled) {
+		val = tegra_dc_readl(dc, DC_CMD_INT_ENABLE);
+		val |= V_BLANK_INT;
+		tegra_dc_writel(dc, val, DC_CMD_INT_ENABLE);
+	}
+	mutex_unlock(&dc->lock);
+}
+
+/* Keep the vblank interrupt on, and tell the overlay about each vblank */
+void tegra_dc_flip_vblank(struct tegra_dc *dc, bool enable)
+{
+	tegra_dc_vblank_user(dc, &dc->flip_vblank, enable);
+}
+
+/* Likewise for the fb, which passes vsync events on to userspace */
+void tegra_dc_fb_vblank(struct tegra_dc *dc, bool enable)
+{
+	tegra_dc_vblank_user(dc, &dc->fb_vblank, enable);
+}
+
 static bool tegra_dc_windows_are_clean(struct tegra_dc_win *windows[],
 					     int n)
 {
@@ -1123,7 +1150,14 @@ static irqreturn_t tegra_dc_irq(int irq, void *ptr)
 			}
 		}
 
-		if (!dc->underflow_mask) {
+		if (dc->fb_vblank && dc->fb)
+			tegra_fb_vblank(dc->fb, ktime_get());
+
+		if (dc->flip_vblank && dc->overlay)
+			tegra_overlay_vblank(dc->overlay);
+
+		if (!dc->underflow_mask && !dc->flip_vblank &&
+		    !dc->fb_vblank) {
 			val = tegra_dc_readl(dc, DC_CMD_INT_ENABLE);
 			val &= ~V_BLANK_INT;
 			tegra_dc_writel(dc, val, DC_CMD_INT_ENABLE);
@@ -1248,7 +1282,9 @@ static void tegra_dc_init(struct tegra_dc *dc)
 			     WIN_C_UF_INT), DC_CMD_INT_MASK);
 	tegra_dc_writel(dc, (WIN_A_UF_INT |
 			     WIN_B_UF_INT |
-			     WIN_C_UF_INT), DC_CMD_INT_ENABLE);
+			     WIN_C_UF_INT |
+			     ((dc->flip_vblank || dc->fb_vblank) ?
+			      V_BLANK_INT : 0)), DC_CMD_INT_ENABLE);
 
 	tegra_dc_writel(dc, 0x00000000, DC_DISP_BORDER_COLOR);
 
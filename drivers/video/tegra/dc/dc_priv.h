@@ -90,6 +90,8 @@ struct tegra_dc {
 	u32				syncpt_max;
 
 	unsigned long			underflow_mask;
+	bool				flip_vblank;
+	bool				fb_vblank;
 	struct work_struct		reset_work;
 
 	struct switch_dev		modeset_switch;
@@ -142,6 +144,8 @@ static inline void *tegra_dc_get_outdata(struct tegra_dc *dc)
 }
 
 void tegra_dc_setup_clk(struct tegra_dc *dc, struct clk *clk);
+void tegra_dc_flip_vblank(struct tegra_dc *dc, bool enable);
+void tegra_dc_fb_vblank(struct tegra_dc *dc, bool enable);
 
 extern struct tegra_dc_out_ops tegra_dc_rgb_ops;
 extern struct tegra_dc_out_ops tegra_dc_hdmi_ops;
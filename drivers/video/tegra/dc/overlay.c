@@ -19,14 +19,19 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/mutex.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/spinlock.h>
 #include <linux/tegra_overlay.h>
+#include <linux/timer.h>
 #include <linux/uaccess.h>
+#include <linux/workqueue.h>
 
 #include <asm/atomic.h>
 
@@ -38,6 +43,9 @@
 #include "../nvmap/nvmap.h"
 #include "overlay.h"
 
+/* A flip whose fences are not done by then is shown anyway */
+#define FLIP_FENCE_TIMEOUT_MS	500
+
 struct overlay_client;
 
 struct overlay {
@@ -62,6 +70,27 @@ struct tegra_overlay_info {
 	struct tegra_dc_blend	blend;
 
 	struct workqueue_struct	*flip_wq;
+	struct work_struct	flip_work;
+	struct timer_list	flip_timer;
+
+	/* flips not yet on screen, in the order their syncpts were taken */
+	struct list_head	flips;
+	struct mutex		flips_lock;
+	bool			flush;
+	/* highest post syncpt of a flip taken off flips */
+	u32			syncpt_shown;
+
+	struct {
+		u32		queued;
+		u32		shown;
+		u32		dropped;
+		u32		timeouts;
+		u64		latency_us;
+		u32		latency_max_us;
+		u64		fence_us;
+		u32		fence_max_us;
+	} stats;
+	struct dentry		*debugfs;
 
 	/* Big enough for tegra_dc%u when %u < 10 */
 	char			name[10];
@@ -81,11 +110,13 @@ struct tegra_overlay_flip_win {
 };
 
 struct tegra_overlay_flip_data {
-	struct work_struct		work;
-	struct tegra_overlay_info	*overlay;
+	struct list_head		list;
 	struct tegra_overlay_flip_win	win[TEGRA_FB_FLIP_N_WINDOWS];
 	u32				syncpt_max;
 	u32				flags;
+	u32				win_mask;
+	ktime_t				queued;
+	ktime_t				ready;
 };
 
 /* Overlay window manipulation */
@@ -187,13 +218,6 @@ static int tegra_overlay_set_windowattr(struct tegra_overlay_info *overlay,
 	if (flip_win->attr.tiled)
 		win->flags |= TEGRA_WIN_FLAG_TILED;
 
-	if ((s32)flip_win->attr.pre_syncpt_id >= 0) {
-		nvhost_syncpt_wait_timeout(&overlay->ndev->host->syncpt,
-					   flip_win->attr.pre_syncpt_id,
-					   flip_win->attr.pre_syncpt_val,
-					   msecs_to_jiffies(500));
-	}
-
 	/* Store the blend state incase we need to reorder later */
 	overlay->blend.z[win->idx] = win->z;
 	overlay->blend.flags[win->idx] = win->flags & TEGRA_WIN_BLEND_FLAGS_MASK;
@@ -242,55 +266,98 @@ static void tegra_overlay_blend_reorder(struct tegra_dc_blend *blend,
 	windows[below]->flags |= blend->flags[idx];
 }
 
-static void tegra_overlay_flip_worker(struct work_struct *work)
+/* All of a flip's buffers are done being rendered to */
+static bool tegra_overlay_flip_ready(struct tegra_overlay_info *overlay,
+				     struct tegra_overlay_flip_data *data)
 {
-	struct tegra_overlay_flip_data *data =
-		container_of(work, struct tegra_overlay_flip_data, work);
-	struct tegra_overlay_info *overlay = data->overlay;
-	struct tegra_dc_win *win;
-	struct tegra_dc_win *wins[TEGRA_FB_FLIP_N_WINDOWS];
-	struct nvmap_handle_ref *unpin_handles[TEGRA_FB_FLIP_N_WINDOWS];
-	int i, nr_win = 0, nr_unpin = 0;
-#if defined(CONFIG_MACH_N1)
-	static int update_address = 0;
-#endif
-
-	data = container_of(work, struct tegra_overlay_flip_data, work);
+	int i;
 
 	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
 		struct tegra_overlay_flip_win *flip_win = &data->win[i];
-		int idx = flip_win->attr.index;
 
-		if (idx == -1)
+		if (flip_win->attr.index == -1 || !flip_win->handle)
 			continue;
-
-		win = tegra_dc_get_window(overlay->dc, idx);
-
-		if (!win)
+		if ((s32)flip_win->attr.pre_syncpt_id < 0)
 			continue;
+		if (nvhost_syncpt_wait_timeout(&overlay->ndev->host->syncpt,
+					       flip_win->attr.pre_syncpt_id,
+					       flip_win->attr.pre_syncpt_val,
+					       0))
+			return false;
+	}
 
-		if (win->flags && win->cur_handle)
-			unpin_handles[nr_unpin++] = win->cur_handle;
-
-		tegra_overlay_set_windowattr(overlay, win, &data->win[i]);
+	return true;
+}
 
-		wins[nr_win++] = win;
+static void tegra_overlay_unpin_flip(struct tegra_overlay_info *overlay,
+				     struct tegra_overlay_flip_data *data)
+{
+	int i;
 
-#if 0
-		if (flip_win->attr.pre_syncpt_id < 0)
+	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+		if (!data->win[i].handle)
 			continue;
-		printk("%08x %08x\n",
-		       flip_win->attr.pre_syncpt_id,
-		       flip_win->attr.pre_syncpt_val);
-
-		nvhost_syncpt_wait_timeout(&overlay->ndev->host->syncpt,
-					   flip_win->attr.pre_syncpt_id,
-					   flip_win->attr.pre_syncpt_val,
-					   msecs_to_jiffies(500));
+		nvmap_unpin(overlay->overlay_nvmap, data->win[i].handle);
+		nvmap_free(overlay->overlay_nvmap, data->win[i].handle);
+	}
+}
+
+/*
+ * Put every flip in @flips on screen with one window update, so that they
+ * are all latched on the same vblank.
+ */
+static void tegra_overlay_show_flips(struct tegra_overlay_info *overlay,
+				     struct list_head *flips)
+{
+	struct tegra_overlay_flip_data *data, *tmp;
+	struct tegra_dc_win *win;
+	struct tegra_dc_win *wins[DC_N_WINDOWS];
+	struct nvmap_handle_ref *unpin_handles[DC_N_WINDOWS];
+	u32 touched = 0, reorder = 0;
+	int i, nr_win = 0, nr_unpin = 0;
+	ktime_t now;
+#if defined(CONFIG_MACH_N1)
+	static int update_address = 0;
 #endif
+
+	list_for_each_entry(data, flips, list) {
+		reorder |= data->flags & TEGRA_OVERLAY_FLIP_FLAG_BLEND_REORDER;
+
+		for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
+			struct tegra_overlay_flip_win *flip_win = &data->win[i];
+			int idx = flip_win->attr.index;
+
+			if (idx == -1)
+				continue;
+
+			win = tegra_dc_get_window(overlay->dc, idx);
+
+			if (!win)
+				continue;
+
+			if (touched & (1 << idx)) {
+				/* set earlier in this update, never scanned out */
+				if (win->flags && win->cur_handle) {
+					nvmap_unpin(overlay->overlay_nvmap,
+						    win->cur_handle);
+					nvmap_free(overlay->overlay_nvmap,
+						   win->cur_handle);
+				}
+			} else {
+				if (win->flags && win->cur_handle)
+					unpin_handles[nr_unpin++] =
+						win->cur_handle;
+				touched |= 1 << idx;
+				wins[nr_win++] = win;
+			}
+
+			tegra_overlay_set_windowattr(overlay, win, flip_win);
+			/* the window owns the reference now */
+			flip_win->handle = NULL;
+		}
 	}
 
-	if (data->flags & TEGRA_OVERLAY_FLIP_FLAG_BLEND_REORDER) {
+	if (reorder) {
 		struct tegra_dc_win *dcwins[DC_N_WINDOWS];
 
 		for (i = 0; i < DC_N_WINDOWS; i++)
@@ -304,14 +371,14 @@ static void tegra_overlay_flip_worker(struct work_struct *work)
 			update_address = 1;
 			tegra_fb_update_address(overlay->dc->fb, dcwins[0]);
 		}
-#endif		
-	} else {
+#endif
+	} else if (nr_win) {
 		tegra_dc_update_windows(wins, nr_win);
 		/* TODO: implement swapinterval here */
 		tegra_dc_sync_windows(wins, nr_win);
 	}
 
-	tegra_dc_incr_syncpt_min(overlay->dc, data->syncpt_max);
+	now = ktime_get();
 
 	/* unpin and deref previous front buffers */
 	for (i = 0; i < nr_unpin; i++) {
@@ -319,7 +386,116 @@ static void tegra_overlay_flip_worker(struct work_struct *work)
 		nvmap_free(overlay->overlay_nvmap, unpin_handles[i]);
 	}
 
-	kfree(data);
+	mutex_lock(&overlay->flips_lock);
+	list_for_each_entry_safe(data, tmp, flips, list) {
+		u32 latency = ktime_us_delta(now, data->queued);
+		u32 fence = ktime_us_delta(data->ready, data->queued);
+
+		overlay->stats.shown++;
+		overlay->stats.latency_us += latency;
+		overlay->stats.latency_max_us =
+			max(overlay->stats.latency_max_us, latency);
+		overlay->stats.fence_us += fence;
+		overlay->stats.fence_max_us =
+			max(overlay->stats.fence_max_us, fence);
+
+		list_del(&data->list);
+		kfree(data);
+	}
+	mutex_unlock(&overlay->flips_lock);
+}
+
+/*
+ * Runs when a flip is queued, on every vblank while flips are waiting on
+ * their fences, and from flip_timer in case vblanks stop.  Flips are taken
+ * in order, but one waiting on a fence only holds back later flips that
+ * touch any of the same windows.  Of the flips that can go, one whose
+ * windows are all flipped again by a later one is dropped unseen.
+ */
+static void tegra_overlay_flip_worker(struct work_struct *work)
+{
+	struct tegra_overlay_info *overlay =
+		container_of(work, struct tegra_overlay_info, flip_work);
+	struct tegra_overlay_flip_data *data, *tmp;
+	LIST_HEAD(flips);
+	LIST_HEAD(dropped);
+	ktime_t now = ktime_get();
+	u32 busy = 0, covered = 0, syncpt_val;
+	bool pending;
+
+	mutex_lock(&overlay->flips_lock);
+	list_for_each_entry_safe(data, tmp, &overlay->flips, list) {
+		if (data->win_mask & busy) {
+			busy |= data->win_mask;
+			continue;
+		}
+		if (!tegra_overlay_flip_ready(overlay, data)) {
+			if (!overlay->flush &&
+			    ktime_us_delta(now, data->queued) <
+			    FLIP_FENCE_TIMEOUT_MS * USEC_PER_MSEC) {
+				busy |= data->win_mask;
+				continue;
+			}
+			overlay->stats.timeouts++;
+		}
+
+		data->ready = now;
+		if ((s32)(data->syncpt_max - overlay->syncpt_shown) > 0)
+			overlay->syncpt_shown = data->syncpt_max;
+		list_move_tail(&data->list, &flips);
+	}
+
+	list_for_each_entry_safe_reverse(data, tmp, &flips, list) {
+		if (!(data->win_mask & ~covered)) {
+			overlay->stats.dropped++;
+			list_move(&data->list, &dropped);
+			continue;
+		}
+		covered |= data->win_mask;
+	}
+
+	/*
+	 * post syncpts go out in order, so stop short of a waiting flip;
+	 * flips shown earlier behind it are signalled once it goes
+	 */
+	syncpt_val = overlay->syncpt_shown;
+	pending = !list_empty(&overlay->flips);
+	if (pending) {
+		data = list_first_entry(&overlay->flips,
+					struct tegra_overlay_flip_data, list);
+		if ((s32)(data->syncpt_max - 1 - syncpt_val) < 0)
+			syncpt_val = data->syncpt_max - 1;
+	}
+	mutex_unlock(&overlay->flips_lock);
+
+	tegra_dc_flip_vblank(overlay->dc, pending);
+	if (pending)
+		mod_timer(&overlay->flip_timer,
+			  jiffies + msecs_to_jiffies(FLIP_FENCE_TIMEOUT_MS));
+
+	if (!list_empty(&flips))
+		tegra_overlay_show_flips(overlay, &flips);
+
+	list_for_each_entry_safe(data, tmp, &dropped, list) {
+		tegra_overlay_unpin_flip(overlay, data);
+		list_del(&data->list);
+		kfree(data);
+	}
+
+	tegra_dc_incr_syncpt_min(overlay->dc, syncpt_val);
+}
+
+static void tegra_overlay_flip_timer(unsigned long arg)
+{
+	struct tegra_overlay_info *overlay = (struct tegra_overlay_info *)arg;
+
+	queue_work(overlay->flip_wq, &overlay->flip_work);
+}
+
+/* Called from the dc interrupt on vblank while flips are waiting */
+void tegra_overlay_vblank(struct tegra_overlay_info *overlay)
+{
+	queue_work(overlay->flip_wq, &overlay->flip_work);
 }
 
 static int tegra_overlay_flip(struct tegra_overlay_info *overlay,
@@ -341,8 +517,6 @@ static int tegra_overlay_flip(struct tegra_overlay_info *overlay,
 		return -ENOMEM;
 	}
 
-	INIT_WORK(&data->work, tegra_overlay_flip_worker);
-	data->overlay = overlay;
 	data->flags = args->flags;
 
 	for (i = 0; i < TEGRA_FB_FLIP_N_WINDOWS; i++) {
@@ -353,6 +527,8 @@ static int tegra_overlay_flip(struct tegra_overlay_info *overlay,
 		if (flip_win->attr.index == -1)
 			continue;
 
+		data->win_mask |= 1 << flip_win->attr.index;
+
 		err = tegra_overlay_pin_window(overlay, flip_win, user_nvmap);
 		if (err < 0) {
 			dev_err(&overlay->ndev->dev,
@@ -361,10 +537,15 @@ static int tegra_overlay_flip(struct tegra_overlay_info *overlay,
 		}
 	}
 
+	mutex_lock(&overlay->flips_lock);
 	syncpt_max = tegra_dc_incr_syncpt_max(overlay->dc);
 	data->syncpt_max = syncpt_max;
+	data->queued = ktime_get();
+	list_add_tail(&data->list, &overlay->flips);
+	overlay->stats.queued++;
+	mutex_unlock(&overlay->flips_lock);
 
-	queue_work(overlay->flip_wq, &data->work);
+	queue_work(overlay->flip_wq, &overlay->flip_work);
 
 	args->post_syncpt_val = syncpt_max;
 	args->post_syncpt_id = tegra_dc_get_syncpt_id(overlay->dc);
@@ -383,6 +564,59 @@ surf_err:
 	kfree(data);
 	return err;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int dbg_flips_show(struct seq_file *s, void *unused)
+{
+	struct tegra_overlay_info *overlay = s->private;
+	struct tegra_overlay_flip_data *data;
+	u32 shown, waiting = 0;
+
+	mutex_lock(&overlay->flips_lock);
+	list_for_each_entry(data, &overlay->flips, list)
+		waiting++;
+	shown = overlay->stats.shown;
+
+	seq_printf(s, "queued:         %u\n", overlay->stats.queued);
+	seq_printf(s, "waiting:        %u\n", waiting);
+	seq_printf(s, "shown:          %u\n", shown);
+	seq_printf(s, "dropped:        %u\n", overlay->stats.dropped);
+	seq_printf(s, "fence timeouts: %u\n", overlay->stats.timeouts);
+	seq_printf(s, "latency:        %llu us avg, %u us max\n",
+		   shown ? div_u64(overlay->stats.latency_us, shown) : 0,
+		   overlay->stats.latency_max_us);
+	seq_printf(s, "fence wait:     %llu us avg, %u us max\n",
+		   shown ? div_u64(overlay->stats.fence_us, shown) : 0,
+		   overlay->stats.fence_max_us);
+	mutex_unlock(&overlay->flips_lock);
+
+	return 0;
+}
+
+static int dbg_flips_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_flips_show, inode->i_private);
+}
+
+static const struct file_operations dbg_flips_fops = {
+	.open		= dbg_flips_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_overlay_dbg_add(struct tegra_overlay_info *overlay)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "%s_flips", overlay->name);
+	overlay->debugfs = debugfs_create_file(name, S_IRUGO, NULL, overlay,
+					       &dbg_flips_fops);
+}
+#else
+static void tegra_overlay_dbg_add(struct tegra_overlay_info *overlay) {}
+#endif
+
 static void tegra_overlay_set_emc_freq(struct tegra_overlay_info *dev)
 {
 	unsigned long emc_freq = 0;
@@ -695,6 +929,12 @@ struct tegra_overlay_info *tegra_overlay_register(struct nvhost_device *ndev,
 
 	mutex_init(&dev->overlays_lock);
 
+	INIT_LIST_HEAD(&dev->flips);
+	mutex_init(&dev->flips_lock);
+	INIT_WORK(&dev->flip_work, tegra_overlay_flip_worker);
+	setup_timer(&dev->flip_timer, tegra_overlay_flip_timer,
+		    (unsigned long)dev);
+
 	e = misc_register(&dev->dev);
 	if (e) {
 		dev_err(&ndev->dev, "unable to register miscdevice %s\n",
@@ -717,6 +957,9 @@ struct tegra_overlay_info *tegra_overlay_register(struct nvhost_device *ndev,
 	}
 
 	dev->dc = dc;
+	dev->syncpt_shown = dc->syncpt_min;
+
+	tegra_overlay_dbg_add(dev);
 
 	dev_info(&ndev->dev, "registered overlay\n");
 
@@ -733,12 +976,39 @@ fail:
 
 void tegra_overlay_unregister(struct tegra_overlay_info *info)
 {
+	struct tegra_overlay_flip_data *data, *tmp;
+
 	misc_deregister(&info->dev);
 
+	/* nothing may queue flip_work or rearm flip_timer after this */
+	tegra_overlay_disable(info);
+	tegra_dc_flip_vblank(info->dc, false);
+	cancel_work_sync(&info->flip_work);
+	del_timer_sync(&info->flip_timer);
+	destroy_workqueue(info->flip_wq);
+
+	list_for_each_entry_safe(data, tmp, &info->flips, list) {
+		tegra_overlay_unpin_flip(info, data);
+		list_del(&data->list);
+		kfree(data);
+	}
+
+	debugfs_remove(info->debugfs);
+
 	kfree(info);
 }
 
+/* Put every queued flip on screen, without waiting for its fences */
 void tegra_overlay_disable(struct tegra_overlay_info *overlay_info)
 {
+	mutex_lock(&overlay_info->flips_lock);
+	overlay_info->flush = true;
+	mutex_unlock(&overlay_info->flips_lock);
+
+	queue_work(overlay_info->flip_wq, &overlay_info->flip_work);
 	flush_workqueue(overlay_info->flip_wq);
+
+	mutex_lock(&overlay_info->flips_lock);
+	overlay_info->flush = false;
+	mutex_unlock(&overlay_info->flips_lock);
 }
@@ -24,6 +24,7 @@ struct tegra_overlay_info *tegra_overlay_register(struct nvhost_device *ndev,
 						  struct tegra_dc *dc);
 void tegra_overlay_unregister(struct tegra_overlay_info *overlay_info);
 void tegra_overlay_disable(struct tegra_overlay_info *overlay_info);
+void tegra_overlay_vblank(struct tegra_overlay_info *overlay_info);
 #else
 static inline struct tegra_overlay_info *tegra_overlay_register(struct nvhost_device *ndev,
 								struct tegra_dc *dc)
@@ -38,6 +39,10 @@ static inline void tegra_overlay_unregister(struct tegra_overlay_info *overlay_i
 static inline void tegra_overlay_disable(struct tegra_overlay_info *overlay_info)
 {
 }
+
+static inline void tegra_overlay_vblank(struct tegra_overlay_info *overlay_info)
+{
+}
 #endif
 
 #endif
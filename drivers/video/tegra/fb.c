@@ -27,6 +27,12 @@
 #include <linux/slab.h>
 #include <linux/file.h>
 #include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/sysfs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <asm/atomic.h>
 
@@ -57,6 +63,27 @@ struct tegra_fb_info {
 	struct nvmap_client	*fb_nvmap;
 
 	struct workqueue_struct	*flip_wq;
+
+	/* triple buffering: one pan waiting for scanout, done by pan_work */
+	struct work_struct	pan_work;
+	wait_queue_head_t	pan_wait;
+	bool			pan_pending;
+	u32			pan_addr;
+	ktime_t			pan_queued;
+
+	struct sysfs_dirent	*vsync_sd;
+	bool			vsync_enabled;
+
+	spinlock_t		stats_lock;
+	ktime_t			vsync_time;
+	struct {
+		u32		vsyncs;
+		u32		pans;
+		u32		waited;
+		u64		latency_us;
+		u32		latency_max_us;
+	} stats;
+	struct dentry		*debugfs;
 };
 
 struct tegra_fb_flip_win {
@@ -75,6 +102,11 @@ struct tegra_fb_flip_data {
 /* palette array used by the fbcon */
 static u32 pseudo_palette[16];
 
+static int triple_buffer;
+module_param(triple_buffer, bool, S_IRUGO);
+MODULE_PARM_DESC(triple_buffer, "pan through three buffers without blocking, "
+		 "where the framebuffer memory is large enough");
+
 static int tegra_fb_open(struct fb_info *info, int user)
 {
 	struct tegra_fb_info *tegra_fb = info->par;
@@ -136,12 +168,19 @@ static int tegra_fb_release(struct fb_info *info, int user)
 static int tegra_fb_check_var(struct fb_var_screeninfo *var,
 			      struct fb_info *info)
 {
-	if ((var->yres * var->xres * var->bits_per_pixel / 8 * 2) >
-	    info->screen_size)
+	unsigned long size = var->yres * var->xres * var->bits_per_pixel / 8;
+
+	if (size * 2 > info->screen_size)
 		return -EINVAL;
 
-	/* double yres_virtual to allow double buffering through pan_display */
-	var->yres_virtual = var->yres * 2;
+	/*
+	 * double yres_virtual to allow double buffering through pan_display,
+	 * or triple it when asked to and there is room
+	 */
+	if (triple_buffer && size * 3 <= info->screen_size)
+		var->yres_virtual = var->yres * 3;
+	else
+		var->yres_virtual = var->yres * 2;
 
 	return 0;
 }
@@ -292,6 +331,65 @@ void tegra_fb_suspend(struct tegra_fb_info *tegra_fb)
 	flush_workqueue(tegra_fb->flip_wq);
 }
 
+void tegra_fb_vblank(struct tegra_fb_info *tegra_fb, ktime_t timestamp)
+{
+	spin_lock(&tegra_fb->stats_lock);
+	tegra_fb->vsync_time = timestamp;
+	tegra_fb->stats.vsyncs++;
+	spin_unlock(&tegra_fb->stats_lock);
+
+	if (tegra_fb->vsync_sd)
+		sysfs_notify_dirent(tegra_fb->vsync_sd);
+}
+
+/* A pan queued at @queued has just started being scanned out */
+static void tegra_fb_pan_done(struct tegra_fb_info *tegra_fb, ktime_t queued)
+{
+	u32 latency = ktime_us_delta(ktime_get(), queued);
+	unsigned long flags;
+
+	spin_lock_irqsave(&tegra_fb->stats_lock, flags);
+	tegra_fb->stats.pans++;
+	tegra_fb->stats.latency_us += latency;
+	if (latency > tegra_fb->stats.latency_max_us)
+		tegra_fb->stats.latency_max_us = latency;
+	spin_unlock_irqrestore(&tegra_fb->stats_lock, flags);
+}
+
+static void tegra_fb_pan_worker(struct work_struct *work)
+{
+	struct tegra_fb_info *tegra_fb =
+		container_of(work, struct tegra_fb_info, pan_work);
+
+	tegra_fb->win->phys_addr = tegra_fb->pan_addr;
+	tegra_dc_update_windows(&tegra_fb->win, 1);
+	tegra_dc_sync_windows(&tegra_fb->win, 1);
+	tegra_fb_pan_done(tegra_fb, tegra_fb->pan_queued);
+
+	tegra_fb->pan_pending = false;
+	wake_up(&tegra_fb->pan_wait);
+}
+
+/*
+ * With three buffers a pan only has to wait for the one before it to
+ * reach the screen, which frees up the buffer it replaced for drawing.
+ */
+static void tegra_fb_queue_pan(struct tegra_fb_info *tegra_fb, u32 addr)
+{
+	unsigned long flags;
+
+	if (tegra_fb->pan_pending) {
+		spin_lock_irqsave(&tegra_fb->stats_lock, flags);
+		tegra_fb->stats.waited++;
+		spin_unlock_irqrestore(&tegra_fb->stats_lock, flags);
+		wait_event(tegra_fb->pan_wait, !tegra_fb->pan_pending);
+	}
+
+	tegra_fb->pan_addr = addr;
+	tegra_fb->pan_queued = ktime_get();
+	tegra_fb->pan_pending = true;
+	queue_work(tegra_fb->flip_wq, &tegra_fb->pan_work);
+}
 
 static int tegra_fb_pan_display(struct fb_var_screeninfo *var,
 				struct fb_info *info)
@@ -299,6 +397,7 @@ static int tegra_fb_pan_display(struct fb_var_screeninfo *var,
 	struct tegra_fb_info *tegra_fb = info->par;
 	char __iomem *flush_start;
 	char __iomem *flush_end;
+	ktime_t start;
 	u32 addr;
 
 	if (!tegra_fb->win->cur_handle) {
@@ -311,11 +410,18 @@ static int tegra_fb_pan_display(struct fb_var_screeninfo *var,
 		addr = info->fix.smem_start + (var->yoffset * info->fix.line_length) +
 			(var->xoffset * (var->bits_per_pixel/8));
 
+		if (info->var.yres_virtual >= info->var.yres * 3) {
+			tegra_fb_queue_pan(tegra_fb, addr);
+			return 0;
+		}
+
+		start = ktime_get();
 		tegra_fb->win->phys_addr = addr;
 		/* TODO: update virt_addr */
 
 		tegra_dc_update_windows(&tegra_fb->win, 1);
 		tegra_dc_sync_windows(&tegra_fb->win, 1);
+		tegra_fb_pan_done(tegra_fb, start);
 	}
 
 	return 0;
@@ -658,6 +764,113 @@ static int tegra_fb_ioctl(struct fb_info *info, unsigned int cmd, unsigned long
 	return 0;
 }
 
+/*
+ * vsync_event reads as the time of the last vblank, in ns on the
+ * monotonic clock, and wakes up poll() on every vblank while
+ * vsync_event_enable is set.
+ */
+static ssize_t tegra_fb_vsync_event_show(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct tegra_fb_info *tegra_fb = info->par;
+	unsigned long flags;
+	ktime_t time;
+
+	spin_lock_irqsave(&tegra_fb->stats_lock, flags);
+	time = tegra_fb->vsync_time;
+	spin_unlock_irqrestore(&tegra_fb->stats_lock, flags);
+
+	return sprintf(buf, "VSYNC=%llu\n", ktime_to_ns(time));
+}
+
+static DEVICE_ATTR(vsync_event, S_IRUGO, tegra_fb_vsync_event_show, NULL);
+
+static ssize_t tegra_fb_vsync_enable_show(struct device *dev,
+					  struct device_attribute *attr,
+					  char *buf)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct tegra_fb_info *tegra_fb = info->par;
+
+	return sprintf(buf, "%d\n", tegra_fb->vsync_enabled);
+}
+
+static ssize_t tegra_fb_vsync_enable_store(struct device *dev,
+					   struct device_attribute *attr,
+					   const char *buf, size_t count)
+{
+	struct fb_info *info = dev_get_drvdata(dev);
+	struct tegra_fb_info *tegra_fb = info->par;
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val))
+		return -EINVAL;
+
+	tegra_fb->vsync_enabled = !!val;
+	tegra_dc_fb_vblank(tegra_fb->win->dc, tegra_fb->vsync_enabled);
+
+	return count;
+}
+
+static DEVICE_ATTR(vsync_event_enable, S_IRUGO | S_IWUSR,
+		   tegra_fb_vsync_enable_show, tegra_fb_vsync_enable_store);
+
+#ifdef CONFIG_DEBUG_FS
+static int dbg_pans_show(struct seq_file *s, void *unused)
+{
+	struct tegra_fb_info *tegra_fb = s->private;
+	struct fb_var_screeninfo *var = &tegra_fb->info->var;
+	unsigned long flags;
+	u64 latency_us, vsync_ns;
+	u32 vsyncs, pans, waited, latency_max_us;
+
+	spin_lock_irqsave(&tegra_fb->stats_lock, flags);
+	vsyncs = tegra_fb->stats.vsyncs;
+	pans = tegra_fb->stats.pans;
+	waited = tegra_fb->stats.waited;
+	latency_us = tegra_fb->stats.latency_us;
+	latency_max_us = tegra_fb->stats.latency_max_us;
+	vsync_ns = ktime_to_ns(tegra_fb->vsync_time);
+	spin_unlock_irqrestore(&tegra_fb->stats_lock, flags);
+
+	seq_printf(s, "buffers:    %u\n",
+		   var->yres ? var->yres_virtual / var->yres : 0);
+	seq_printf(s, "pans:       %u\n", pans);
+	seq_printf(s, "waited:     %u\n", waited);
+	seq_printf(s, "latency:    %llu us avg, %u us max\n",
+		   pans ? div_u64(latency_us, pans) : 0, latency_max_us);
+	seq_printf(s, "vsyncs:     %u\n", vsyncs);
+	seq_printf(s, "last vsync: %llu ns\n", vsync_ns);
+
+	return 0;
+}
+
+static int dbg_pans_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_pans_show, inode->i_private);
+}
+
+static const struct file_operations dbg_pans_fops = {
+	.open		= dbg_pans_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_fb_dbg_add(struct tegra_fb_info *tegra_fb)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "tegra_fb%d_pans", tegra_fb->ndev->id);
+	tegra_fb->debugfs = debugfs_create_file(name, S_IRUGO, NULL, tegra_fb,
+						&dbg_pans_fops);
+}
+#else
+static void tegra_fb_dbg_add(struct tegra_fb_info *tegra_fb) {}
+#endif
+
 static struct fb_ops tegra_fb_ops = {
 	.owner = THIS_MODULE,
 	.fb_open = tegra_fb_open,
@@ -796,6 +1009,9 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 		goto err_free;
 	}
 	atomic_set(&tegra_fb->in_use, 0);
+	INIT_WORK(&tegra_fb->pan_work, tegra_fb_pan_worker);
+	init_waitqueue_head(&tegra_fb->pan_wait);
+	spin_lock_init(&tegra_fb->stats_lock);
 
 	tegra_fb->flip_wq = create_singlethread_workqueue(dev_name(&ndev->dev));
 	if (!tegra_fb->flip_wq) {
@@ -834,6 +1050,9 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 	info->var.yres			= fb_data->yres;
 	info->var.xres_virtual		= fb_data->xres;
 	info->var.yres_virtual		= fb_data->yres * 2;
+	if (triple_buffer && fb_size >= fb_data->xres * fb_data->yres *
+	    fb_data->bits_per_pixel / 8 * 3)
+		info->var.yres_virtual	= fb_data->yres * 3;
 	info->var.bits_per_pixel	= fb_data->bits_per_pixel;
 	info->var.activate		= FB_ACTIVATE_VBL;
 	info->var.height		= tegra_dc_get_out_height(dc);
@@ -876,6 +1095,15 @@ struct tegra_fb_info *tegra_fb_register(struct nvhost_device *ndev,
 
 	tegra_fb->info = info;
 
+	if (device_create_file(info->dev, &dev_attr_vsync_event) ||
+	    device_create_file(info->dev, &dev_attr_vsync_event_enable))
+		dev_warn(&ndev->dev, "couldn't create vsync event files\n");
+	else
+		tegra_fb->vsync_sd = sysfs_get_dirent(info->dev->kobj.sd, NULL,
+						      "vsync_event");
+
+	tegra_fb_dbg_add(tegra_fb);
+
 	dev_info(&ndev->dev, "probed\n");
 
 	if (fb_data->flags & TEGRA_FB_FLIP_ON_PROBE) {
@@ -901,6 +1129,15 @@ void tegra_fb_unregister(struct tegra_fb_info *fb_info)
 {
 	struct fb_info *info = fb_info->info;
 
+	tegra_dc_fb_vblank(fb_info->win->dc, false);
+	if (fb_info->vsync_sd) {
+		sysfs_put(fb_info->vsync_sd);
+		fb_info->vsync_sd = NULL;
+	}
+	device_remove_file(info->dev, &dev_attr_vsync_event_enable);
+	device_remove_file(info->dev, &dev_attr_vsync_event);
+	debugfs_remove(fb_info->debugfs);
+
 	if (fb_info->win->cur_handle) {
 		nvmap_unpin(fb_info->fb_nvmap, fb_info->win->cur_handle);
 		nvmap_free(fb_info->fb_nvmap, fb_info->win->cur_handle);
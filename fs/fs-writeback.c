@@ -944,6 +944,8 @@ void __mark_inode_dirty(struct inode *inode, int flags)
 	if ((inode->i_state & flags) == flags)
 		return;
 
+	sb_mark_changed(sb);
+
 	if (unlikely(block_dump > 1))
 		block_dump___mark_inode_dirty(inode);
 
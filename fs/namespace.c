@@ -294,6 +294,8 @@ int mnt_want_write(struct vfsmount *mnt)
 		ret = -EROFS;
 		goto out;
 	}
+	/* Namespace changes need not dirty any inode the VFS sees. */
+	sb_mark_changed(mnt->mnt_sb);
 out:
 	preempt_enable();
 	return ret;
@@ -91,12 +91,24 @@ static void sync_filesystems(int wait)
 	iterate_supers(sync_one_sb, &wait);
 }
 
+/*
+ * Anything changed from here on is left for the next sync to find.  The
+ * barrier orders the store against the writeback that follows, the way
+ * __mark_inode_dirty() orders its test of i_state.
+ */
+static void sb_start_sync(struct super_block *sb, void *unused)
+{
+	sb->s_synced = sb->s_changed;
+	smp_mb();
+}
+
 /*
  * sync everything.  Start out by waking pdflush, because that writes back
  * all queues in parallel.
  */
 SYSCALL_DEFINE0(sync)
 {
+	iterate_supers(sb_start_sync, NULL);
 	wakeup_flusher_threads(0);
 	sync_filesystems(0);
 	sync_filesystems(1);
@@ -105,6 +117,59 @@ SYSCALL_DEFINE0(sync)
 	return 0;
 }
 
+/*
+ * Metadata of simple filesystems lives in the block device's page cache,
+ * which dirtying does not move s_changed of the filesystem for.
+ */
+static bool sb_needs_sync(struct super_block *sb)
+{
+	if (sb->s_changed != sb->s_synced || sb_is_dirty(sb))
+		return true;
+	return sb->s_bdev &&
+	       mapping_tagged(sb->s_bdev->bd_inode->i_mapping,
+			      PAGECACHE_TAG_DIRTY);
+}
+
+static void sync_dirty_sb(struct super_block *sb, void *arg)
+{
+	int *synced = arg;
+
+	/*
+	 * sysfs, proc and tmpfs see mnt_want_write() on every suspend, but
+	 * have nothing to write back: __sync_filesystem() skips them too.
+	 */
+	if ((sb->s_flags & MS_RDONLY) || !sb->s_bdi ||
+	    sb->s_bdi == &noop_backing_dev_info || !sb_needs_sync(sb))
+		return;
+
+	sb_start_sync(sb, NULL);
+	if (__sync_filesystem(sb, 0) < 0 || __sync_filesystem(sb, 1) < 0)
+		sb->s_synced--;		/* try it again next time */
+	(*synced)++;
+}
+
+/**
+ * sync_dirty_filesystems - sync the filesystems that have changed
+ *
+ * Like sync(), but filesystems nothing has changed on since they were
+ * last synced are left alone, without even a journal commit.  Suspend
+ * runs this on every attempt, mostly finding nothing to do.  As with
+ * sync(), the flusher threads are still kicked for dirty data of block
+ * devices no filesystem is mounted on.  Returns how many filesystems
+ * were synced.
+ */
+int sync_dirty_filesystems(void)
+{
+	int synced = 0;
+
+	wakeup_flusher_threads(0);
+	iterate_supers(sync_dirty_sb, &synced);
+	if (synced && unlikely(laptop_mode))
+		laptop_sync_completion();
+	return synced;
+}
+EXPORT_SYMBOL_GPL(sync_dirty_filesystems);
+
 static void do_sync_work(struct work_struct *work)
 {
 	/*
@@ -18,6 +18,7 @@
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/list.h>
+#include <linux/types.h>
 #endif
 
 /* The early_suspend structure defines suspend and resume hooks to be called
@@ -29,6 +30,10 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ * Handlers that set async do not depend on anything else at their level, and
+ * are run in parallel with the other handlers there; the next level is not
+ * started until all of them are done. How long each handler took is kept in
+ * the structure and shown in debugfs, in /sys/kernel/debug/earlysuspend.
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -41,6 +46,12 @@ struct early_suspend {
 	int level;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	bool async;
+	/* Filled in by the early suspend core, in microseconds */
+	u32 suspend_us;
+	u32 suspend_max_us;
+	u32 resume_us;
+	u32 resume_max_us;
 #endif
 };
 
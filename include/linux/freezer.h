@@ -48,6 +48,8 @@ static inline bool should_send_signal(struct task_struct *p)
 extern int thaw_process(struct task_struct *p);
 
 extern void refrigerator(void);
+extern atomic_t freezer_events;
+extern wait_queue_head_t freezer_wait;
 extern int freeze_processes(void);
 extern void thaw_processes(void);
 
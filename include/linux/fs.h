@@ -1359,6 +1359,14 @@ struct super_block {
 	int			s_frozen;
 	wait_queue_head_t	s_wait_unfrozen;
 
+	/*
+	 * s_changed moves on when something changes on the filesystem after
+	 * s_synced was last set to it, which sync() and
+	 * sync_dirty_filesystems() do before they start syncing it.
+	 */
+	unsigned int		s_changed;
+	unsigned int		s_synced;
+
 	char s_id[32];				/* Informational name */
 
 	void 			*s_fs_info;	/* Filesystem private info */
@@ -1389,6 +1397,13 @@ struct super_block {
 
 extern struct timespec current_fs_time(struct super_block *sb);
 
+/* Only written once per sync, so it stays cheap for the callers. */
+static inline void sb_mark_changed(struct super_block *sb)
+{
+	if (sb->s_changed == sb->s_synced)
+		sb->s_changed++;
+}
+
 /*
  * Snapshotting support.
  */
@@ -2108,6 +2123,7 @@ extern int vfs_fsync_range(struct file *file, loff_t start, loff_t end,
 extern int vfs_fsync(struct file *file, int datasync);
 extern int generic_write_sync(struct file *file, loff_t pos, loff_t count);
 extern void sync_supers(void);
+extern int sync_dirty_filesystems(void);
 extern void emergency_sync(void);
 extern void emergency_remount(void);
 #ifdef CONFIG_BLOCK
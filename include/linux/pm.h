@@ -453,11 +453,15 @@ struct dev_pm_info {
 	unsigned int		can_wakeup:1;
 	unsigned int		should_wakeup:1;
 	unsigned		async_suspend:1;
+	unsigned		async_leaf:1;	/* Owned by the PM core */
 	enum dpm_state		status;		/* Owned by the PM core */
 #ifdef CONFIG_PM_SLEEP
 	struct list_head	entry;
 	struct completion	completion;
 	unsigned long		wakeup_count;
+	ktime_t			resume_start;	/* Owned by the PM core */
+	ktime_t			resume_end;
+	struct device		*resume_prev;
 #endif
 #ifdef CONFIG_PM_RUNTIME
 	struct timer_list	suspend_timer;
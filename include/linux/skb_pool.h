@@ -0,0 +1,56 @@
+/*
+ * Per-device pools of recycled receive buffers.
+ *
+ * A driver which copies received frames out of its own DMA or URB
+ * buffers, or which frees its receive buffers itself, can hand those
+ * buffers back to a pool instead of freeing them and take them out of
+ * the pool again for the next receive, saving the sk_buff and data
+ * allocations.  Small frames copied out of a receive buffer get their
+ * payload in page fragments rather than in a kmalloc()ed data area.
+ */
+#ifndef _LINUX_SKB_POOL_H
+#define _LINUX_SKB_POOL_H
+
+#include <linux/skbuff.h>
+
+struct dentry;
+struct net_device;
+
+struct skb_pool_stats {
+	unsigned long	alloc_hit;	/* allocations served by the pool */
+	unsigned long	alloc_miss;	/* allocations that went to the slab */
+	unsigned long	recycled;	/* buffers taken back into the pool */
+	unsigned long	recycle_fail;	/* buffers freed instead */
+	unsigned long	copies;		/* frames copied by skb_pool_copy() */
+	unsigned long	frag_pages;	/* pages carved up into fragments */
+};
+
+struct skb_pool {
+	struct sk_buff_head	list;		/* its lock covers all below */
+	struct net_device	*dev;
+	unsigned int		size;		/* data bytes of pooled skbs */
+	unsigned int		depth;		/* pooled skbs kept at most */
+	struct page		*frag_page;
+	unsigned int		frag_offset;
+	struct skb_pool_stats	stats;
+	struct dentry		*dentry;
+	struct list_head	node;		/* on the list of named pools */
+};
+
+extern struct skb_pool *skb_pool_create(struct net_device *dev,
+					unsigned int size, unsigned int depth);
+extern void skb_pool_destroy(struct skb_pool *pool);
+
+extern struct sk_buff *skb_pool_alloc(struct skb_pool *pool, gfp_t gfp_mask);
+extern int skb_pool_alloc_bulk(struct skb_pool *pool,
+			       struct sk_buff_head *list, int n,
+			       gfp_t gfp_mask);
+extern bool skb_pool_recycle(struct skb_pool *pool, struct sk_buff *skb);
+extern void skb_pool_free(struct skb_pool *pool, struct sk_buff *skb);
+extern void skb_pool_free_bulk(struct skb_pool *pool,
+			       struct sk_buff_head *list);
+
+extern struct sk_buff *skb_pool_copy(struct skb_pool *pool, const void *data,
+				     unsigned int len, gfp_t gfp_mask);
+
+#endif	/* _LINUX_SKB_POOL_H */
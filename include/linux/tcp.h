@@ -105,6 +105,7 @@ enum {
 #define TCP_COOKIE_TRANSACTIONS	15	/* TCP Cookie Transactions */
 #define TCP_THIN_LINEAR_TIMEOUTS 16      /* Use linear timeouts for thin streams*/
 #define TCP_THIN_DUPACK         17      /* Fast retrans. after 1 dupack */
+#define TCP_FASTOPEN		23	/* Enable FastOpen on listeners */
 
 /* for TCP_INFO socket option */
 #define TCPI_OPT_TIMESTAMPS	1
@@ -165,6 +166,14 @@ struct tcp_info {
 	__u32	tcpi_rcv_space;
 
 	__u32	tcpi_total_retrans;
+
+	/* TCP small queues: bytes allowed below the TCP layer and the
+	 * queueing delay (usec) observed between transmit and tx completion.
+	 */
+	__u32	tcpi_tsq_limit;
+	__u32	tcpi_tsq_qdelay;
+	__u32	tcpi_tsq_qdelay_max;
+	__u32	tcpi_tsq_throttled;
 };
 
 /* for TCP_MD5SIG socket option */
@@ -281,6 +290,10 @@ struct tcp_request_sock {
 #endif
 	u32				rcv_isn;
 	u32				snt_isn;
+	u32				rcv_nxt; /* the ack # by SYNACK. For
+						  * FastOpen it's the seq#
+						  * after data-in-SYN.
+						  */
 };
 
 static inline struct tcp_request_sock *tcp_rsk(const struct request_sock *req)
@@ -459,6 +472,31 @@ struct tcp_sock {
 	 * contains related tcp_cookie_transactions fields.
 	 */
 	struct tcp_cookie_values  *cookie_values;
+
+/* TCP Fast Open */
+	struct tcp_fastopen_request *fastopen_req;
+	/* fastopen_rsk points to request_sock that resulted in this big
+	 * socket. Used to retransmit SYNACKs etc.
+	 */
+	struct request_sock	*fastopen_rsk;
+	u16	fastopen_max_qlen; /* listener: accept queue bound for FO	*/
+	u8	syn_data:1,	/* SYN includes data */
+		syn_fastopen:1,	/* SYN includes Fast Open option */
+		syn_data_acked:1;/* data in SYN is acked by SYN-ACK */
+
+/* TCP small queues */
+	unsigned long	tsq_flags;
+	struct list_head tsq_node;	/* anchor in tsq_tasklet.head list */
+	u32	tsq_limit;	/* Last computed limit of bytes in qdisc/dev */
+	u32	tsq_qdelay;	/* smoothed qdisc+device delay (usec) << 3 */
+	u32	tsq_qdelay_max;	/* maximal qdisc+device delay (usec)	*/
+	u32	tsq_throttled;	/* times transmit was held back by TSQ	*/
+};
+
+enum tsq_flags {
+	TSQ_THROTTLED,		/* tcp_write_xmit() stopped on the TSQ limit */
+	TSQ_QUEUED,		/* socket is on the per-cpu tsq tasklet list */
+	TCP_TSQ_DEFERRED,	/* tasklet found the socket owned by user */
 };
 
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
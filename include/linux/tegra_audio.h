@@ -93,4 +93,46 @@ enum tegra_audio_device {
 #define TEGRA_AUDIO_GET_BIT_FORMAT	_IOR(TEGRA_AUDIO_MAGIC, 12, \
 			unsigned int *)
 
+/* Low-latency ring mode.  Instead of write() or read() copying whole
+ * buffers, the DMA runs continuously over a ring of num_periods periods of
+ * period_size bytes each, which userspace mmap()s from the audio%d_out or
+ * audio%d_in device.  num_periods of 0 turns the ring off again.
+ */
+struct tegra_audio_ring_config {
+	unsigned int period_size;	/* bytes, a multiple of 4 */
+	unsigned int num_periods;
+};
+
+/* Userspace tells the driver how far it has written (playback) or read
+ * (capture) in appl_bytes, and gets the DMA position back.  Byte counts run
+ * from RING_START.  After an xrun, appl_bytes is behind hw_bytes (playback)
+ * or more than a ring behind it (capture), and should be moved up to it.
+ */
+struct tegra_audio_ring_sync {
+	unsigned long long appl_bytes;	/* in */
+	unsigned long long hw_bytes;	/* out: moved by the DMA so far */
+	unsigned long long tstamp_ns;	/* out: CLOCK_MONOTONIC of hw_bytes */
+	unsigned int hw_ptr;		/* out: offset of hw_bytes in the ring */
+	unsigned int avail;		/* out: bytes free, or ready to read */
+	unsigned int xruns;		/* out: since RING_START */
+};
+
+#define TEGRA_AUDIO_OUT_SET_RING	_IOW(TEGRA_AUDIO_MAGIC, 13, \
+			const struct tegra_audio_ring_config *)
+#define TEGRA_AUDIO_OUT_GET_RING	_IOR(TEGRA_AUDIO_MAGIC, 14, \
+			struct tegra_audio_ring_config *)
+#define TEGRA_AUDIO_OUT_RING_START	_IO(TEGRA_AUDIO_MAGIC, 15)
+#define TEGRA_AUDIO_OUT_RING_STOP	_IO(TEGRA_AUDIO_MAGIC, 16)
+#define TEGRA_AUDIO_OUT_RING_SYNC	_IOWR(TEGRA_AUDIO_MAGIC, 17, \
+			struct tegra_audio_ring_sync *)
+
+#define TEGRA_AUDIO_IN_SET_RING		_IOW(TEGRA_AUDIO_MAGIC, 18, \
+			const struct tegra_audio_ring_config *)
+#define TEGRA_AUDIO_IN_GET_RING		_IOR(TEGRA_AUDIO_MAGIC, 19, \
+			struct tegra_audio_ring_config *)
+#define TEGRA_AUDIO_IN_RING_START	_IO(TEGRA_AUDIO_MAGIC, 20)
+#define TEGRA_AUDIO_IN_RING_STOP	_IO(TEGRA_AUDIO_MAGIC, 21)
+#define TEGRA_AUDIO_IN_RING_SYNC	_IOWR(TEGRA_AUDIO_MAGIC, 22, \
+			struct tegra_audio_ring_sync *)
+
 #endif/*_CPCAP_AUDIO_H*/
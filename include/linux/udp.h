@@ -77,6 +77,18 @@ struct udp_sock {
 #define UDPLITE_RECV_CC  0x4		/* set via udplite setsocktopt        */
 	__u8		 pcflag;        /* marks socket as UDP-Lite if > 0    */
 	__u8		 unused[3];
+	/*
+	 * Flow of the route an unconnected socket keeps in sk_dst_cache,
+	 * reused while the next datagram goes the same way.
+	 */
+	struct {
+		__be32	daddr, saddr;
+		__be16	dport;
+		__u8	tos;
+		__u8	flags;
+		int	oif;
+		__u32	mark;
+	} dst_key;
 	/*
 	 * For encapsulation sockets.
 	 */
@@ -13,6 +13,27 @@
 #include <linux/spinlock.h>
 #include <asm/atomic.h>
 
+#define TCP_FASTOPEN_COOKIE_MAX	16	/* Max Fast Open Cookie size in bytes */
+
+/* TCP state remembered per destination, so that new connections do not
+ * start cold after the routing cache entry carrying the route metrics
+ * has been flushed (see net/ipv4/tcp_metrics.c).
+ */
+struct inet_peer_tcp_metrics {
+	unsigned long	stamp;		/* jiffies of last update, 0 if unset */
+	__u32		rtt;		/* srtt, jiffies << 3 */
+	__u32		rttvar;		/* mdev, jiffies << 2 */
+	__u32		ssthresh;
+	__u32		cwnd;
+	__u16		reordering;
+	__u16		mss;		/* MSS the peer advertised */
+	/* TCP Fast Open client state */
+	__u16		fo_syn_loss;	/* recurring SYN-data losses */
+	__s8		fo_cookie_len;
+	__u8		fo_cookie[TCP_FASTOPEN_COOKIE_MAX];
+	unsigned long	fo_syn_loss_stamp;
+};
+
 struct inet_peer {
 	/* group together avl_left,avl_right,v4daddr to speedup lookups */
 	struct inet_peer	*avl_left, *avl_right;
@@ -24,9 +45,8 @@ struct inet_peer {
 	atomic_t		refcnt;
 	/*
 	 * Once inet_peer is queued for deletion (refcnt == -1), following fields
-	 * are not available: rid, ip_id_count, tcp_ts, tcp_ts_stamp
+	 * are not available: rid, ip_id_count, tcp_ts, tcp_ts_stamp, tcp
 	 * We can share memory with rcu_head to keep inet_peer small
-	 * (less then 64 bytes)
 	 */
 	union {
 		struct {
@@ -34,6 +54,7 @@ struct inet_peer {
 			atomic_t	ip_id_count;	/* IP ID for the next packet */
 			__u32		tcp_ts;
 			__u32		tcp_ts_stamp;
+			struct inet_peer_tcp_metrics tcp;
 		};
 		struct rcu_head         rcu;
 	};
@@ -22,6 +22,13 @@ static inline void frozen_process(void)
 	clear_freeze_flag(current);
 }
 
+/*
+ * Counts tasks entering the refrigerator, so that the freezer can sleep on
+ * freezer_wait until as many as it is waiting for have.
+ */
+atomic_t freezer_events = ATOMIC_INIT(0);
+DECLARE_WAIT_QUEUE_HEAD(freezer_wait);
+
 /* Refrigerator is place where frozen processes are stored :-). */
 void refrigerator(void)
 {
@@ -33,6 +40,8 @@ void refrigerator(void)
 	if (freezing(current)) {
 		frozen_process();
 		task_unlock(current);
+		atomic_inc(&freezer_events);
+		wake_up(&freezer_wait);
 	} else {
 		task_unlock(current);
 		return;
@@ -15,26 +15,81 @@
 #include "power.h"
 
 /**
- *	submit - submit BIO request.
+ *	hib_init_batch - prepare @hb for collecting image I/O.
+ */
+void hib_init_batch(struct hib_bio_batch *hb)
+{
+	atomic_set(&hb->count, 1);
+	init_completion(&hb->done);
+	hb->error = 0;
+	hb->bio = NULL;
+}
+
+static void hib_end_io(struct bio *bio, int error)
+{
+	struct hib_bio_batch *hb = bio->bi_private;
+	struct bio_vec *bvec;
+	int i;
+
+	if (!test_bit(BIO_UPTODATE, &bio->bi_flags) && !error)
+		error = -EIO;
+	if (error) {
+		printk(KERN_ERR "PM: I/O error %d at sector %llu\n", error,
+			(unsigned long long)bio->bi_sector);
+		if (!hb->error)
+			hb->error = error;
+	}
+
+	/* Pages written through a batch are copies made for it. */
+	if (bio_data_dir(bio) == WRITE)
+		__bio_for_each_segment(bvec, bio, i, 0)
+			put_page(bvec->bv_page);
+	bio_put(bio);
+
+	if (atomic_dec_and_test(&hb->count))
+		complete(&hb->done);
+}
+
+static void hib_submit_batch(struct hib_bio_batch *hb)
+{
+	struct bio *bio = hb->bio;
+
+	if (!bio)
+		return;
+	hb->bio = NULL;
+	atomic_inc(&hb->count);
+	submit_bio(hb->rw | REQ_SYNC | REQ_UNPLUG, bio);
+}
+
+/**
+ *	submit - add a page to a batch of image I/O.
  *	@rw:	READ or WRITE.
- *	@off	physical offset of page.
+ *	@sector: physical sector of the page.
  *	@page:	page we're reading or writing.
- *	@bio_chain: list of pending biod (for async reading)
+ *	@hb:	batch the page goes in.
  *
- *	Straight from the textbook - allocate and initialize the bio.
- *	If we're reading, make sure the page is marked as dirty.
- *	Then submit it and, if @bio_chain == NULL, wait.
+ *	Pages for consecutive sectors go into the same bio, up to what the
+ *	queue takes in one, and a bio is only submitted once the next page
+ *	does not fit in it or hib_wait_io() is called.
  */
 static int submit(int rw, struct block_device *bdev, sector_t sector,
-		struct page *page, struct bio **bio_chain)
+		struct page *page, struct hib_bio_batch *hb)
 {
-	const int bio_rw = rw | REQ_SYNC | REQ_UNPLUG;
-	struct bio *bio;
+	struct bio *bio = hb->bio;
 
-	bio = bio_alloc(__GFP_WAIT | __GFP_HIGH, 1);
+	if (bio) {
+		if (hb->rw == rw &&
+		    bio->bi_sector + (bio->bi_size >> 9) == sector &&
+		    bio_add_page(bio, page, PAGE_SIZE, 0) == PAGE_SIZE)
+			return 0;
+		hib_submit_batch(hb);
+	}
+
+	bio = bio_alloc(__GFP_WAIT | __GFP_HIGH, BIO_MAX_PAGES);
 	bio->bi_sector = sector;
 	bio->bi_bdev = bdev;
-	bio->bi_end_io = end_swap_bio_read;
+	bio->bi_end_io = hib_end_io;
+	bio->bi_private = hb;
 
 	if (bio_add_page(bio, page, PAGE_SIZE, 0) < PAGE_SIZE) {
 		printk(KERN_ERR "PM: Adding page to bio failed at %llu\n",
@@ -42,62 +97,63 @@ static int submit(int rw, struct block_device *bdev, sector_t sector,
 		bio_put(bio);
 		return -EFAULT;
 	}
-
-	lock_page(page);
-	bio_get(bio);
-
-	if (bio_chain == NULL) {
-		submit_bio(bio_rw, bio);
-		wait_on_page_locked(page);
-		if (rw == READ)
-			bio_set_pages_dirty(bio);
-		bio_put(bio);
-	} else {
-		if (rw == READ)
-			get_page(page);	/* These pages are freed later */
-		bio->bi_private = *bio_chain;
-		*bio_chain = bio;
-		submit_bio(bio_rw, bio);
-	}
+	hb->bio = bio;
+	hb->rw = rw;
 	return 0;
 }
 
-int hib_bio_read_page(pgoff_t page_off, void *addr, struct bio **bio_chain)
+/**
+ *	hib_wait_io - submit what is left in @hb and wait for all of it.
+ *
+ *	Returns the first error any of the I/O in the batch ended with.
+ */
+int hib_wait_io(struct hib_bio_batch *hb)
 {
-	return submit(READ, hib_resume_bdev, page_off * (PAGE_SIZE >> 9),
-			virt_to_page(addr), bio_chain);
+	hib_submit_batch(hb);
+	if (!atomic_dec_and_test(&hb->count))
+		wait_for_completion(&hb->done);
+	atomic_set(&hb->count, 1);
+	INIT_COMPLETION(hb->done);
+	return hb->error;
 }
 
-int hib_bio_write_page(pgoff_t page_off, void *addr, struct bio **bio_chain)
+/*
+ * Without a batch, the page is read or written before these return.  With
+ * one, it must be left alone until hib_wait_io() has been called on the
+ * batch, and pages written are freed once they are on the disk.
+ */
+int hib_bio_read_page(pgoff_t page_off, void *addr, struct hib_bio_batch *hb)
 {
-	return submit(WRITE, hib_resume_bdev, page_off * (PAGE_SIZE >> 9),
-			virt_to_page(addr), bio_chain);
+	struct hib_bio_batch sync;
+	int error;
+
+	if (hb)
+		return submit(READ, hib_resume_bdev,
+			      page_off * (PAGE_SIZE >> 9), virt_to_page(addr),
+			      hb);
+
+	hib_init_batch(&sync);
+	error = submit(READ, hib_resume_bdev, page_off * (PAGE_SIZE >> 9),
+		       virt_to_page(addr), &sync);
+	return hib_wait_io(&sync) ?: error;
 }
 
-int hib_wait_on_bio_chain(struct bio **bio_chain)
+int hib_bio_write_page(pgoff_t page_off, void *addr, struct hib_bio_batch *hb)
 {
-	struct bio *bio;
-	struct bio *next_bio;
-	int ret = 0;
-
-	if (bio_chain == NULL)
-		return 0;
-
-	bio = *bio_chain;
-	if (bio == NULL)
-		return 0;
-	while (bio) {
-		struct page *page;
-
-		next_bio = bio->bi_private;
-		page = bio->bi_io_vec[0].bv_page;
-		wait_on_page_locked(page);
-		if (!PageUptodate(page) || PageError(page))
-			ret = -EIO;
-		put_page(page);
-		bio_put(bio);
-		bio = next_bio;
-	}
-	*bio_chain = NULL;
-	return ret;
+	struct hib_bio_batch sync;
+	int error;
+
+	if (hb)
+		return submit(WRITE, hib_resume_bdev,
+			      page_off * (PAGE_SIZE >> 9), virt_to_page(addr),
+			      hb);
+
+	/* The bio puts the page when done, and the caller keeps it. */
+	get_page(virt_to_page(addr));
+	hib_init_batch(&sync);
+	error = submit(WRITE, hib_resume_bdev, page_off * (PAGE_SIZE >> 9),
+		       virt_to_page(addr), &sync);
+	if (error)
+		put_page(virt_to_page(addr));
+	return hib_wait_io(&sync) ?: error;
 }
@@ -13,11 +13,15 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
-#include <linux/syscalls.h> /* sys_sync */
+#include <linux/seq_file.h>
+#include <linux/fs.h> /* sync_dirty_filesystems */
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
 
@@ -29,6 +33,8 @@ enum {
 };
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
+static int early_suspend_async = 1;
+module_param_named(async, early_suspend_async, bool, S_IRUGO | S_IWUSR | S_IWGRP);
 
 extern struct wake_lock sync_wake_lock;
 extern struct workqueue_struct *sync_work_queue;
@@ -38,6 +44,7 @@ static LIST_HEAD(early_suspend_handlers);
 static void sync_system(struct work_struct *work);
 static void early_suspend(struct work_struct *work);
 static void late_resume(struct work_struct *work);
+static void early_suspend_call(struct early_suspend *h, bool resume);
 static DECLARE_WORK(sync_system_work, sync_system);
 static DECLARE_WORK(early_suspend_work, early_suspend);
 static DECLARE_WORK(late_resume_work, late_resume);
@@ -48,14 +55,19 @@ enum {
 	SUSPEND_REQUESTED_AND_SUSPENDED = SUSPEND_REQUESTED | SUSPENDED,
 };
 static int state;
+static LIST_HEAD(early_suspend_async_domain);
+static u32 early_suspend_us;
+static u32 late_resume_us;
 
 static void sync_system(struct work_struct *work)
 {
+	int synced;
+
 	pr_info("%s +\n", __func__);
 	wake_lock(&sync_wake_lock);
-   	sys_sync();
+	synced = sync_dirty_filesystems();
 	wake_unlock(&sync_wake_lock);
-	pr_info("%s -\n", __func__);
+	pr_info("%s - %d synced\n", __func__, synced);
 }
 
 void register_early_suspend(struct early_suspend *handler)
@@ -70,8 +82,10 @@ void register_early_suspend(struct early_suspend *handler)
 			break;
 	}
 	list_add_tail(&handler->link, pos);
+	handler->suspend_us = handler->suspend_max_us = 0;
+	handler->resume_us = handler->resume_max_us = 0;
 	if ((state & SUSPENDED) && handler->suspend)
-		handler->suspend(handler);
+		early_suspend_call(handler, false);
 	mutex_unlock(&early_suspend_lock);
 }
 EXPORT_SYMBOL(register_early_suspend);
@@ -84,9 +98,94 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static void early_suspend_call(struct early_suspend *h, bool resume)
+{
+	ktime_t start = ktime_get();
+	u32 us;
+
+	if (resume)
+		h->resume(h);
+	else
+		h->suspend(h);
+	us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	if (resume) {
+		h->resume_us = us;
+		h->resume_max_us = max(h->resume_max_us, us);
+	} else {
+		h->suspend_us = us;
+		h->suspend_max_us = max(h->suspend_max_us, us);
+	}
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("%s: %pf took %u us\n",
+			resume ? "late_resume" : "early_suspend",
+			resume ? (void *)h->resume : (void *)h->suspend, us);
+}
+
+static void early_suspend_async_call(void *data, async_cookie_t cookie)
+{
+	early_suspend_call(data, false);
+}
+
+static void late_resume_async_call(void *data, async_cookie_t cookie)
+{
+	early_suspend_call(data, true);
+}
+
+static struct early_suspend *early_suspend_next(struct early_suspend *pos,
+						bool resume)
+{
+	struct list_head *next = resume ? pos->link.prev : pos->link.next;
+
+	return list_entry(next, struct early_suspend, link);
+}
+
+/*
+ * Run the suspend, or the resume, handlers one level at a time, in low to
+ * high level order for suspend and the opposite for resume.  Within a level
+ * the async handlers are started first and run alongside the others, which
+ * are called in order; all of them finish before the next level starts.
+ * Returns how long it all took, in microseconds.  Called with
+ * early_suspend_lock held.
+ */
+static u32 early_suspend_call_all(bool resume)
+{
+	struct list_head *head = &early_suspend_handlers;
+	struct early_suspend *first, *pos;
+	int async = early_suspend_async;
+	ktime_t start = ktime_get();
+
+	first = list_entry(resume ? head->prev : head->next,
+			   struct early_suspend, link);
+	while (&first->link != head) {
+		for (pos = first; &pos->link != head &&
+		     pos->level == first->level;
+		     pos = early_suspend_next(pos, resume)) {
+			if (!async || !pos->async)
+				continue;
+			if (resume && pos->resume)
+				async_schedule_domain(late_resume_async_call,
+					pos, &early_suspend_async_domain);
+			else if (!resume && pos->suspend)
+				async_schedule_domain(early_suspend_async_call,
+					pos, &early_suspend_async_domain);
+		}
+		for (pos = first; &pos->link != head &&
+		     pos->level == first->level;
+		     pos = early_suspend_next(pos, resume)) {
+			if (async && pos->async)
+				continue;
+			if (resume ? pos->resume : pos->suspend)
+				early_suspend_call(pos, resume);
+		}
+		async_synchronize_full_domain(&early_suspend_async_domain);
+		first = pos;
+	}
+	return ktime_to_us(ktime_sub(ktime_get(), start));
+}
+
 static void early_suspend(struct work_struct *work)
 {
-	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -107,14 +206,12 @@ static void early_suspend(struct work_struct *work)
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
-	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL)
-			pos->suspend(pos);
-	}
+	early_suspend_us = early_suspend_call_all(false);
 	mutex_unlock(&early_suspend_lock);
 
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("early_suspend: sync\n");
+		pr_info("early_suspend: handlers done in %u us, sync\n",
+			early_suspend_us);
 
 	/* sys_sync(); */
 	queue_work(sync_work_queue, &sync_system_work);
@@ -128,7 +225,6 @@ abort:
 
 static void late_resume(struct work_struct *work)
 {
-	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -147,11 +243,9 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
-	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
-		if (pos->resume != NULL)
-			pos->resume(pos);
+	late_resume_us = early_suspend_call_all(true);
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done in %u us\n", late_resume_us);
 abort:
 	mutex_unlock(&early_suspend_lock);
 }
@@ -192,3 +286,44 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int early_suspend_stats_show(struct seq_file *s, void *unused)
+{
+	struct early_suspend *pos;
+
+	mutex_lock(&early_suspend_lock);
+	seq_printf(s, "level async   suspend (us)    resume (us)  handler\n");
+	seq_printf(s, "               last    max    last    max\n");
+	list_for_each_entry(pos, &early_suspend_handlers, link)
+		seq_printf(s, "%5d %5s %7u %6u %7u %6u  %pf\n", pos->level,
+			   pos->async ? "yes" : "no", pos->suspend_us,
+			   pos->suspend_max_us, pos->resume_us,
+			   pos->resume_max_us, pos->suspend ?
+			   (void *)pos->suspend : (void *)pos->resume);
+	seq_printf(s, "last early_suspend %u us, late_resume %u us\n",
+		   early_suspend_us, late_resume_us);
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open		= early_suspend_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debugfs_init(void)
+{
+	debugfs_create_file("earlysuspend", S_IRUGO, NULL, NULL,
+			    &early_suspend_stats_fops);
+	return 0;
+}
+late_initcall(early_suspend_debugfs_init);
+#endif
@@ -23,6 +23,7 @@
 #include <linux/cpu.h>
 #include <linux/freezer.h>
 #include <linux/gfp.h>
+#include <linux/ktime.h>
 #include <scsi/scsi_scan.h>
 #include <asm/suspend.h>
 
@@ -30,6 +31,7 @@
 
 
 static int noresume = 0;
+static int nocompress = 1;
 static char resume_file[256] = CONFIG_PM_STD_PARTITION;
 dev_t swsusp_resume_device;
 sector_t swsusp_resume_block;
@@ -42,6 +44,7 @@ enum {
 	HIBERNATION_TESTPROC,
 	HIBERNATION_SHUTDOWN,
 	HIBERNATION_REBOOT,
+	HIBERNATION_TEST_RESUME,
 	/* keep last */
 	__HIBERNATION_AFTER_LAST
 };
@@ -203,6 +206,20 @@ static void platform_recover(int platform_mode)
 		hibernation_ops->recover();
 }
 
+/**
+ *	hibernation_show_time - print the time a phase of hibernation took.
+ *	@start: When the phase started.
+ *	@phase: What it was.
+ */
+
+static void hibernation_show_time(ktime_t start, const char *phase)
+{
+	s64 elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	printk(KERN_INFO "PM: %s took %lld msecs\n", phase,
+		div_s64(elapsed, NSEC_PER_MSEC));
+}
+
 /**
  *	swsusp_show_speed - print the time elapsed between two events.
  *	@start: Starting event.
@@ -593,6 +610,8 @@ static int prepare_processes(void)
 
 int hibernate(void)
 {
+	bool snapshot_test = false;
+	ktime_t start;
 	int error;
 
 	mutex_lock(&pm_mutex);
@@ -617,12 +636,16 @@ int hibernate(void)
 		goto Exit;
 
 	printk(KERN_INFO "PM: Syncing filesystems ... ");
+	start = ktime_get();
 	sys_sync();
 	printk("done.\n");
+	hibernation_show_time(start, "Syncing filesystems");
 
+	start = ktime_get();
 	error = prepare_processes();
 	if (error)
 		goto Finish;
+	hibernation_show_time(start, "Freezing tasks");
 
 	if (hibernation_test(TEST_FREEZER))
 		goto Thaw;
@@ -630,6 +653,7 @@ int hibernate(void)
 	if (hibernation_testmode(HIBERNATION_TESTPROC))
 		goto Thaw;
 
+	start = ktime_get();
 	error = hibernation_snapshot(hibernation_mode == HIBERNATION_PLATFORM);
 	if (error)
 		goto Thaw;
@@ -637,19 +661,47 @@ int hibernate(void)
 	if (in_suspend) {
 		unsigned int flags = 0;
 
+		hibernation_show_time(start, "Creating the image");
 		if (hibernation_mode == HIBERNATION_PLATFORM)
 			flags |= SF_PLATFORM_MODE;
+		if (nocompress)
+			flags |= SF_NOCOMPRESS_MODE;
 		pr_debug("PM: writing image.\n");
+		start = ktime_get();
 		error = swsusp_write(flags);
 		swsusp_free();
-		if (!error)
-			power_down();
+		if (!error) {
+			hibernation_show_time(start, "Writing the image");
+			if (hibernation_mode == HIBERNATION_TEST_RESUME)
+				snapshot_test = true;
+			else
+				power_down();
+		}
+		/* Not saved, so it is still 0 once the image is restored. */
+		in_suspend = 0;
 		pm_restore_gfp_mask();
 	} else {
 		pr_debug("PM: Image restored successfully.\n");
 	}
 
  Thaw:
+	if (snapshot_test) {
+		unsigned int flags;
+
+		pr_debug("PM: Checking hibernation image.\n");
+		start = ktime_get();
+		error = swsusp_check();
+		if (!error) {
+			error = swsusp_read(&flags);
+			swsusp_close(FMODE_READ);
+		}
+		if (!error) {
+			hibernation_show_time(start, "Reading the image");
+			error = hibernation_restore(flags & SF_PLATFORM_MODE);
+		}
+		printk(KERN_ERR "PM: Restoring the image failed: %d\n", error);
+		swsusp_free();
+	}
 	thaw_processes();
  Finish:
 	free_basic_memory_bitmaps();
@@ -680,6 +732,7 @@ static int software_resume(void)
 {
 	int error;
 	unsigned int flags;
+	ktime_t start;
 
 	/*
 	 * If the user said "noresume".. bail out early.
@@ -769,10 +822,13 @@ static int software_resume(void)
 
 	pr_debug("PM: Reading hibernation image.\n");
 
+	start = ktime_get();
 	error = swsusp_read(&flags);
 	swsusp_close(FMODE_READ);
-	if (!error)
+	if (!error) {
+		hibernation_show_time(start, "Reading the image");
 		hibernation_restore(flags & SF_PLATFORM_MODE);
+	}
 
 	printk(KERN_ERR "PM: Restore failed, recovering.\n");
 	swsusp_free();
@@ -803,6 +859,7 @@ static const char * const hibernation_modes[] = {
 	[HIBERNATION_REBOOT]	= "reboot",
 	[HIBERNATION_TEST]	= "test",
 	[HIBERNATION_TESTPROC]	= "testproc",
+	[HIBERNATION_TEST_RESUME]	= "test_resume",
 };
 
 /**
@@ -816,7 +873,8 @@ static const char * const hibernation_modes[] = {
  *	The system can support 'platform', and that is known a priori (and
  *	encoded by the presence of hibernation_ops). However, the user may
  *	choose 'shutdown' or 'reboot' as alternatives, as well as one fo the
- *	test modes, 'test' or 'testproc'.
+ *	test modes, 'test' or 'testproc', or 'test_resume', which writes the
+ *	image and then restores it right away, without powering down.
  *
  *	show() will display what the mode is currently set to.
  *	store() will accept one of
@@ -826,6 +884,7 @@ static const char * const hibernation_modes[] = {
  *	'reboot'
  *	'test'
  *	'testproc'
+ *	'test_resume'
  *
  *	It will only change to 'platform' if the system
  *	supports it (as determined by having hibernation_ops).
@@ -845,6 +904,7 @@ static ssize_t disk_show(struct kobject *kobj, struct kobj_attribute *attr,
 		case HIBERNATION_REBOOT:
 		case HIBERNATION_TEST:
 		case HIBERNATION_TESTPROC:
+		case HIBERNATION_TEST_RESUME:
 			break;
 		case HIBERNATION_PLATFORM:
 			if (hibernation_ops)
@@ -888,6 +948,7 @@ static ssize_t disk_store(struct kobject *kobj, struct kobj_attribute *attr,
 		case HIBERNATION_REBOOT:
 		case HIBERNATION_TEST:
 		case HIBERNATION_TESTPROC:
+		case HIBERNATION_TEST_RESUME:
 			hibernation_mode = mode;
 			break;
 		case HIBERNATION_PLATFORM:
@@ -1012,6 +1073,16 @@ static int __init noresume_setup(char *str)
 	return 1;
 }
 
+static int __init hibernate_setup(char *str)
+{
+	if (!strncmp(str, "compress", 8))
+		nocompress = 0;
+	else if (!strncmp(str, "nocompress", 10))
+		nocompress = 1;
+	return 1;
+}
+
 __setup("noresume", noresume_setup);
+__setup("hibernate=", hibernate_setup);
 __setup("resume_offset=", resume_offset_setup);
 __setup("resume=", resume_setup);
@@ -94,6 +94,36 @@ static ssize_t pm_async_store(struct kobject *kobj, struct kobj_attribute *attr,
 
 power_attr(pm_async);
 
+/*
+ * If set, devices with a driver and no children are suspended and resumed
+ * asynchronously even if their drivers have not asked for it.
+ */
+int pm_async_leaves_enabled = 1;
+
+static ssize_t pm_async_leaves_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", pm_async_leaves_enabled);
+}
+
+static ssize_t pm_async_leaves_store(struct kobject *kobj,
+				     struct kobj_attribute *attr,
+				     const char *buf, size_t n)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 10, &val))
+		return -EINVAL;
+
+	if (val > 1)
+		return -EINVAL;
+
+	pm_async_leaves_enabled = val;
+	return n;
+}
+
+power_attr(pm_async_leaves);
+
 #ifdef CONFIG_PM_DEBUG
 int pm_test_level = TEST_NONE;
 
@@ -127,34 +157,53 @@ static ssize_t pm_test_show(struct kobject *kobj, struct kobj_attribute *attr,
 	return (s - buf);
 }
 
+static int pm_test_parse(const char *buf, int len)
+{
+	const char * const *s;
+	int level;
+
+	level = TEST_FIRST;
+	for (s = &pm_tests[level]; level <= TEST_MAX; s++, level++)
+		if (*s && len == strlen(*s) && !strncmp(buf, *s, len))
+			return level;
+	return -EINVAL;
+}
+
 static ssize_t pm_test_store(struct kobject *kobj, struct kobj_attribute *attr,
 				const char *buf, size_t n)
 {
-	const char * const *s;
 	int level;
 	char *p;
 	int len;
-	int error = -EINVAL;
 
 	p = memchr(buf, '\n', n);
 	len = p ? p - buf : n;
 
-	mutex_lock(&pm_mutex);
-
-	level = TEST_FIRST;
-	for (s = &pm_tests[level]; level <= TEST_MAX; s++, level++)
-		if (*s && len == strlen(*s) && !strncmp(buf, *s, len)) {
-			pm_test_level = level;
-			error = 0;
-			break;
-		}
+	level = pm_test_parse(buf, len);
+	if (level < 0)
+		return level;
 
+	mutex_lock(&pm_mutex);
+	pm_test_level = level;
 	mutex_unlock(&pm_mutex);
 
-	return error ? error : n;
+	return n;
 }
 
 power_attr(pm_test);
+
+/* "pm_test=devices" sets the test level from boot, for test_suspend= runs. */
+static int __init pm_test_setup(char *str)
+{
+	int level = pm_test_parse(str, strlen(str));
+
+	if (level < 0)
+		printk(KERN_WARNING "PM: unknown pm_test level '%s'\n", str);
+	else
+		pm_test_level = level;
+	return 1;
+}
+__setup("pm_test=", pm_test_setup);
 #endif /* CONFIG_PM_DEBUG */
 
 #endif /* CONFIG_PM_SLEEP */
@@ -393,6 +442,7 @@ static struct attribute * g[] = {
 #endif
 #ifdef CONFIG_PM_SLEEP
 	&pm_async_attr.attr,
+	&pm_async_leaves_attr.attr,
 	&wakeup_count_attr.attr,
 #ifdef CONFIG_PM_DEBUG
 	&pm_test_attr.attr,
@@ -2,6 +2,7 @@
 #include <linux/suspend_ioctls.h>
 #include <linux/utsname.h>
 #include <linux/freezer.h>
+#include <linux/completion.h>
 
 struct swsusp_info {
 	struct new_utsname	uts;
@@ -105,7 +106,7 @@ struct snapshot_handle {
 					 */
 	int		sync_read;	/* Set to one to notify the caller of
 					 * snapshot_write_next() that it may
-					 * need to call wait_on_bio_chain()
+					 * need to call hib_wait_io()
 					 */
 };
 
@@ -134,6 +135,7 @@ extern int swsusp_swap_in_use(void);
  * the image header.
  */
 #define SF_PLATFORM_MODE	1
+#define SF_NOCOMPRESS_MODE	2
 
 /* kernel/power/hibernate.c */
 extern int swsusp_check(void);
@@ -145,11 +147,21 @@ extern void swsusp_close(fmode_t);
 /* kernel/power/block_io.c */
 extern struct block_device *hib_resume_bdev;
 
+/* Image I/O submitted together and waited for with hib_wait_io() */
+struct hib_bio_batch {
+	atomic_t		count;
+	struct completion	done;
+	int			error;
+	struct bio		*bio;	/* Being filled, not submitted yet */
+	int			rw;
+};
+
+extern void hib_init_batch(struct hib_bio_batch *hb);
+extern int hib_wait_io(struct hib_bio_batch *hb);
 extern int hib_bio_read_page(pgoff_t page_off, void *addr,
-		struct bio **bio_chain);
+		struct hib_bio_batch *hb);
 extern int hib_bio_write_page(pgoff_t page_off, void *addr,
-		struct bio **bio_chain);
-extern int hib_wait_on_bio_chain(struct bio **bio_chain);
+		struct hib_bio_batch *hb);
 
 struct timeval;
 /* kernel/power/swsusp.c */
@@ -32,11 +32,19 @@ static inline int freezeable(struct task_struct * p)
 	return 1;
 }
 
+/*
+ * Longest the freezer sleeps before looking again without being woken,
+ * for tasks that exit or stop instead of entering the refrigerator and
+ * for busy workqueues, which do not wake it.
+ */
+#define FREEZE_POLL	msecs_to_jiffies(10)
+
 static int try_to_freeze_tasks(bool sig_only)
 {
 	struct task_struct *g, *p;
 	unsigned long end_time;
-	unsigned int todo;
+	unsigned int todo, tasks;
+	int events;
 	bool wq_busy = false;
 	struct timeval start, end;
 	u64 elapsed_csecs64;
@@ -52,6 +60,7 @@ static int try_to_freeze_tasks(bool sig_only)
 
 	while (true) {
 		todo = 0;
+		events = atomic_read(&freezer_events);
 		read_lock(&tasklist_lock);
 		do_each_thread(g, p) {
 			if (frozen(p) || !freezeable(p))
@@ -71,6 +80,7 @@ static int try_to_freeze_tasks(bool sig_only)
 				todo++;
 		} while_each_thread(g, p);
 		read_unlock(&tasklist_lock);
+		tasks = todo;
 
 		if (!sig_only) {
 			wq_busy = freeze_workqueues_busy();
@@ -86,9 +96,15 @@ static int try_to_freeze_tasks(bool sig_only)
 
 		/*
 		 * We need to retry, but first give the freezing tasks some
-		 * time to enter the regrigerator.
+		 * time to enter the regrigerator.  Once all those counted
+		 * have, there is no point waiting any longer.
 		 */
-		msleep(10);
+		if (tasks)
+			wait_event_timeout(freezer_wait,
+				atomic_read(&freezer_events) - events >= tasks,
+				FREEZE_POLL);
+		else
+			schedule_timeout_uninterruptible(FREEZE_POLL);
 	}
 
 	do_gettimeofday(&end);
@@ -22,6 +22,10 @@
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "power.h"
 
@@ -37,6 +41,35 @@ int pm_prepare_console_access = 0;
 
 static struct platform_suspend_ops *suspend_ops;
 
+/*
+ * How long syncing and freezing took on each suspend attempt, counted in
+ * buckets of powers of two milliseconds: under 1 ms, under 2 ms, under 4 ms
+ * and so on, the last one taking all the rest.
+ */
+#define SUSPEND_HIST_BUCKETS	12
+
+struct suspend_hist {
+	unsigned int count[SUSPEND_HIST_BUCKETS];
+	u64 total_us;
+	u32 max_us;
+};
+
+static struct suspend_hist suspend_sync_hist;
+static struct suspend_hist suspend_freeze_hist;
+static unsigned int suspend_sync_skipped;
+
+static void suspend_hist_add(struct suspend_hist *hist, ktime_t start)
+{
+	u32 us = ktime_to_us(ktime_sub(ktime_get(), start));
+	unsigned int ms = us / USEC_PER_MSEC;
+
+	hist->count[min_t(unsigned int, ms ? fls(ms) : 0,
+			  SUSPEND_HIST_BUCKETS - 1)]++;
+	hist->total_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+}
+
 /**
  *	suspend_set_ops - Set the global suspend method table.
  *	@ops:	Pointer to ops structure.
@@ -89,6 +122,7 @@ static int suspend_test(int level)
  */
 static int suspend_prepare(void)
 {
+	ktime_t start;
 	int error;
 
 	if (!suspend_ops || !suspend_ops->enter)
@@ -106,7 +140,9 @@ static int suspend_prepare(void)
 	if (error)
 		goto Finish;
 
+	start = ktime_get();
 	error = suspend_freeze_processes();
+	suspend_hist_add(&suspend_freeze_hist, start);
 	if (!error)
 		return 0;
 
@@ -270,6 +306,7 @@ static void suspend_finish(void)
  */
 int enter_state(suspend_state_t state)
 {
+	ktime_t start;
 	int error;
 
 	if (!valid_state(state))
@@ -279,7 +316,10 @@ int enter_state(suspend_state_t state)
 		return -EBUSY;
 
 	printk(KERN_INFO "PM: Syncing filesystems ... ");
-	sys_sync();
+	start = ktime_get();
+	if (!sync_dirty_filesystems())
+		suspend_sync_skipped++;
+	suspend_hist_add(&suspend_sync_hist, start);
 	printk("done.\n");
 
 	pr_debug("PM: Preparing system for %s sleep\n", pm_states[state]);
@@ -315,3 +355,48 @@ int pm_suspend(suspend_state_t state)
 	return -EINVAL;
 }
 EXPORT_SYMBOL(pm_suspend);
+
+#ifdef CONFIG_DEBUG_FS
+static void suspend_hist_show(struct seq_file *s, const char *name,
+			      struct suspend_hist *hist)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < SUSPEND_HIST_BUCKETS; i++)
+		n += hist->count[i];
+	seq_printf(s, "%s: %u attempts, %llu us on average, %u us at most\n",
+		   name, n, n ? div_u64(hist->total_us, n) : 0, hist->max_us);
+	for (i = 0; i < SUSPEND_HIST_BUCKETS - 1; i++)
+		seq_printf(s, "  < %4u ms %8u\n", 1U << i, hist->count[i]);
+	seq_printf(s, "  >=%4u ms %8u\n", 1U << (i - 1), hist->count[i]);
+}
+
+static int suspend_prepare_show(struct seq_file *s, void *unused)
+{
+	suspend_hist_show(s, "sync", &suspend_sync_hist);
+	seq_printf(s, "  nothing to sync on %u\n", suspend_sync_skipped);
+	suspend_hist_show(s, "freeze", &suspend_freeze_hist);
+	return 0;
+}
+
+static int suspend_prepare_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_prepare_show, NULL);
+}
+
+static const struct file_operations suspend_prepare_fops = {
+	.open		= suspend_prepare_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init suspend_prepare_debugfs_init(void)
+{
+	debugfs_create_file("suspend_prepare", S_IRUGO, NULL, NULL,
+			    &suspend_prepare_fops);
+	return 0;
+}
+
+late_initcall(suspend_prepare_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
@@ -8,6 +8,9 @@
 
 #include <linux/init.h>
 #include <linux/rtc.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "power.h"
 
@@ -21,23 +24,63 @@
  */
 #define TEST_SUSPEND_SECONDS	10
 
-static unsigned long suspend_test_start_time;
+static ktime_t suspend_test_start_time;
+
+/*
+ * How long each timed phase took over all the suspends since boot, as read
+ * from /sys/kernel/debug/suspend_test.  With pm_test set to "devices" the
+ * system does not actually sleep, so many cycles can be timed in a row.
+ */
+struct suspend_test_phase {
+	const char	*label;
+	unsigned int	runs;
+	unsigned int	last_usecs;
+	unsigned int	min_usecs;
+	unsigned int	max_usecs;
+	u64		total_usecs;
+};
+
+static struct suspend_test_phase suspend_test_phases[] = {
+	{ .label = "suspend devices" },
+	{ .label = "resume devices" },
+};
+
+static void suspend_test_account(const char *label, unsigned int usecs)
+{
+	struct suspend_test_phase *p;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(suspend_test_phases); i++) {
+		p = &suspend_test_phases[i];
+		if (strcmp(p->label, label))
+			continue;
+		if (!p->runs || usecs < p->min_usecs)
+			p->min_usecs = usecs;
+		if (usecs > p->max_usecs)
+			p->max_usecs = usecs;
+		p->last_usecs = usecs;
+		p->total_usecs += usecs;
+		p->runs++;
+		break;
+	}
+}
 
 void suspend_test_start(void)
 {
-	/* FIXME Use better timebase than "jiffies", ideally a clocksource.
-	 * What we want is a hardware counter that will work correctly even
-	 * during the irqs-are-off stages of the suspend/resume cycle...
+	/* FIXME What we want is a hardware counter that will work correctly
+	 * even during the irqs-are-off stages of the suspend/resume cycle...
 	 */
-	suspend_test_start_time = jiffies;
+	suspend_test_start_time = ktime_get();
 }
 
 void suspend_test_finish(const char *label)
 {
-	long nj = jiffies - suspend_test_start_time;
-	unsigned msec;
+	unsigned int usecs, msec;
 
-	msec = jiffies_to_msecs(abs(nj));
+	usecs = ktime_to_us(ktime_sub(ktime_get(), suspend_test_start_time));
+	suspend_test_account(label, usecs);
+
+	msec = usecs / USEC_PER_MSEC;
 	pr_info("PM: %s took %d.%03d seconds\n", label,
 			msec / 1000, msec % 1000);
 
@@ -58,7 +101,7 @@ void suspend_test_finish(const char *label)
  * system.  RTCs wake alarms are a common self-contained mechanism.
  */
 
-static void __init test_wakealarm(struct rtc_device *rtc, suspend_state_t state)
+static int __init test_wakealarm(struct rtc_device *rtc, suspend_state_t state)
 {
 	static char err_readtime[] __initdata =
 		KERN_ERR "PM: can't read %s time, err %d\n";
@@ -77,7 +120,7 @@ static void __init test_wakealarm(struct rtc_device *rtc, suspend_state_t state)
 	status = rtc_read_time(rtc, &alm.time);
 	if (status < 0) {
 		printk(err_readtime, dev_name(&rtc->dev), status);
-		return;
+		return status;
 	}
 	rtc_tm_to_time(&alm.time, &now);
 
@@ -88,7 +131,7 @@ static void __init test_wakealarm(struct rtc_device *rtc, suspend_state_t state)
 	status = rtc_set_alarm(rtc, &alm);
 	if (status < 0) {
 		printk(err_wakealarm, dev_name(&rtc->dev), status);
-		return;
+		return status;
 	}
 
 	if (state == PM_SUSPEND_MEM) {
@@ -110,6 +153,7 @@ static void __init test_wakealarm(struct rtc_device *rtc, suspend_state_t state)
 	 */
 	alm.enabled = false;
 	rtc_set_alarm(rtc, &alm);
+	return status;
 }
 
 static int __init has_wakealarm(struct device *dev, void *name_ptr)
@@ -129,8 +173,12 @@ static int __init has_wakealarm(struct device *dev, void *name_ptr)
  * Kernel options like "test_suspend=mem" force suspend/resume sanity tests
  * at startup time.  They're normally disabled, for faster boot and because
  * we can't know which states really work on this particular system.
+ * "test_suspend=mem,20" does it 20 times and reports how long suspending and
+ * resuming devices took at best, on average and at worst.  With
+ * "pm_test=devices" as well, that is all each run does.
  */
 static suspend_state_t test_state __initdata = PM_SUSPEND_ON;
+static unsigned long test_runs __initdata = 1;
 
 static char warn_bad_state[] __initdata =
 	KERN_WARNING "PM: can't test '%s' suspend state\n";
@@ -138,9 +186,19 @@ static char warn_bad_state[] __initdata =
 static int __init setup_test_suspend(char *value)
 {
 	unsigned i;
+	char *runs;
 
 	/* "=mem" ==> "mem" */
 	value++;
+	runs = strchr(value, ',');
+	if (runs) {
+		*runs++ = '\0';
+		if (strict_strtoul(runs, 10, &test_runs) || !test_runs) {
+			printk(KERN_WARNING "PM: bad test_suspend run count "
+			       "'%s'\n", runs);
+			test_runs = 1;
+		}
+	}
 	for (i = 0; i < PM_SUSPEND_MAX; i++) {
 		if (!pm_states[i])
 			continue;
@@ -161,6 +219,10 @@ static int __init test_suspend(void)
 
 	char			*pony = NULL;
 	struct rtc_device	*rtc = NULL;
+	struct suspend_test_phase *p;
+	unsigned long		run;
+	unsigned int		avg;
+	int			i;
 
 	/* PM is initialized by now; is that state testable? */
 	if (test_state == PM_SUSPEND_ON)
@@ -180,9 +242,62 @@ static int __init test_suspend(void)
 	}
 
 	/* go for it */
-	test_wakealarm(rtc, test_state);
+	for (run = 0; run < test_runs; run++)
+		if (test_wakealarm(rtc, test_state) < 0)
+			break;
 	rtc_class_close(rtc);
+
+	for (i = 0; test_runs > 1 && i < ARRAY_SIZE(suspend_test_phases); i++) {
+		p = &suspend_test_phases[i];
+		if (!p->runs)
+			continue;
+		avg = div_u64(p->total_usecs, p->runs);
+		printk(KERN_INFO "PM: %s over %u runs: min %u.%03u, "
+		       "avg %u.%03u, max %u.%03u msecs\n", p->label, p->runs,
+		       p->min_usecs / 1000, p->min_usecs % 1000,
+		       avg / 1000, avg % 1000,
+		       p->max_usecs / 1000, p->max_usecs % 1000);
+	}
 done:
 	return 0;
 }
 late_initcall(test_suspend);
+
+#ifdef CONFIG_DEBUG_FS
+static int suspend_test_show(struct seq_file *s, void *unused)
+{
+	struct suspend_test_phase *p;
+	int i;
+
+	seq_printf(s, "%-16s %6s %10s %10s %10s %10s\n", "phase", "runs",
+		   "last_us", "min_us", "avg_us", "max_us");
+	for (i = 0; i < ARRAY_SIZE(suspend_test_phases); i++) {
+		p = &suspend_test_phases[i];
+		seq_printf(s, "%-16s %6u %10u %10u %10llu %10u\n", p->label,
+			   p->runs, p->last_usecs, p->min_usecs,
+			   p->runs ? div_u64(p->total_usecs, p->runs) : 0,
+			   p->max_usecs);
+	}
+	return 0;
+}
+
+static int suspend_test_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_test_show, NULL);
+}
+
+static const struct file_operations suspend_test_fops = {
+	.open		= suspend_test_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init suspend_test_debugfs_init(void)
+{
+	debugfs_create_file("suspend_test", S_IRUGO, NULL, NULL,
+			    &suspend_test_fops);
+	return 0;
+}
+late_initcall(suspend_test_debugfs_init);
+#endif
@@ -4,6 +4,11 @@
  * This file provides functions for reading the suspend image from
  * and writing it to a swap partition.
  *
+ * Hibernation needs ARCH_HIBERNATION_POSSIBLE, which ARM does not select, so
+ * on Tegra none of this is built.  The threaded LZO, bio batching and CRC
+ * paths can be tried on x86, with test_resume and swap on brd; until they
+ * have been, images are only compressed with hibernate=compress.
+ *
  * Copyright (C) 1998,2001-2005 Pavel Machek <pavel@ucw.cz>
  * Copyright (C) 2006 Rafael J. Wysocki <rjw@sisk.pl>
  *
@@ -24,6 +29,12 @@
 #include <linux/swapops.h>
 #include <linux/pm.h>
 #include <linux/slab.h>
+#include <linux/lzo.h>
+#include <linux/vmalloc.h>
+#include <linux/kthread.h>
+#include <linux/crc32.h>
+#include <linux/highmem.h>
+#include <linux/ktime.h>
 
 #include "power.h"
 
@@ -61,6 +72,7 @@ struct swap_map_handle {
 	sector_t cur_swap;
 	sector_t first_sector;
 	unsigned int k;
+	unsigned long reqd_free_pages;
 };
 
 struct swsusp_header {
@@ -236,29 +248,46 @@ static int swsusp_swap_check(void)
  *	write_page - Write one page to given swap location.
  *	@buf:		Address we're writing.
  *	@offset:	Offset of the swap page we're writing to.
- *	@bio_chain:	Link the next write BIO here
+ *	@hb:		Batch to add the write to, or NULL to wait for it
  */
 
-static int write_page(void *buf, sector_t offset, struct bio **bio_chain)
+static int write_page(void *buf, sector_t offset, struct hib_bio_batch *hb)
 {
 	void *src;
+	int ret;
 
 	if (!offset)
 		return -ENOSPC;
 
-	if (bio_chain) {
+	if (hb) {
 		src = (void *)__get_free_page(__GFP_WAIT | __GFP_HIGH);
+		if (!src) {
+			/* Let the copies already in flight go first. */
+			ret = hib_wait_io(hb);
+			if (ret)
+				return ret;
+			src = (void *)__get_free_page(__GFP_WAIT | __GFP_HIGH);
+		}
 		if (src) {
 			memcpy(src, buf, PAGE_SIZE);
 		} else {
 			WARN_ON_ONCE(1);
-			bio_chain = NULL;	/* Go synchronous */
+			hb = NULL;	/* Go synchronous */
 			src = buf;
 		}
 	} else {
 		src = buf;
 	}
-	return hib_bio_write_page(offset, src, bio_chain);
+	ret = hib_bio_write_page(offset, src, hb);
+	if (ret && hb)
+		free_page((unsigned long)src);
+	return ret;
+}
+
+/* Free lowmem that copies of pages being written may take half of. */
+static unsigned long reqd_free_pages(void)
+{
+	return (nr_free_pages() - nr_free_highpages()) / 2;
 }
 
 static void release_swap_writer(struct swap_map_handle *handle)
@@ -291,6 +320,7 @@ static int get_swap_writer(struct swap_map_handle *handle)
 	}
 	handle->k = 0;
 	handle->first_sector = handle->cur_swap;
+	handle->reqd_free_pages = reqd_free_pages();
 	return 0;
 err_rel:
 	release_swap_writer(handle);
@@ -300,7 +330,7 @@ err_close:
 }
 
 static int swap_write_page(struct swap_map_handle *handle, void *buf,
-				struct bio **bio_chain)
+				struct hib_bio_batch *hb)
 {
 	int error = 0;
 	sector_t offset;
@@ -308,25 +338,30 @@ static int swap_write_page(struct swap_map_handle *handle, void *buf,
 	if (!handle->cur)
 		return -EINVAL;
 	offset = alloc_swapdev_block(root_swap);
-	error = write_page(buf, offset, bio_chain);
+	error = write_page(buf, offset, hb);
 	if (error)
 		return error;
 	handle->cur->entries[handle->k++] = offset;
 	if (handle->k >= MAP_PAGE_ENTRIES) {
-		error = hib_wait_on_bio_chain(bio_chain);
-		if (error)
-			goto out;
 		offset = alloc_swapdev_block(root_swap);
 		if (!offset)
 			return -ENOSPC;
 		handle->cur->next_swap = offset;
-		error = write_page(handle->cur, handle->cur_swap, NULL);
+		/* Written from a copy, so the map page can be reused at once */
+		error = write_page(handle->cur, handle->cur_swap, hb);
 		if (error)
 			goto out;
 		memset(handle->cur, 0, PAGE_SIZE);
 		handle->cur_swap = offset;
 		handle->k = 0;
 	}
+	if (hb && nr_free_pages() - nr_free_highpages() <=
+		  handle->reqd_free_pages) {
+		error = hib_wait_io(hb);
+		if (error)
+			goto out;
+		handle->reqd_free_pages = reqd_free_pages();
+	}
  out:
 	return error;
 }
@@ -369,7 +404,7 @@ static int save_image(struct swap_map_handle *handle,
 	int ret;
 	int nr_pages;
 	int err2;
-	struct bio *bio;
+	struct hib_bio_batch hb;
 	struct timeval start;
 	struct timeval stop;
 
@@ -379,20 +414,258 @@ static int save_image(struct swap_map_handle *handle,
 	if (!m)
 		m = 1;
 	nr_pages = 0;
-	bio = NULL;
+	hib_init_batch(&hb);
 	do_gettimeofday(&start);
 	while (1) {
 		ret = snapshot_read_next(snapshot);
 		if (ret <= 0)
 			break;
-		ret = swap_write_page(handle, data_of(*snapshot), &bio);
+		ret = swap_write_page(handle, data_of(*snapshot), &hb);
 		if (ret)
 			break;
 		if (!(nr_pages % m))
 			printk(KERN_CONT "\b\b\b\b%3d%%", nr_pages / m);
 		nr_pages++;
 	}
-	err2 = hib_wait_on_bio_chain(&bio);
+	err2 = hib_wait_io(&hb);
+	do_gettimeofday(&stop);
+	if (!ret)
+		ret = err2;
+	if (!ret)
+		printk(KERN_CONT "\b\b\b\bdone\n");
+	else
+		printk(KERN_CONT "\n");
+	swsusp_show_speed(&start, &stop, nr_to_write, "Wrote");
+	return ret;
+}
+
+/*
+ * Unless SF_NOCOMPRESS_MODE is set, the image data is compressed with LZO
+ * LZO_UNC_PAGES pages at a time, by one thread per CPU up to LZO_THREADS.
+ * On the swap, each compressed block is preceded by a struct lzo_block and
+ * padded to whole pages.  The header carries a CRC32 of the uncompressed
+ * data, which the threads decompressing the block check it against.
+ */
+#define LZO_THREADS	4
+#define LZO_UNC_PAGES	32
+#define LZO_UNC_SIZE	(LZO_UNC_PAGES * PAGE_SIZE)
+#define LZO_HEADER	sizeof(struct lzo_block)
+#define LZO_CMP_PAGES	DIV_ROUND_UP(lzo1x_worst_compress(LZO_UNC_SIZE) + \
+				     LZO_HEADER, PAGE_SIZE)
+#define LZO_CMP_SIZE	(LZO_CMP_PAGES * PAGE_SIZE)
+
+struct lzo_block {
+	u32 cmp_len;		/* Bytes of compressed data that follow */
+	u32 unc_len;		/* Bytes they decompress to */
+	u32 crc32;		/* Of the uncompressed data */
+};
+
+struct lzo_data {
+	struct task_struct *thr;
+	wait_queue_head_t go;		/* Woken with ready set for a block */
+	wait_queue_head_t done;		/* Woken with stop set when done */
+	atomic_t ready;
+	atomic_t stop;
+	bool compress;
+	int ret;
+	size_t unc_len;
+	size_t cmp_len;
+	unsigned char unc[LZO_UNC_SIZE];
+	unsigned char cmp[LZO_CMP_SIZE];
+	unsigned char wrk[LZO1X_1_MEM_COMPRESS];
+};
+
+static int lzo_threadfn(void *data)
+{
+	struct lzo_data *d = data;
+	struct lzo_block *blk = (struct lzo_block *)d->cmp;
+
+	while (1) {
+		wait_event(d->go, atomic_read(&d->ready) ||
+				  kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+		atomic_set(&d->ready, 0);
+
+		if (d->compress) {
+			d->ret = lzo1x_1_compress(d->unc, d->unc_len,
+						  d->cmp + LZO_HEADER,
+						  &d->cmp_len, d->wrk);
+			blk->cmp_len = d->cmp_len;
+			blk->unc_len = d->unc_len;
+			blk->crc32 = crc32_le(~0, d->unc, d->unc_len);
+		} else {
+			d->unc_len = LZO_UNC_SIZE;
+			d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER,
+						       blk->cmp_len, d->unc,
+						       &d->unc_len);
+			if (!d->ret && (d->unc_len != blk->unc_len ||
+			    crc32_le(~0, d->unc, d->unc_len) != blk->crc32))
+				d->ret = -EIO;
+		}
+
+		atomic_set(&d->stop, 1);
+		wake_up(&d->done);
+	}
+	return 0;
+}
+
+static struct lzo_data *lzo_start_threads(int *nr_threads, bool compress)
+{
+	struct lzo_data *data;
+	int thr, nr;
+
+	nr = clamp_t(int, num_online_cpus(), 1, LZO_THREADS);
+	data = vmalloc(sizeof(*data) * nr);
+	if (!data)
+		return NULL;
+
+	for (thr = 0; thr < nr; thr++) {
+		struct lzo_data *d = &data[thr];
+
+		init_waitqueue_head(&d->go);
+		init_waitqueue_head(&d->done);
+		atomic_set(&d->ready, 0);
+		atomic_set(&d->stop, 0);
+		d->compress = compress;
+		d->thr = kthread_run(lzo_threadfn, d, "image_%s/%d",
+				     compress ? "compress" : "decompress", thr);
+		if (IS_ERR(d->thr))
+			break;
+	}
+	if (!thr) {
+		vfree(data);
+		return NULL;
+	}
+	*nr_threads = thr;
+	return data;
+}
+
+static void lzo_stop_threads(struct lzo_data *data, int nr_threads)
+{
+	int thr;
+
+	for (thr = 0; thr < nr_threads; thr++)
+		kthread_stop(data[thr].thr);
+	vfree(data);
+}
+
+static void lzo_start_block(struct lzo_data *d)
+{
+	atomic_set(&d->ready, 1);
+	wake_up(&d->go);
+}
+
+/* Wait for @d to be done with its block, adding the time to @wait_ns. */
+static int lzo_wait_block(struct lzo_data *d, s64 *wait_ns)
+{
+	ktime_t start = ktime_get();
+
+	wait_event(d->done, atomic_read(&d->stop));
+	atomic_set(&d->stop, 0);
+	*wait_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	return d->ret;
+}
+
+static int lzo_wait_io(struct hib_bio_batch *hb, s64 *wait_ns)
+{
+	ktime_t start = ktime_get();
+	int ret;
+
+	ret = hib_wait_io(hb);
+	*wait_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	return ret;
+}
+
+static void lzo_show_stats(const char *msg, unsigned int nr_pages,
+			   unsigned int nr_cmp_pages, int nr_threads,
+			   s64 thr_wait_ns, s64 io_wait_ns)
+{
+	printk(KERN_INFO "PM: %s %u pages as %u (%u%%) with %d threads, "
+		"%lld msecs waiting for them and %lld for I/O\n", msg,
+		nr_pages, nr_cmp_pages,
+		nr_pages ? nr_cmp_pages * 100 / nr_pages : 0, nr_threads,
+		div_s64(thr_wait_ns, NSEC_PER_MSEC),
+		div_s64(io_wait_ns, NSEC_PER_MSEC));
+}
+
+/**
+ *	save_image_lzo - save the suspend image data, compressed
+ *	@data, @nr_threads: threads from lzo_start_threads()
+ *
+ *	The threads compress a block each while the previous blocks are
+ *	being written.
+ */
+
+static int save_image_lzo(struct swap_map_handle *handle,
+			  struct snapshot_handle *snapshot,
+			  unsigned int nr_to_write,
+			  struct lzo_data *data, int nr_threads)
+{
+	struct hib_bio_batch hb;
+	struct timeval start;
+	struct timeval stop;
+	s64 thr_wait_ns = 0, io_wait_ns = 0;
+	unsigned int m, nr_pages = 0, nr_cmp_pages = 0;
+	size_t off, len;
+	int thr, run, ret = 0, err2;
+
+	printk(KERN_INFO "PM: Compressing and saving image data "
+		"(%u pages) ...     ", nr_to_write);
+	m = nr_to_write / 100;
+	if (!m)
+		m = 1;
+	hib_init_batch(&hb);
+	do_gettimeofday(&start);
+	for (;;) {
+		for (thr = 0; thr < nr_threads; thr++) {
+			struct lzo_data *d = &data[thr];
+
+			for (off = 0; off < LZO_UNC_SIZE; off += PAGE_SIZE) {
+				ret = snapshot_read_next(snapshot);
+				if (ret < 0)
+					goto out_finish;
+				if (!ret)
+					break;
+				memcpy(d->unc + off, data_of(*snapshot),
+				       PAGE_SIZE);
+				if (!(nr_pages % m))
+					printk(KERN_CONT "\b\b\b\b%3d%%",
+						nr_pages / m);
+				nr_pages++;
+			}
+			if (!off)
+				break;
+			d->unc_len = off;
+			lzo_start_block(d);
+		}
+		if (!thr)
+			break;
+
+		for (run = 0; run < thr; run++) {
+			struct lzo_data *d = &data[run];
+
+			ret = lzo_wait_block(d, &thr_wait_ns);
+			if (ret || !d->cmp_len ||
+			    d->cmp_len > lzo1x_worst_compress(d->unc_len)) {
+				printk(KERN_ERR "PM: LZO compression failed\n");
+				ret = -EIO;
+				goto out_finish;
+			}
+
+			len = LZO_HEADER + d->cmp_len;
+			for (off = 0; off < len; off += PAGE_SIZE) {
+				ret = swap_write_page(handle, d->cmp + off,
+						      &hb);
+				if (ret)
+					goto out_finish;
+				nr_cmp_pages++;
+			}
+		}
+	}
+
+out_finish:
+	err2 = lzo_wait_io(&hb, &io_wait_ns);
 	do_gettimeofday(&stop);
 	if (!ret)
 		ret = err2;
@@ -401,6 +674,8 @@ static int save_image(struct swap_map_handle *handle,
 	else
 		printk(KERN_CONT "\n");
 	swsusp_show_speed(&start, &stop, nr_to_write, "Wrote");
+	lzo_show_stats("Compressed", nr_pages, nr_cmp_pages, nr_threads,
+		       thr_wait_ns, io_wait_ns);
 	return ret;
 }
 
@@ -434,7 +709,9 @@ int swsusp_write(unsigned int flags)
 	struct swap_map_handle handle;
 	struct snapshot_handle snapshot;
 	struct swsusp_info *header;
+	struct lzo_data *data = NULL;
 	unsigned long pages;
+	int nr_threads;
 	int error;
 
 	pages = snapshot_get_image_size();
@@ -448,6 +725,14 @@ int swsusp_write(unsigned int flags)
 		error = -ENOSPC;
 		goto out_finish;
 	}
+	if (!(flags & SF_NOCOMPRESS_MODE)) {
+		data = lzo_start_threads(&nr_threads, true);
+		if (!data) {
+			printk(KERN_INFO "PM: No memory to compress the image, "
+				"saving it uncompressed\n");
+			flags |= SF_NOCOMPRESS_MODE;
+		}
+	}
 	memset(&snapshot, 0, sizeof(struct snapshot_handle));
 	error = snapshot_read_next(&snapshot);
 	if (error < PAGE_SIZE) {
@@ -458,9 +743,16 @@ int swsusp_write(unsigned int flags)
 	}
 	header = (struct swsusp_info *)data_of(snapshot);
 	error = swap_write_page(&handle, header, NULL);
-	if (!error)
-		error = save_image(&handle, &snapshot, pages - 1);
+	if (!error) {
+		if (data)
+			error = save_image_lzo(&handle, &snapshot, pages - 1,
+					       data, nr_threads);
+		else
+			error = save_image(&handle, &snapshot, pages - 1);
+	}
 out_finish:
+	if (data)
+		lzo_stop_threads(data, nr_threads);
 	error = swap_writer_finish(&handle, flags, error);
 	return error;
 }
@@ -501,7 +793,7 @@ static int get_swap_reader(struct swap_map_handle *handle,
 }
 
 static int swap_read_page(struct swap_map_handle *handle, void *buf,
-				struct bio **bio_chain)
+				struct hib_bio_batch *hb)
 {
 	sector_t offset;
 	int error;
@@ -511,16 +803,15 @@ static int swap_read_page(struct swap_map_handle *handle, void *buf,
 	offset = handle->cur->entries[handle->k];
 	if (!offset)
 		return -EFAULT;
-	error = hib_bio_read_page(offset, buf, bio_chain);
+	error = hib_bio_read_page(offset, buf, hb);
 	if (error)
 		return error;
 	if (++handle->k >= MAP_PAGE_ENTRIES) {
-		error = hib_wait_on_bio_chain(bio_chain);
 		handle->k = 0;
 		offset = handle->cur->next_swap;
 		if (!offset)
 			release_swap_reader(handle);
-		else if (!error)
+		else
 			error = hib_bio_read_page(offset, handle->cur, NULL);
 	}
 	return error;
@@ -547,7 +838,7 @@ static int load_image(struct swap_map_handle *handle,
 	int error = 0;
 	struct timeval start;
 	struct timeval stop;
-	struct bio *bio;
+	struct hib_bio_batch hb;
 	int err2;
 	unsigned nr_pages;
 
@@ -557,24 +848,24 @@ static int load_image(struct swap_map_handle *handle,
 	if (!m)
 		m = 1;
 	nr_pages = 0;
-	bio = NULL;
+	hib_init_batch(&hb);
 	do_gettimeofday(&start);
 	for ( ; ; ) {
 		error = snapshot_write_next(snapshot);
 		if (error <= 0)
 			break;
-		error = swap_read_page(handle, data_of(*snapshot), &bio);
+		error = swap_read_page(handle, data_of(*snapshot), &hb);
 		if (error)
 			break;
 		if (snapshot->sync_read)
-			error = hib_wait_on_bio_chain(&bio);
+			error = hib_wait_io(&hb);
 		if (error)
 			break;
 		if (!(nr_pages % m))
 			printk("\b\b\b\b%3d%%", nr_pages / m);
 		nr_pages++;
 	}
-	err2 = hib_wait_on_bio_chain(&bio);
+	err2 = hib_wait_io(&hb);
 	do_gettimeofday(&stop);
 	if (!error)
 		error = err2;
@@ -589,6 +880,179 @@ static int load_image(struct swap_map_handle *handle,
 	return error;
 }
 
+/**
+ *	load_image_lzo - load the compressed image using the swap map handle
+ *	@handle and the snapshot handle @snapshot
+ *	(assume there are @nr_to_read pages to load)
+ *
+ *	Compressed pages are read ahead into a ring twice as big as what the
+ *	threads take at a time, so the next blocks are on their way while the
+ *	threads decompress the current ones.
+ */
+
+static int load_image_lzo(struct swap_map_handle *handle,
+			  struct snapshot_handle *snapshot,
+			  unsigned int nr_to_read)
+{
+	struct hib_bio_batch hb;
+	struct timeval start;
+	struct timeval stop;
+	struct lzo_data *data;
+	struct lzo_block *blk;
+	unsigned char **page;
+	s64 thr_wait_ns = 0, io_wait_ns = 0;
+	unsigned int m, nr_pages = 0, nr_cmp_pages = 0;
+	unsigned int nr_ring, ring = 0, pg = 0, have = 0, asked = 0, need;
+	size_t off;
+	int thr, run, nr_threads, i, ret, err2, eof = 0;
+
+	data = lzo_start_threads(&nr_threads, false);
+	if (!data) {
+		printk(KERN_ERR "PM: No memory to decompress the image\n");
+		return -ENOMEM;
+	}
+
+	nr_ring = 2 * nr_threads * LZO_CMP_PAGES;
+	page = kzalloc(nr_ring * sizeof(*page), __GFP_WAIT | __GFP_HIGH);
+	if (!page) {
+		ret = -ENOMEM;
+		goto out_threads;
+	}
+	for (i = 0; i < nr_ring; i++) {
+		page[i] = (void *)__get_free_page(__GFP_WAIT | __GFP_HIGH);
+		if (!page[i])
+			break;
+	}
+	if (i < LZO_CMP_PAGES) {
+		printk(KERN_ERR "PM: No memory to read the image ahead\n");
+		ret = -ENOMEM;
+		goto out_ring;
+	}
+	nr_ring = i;
+
+	printk(KERN_INFO "PM: Loading and decompressing image data "
+		"(%u pages) ...     ", nr_to_read);
+	m = nr_to_read / 100;
+	if (!m)
+		m = 1;
+	hib_init_batch(&hb);
+	do_gettimeofday(&start);
+
+	ret = snapshot_write_next(snapshot);
+	if (ret <= 0)
+		goto out_finish;
+
+	for (;;) {
+		if (asked) {
+			ret = lzo_wait_io(&hb, &io_wait_ns);
+			if (ret)
+				goto out_finish;
+			have += asked;
+			asked = 0;
+		}
+
+		/* Hand each thread a whole block, if there is one. */
+		for (thr = 0; thr < nr_threads && have; thr++) {
+			blk = (struct lzo_block *)page[pg];
+			if (!blk->cmp_len || blk->cmp_len >
+			    lzo1x_worst_compress(LZO_UNC_SIZE) ||
+			    !blk->unc_len || blk->unc_len > LZO_UNC_SIZE ||
+			    blk->unc_len % PAGE_SIZE) {
+				printk(KERN_ERR "PM: Bad LZO block header\n");
+				ret = -EINVAL;
+				goto out_finish;
+			}
+			need = DIV_ROUND_UP(LZO_HEADER + blk->cmp_len,
+					    PAGE_SIZE);
+			if (need > have)
+				break;
+			for (off = 0; off < need * PAGE_SIZE;
+			     off += PAGE_SIZE) {
+				memcpy(data[thr].cmp + off, page[pg],
+				       PAGE_SIZE);
+				if (++pg >= nr_ring)
+					pg = 0;
+			}
+			have -= need;
+			nr_cmp_pages += need;
+			lzo_start_block(&data[thr]);
+		}
+
+		/* Read ahead into the pages just freed while they work. */
+		for (; !eof && have + asked < nr_ring; asked++) {
+			ret = swap_read_page(handle, page[ring], &hb);
+			if (ret) {
+				/* Nothing more was written, or an error? */
+				if (handle->cur &&
+				    handle->cur->entries[handle->k])
+					goto out_finish;
+				eof = 1;
+				break;
+			}
+			if (++ring >= nr_ring)
+				ring = 0;
+		}
+
+		if (!thr) {
+			if (eof && !asked) {
+				printk(KERN_ERR "PM: Image data ends "
+					"prematurely\n");
+				ret = -ENODATA;
+				goto out_finish;
+			}
+			continue;
+		}
+
+		for (run = 0; run < thr; run++) {
+			struct lzo_data *d = &data[run];
+
+			ret = lzo_wait_block(d, &thr_wait_ns);
+			if (ret) {
+				printk(KERN_ERR "PM: LZO decompression of "
+					"image data failed: %d\n", ret);
+				ret = -EIO;
+				goto out_finish;
+			}
+
+			for (off = 0; off < d->unc_len; off += PAGE_SIZE) {
+				memcpy(data_of(*snapshot), d->unc + off,
+				       PAGE_SIZE);
+				if (!(nr_pages % m))
+					printk("\b\b\b\b%3d%%", nr_pages / m);
+				nr_pages++;
+
+				ret = snapshot_write_next(snapshot);
+				if (ret <= 0)
+					goto out_finish;
+			}
+		}
+	}
+
+out_finish:
+	/* The ring may still be being read into. */
+	err2 = lzo_wait_io(&hb, &io_wait_ns);
+	do_gettimeofday(&stop);
+	if (!ret)
+		ret = err2;
+	if (!ret) {
+		printk("\b\b\b\bdone\n");
+		snapshot_write_finalize(snapshot);
+		if (!snapshot_image_loaded(snapshot))
+			ret = -ENODATA;
+	} else
+		printk("\n");
+	swsusp_show_speed(&start, &stop, nr_to_read, "Read");
+	lzo_show_stats("Decompressed", nr_pages, nr_cmp_pages, nr_threads,
+		       thr_wait_ns, io_wait_ns);
+out_ring:
+	for (i = 0; i < nr_ring && page[i]; i++)
+		free_page((unsigned long)page[i]);
+	kfree(page);
+out_threads:
+	lzo_stop_threads(data, nr_threads);
+	return ret;
+}
+
 /**
  *	swsusp_read - read the hibernation image.
  *	@flags_p: flags passed by the "frozen" kernel in the image header should
@@ -612,8 +1076,14 @@ int swsusp_read(unsigned int *flags_p)
 		goto end;
 	if (!error)
 		error = swap_read_page(&handle, header, NULL);
-	if (!error)
-		error = load_image(&handle, &snapshot, header->pages - 1);
+	if (!error) {
+		if (*flags_p & SF_NOCOMPRESS_MODE)
+			error = load_image(&handle, &snapshot,
+					   header->pages - 1);
+		else
+			error = load_image_lzo(&handle, &snapshot,
+					       header->pages - 1);
+	}
 	swap_reader_finish(&handle);
 end:
 	if (!error)
@@ -28,13 +28,13 @@
 #include <linux/init.h>
 #include <asm/atomic.h>
 #include "crc32defs.h"
-#if CRC_LE_BITS == 8
+#if CRC_LE_BITS > 4
 # define tole(x) __constant_cpu_to_le32(x)
 #else
 # define tole(x) (x)
 #endif
 
-#if CRC_BE_BITS == 8
+#if CRC_BE_BITS > 4
 # define tobe(x) __constant_cpu_to_be32(x)
 #else
 # define tobe(x) (x)
@@ -45,26 +45,48 @@ MODULE_AUTHOR("Matt Domsch <Matt_Domsch@dell.com>");
 MODULE_DESCRIPTION("Ethernet CRC32 calculations");
 MODULE_LICENSE("GPL");
 
-#if CRC_LE_BITS == 8 || CRC_BE_BITS == 8
+#ifdef CONFIG_CRC32_ARM
+asmlinkage u32 crc32_le_arm(u32 crc, unsigned char const *p, size_t len,
+			    const u32 (*tab)[256]);
+#endif
+
+#if CRC_LE_BITS > 4 || CRC_BE_BITS > 4
 
+/*
+ * Table driven crc over buf, @slices bytes a time: 1 for the classic
+ * Sarwate byte at a time loop, 4 or 8 for "slicing-by-4/8" where each
+ * byte of a word is looked up in its own table, so the lookups of a
+ * word are independent of each other and the crc is only folded once
+ * per word.  tab must have @slices rows; slices is always a constant,
+ * so the unused paths go away.
+ */
 static inline u32
-crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
+crc32_body(u32 crc, unsigned char const *buf, size_t len,
+	   const u32 (*tab)[256], const int slices)
 {
 # ifdef __LITTLE_ENDIAN
-#  define DO_CRC(x) crc = tab[0][(crc ^ (x)) & 255] ^ (crc >> 8)
-#  define DO_CRC4 crc = tab[3][(crc) & 255] ^ \
-		tab[2][(crc >> 8) & 255] ^ \
-		tab[1][(crc >> 16) & 255] ^ \
-		tab[0][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[(crc ^ (x)) & 255] ^ (crc >> 8)
+#  define DO_CRC4 (t3[(q) & 255] ^ t2[(q >> 8) & 255] ^ \
+		   t1[(q >> 16) & 255] ^ t0[(q >> 24) & 255])
+#  define DO_CRC8 (t7[(q) & 255] ^ t6[(q >> 8) & 255] ^ \
+		   t5[(q >> 16) & 255] ^ t4[(q >> 24) & 255])
 # else
-#  define DO_CRC(x) crc = tab[0][((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
-#  define DO_CRC4 crc = tab[0][(crc) & 255] ^ \
-		tab[1][(crc >> 8) & 255] ^ \
-		tab[2][(crc >> 16) & 255] ^ \
-		tab[3][(crc >> 24) & 255]
+#  define DO_CRC(x) crc = t0[((crc >> 24) ^ (x)) & 255] ^ (crc << 8)
+#  define DO_CRC4 (t0[(q) & 255] ^ t1[(q >> 8) & 255] ^ \
+		   t2[(q >> 16) & 255] ^ t3[(q >> 24) & 255])
+#  define DO_CRC8 (t4[(q) & 255] ^ t5[(q >> 8) & 255] ^ \
+		   t6[(q >> 16) & 255] ^ t7[(q >> 24) & 255])
 # endif
+	const u32 *t0 = tab[0];
 	const u32 *b;
 	size_t    rem_len;
+	u32 q;
+
+	if (slices == 1) {
+		while (len--)
+			DO_CRC(*buf++);
+		return crc;
+	}
 
 	/* Align it */
 	if (unlikely((long)buf & 3 && len)) {
@@ -72,14 +94,36 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 			DO_CRC(*buf++);
 		} while ((--len) && ((long)buf)&3);
 	}
-	rem_len = len & 3;
-	/* load data 32 bits wide, xor data 32 bits wide. */
-	len = len >> 2;
+
+	rem_len = len & (slices - 1);
+	len /= slices;
 	b = (const u32 *)buf;
-	for (--b; len; --len) {
-		crc ^= *++b; /* use pre increment for speed */
-		DO_CRC4;
+
+	if (slices == 4) {
+		const u32 *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+
+		/* load data 32 bits wide, xor data 32 bits wide. */
+		for (--b; len; --len) {
+			q = crc ^ *++b; /* use pre increment for speed */
+			crc = DO_CRC4;
+		}
+	} else {
+		const u32 *t1 = tab[1], *t2 = tab[2], *t3 = tab[3];
+		const u32 *t4 = tab[4], *t5 = tab[5], *t6 = tab[6];
+		const u32 *t7 = tab[7];
+
+		/*
+		 * Two words per iteration: the crc only goes into the first,
+		 * the second is looked up in parallel with it.
+		 */
+		for (--b; len; --len) {
+			q = crc ^ *++b;
+			crc = DO_CRC8;
+			q = *++b;
+			crc ^= DO_CRC4;
+		}
 	}
+
 	len = rem_len;
 	/* And the last few bytes */
 	if (len) {
@@ -91,62 +135,86 @@ crc32_body(u32 crc, unsigned char const *buf, size_t len, const u32 (*tab)[256])
 	return crc;
 #undef DO_CRC
 #undef DO_CRC4
+#undef DO_CRC8
 }
 #endif
+
 /**
- * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
- * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
- *	other uses, or the previous crc32 value if computing incrementally.
+ * crc32_le_generic() - Calculate bitwise little-endian crc32 of a polynomial
+ * @crc: seed value for computation.
  * @p: pointer to buffer over which CRC is run
  * @len: length of buffer @p
+ * @tab: little-endian table for the polynomial
+ * @polynomial: the bit-reversed polynomial, for the bitwise version
  */
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len);
-
-#if CRC_LE_BITS == 1
-/*
- * In fact, the table-based code will work in this case, but it can be
- * simplified by inlining the table in ?: form.
- */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+static inline u32 __pure crc32_le_generic(u32 crc, unsigned char const *p,
+					  size_t len, const u32 (*tab)[256],
+					  u32 polynomial)
 {
+#if CRC_LE_BITS == 1
+	/*
+	 * In fact, the table-based code will work in this case, but it can be
+	 * simplified by inlining the table in ?: form.
+	 */
 	int i;
 	while (len--) {
 		crc ^= *p++;
 		for (i = 0; i < 8; i++)
-			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+			crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
 	}
-	return crc;
-}
-#else				/* Table-based approach */
-
-u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
-{
-# if CRC_LE_BITS == 8
-	const u32      (*tab)[] = crc32table_le;
-
-	crc = __cpu_to_le32(crc);
-	crc = crc32_body(crc, p, len, tab);
-	return __le32_to_cpu(crc);
-# elif CRC_LE_BITS == 4
+#elif CRC_LE_BITS == 2
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
-		crc = (crc >> 4) ^ crc32table_le[crc & 15];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
+		crc = (crc >> 2) ^ tab[0][crc & 3];
 	}
-	return crc;
-# elif CRC_LE_BITS == 2
+#elif CRC_LE_BITS == 4
 	while (len--) {
 		crc ^= *p++;
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
-		crc = (crc >> 2) ^ crc32table_le[crc & 3];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
+		crc = (crc >> 4) ^ tab[0][crc & 15];
 	}
+#elif defined(CONFIG_CRC32_ARM)
+	crc = crc32_le_arm(crc, p, len, tab);
+#else
+	crc = __cpu_to_le32(crc);
+	crc = crc32_body(crc, p, len, tab, CRC_LE_BITS / 8);
+	crc = __le32_to_cpu(crc);
+#endif
 	return crc;
-# endif
 }
-#endif
+
+/**
+ * crc32_le() - Calculate bitwise little-endian Ethernet AUTODIN II CRC32
+ * @crc: seed value for computation.  ~0 for Ethernet, sometimes 0 for
+ *	other uses, or the previous crc32 value if computing incrementally.
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ */
+u32 __pure crc32_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len,
+				(const u32 (*)[256])crc32table_le, CRCPOLY_LE);
+}
+
+/**
+ * __crc32c_le() - Calculate bitwise little-endian Castagnoli CRC32c
+ * @crc: seed value for computation, ~0 for the usual users
+ * @p: pointer to buffer over which CRC is run
+ * @len: length of buffer @p
+ *
+ * The same as crc32_le() with the iSCSI/SCTP/ext4 polynomial; most users
+ * should go through the "crc32c" crypto API hash or libcrc32c, which end
+ * up here unless a hardware implementation is registered.
+ */
+u32 __pure __crc32c_le(u32 crc, unsigned char const *p, size_t len)
+{
+	return crc32_le_generic(crc, p, len,
+				(const u32 (*)[256])crc32ctable_le,
+				CRC32C_POLY_LE);
+}
 
 /**
  * crc32_be() - Calculate bitwise big-endian Ethernet AUTODIN II CRC32
@@ -179,26 +247,26 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 #else				/* Table-based approach */
 u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 {
-# if CRC_BE_BITS == 8
-	const u32      (*tab)[] = crc32table_be;
+# if CRC_BE_BITS > 4
+	const u32      (*tab)[256] = crc32table_be;
 
 	crc = __cpu_to_be32(crc);
-	crc = crc32_body(crc, p, len, tab);
+	crc = crc32_body(crc, p, len, tab, CRC_BE_BITS / 8);
 	return __be32_to_cpu(crc);
 # elif CRC_BE_BITS == 4
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
-		crc = (crc << 4) ^ crc32table_be[crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
+		crc = (crc << 4) ^ crc32table_be[0][crc >> 28];
 	}
 	return crc;
 # elif CRC_BE_BITS == 2
 	while (len--) {
 		crc ^= *p++ << 24;
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
-		crc = (crc << 2) ^ crc32table_be[crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
+		crc = (crc << 2) ^ crc32table_be[0][crc >> 30];
 	}
 	return crc;
 # endif
@@ -206,6 +274,7 @@ u32 __pure crc32_be(u32 crc, unsigned char const *p, size_t len)
 #endif
 
 EXPORT_SYMBOL(crc32_le);
+EXPORT_SYMBOL(__crc32c_le);
 EXPORT_SYMBOL(crc32_be);
 
 /*
@@ -0,0 +1,229 @@
+/*
+ * Self test and throughput benchmark for crc32_le(), crc32_be() and
+ * __crc32c_le().
+ *
+ * The test checks the check values of the three CRCs and compares them
+ * with a bit at a time reference over random data of every length up to
+ * 256 bytes and a few larger ones, at all alignments, in one piece and
+ * split in two.  The benchmark then runs each CRC, and the byte at a
+ * time Sarwate loop as the baseline, over buffers of each size in sizes
+ * until mbytes have been checksummed:
+ *
+ *	modprobe crc32_bench mbytes=64 sizes=64,512,4096,65536
+ *
+ * Results go to the kernel log; the module does not stay loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/crc32.h>
+#include "crc32defs.h"
+
+#define TEST_BUF_SIZE	4096
+
+static unsigned int mbytes = 32;
+module_param(mbytes, uint, 0);
+MODULE_PARM_DESC(mbytes, "megabytes to checksum per run");
+
+static unsigned int sizes[8] = { 64, 512, 4096, 65536 };
+static unsigned int nr_sizes = 4;
+module_param_array(sizes, uint, &nr_sizes, 0);
+MODULE_PARM_DESC(sizes, "buffer sizes to run");
+
+static u32 sarwate_table[256];
+
+static u32 crc32_le_bitwise(u32 crc, const u8 *p, size_t len, u32 poly)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? poly : 0);
+	}
+	return crc;
+}
+
+static u32 crc32_be_bitwise(u32 crc, const u8 *p, size_t len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *p++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^
+			      ((crc & 0x80000000) ? CRCPOLY_BE : 0);
+	}
+	return crc;
+}
+
+/* The one table, byte at a time loop crc32_le() used to be. */
+static u32 crc32_le_sarwate(u32 crc, const u8 *p, size_t len)
+{
+	while (len--)
+		crc = sarwate_table[(crc ^ *p++) & 255] ^ (crc >> 8);
+	return crc;
+}
+
+static u32 crc32c_le(u32 crc, const u8 *p, size_t len)
+{
+	return __crc32c_le(crc, p, len);
+}
+
+static u32 crc32_le_bit(u32 crc, const u8 *p, size_t len)
+{
+	return crc32_le_bitwise(crc, p, len, CRCPOLY_LE);
+}
+
+static u32 crc32c_le_bit(u32 crc, const u8 *p, size_t len)
+{
+	return crc32_le_bitwise(crc, p, len, CRC32C_POLY_LE);
+}
+
+static u32 crc32_le_lib(u32 crc, const u8 *p, size_t len)
+{
+	return crc32_le(crc, p, len);
+}
+
+static u32 crc32_be_lib(u32 crc, const u8 *p, size_t len)
+{
+	return crc32_be(crc, p, len);
+}
+
+static const struct crc_test {
+	const char *name;
+	u32 (*fn)(u32 crc, const u8 *p, size_t len);
+	u32 (*ref)(u32 crc, const u8 *p, size_t len);
+	u32 check;			/* of "123456789", seed and xor ~0 */
+} crc_tests[] = {
+	{ "crc32_le", crc32_le_lib, crc32_le_bit, 0xcbf43926 },
+	{ "crc32_be", crc32_be_lib, crc32_be_bitwise, 0xfc891918 },
+	{ "crc32c", crc32c_le, crc32c_le_bit, 0xe3069283 },
+};
+
+static int __init crc32_test_one(const struct crc_test *t, const u8 *buf)
+{
+	static const size_t big[] = { 511, 512, 1000, 1500, 4000 };
+	size_t len, off, i, split;
+	u32 seed, crc, ref;
+
+	crc = t->fn(~0, (const u8 *)"123456789", 9) ^ ~0;
+	if (crc != t->check) {
+		printk(KERN_ERR "crc32_bench: %s check value %08x, "
+		       "expected %08x\n", t->name, crc, t->check);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < 256 + ARRAY_SIZE(big); i++) {
+		len = i < 256 ? i : big[i - 256];
+		for (off = 0; off < 8; off++) {
+			seed = random32();
+			ref = t->ref(seed, buf + off, len);
+			crc = t->fn(seed, buf + off, len);
+			split = len ? random32() % len : 0;
+			if (crc == ref) {
+				crc = t->fn(seed, buf + off, split);
+				crc = t->fn(crc, buf + off + split,
+					    len - split);
+			}
+			if (crc != ref) {
+				printk(KERN_ERR "crc32_bench: %s of %zu bytes "
+				       "at offset %zu (split %zu) is %08x, "
+				       "expected %08x\n", t->name, len, off,
+				       split, crc, ref);
+				return -EINVAL;
+			}
+		}
+	}
+	return 0;
+}
+
+static void __init crc32_bench_one(const char *name,
+				   u32 (*fn)(u32 crc, const u8 *p, size_t len),
+				   const u8 *buf, size_t size)
+{
+	u64 total = (u64)mbytes << 20, done, ns;
+	ktime_t start;
+	u32 crc = ~0;
+
+	start = ktime_get();
+	for (done = 0; done < total; done += size) {
+		crc = fn(crc, buf, size);
+		if ((done & ((1 << 20) - 1)) < size)
+			cond_resched();
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (!ns)
+		ns = 1;
+
+	printk(KERN_INFO "crc32_bench: %-10s %6zu bytes: %llu MB/s, "
+	       "%llu ns/buffer (%08x)\n", name, size,
+	       div64_u64(done * NSEC_PER_SEC, ns << 20),
+	       div64_u64(ns * size, done), crc);
+}
+
+static int __init crc32_bench_init(void)
+{
+	size_t max = TEST_BUF_SIZE + 8;
+	unsigned int i, j;
+	u8 *buf;
+	int err = 0;
+
+	if (!mbytes)
+		return -EINVAL;
+	for (i = 0; i < nr_sizes; i++) {
+		if (!sizes[i] || sizes[i] > (16 << 20))
+			return -EINVAL;
+		max = max_t(size_t, max, sizes[i]);
+	}
+
+	buf = vmalloc(max);
+	if (!buf)
+		return -ENOMEM;
+	get_random_bytes(buf, max);
+
+	for (i = 0; i < 256; i++) {
+		u8 b = i;
+
+		sarwate_table[i] = crc32_le_bitwise(0, &b, 1, CRCPOLY_LE);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(crc_tests) && !err; i++)
+		err = crc32_test_one(&crc_tests[i], buf);
+	if (err)
+		goto out;
+	printk(KERN_INFO "crc32_bench: self test passed (%d bit tables)\n",
+	       CRC_LE_BITS);
+
+	for (i = 0; i < nr_sizes; i++) {
+		crc32_bench_one("sarwate", crc32_le_sarwate, buf, sizes[i]);
+		for (j = 0; j < ARRAY_SIZE(crc_tests); j++)
+			crc32_bench_one(crc_tests[j].name, crc_tests[j].fn,
+					buf, sizes[i]);
+	}
+
+	/* Nothing to keep loaded for. */
+	err = -EAGAIN;
+out:
+	vfree(buf);
+	return err;
+}
+
+static void __exit crc32_bench_exit(void)
+{
+}
+
+module_init(crc32_bench_init);
+module_exit(crc32_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("crc32 self test and throughput benchmark");
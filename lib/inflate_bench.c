@@ -0,0 +1,260 @@
+/*
+ * Decompression throughput benchmark for zlib_inflate().
+ *
+ * A corpus, by default the kernel's own text and otherwise the first
+ * corpus_kb of a file, is cut into blocks of each size in blocks (in KB)
+ * and each block is deflated on its own, with a zlib header, the way
+ * squashfs and cramfs store them.  Blocks that do not shrink are left out,
+ * as those filesystems store them uncompressed.  Every block is checked to
+ * inflate back to its contents, then all of them are inflated over and
+ * over until mbytes have come out:
+ *
+ *	modprobe inflate_bench file=/system/lib/libwebcore.so blocks=4,32,128
+ *
+ * Results go to the kernel log; the module does not stay loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/fs.h>
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/zlib.h>
+#include <asm/sections.h>
+
+static char *file;
+module_param(file, charp, 0);
+MODULE_PARM_DESC(file, "file to take the corpus from instead of kernel text");
+
+static unsigned int corpus_kb = 4096;
+module_param(corpus_kb, uint, 0);
+MODULE_PARM_DESC(corpus_kb, "largest corpus to use, in KB");
+
+static unsigned int blocks[8] = { 4, 32, 128 };
+static unsigned int nr_blocks = 3;
+module_param_array(blocks, uint, &nr_blocks, 0);
+MODULE_PARM_DESC(blocks, "block sizes to compress the corpus in, in KB");
+
+static unsigned int level = Z_BEST_COMPRESSION;
+module_param(level, uint, 0);
+MODULE_PARM_DESC(level, "deflate compression level");
+
+static unsigned int mbytes = 32;
+module_param(mbytes, uint, 0);
+MODULE_PARM_DESC(mbytes, "megabytes to inflate per block size");
+
+static struct z_stream_s inflate_bench_def, inflate_bench_inf;
+
+static void * __init inflate_bench_corpus(size_t *size)
+{
+	size_t max = (size_t)corpus_kb << 10;
+	struct file *filp;
+	void *buf;
+	int n;
+
+	if (!file) {
+		*size = min_t(size_t, max, _etext - _stext);
+		buf = vmalloc(*size);
+		if (buf)
+			memcpy(buf, _stext, *size);
+		return buf;
+	}
+
+	filp = filp_open(file, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return filp;
+	buf = vmalloc(max);
+	if (!buf) {
+		filp_close(filp, NULL);
+		return NULL;
+	}
+	n = kernel_read(filp, 0, buf, max);
+	filp_close(filp, NULL);
+	if (n <= 0) {
+		vfree(buf);
+		return ERR_PTR(n ? n : -EINVAL);
+	}
+	*size = n;
+	return buf;
+}
+
+/* Deflate len bytes of src to dst, returning the size, or 0 if no smaller. */
+static unsigned int __init inflate_bench_deflate(void *dst, const void *src,
+					  unsigned int len)
+{
+	struct z_stream_s *strm = &inflate_bench_def;
+	int ret;
+
+	if (zlib_deflateReset(strm) != Z_OK)
+		return 0;
+	strm->next_in = src;
+	strm->avail_in = len;
+	strm->next_out = dst;
+	strm->avail_out = len;
+	ret = zlib_deflate(strm, Z_FINISH);
+	if (ret != Z_STREAM_END)
+		return 0;
+	return strm->total_out;
+}
+
+static int __init inflate_bench_inflate(void *dst, unsigned int len,
+				 const void *src, unsigned int clen)
+{
+	struct z_stream_s *strm = &inflate_bench_inf;
+
+	if (zlib_inflateReset(strm) != Z_OK)
+		return -EINVAL;
+	strm->next_in = src;
+	strm->avail_in = clen;
+	strm->next_out = dst;
+	strm->avail_out = len;
+	if (zlib_inflate(strm, Z_FINISH) != Z_STREAM_END ||
+	    strm->total_out != len)
+		return -EINVAL;
+	return 0;
+}
+
+static int __init inflate_bench_one(const u8 *corpus, size_t size,
+				    unsigned int bsize)
+{
+	unsigned int nr = DIV_ROUND_UP(size, bsize), i, n = 0, len;
+	unsigned int *clens;
+	u8 *packed, *out;
+	u64 total = (u64)mbytes << 20, done = 0, in = 0, packed_in = 0, ns;
+	size_t pos;
+	ktime_t start;
+	int err = -ENOMEM;
+
+	clens = kcalloc(nr, sizeof(*clens), GFP_KERNEL);
+	packed = vmalloc(nr * bsize);
+	out = vmalloc(bsize);
+	if (!clens || !packed || !out)
+		goto out;
+
+	for (i = 0, pos = 0; i < nr; i++, pos += bsize) {
+		len = min_t(size_t, bsize, size - pos);
+		clens[i] = inflate_bench_deflate(packed + pos, corpus + pos,
+						 len);
+		if (clens[i]) {
+			n++;
+			in += len;
+			packed_in += clens[i];
+		}
+		cond_resched();
+	}
+	if (!n) {
+		printk(KERN_INFO "inflate_bench: %4uKB blocks: none "
+		       "compress\n", bsize >> 10);
+		err = 0;
+		goto out;
+	}
+
+	for (i = 0, pos = 0; i < nr; i++, pos += bsize) {
+		len = min_t(size_t, bsize, size - pos);
+		if (!clens[i])
+			continue;
+		err = inflate_bench_inflate(out, len, packed + pos, clens[i]);
+		if (!err && memcmp(out, corpus + pos, len))
+			err = -EINVAL;
+		if (err) {
+			printk(KERN_ERR "inflate_bench: %uKB block %u does "
+			       "not inflate back\n", bsize >> 10, i);
+			goto out;
+		}
+	}
+
+	start = ktime_get();
+	while (done < total) {
+		for (i = 0, pos = 0; i < nr; i++, pos += bsize) {
+			if (!clens[i])
+				continue;
+			len = min_t(size_t, bsize, size - pos);
+			inflate_bench_inflate(out, len, packed + pos, clens[i]);
+			done += len;
+		}
+		cond_resched();
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (!ns)
+		ns = 1;
+
+	printk(KERN_INFO "inflate_bench: %4uKB blocks: %u of %u compress "
+	       "to %llu%%, %llu MB/s, %llu us per block\n", bsize >> 10, n,
+	       nr, div64_u64(packed_in * 100, in),
+	       div64_u64(done * NSEC_PER_SEC, ns << 20),
+	       div64_u64(ns * in, done * n * NSEC_PER_USEC));
+	err = 0;
+out:
+	vfree(out);
+	vfree(packed);
+	kfree(clens);
+	return err;
+}
+
+static int __init inflate_bench_init(void)
+{
+	size_t size;
+	void *corpus;
+	unsigned int i;
+	int err;
+
+	if (!mbytes || !corpus_kb || level > Z_BEST_COMPRESSION)
+		return -EINVAL;
+	for (i = 0; i < nr_blocks; i++)
+		if (!blocks[i] || blocks[i] > 1024)
+			return -EINVAL;
+
+	corpus = inflate_bench_corpus(&size);
+	if (IS_ERR(corpus))
+		return PTR_ERR(corpus);
+	if (!corpus)
+		return -ENOMEM;
+	printk(KERN_INFO "inflate_bench: %zuKB of %s at level %u\n",
+	       size >> 10, file ? file : "kernel text", level);
+
+	err = -ENOMEM;
+	inflate_bench_def.workspace = vmalloc(zlib_deflate_workspacesize());
+	inflate_bench_inf.workspace = vmalloc(zlib_inflate_workspacesize());
+	if (!inflate_bench_def.workspace || !inflate_bench_inf.workspace)
+		goto out;
+
+	err = -EINVAL;
+	if (zlib_deflateInit2(&inflate_bench_def, level, Z_DEFLATED, MAX_WBITS,
+			      MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+		goto out;
+	if (zlib_inflateInit(&inflate_bench_inf) != Z_OK)
+		goto out_deflate;
+
+	for (i = 0, err = 0; i < nr_blocks && !err; i++)
+		err = inflate_bench_one(corpus, size, blocks[i] << 10);
+	if (!err)
+		/* Nothing to keep loaded for. */
+		err = -EAGAIN;
+
+	zlib_inflateEnd(&inflate_bench_inf);
+out_deflate:
+	zlib_deflateEnd(&inflate_bench_def);
+out:
+	vfree(inflate_bench_inf.workspace);
+	vfree(inflate_bench_def.workspace);
+	vfree(corpus);
+	return err;
+}
+
+static void __exit inflate_bench_exit(void)
+{
+}
+
+module_init(inflate_bench_init);
+module_exit(inflate_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("zlib_inflate() throughput benchmark");
@@ -24,8 +24,13 @@
 #define HAVE_OP(x, op_end, op) ((size_t)(op_end - op) < (x))
 #define HAVE_LB(m_pos, out, op) (m_pos < out || m_pos >= op)
 
-#define COPY4(dst, src)	\
-		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+/*
+ * Runs are copied eight bytes at a time when there is room to go up to
+ * seven bytes past their end, on both sides; the bytes written too many
+ * are overwritten by what follows.  Near the ends of the buffers they go
+ * four and then one at a time.
+ */
+#define OVERRUN		7
 
 int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 			unsigned char *out, size_t *out_len)
@@ -72,6 +77,21 @@ int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
 		if (HAVE_IP(t + 4, ip_end, ip))
 			goto input_overrun;
 
+		if (!HAVE_OP(t + 3 + OVERRUN, op_end, op) &&
+		    !HAVE_IP(t + 4 + OVERRUN, ip_end, ip)) {
+			const unsigned char *ie = ip + t + 3;
+			unsigned char *oe = op + t + 3;
+
+			do {
+				COPY8(op, ip);
+				op += 8;
+				ip += 8;
+			} while (ip < ie);
+			ip = ie;
+			op = oe;
+			goto first_literal_run;
+		}
+
 		COPY4(op, ip);
 		op += 4;
 		ip += 4;
@@ -99,6 +119,8 @@ first_literal_run:
 		t = *ip++;
 		if (t >= 16)
 			goto match;
+		if (HAVE_IP(1, ip_end, ip))
+			goto input_overrun;
 		m_pos = op - (1 + M2_MAX_OFFSET);
 		m_pos -= t >> 2;
 		m_pos -= *ip++ << 2;
@@ -117,6 +139,8 @@ first_literal_run:
 		do {
 match:
 			if (t >= 64) {
+				if (HAVE_IP(1, ip_end, ip))
+					goto input_overrun;
 				m_pos = op - 1;
 				m_pos -= (t >> 2) & 7;
 				m_pos -= *ip++ << 3;
@@ -125,7 +149,7 @@ match:
 					goto lookbehind_overrun;
 				if (HAVE_OP(t + 3 - 1, op_end, op))
 					goto output_overrun;
-				goto copy_match;
+				goto copy_match_words;
 			} else if (t >= 32) {
 				t &= 31;
 				if (t == 0) {
@@ -139,6 +163,8 @@ match:
 					}
 					t += 31 + *ip++;
 				}
+				if (HAVE_IP(2, ip_end, ip))
+					goto input_overrun;
 				m_pos = op - 1;
 				m_pos -= get_unaligned_le16(ip) >> 2;
 				ip += 2;
@@ -158,12 +184,16 @@ match:
 					}
 					t += 7 + *ip++;
 				}
+				if (HAVE_IP(2, ip_end, ip))
+					goto input_overrun;
 				m_pos -= get_unaligned_le16(ip) >> 2;
 				ip += 2;
 				if (m_pos == op)
 					goto eof_found;
 				m_pos -= 0x4000;
 			} else {
+				if (HAVE_IP(1, ip_end, ip))
+					goto input_overrun;
 				m_pos = op - 1;
 				m_pos -= t >> 2;
 				m_pos -= *ip++ << 2;
@@ -183,7 +213,19 @@ match:
 			if (HAVE_OP(t + 3 - 1, op_end, op))
 				goto output_overrun;
 
-			if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
+copy_match_words:
+			/* each word read must have been written already */
+			if (op - m_pos >= 8 &&
+			    !HAVE_OP(t + 3 - 1 + OVERRUN, op_end, op)) {
+				unsigned char *oe = op + t + 3 - 1;
+
+				do {
+					COPY8(op, m_pos);
+					op += 8;
+					m_pos += 8;
+				} while (op < oe);
+				op = oe;
+			} else if (t >= 2 * 4 - (3 - 1) && (op - m_pos) >= 4) {
 				COPY4(op, m_pos);
 				op += 4;
 				m_pos += 4;
@@ -199,7 +241,6 @@ match:
 						*op++ = *m_pos++;
 					} while (--t > 0);
 			} else {
-copy_match:
 				*op++ = *m_pos++;
 				*op++ = *m_pos++;
 				do {
@@ -11,6 +11,31 @@
  *  Richard Purdie <rpurdie@openedhand.com>
  */
 
+/*
+ * Unaligned word copies.  ARMv6 and later do them in hardware once
+ * alignment_init() has cleared the A bit, which the boot decompressor
+ * (STATIC) runs before; the ldr and str are spelled out so the compiler
+ * cannot pair them into an ldrd or ldm, which would still trap.
+ */
+#if defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6 && !defined(STATIC)
+#define COPY4(dst, src)							\
+	do {								\
+		u32 __w;						\
+		asm("ldr	%0, %1" : "=r" (__w)			\
+		    : "m" (*(const u32 *)(src)));			\
+		asm("str	%1, %0" : "=m" (*(u32 *)(dst))		\
+		    : "r" (__w));					\
+	} while (0)
+#else
+#define COPY4(dst, src)	\
+		put_unaligned(get_unaligned((const u32 *)(src)), (u32 *)(dst))
+#endif
+#define COPY8(dst, src)							\
+	do {								\
+		COPY4(dst, src);					\
+		COPY4((dst) + 4, (src) + 4);				\
+	} while (0)
+
 #define LZO_VERSION		0x2020
 #define LZO_VERSION_STRING	"2.02"
 #define LZO_VERSION_DATE	"Oct 17 2005"
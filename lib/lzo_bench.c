@@ -0,0 +1,204 @@
+/*
+ * Round trip test and throughput benchmark for lzo1x_1_compress() and
+ * lzo1x_decompress_safe().
+ *
+ * Three corpora, the kernel's own text, random bytes and zeroes, are cut
+ * into blocks of each size in sizes (in bytes).  Every block is
+ * compressed and checked to decompress back to itself, and to fail
+ * cleanly with one byte too little output space or input.  Then each
+ * corpus is compressed and decompressed over and over until mbytes have
+ * gone through:
+ *
+ *	modprobe lzo_bench sizes=4096,131072 mbytes=64
+ *
+ * Results go to the kernel log; the module does not stay loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/lzo.h>
+#include <asm/sections.h>
+
+#define CORPUS_SIZE	(1024 * 1024)
+
+static unsigned int sizes[8] = { PAGE_SIZE, 128 * 1024 };
+static unsigned int nr_sizes = 2;
+module_param_array(sizes, uint, &nr_sizes, 0);
+MODULE_PARM_DESC(sizes, "block sizes to run, in bytes");
+
+static unsigned int mbytes = 32;
+module_param(mbytes, uint, 0);
+MODULE_PARM_DESC(mbytes, "megabytes to compress and decompress per run");
+
+enum { LZO_BENCH_TEXT, LZO_BENCH_RANDOM, LZO_BENCH_ZERO, NR_LZO_BENCH };
+
+static const char *const lzo_bench_names[NR_LZO_BENCH] = {
+	[LZO_BENCH_TEXT]	= "kernel text",
+	[LZO_BENCH_RANDOM]	= "random",
+	[LZO_BENCH_ZERO]	= "zeroes",
+};
+
+static void __init lzo_bench_fill(u8 *buf, int corpus)
+{
+	size_t text = _etext - _stext, pos;
+
+	switch (corpus) {
+	case LZO_BENCH_TEXT:
+		for (pos = 0; pos < CORPUS_SIZE; pos += text)
+			memcpy(buf + pos, _stext, min(text, CORPUS_SIZE - pos));
+		break;
+	case LZO_BENCH_RANDOM:
+		get_random_bytes(buf, CORPUS_SIZE);
+		break;
+	default:
+		memset(buf, 0, CORPUS_SIZE);
+	}
+}
+
+/* Each block must come back, and must not with a byte too few. */
+static int __init lzo_bench_test(const u8 *src, size_t size, u8 *dst,
+				 u8 *out, void *wrkmem)
+{
+	size_t dst_len, out_len;
+	int ret;
+
+	ret = lzo1x_1_compress(src, size, dst, &dst_len, wrkmem);
+	if (ret != LZO_E_OK)
+		return ret;
+
+	out_len = size;
+	ret = lzo1x_decompress_safe(dst, dst_len, out, &out_len);
+	if (ret != LZO_E_OK || out_len != size || memcmp(out, src, size))
+		return ret != LZO_E_OK ? ret : -EINVAL;
+
+	out_len = size - 1;
+	ret = lzo1x_decompress_safe(dst, dst_len, out, &out_len);
+	if (ret != LZO_E_OUTPUT_OVERRUN)
+		return ret != LZO_E_OK ? ret : -EINVAL;
+
+	out_len = size;
+	ret = lzo1x_decompress_safe(dst, dst_len - 1, out, &out_len);
+	if (ret == LZO_E_OK)
+		return -EINVAL;
+	return LZO_E_OK;
+}
+
+static int __init lzo_bench_one(const u8 *corpus, int c, size_t size,
+				u8 *out, void *wrkmem)
+{
+	u64 total = (u64)mbytes << 20, done, packed = 0, comp_ns, decomp_ns;
+	size_t nr = CORPUS_SIZE / size, worst = lzo1x_worst_compress(size);
+	size_t i, out_len, *lens;
+	u8 *dst;
+	ktime_t start;
+	int ret = -ENOMEM;
+
+	lens = kcalloc(nr, sizeof(*lens), GFP_KERNEL);
+	dst = vmalloc(nr * worst);
+	if (!lens || !dst)
+		goto out;
+
+	for (i = 0; i < nr; i++) {
+		ret = lzo_bench_test(corpus + i * size, size, dst, out, wrkmem);
+		if (ret != LZO_E_OK) {
+			printk(KERN_ERR "lzo_bench: %s block %zu of %zu bytes "
+			       "does not round trip: %d\n", lzo_bench_names[c],
+			       i, size, ret);
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	start = ktime_get();
+	for (done = 0, i = 0; done < total; done += size) {
+		lzo1x_1_compress(corpus + i * size, size, dst + i * worst,
+				 &lens[i], wrkmem);
+		packed += lens[i];
+		if (++i == nr) {
+			i = 0;
+			cond_resched();
+		}
+	}
+	comp_ns = ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1;
+
+	start = ktime_get();
+	for (done = 0, i = 0; done < total; done += size) {
+		out_len = size;
+		lzo1x_decompress_safe(dst + i * worst, lens[i], out, &out_len);
+		if (++i == nr) {
+			i = 0;
+			cond_resched();
+		}
+	}
+	decomp_ns = ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1;
+
+	printk(KERN_INFO "lzo_bench: %-11s %6zu bytes: to %llu%%, compress "
+	       "%llu MB/s, decompress %llu MB/s\n", lzo_bench_names[c], size,
+	       div64_u64(packed * 100, done),
+	       div64_u64(done * NSEC_PER_SEC, comp_ns << 20),
+	       div64_u64(done * NSEC_PER_SEC, decomp_ns << 20));
+	ret = 0;
+out:
+	vfree(dst);
+	kfree(lens);
+	return ret;
+}
+
+static int __init lzo_bench_init(void)
+{
+	size_t max = 0;
+	u8 *corpus, *out;
+	void *wrkmem;
+	unsigned int i;
+	int c, err = -ENOMEM;
+
+	if (!mbytes)
+		return -EINVAL;
+	for (i = 0; i < nr_sizes; i++) {
+		if (sizes[i] < 2 || sizes[i] > CORPUS_SIZE)
+			return -EINVAL;
+		max = max_t(size_t, max, sizes[i]);
+	}
+
+	corpus = vmalloc(CORPUS_SIZE);
+	out = vmalloc(max);
+	wrkmem = vmalloc(LZO1X_MEM_COMPRESS);
+	if (!corpus || !out || !wrkmem)
+		goto out;
+
+	for (c = 0, err = 0; c < NR_LZO_BENCH && !err; c++) {
+		lzo_bench_fill(corpus, c);
+		for (i = 0; i < nr_sizes && !err; i++)
+			err = lzo_bench_one(corpus, c, sizes[i], out, wrkmem);
+	}
+	if (!err) {
+		printk(KERN_INFO "lzo_bench: round trip tests passed\n");
+		/* Nothing to keep loaded for. */
+		err = -EAGAIN;
+	}
+out:
+	vfree(wrkmem);
+	vfree(out);
+	vfree(corpus);
+	return err;
+}
+
+static void __exit lzo_bench_exit(void)
+{
+}
+
+module_init(lzo_bench_init);
+module_exit(lzo_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZO round trip test and benchmark");
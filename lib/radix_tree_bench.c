@@ -0,0 +1,361 @@
+/*
+ * Radix tree lookup benchmark and tree_lock hold times under contention.
+ *
+ * A tree of nr_items entries, every eighth one tagged, is set up the way
+ * the pagecache keeps a file: atomic node allocations after a preload,
+ * and changes under an irq-safe spinlock standing in for tree_lock.  The
+ * cost of radix_tree_lookup(), of radix_tree_gang_lookup() and of
+ * radix_tree_gang_lookup_tag() a pagevec at a time is measured over the
+ * whole tree.
+ *
+ * Then, for each size in batches, readers threads look up, gang look up
+ * and tag look up random indices under RCU for ms milliseconds while
+ * writers threads insert and tag that many neighbouring entries under one
+ * hold of the lock and delete them again under another, as readahead and
+ * truncate do with add_to_page_cache_lru_pagevec() and
+ * remove_from_page_cache_pagevec():
+ *
+ *	modprobe radix_tree_bench nr_items=65536 readers=1 writers=1 batches=1,14
+ *
+ * Results go to the kernel log; the module does not stay loaded.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/delay.h>
+#include <linux/spinlock.h>
+#include <linux/rcupdate.h>
+#include <linux/radix-tree.h>
+#include <linux/pagevec.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+
+#define RTB_TAG		0
+#define RTB_MAX_BATCH	64
+#define RTB_MAX_THREADS	8
+
+static unsigned int nr_items = 16384;
+module_param(nr_items, uint, 0);
+MODULE_PARM_DESC(nr_items, "entries in the tree");
+
+static unsigned int readers = 1;
+module_param(readers, uint, 0);
+MODULE_PARM_DESC(readers, "concurrent lookup threads");
+
+static unsigned int writers = 1;
+module_param(writers, uint, 0);
+MODULE_PARM_DESC(writers, "concurrent insert and delete threads");
+
+static unsigned int ms = 1000;
+module_param(ms, uint, 0);
+MODULE_PARM_DESC(ms, "milliseconds to run each batch size for");
+
+static unsigned int batches[8] = { 1, PAGEVEC_SIZE };
+static unsigned int nr_batches = 2;
+module_param_array(batches, uint, &nr_batches, 0);
+MODULE_PARM_DESC(batches, "entries inserted or deleted per lock hold");
+
+static RADIX_TREE(rtb_tree, GFP_ATOMIC);
+static DEFINE_SPINLOCK(rtb_lock);
+static unsigned long *rtb_items;
+
+struct rtb_thread {
+	struct task_struct *task;
+	unsigned long base;		/* first index, for writers */
+	unsigned int batch;
+	u64 ops;
+	u64 holds;
+	u64 hold_ns;
+	u64 hold_max;
+};
+
+static struct rtb_thread rtb_threads[2 * RTB_MAX_THREADS];
+
+static unsigned long rtb_span(void)
+{
+	return nr_items + writers * RTB_MAX_BATCH;
+}
+
+static void *rtb_item(unsigned long index)
+{
+	return &rtb_items[index];
+}
+
+static void rtb_account_hold(struct rtb_thread *t, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	t->holds++;
+	t->hold_ns += ns;
+	if (ns > t->hold_max)
+		t->hold_max = ns;
+}
+
+static int rtb_reader(void *data)
+{
+	struct rtb_thread *t = data;
+	void *results[PAGEVEC_SIZE];
+	unsigned long index;
+
+	while (!kthread_should_stop()) {
+		index = random32() % rtb_span();
+		rcu_read_lock();
+		radix_tree_lookup(&rtb_tree, index);
+		radix_tree_gang_lookup(&rtb_tree, results, index,
+				       PAGEVEC_SIZE);
+		radix_tree_gang_lookup_tag(&rtb_tree, results, index,
+					   PAGEVEC_SIZE, RTB_TAG);
+		rcu_read_unlock();
+		t->ops += 3;
+		cond_resched();
+	}
+	return 0;
+}
+
+static int rtb_writer(void *data)
+{
+	struct rtb_thread *t = data;
+	unsigned long index;
+	ktime_t start;
+	int err = 0;
+
+	while (!kthread_should_stop()) {
+		if (radix_tree_preload(GFP_KERNEL)) {
+			cond_resched();
+			continue;
+		}
+		spin_lock_irq(&rtb_lock);
+		start = ktime_get();
+		for (index = t->base; index < t->base + t->batch; index++) {
+			err = radix_tree_insert(&rtb_tree, index,
+						rtb_item(index));
+			if (err)
+				break;
+			radix_tree_tag_set(&rtb_tree, index, RTB_TAG);
+		}
+		rtb_account_hold(t, start);
+		spin_unlock_irq(&rtb_lock);
+		radix_tree_preload_end();
+
+		spin_lock_irq(&rtb_lock);
+		start = ktime_get();
+		for (index = t->base; index < t->base + t->batch; index++)
+			radix_tree_delete(&rtb_tree, index);
+		rtb_account_hold(t, start);
+		spin_unlock_irq(&rtb_lock);
+
+		if (!err)
+			t->ops += t->batch;
+		cond_resched();
+	}
+	return 0;
+}
+
+/* Lookups with nobody else about, in ns per entry. */
+static int __init rtb_lookup_bench(void)
+{
+	void *results[PAGEVEC_SIZE];
+	unsigned long index, found;
+	u64 lookup, gang, tag;
+	unsigned int nr, i;
+	ktime_t start;
+
+	start = ktime_get();
+	rcu_read_lock();
+	for (index = 0; index < nr_items; index++) {
+		if (radix_tree_lookup(&rtb_tree, index) != rtb_item(index)) {
+			rcu_read_unlock();
+			printk(KERN_ERR "radix_tree_bench: lookup of %lu "
+			       "failed\n", index);
+			return -EINVAL;
+		}
+	}
+	rcu_read_unlock();
+	lookup = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	found = 0;
+	index = 0;
+	start = ktime_get();
+	rcu_read_lock();
+	while ((nr = radix_tree_gang_lookup(&rtb_tree, results, index,
+					    PAGEVEC_SIZE))) {
+		found += nr;
+		index = (unsigned long *)results[nr - 1] - rtb_items + 1;
+	}
+	rcu_read_unlock();
+	gang = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (found != nr_items) {
+		printk(KERN_ERR "radix_tree_bench: gang lookup found %lu of %u "
+		       "entries\n", found, nr_items);
+		return -EINVAL;
+	}
+
+	found = 0;
+	index = 0;
+	start = ktime_get();
+	rcu_read_lock();
+	while ((nr = radix_tree_gang_lookup_tag(&rtb_tree, results, index,
+						PAGEVEC_SIZE, RTB_TAG))) {
+		for (i = 0; i < nr; i++)
+			if (((unsigned long *)results[i] - rtb_items) % 8)
+				break;
+		if (i < nr) {
+			rcu_read_unlock();
+			printk(KERN_ERR "radix_tree_bench: tag lookup found an "
+			       "untagged entry\n");
+			return -EINVAL;
+		}
+		found += nr;
+		index = (unsigned long *)results[nr - 1] - rtb_items + 1;
+	}
+	rcu_read_unlock();
+	tag = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (found != DIV_ROUND_UP(nr_items, 8)) {
+		printk(KERN_ERR "radix_tree_bench: tag lookup found %lu of %u "
+		       "entries\n", found, DIV_ROUND_UP(nr_items, 8));
+		return -EINVAL;
+	}
+
+	printk(KERN_INFO "radix_tree_bench: %u entries: lookup %llu ns, "
+	       "gang lookup %llu ns, tag lookup %llu ns per entry\n",
+	       nr_items, div64_u64(lookup, nr_items),
+	       div64_u64(gang, nr_items), div64_u64(tag, found));
+	return 0;
+}
+
+static void __init rtb_stop(unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		kthread_stop(rtb_threads[i].task);
+}
+
+/* Readers and writers together, with batch entries per lock hold. */
+static int __init rtb_contended_bench(unsigned int batch)
+{
+	u64 reads = 0, writes = 0, holds = 0, hold_ns = 0, hold_max = 0;
+	struct rtb_thread *t;
+	unsigned int i;
+
+	memset(rtb_threads, 0, sizeof(rtb_threads));
+	for (i = 0; i < readers + writers; i++) {
+		t = &rtb_threads[i];
+		if (i < readers) {
+			t->task = kthread_run(rtb_reader, t, "rtb_reader/%u", i);
+		} else {
+			t->base = nr_items + (i - readers) * RTB_MAX_BATCH;
+			t->batch = batch;
+			t->task = kthread_run(rtb_writer, t, "rtb_writer/%u",
+					      i - readers);
+		}
+		if (IS_ERR(t->task)) {
+			int err = PTR_ERR(t->task);
+
+			rtb_stop(i);
+			return err;
+		}
+	}
+
+	msleep(ms);
+	rtb_stop(readers + writers);
+
+	for (i = 0; i < readers + writers; i++) {
+		t = &rtb_threads[i];
+		if (i < readers) {
+			reads += t->ops;
+			continue;
+		}
+		writes += t->ops;
+		holds += t->holds;
+		hold_ns += t->hold_ns;
+		if (t->hold_max > hold_max)
+			hold_max = t->hold_max;
+	}
+
+	printk(KERN_INFO "radix_tree_bench: batch %2u: %llu lookups/s, "
+	       "%llu entries/s in and out, lock held %llu ns on average, "
+	       "%llu ns at most\n", batch, div64_u64(reads * MSEC_PER_SEC, ms),
+	       div64_u64(writes * MSEC_PER_SEC, ms),
+	       holds ? div64_u64(hold_ns, holds) : 0, hold_max);
+	return 0;
+}
+
+static void __init rtb_empty(void)
+{
+	unsigned long index;
+
+	for (index = 0; index < rtb_span(); index++) {
+		spin_lock_irq(&rtb_lock);
+		radix_tree_delete(&rtb_tree, index);
+		spin_unlock_irq(&rtb_lock);
+		if (!(index % 1024))
+			cond_resched();
+	}
+}
+
+static int __init radix_tree_bench_init(void)
+{
+	unsigned long index;
+	unsigned int i;
+	int err = 0;
+
+	if (!nr_items || !ms || readers > RTB_MAX_THREADS ||
+	    writers > RTB_MAX_THREADS)
+		return -EINVAL;
+	for (i = 0; i < nr_batches; i++)
+		if (!batches[i] || batches[i] > RTB_MAX_BATCH)
+			return -EINVAL;
+
+	rtb_items = vmalloc(rtb_span() * sizeof(*rtb_items));
+	if (!rtb_items)
+		return -ENOMEM;
+
+	for (index = 0; index < nr_items && !err; index++) {
+		err = radix_tree_preload(GFP_KERNEL);
+		if (err)
+			break;
+		spin_lock_irq(&rtb_lock);
+		err = radix_tree_insert(&rtb_tree, index, rtb_item(index));
+		if (!err && !(index % 8))
+			radix_tree_tag_set(&rtb_tree, index, RTB_TAG);
+		spin_unlock_irq(&rtb_lock);
+		radix_tree_preload_end();
+		if (!(index % 1024))
+			cond_resched();
+	}
+	if (err)
+		goto out;
+
+	err = rtb_lookup_bench();
+	for (i = 0; i < nr_batches && !err; i++)
+		err = rtb_contended_bench(batches[i]);
+	if (err)
+		goto out;
+
+	/* Nothing to keep loaded for. */
+	err = -EAGAIN;
+out:
+	rtb_empty();
+	synchronize_rcu();
+	vfree(rtb_items);
+	return err;
+}
+
+static void __exit radix_tree_bench_exit(void)
+{
+}
+
+module_init(radix_tree_bench_init);
+module_exit(radix_tree_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("radix tree lookup and tree_lock hold time benchmark");
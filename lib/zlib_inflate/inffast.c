@@ -4,50 +4,59 @@
  */
 
 #include <linux/zutil.h>
+#include <asm/unaligned.h>
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
 
 #ifndef ASMINF
 
-/* Allow machine dependent optimization for post-increment or pre-increment.
-   Based on testing to date,
-   Pre-increment preferred for:
-   - PowerPC G3 (Adler)
-   - MIPS R5000 (Randers-Pehrson)
-   Post-increment preferred for:
-   - none
-   No measurable difference:
-   - Pentium III (Anderson)
-   - M68060 (Nikl)
+/*
+ * Input is taken a word at a time and matches are copied a word at a
+ * time.  ARMv6 and later load and store unaligned words in hardware once
+ * alignment_init() has cleared the A bit, which is before anything but the
+ * boot decompressor (STATIC) inflates.  As in lib/lzo, the ldr and str are
+ * spelled out there so the compiler cannot pair them into an ldrd or ldm,
+ * which would still trap.  Elsewhere get_unaligned() and put_unaligned()
+ * know best, and are plain loads and stores where that is safe.
  */
-union uu {
-	unsigned short us;
-	unsigned char b[2];
-};
-
-/* Endian independed version */
-static inline unsigned short
-get_unaligned16(const unsigned short *p)
+#if defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6 && !defined(STATIC)
+static inline u32 load_word(const void *p)
 {
-	union uu  mm;
-	unsigned char *b = (unsigned char *)p;
+    u32 w;
 
-	mm.b[0] = b[0];
-	mm.b[1] = b[1];
-	return mm.us;
+    asm("ldr\t%0, %1" : "=r" (w) : "m" (*(const u32 *)p));
+    return w;
 }
 
-#ifdef POSTINC
-#  define OFF 0
-#  define PUP(a) *(a)++
-#  define UP_UNALIGNED(a) get_unaligned16((a)++)
+static inline void store_word(void *p, u32 w)
+{
+    asm("str\t%1, %0" : "=m" (*(u32 *)p) : "r" (w));
+}
+
+#  define LOAD_LE32(p) le32_to_cpu((__force __le32)load_word(p))
+#  define STORE_WORD(p, v) store_word(p, v)
+#  define COPY_WORD(to, from) store_word(to, load_word(from))
 #else
-#  define OFF 1
-#  define PUP(a) *++(a)
-#  define UP_UNALIGNED(a) get_unaligned16(++(a))
+#  define LOAD_LE32(p) get_unaligned_le32(p)
+#  define STORE_WORD(p, v) put_unaligned((u32)(v), (u32 *)(p))
+#  define COPY_WORD(to, from) \
+    put_unaligned(get_unaligned((const u32 *)(from)), (u32 *)(to))
 #endif
 
+/*
+ * Top up hold to at least 24 bits with a single load, whatever bits is.
+ * The bits of the word past those counted are ORed in again, at the same
+ * place, by the next refill, and are masked off when inflate_fast()
+ * returns.
+ */
+#define REFILL() \
+    do { \
+        hold |= (unsigned long)LOAD_LE32(in) << bits; \
+        in += (31 - bits) >> 3; \
+        bits |= 24; \
+    } while (0)
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -59,8 +68,8 @@ get_unaligned16(const unsigned short *p)
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_IN
+        strm->avail_out >= INFLATE_FAST_MIN_OUT
         start >= strm->avail_out
         state->bits < 8
 
@@ -72,16 +81,18 @@ get_unaligned16(const unsigned short *p)
 
    Notes:
 
-    - The maximum input bits used by a length/distance pair is 15 bits for the
-      length code, 5 bits for the length extra, 15 bits for the distance code,
-      and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
-      Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+    - hold is refilled to 24 bits or more before the length code, which
+      with its extra bits takes at most 20, and before the distance code,
+      which takes at most 15.  The up to 13 extra distance bits can take
+      a third refill.  From a bit count under 8, those read 10 bytes past
+      in and move it on by no more than 8, so if strm->avail_in >= 10,
+      there is enough input to avoid checking for available input while
+      decoding.
 
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
-      output space.
+      output space.  Two literals may be written by one loop.
 
     - @start:	inflate()'s starting value for strm->avail_out
  */
@@ -89,6 +100,7 @@ void inflate_fast(z_streamp strm, unsigned start)
 {
     struct inflate_state *state;
     const unsigned char *in;    /* local strm->next_in */
+    const unsigned char *first; /* strm->next_in on entry */
     const unsigned char *last;  /* while in < last, enough input available */
     unsigned char *out;         /* local strm->next_out */
     unsigned char *beg;         /* inflate()'s initial strm->next_out */
@@ -115,11 +127,11 @@ void inflate_fast(z_streamp strm, unsigned start)
 
     /* copy state to local variables */
     state = (struct inflate_state *)strm->state;
-    in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
-    out = strm->next_out - OFF;
+    in = first = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_IN - 1));
+    out = strm->next_out;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_OUT - 1));
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -137,12 +149,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-        }
+        REFILL();
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -150,26 +157,22 @@ void inflate_fast(z_streamp strm, unsigned start)
         bits -= op;
         op = (unsigned)(this.op);
         if (op == 0) {                          /* literal */
-            PUP(out) = (unsigned char)(this.val);
+            *out++ = (unsigned char)(this.val);
+            /* a second one if its code is already in hold */
+            this = lcode[hold & lmask];
+            if (this.op == 0 && this.bits <= bits) {
+                hold >>= this.bits;
+                bits -= this.bits;
+                *out++ = (unsigned char)(this.val);
+            }
         }
         else if (op & 16) {                     /* length base */
             len = (unsigned)(this.val);
             op &= 15;                           /* number of extra bits */
-            if (op) {
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                }
-                len += (unsigned)hold & ((1U << op) - 1);
-                hold >>= op;
-                bits -= op;
-            }
-            if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-            }
+            len += (unsigned)hold & ((1U << op) - 1);
+            hold >>= op;
+            bits -= op;
+            REFILL();
             this = dcode[hold & dmask];
           dodist:
             op = (unsigned)(this.bits);
@@ -179,14 +182,8 @@ void inflate_fast(z_streamp strm, unsigned start)
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(this.val);
                 op &= 15;                       /* number of extra bits */
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                    if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
-                        bits += 8;
-                    }
-                }
+                if (bits < op)
+                    REFILL();
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -205,13 +202,13 @@ void inflate_fast(z_streamp strm, unsigned start)
                         state->mode = BAD;
                         break;
                     }
-                    from = window - OFF;
+                    from = window;
                     if (write == 0) {           /* very common case */
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
                             do {
-                                PUP(out) = PUP(from);
+                                *out++ = *from++;
                             } while (--op);
                             from = out - dist;  /* rest from output */
                         }
@@ -222,14 +219,14 @@ void inflate_fast(z_streamp strm, unsigned start)
                         if (op < len) {         /* some from end of window */
                             len -= op;
                             do {
-                                PUP(out) = PUP(from);
+                                *out++ = *from++;
                             } while (--op);
-                            from = window - OFF;
+                            from = window;
                             if (write < len) {  /* some from start of window */
                                 op = write;
                                 len -= op;
                                 do {
-                                    PUP(out) = PUP(from);
+                                    *out++ = *from++;
                                 } while (--op);
                                 from = out - dist;      /* rest from output */
                             }
@@ -240,68 +237,52 @@ void inflate_fast(z_streamp strm, unsigned start)
                         if (op < len) {         /* some from window */
                             len -= op;
                             do {
-                                PUP(out) = PUP(from);
+                                *out++ = *from++;
                             } while (--op);
                             from = out - dist;  /* rest from output */
                         }
                     }
                     while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        *out++ = *from++;
                         len -= 3;
                     }
                     if (len) {
-                        PUP(out) = PUP(from);
+                        *out++ = *from++;
                         if (len > 1)
-                            PUP(out) = PUP(from);
+                            *out++ = *from++;
                     }
                 }
-                else {
-		    unsigned short *sout;
-		    unsigned long loops;
-
-                    from = out - dist;          /* copy direct from output */
-		    /* minimum length is three */
-		    /* Align out addr */
-		    if (!((long)(out - 1 + OFF) & 1)) {
-			PUP(out) = PUP(from);
-			len--;
-		    }
-		    sout = (unsigned short *)(out - OFF);
-		    if (dist > 2) {
-			unsigned short *sfrom;
-
-			sfrom = (unsigned short *)(from - OFF);
-			loops = len >> 1;
-			do
-#ifdef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
-			    PUP(sout) = PUP(sfrom);
-#else
-			    PUP(sout) = UP_UNALIGNED(sfrom);
-#endif
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-			from = (unsigned char *)sfrom + OFF;
-		    } else { /* dist == 1 or dist == 2 */
-			unsigned short pat16;
+                else if (dist >= 4) {
+                    /* copy direct from output, the source a word or more
+                       behind, so each word read has been written */
+                    from = out - dist;
+                    while (len >= 4) {
+                        COPY_WORD(out, from);
+                        out += 4;
+                        from += 4;
+                        len -= 4;
+                    }
+                    while (len--)
+                        *out++ = *from++;
+                }
+                else if (dist == 1) {           /* run of the last byte */
+                    u32 pat = out[-1] * 0x01010101U;
 
-			pat16 = *(sout-1+OFF);
-			if (dist == 1) {
-				union uu mm;
-				/* copy one char pattern to both bytes */
-				mm.us = pat16;
-				mm.b[0] = mm.b[1];
-				pat16 = mm.us;
-			}
-			loops = len >> 1;
-			do
-			    PUP(sout) = pat16;
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-		    }
-		    if (len & 1)
-			PUP(out) = PUP(from);
+                    while (len >= 4) {
+                        STORE_WORD(out, pat);
+                        out += 4;
+                        len -= 4;
+                    }
+                    while (len--)
+                        *out++ = (unsigned char)pat;
+                }
+                else {                          /* dist == 2 or dist == 3 */
+                    from = out - dist;
+                    do {
+                        *out++ = *from++;
+                    } while (--len);
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -336,11 +317,10 @@ void inflate_fast(z_streamp strm, unsigned start)
     hold &= (1U << bits) - 1;
 
     /* update state and return */
-    strm->next_in = in + OFF;
-    strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
-    strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
+    strm->avail_in -= (unsigned)(in - first);
+    strm->avail_out -= (unsigned)(out - strm->next_out);
+    strm->next_in = in;
+    strm->next_out = out;
     state->hold = hold;
     state->bits = bits;
     return;
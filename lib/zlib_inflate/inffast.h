@@ -8,4 +8,8 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* input and output inflate() must have available to call inflate_fast() */
+#define INFLATE_FAST_MIN_IN	10
+#define INFLATE_FAST_MIN_OUT	258
+
 void inflate_fast (z_streamp strm, unsigned start);
@@ -570,7 +570,7 @@ int zlib_inflate(z_streamp strm, int flush)
             }
             state->mode = LEN;
         case LEN:
-            if (have >= 6 && left >= 258) {
+            if (have >= INFLATE_FAST_MIN_IN && left >= INFLATE_FAST_MIN_OUT) {
                 RESTORE();
                 inflate_fast(strm, out);
                 LOAD();
@@ -153,6 +153,36 @@ void remove_from_page_cache(struct page *page)
 }
 EXPORT_SYMBOL(remove_from_page_cache);
 
+/**
+ * remove_from_page_cache_pagevec - remove a batch of pages from the pagecache
+ * @mapping:	the address_space the pages are in
+ * @pvec:	the pages, each locked and still in @mapping
+ *
+ * Does remove_from_page_cache() on each page in @pvec under a single hold
+ * of tree_lock.  Dropping the pagecache references is left to the caller.
+ */
+void remove_from_page_cache_pagevec(struct address_space *mapping,
+				    struct pagevec *pvec)
+{
+	int i;
+
+	spin_lock_irq(&mapping->tree_lock);
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		struct page *page = pvec->pages[i];
+
+		BUG_ON(!PageLocked(page));
+		BUG_ON(page->mapping != mapping);
+		__remove_from_page_cache(page);
+	}
+	spin_unlock_irq(&mapping->tree_lock);
+
+	mem_cgroup_uncharge_start();
+	for (i = 0; i < pagevec_count(pvec); i++)
+		mem_cgroup_uncharge_cache_page(pvec->pages[i]);
+	mem_cgroup_uncharge_end();
+}
+EXPORT_SYMBOL(remove_from_page_cache_pagevec);
+
 static int sync_page(void *word)
 {
 	struct address_space *mapping;
@@ -459,6 +489,100 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
 
+/**
+ * add_to_page_cache_lru_pagevec - add a batch of new pages to the pagecache
+ * @pvec:	the pages, each with ->index set
+ * @mapping:	the address_space to add them to
+ * @gfp_mask:	page allocation mode
+ *
+ * Does add_to_page_cache_lru() on each page in @pvec, but inserts them all
+ * under a single hold of tree_lock, which readahead would otherwise take
+ * once for every page it reads.  On return @pvec holds the pages that were
+ * added, locked and in their original order; those that were not, because
+ * their index was cached already or memory ran out, have been released.
+ * Returns the number of pages added.
+ */
+int add_to_page_cache_lru_pagevec(struct pagevec *pvec,
+				  struct address_space *mapping, gfp_t gfp_mask)
+{
+	struct pagevec failed;
+	struct page *page;
+	int i, nr;
+
+	pagevec_init(&failed, 0);
+	for (i = 0, nr = 0; i < pagevec_count(pvec); i++) {
+		page = pvec->pages[i];
+		/* As add_to_page_cache_lru() */
+		if (mapping_cap_swap_backed(mapping))
+			SetPageSwapBacked(page);
+		__set_page_locked(page);
+		if (mem_cgroup_cache_charge(page, current->mm,
+					    gfp_mask & GFP_RECLAIM_MASK)) {
+			__clear_page_locked(page);
+			page_cache_release(page);
+			continue;
+		}
+		pvec->pages[nr++] = page;
+	}
+	pvec->nr = nr;
+	if (!nr)
+		return 0;
+
+	if (radix_tree_preload(gfp_mask & ~__GFP_HIGHMEM)) {
+		for (i = 0; i < nr; i++) {
+			page = pvec->pages[i];
+			mem_cgroup_uncharge_cache_page(page);
+			__clear_page_locked(page);
+			page_cache_release(page);
+		}
+		pvec->nr = 0;
+		return 0;
+	}
+
+	/*
+	 * The preload covers the first insertion; the pages are usually
+	 * neighbours and share its leaf, and past the preloaded nodes the
+	 * tree falls back to atomic allocations.
+	 */
+	spin_lock_irq(&mapping->tree_lock);
+	for (i = 0, nr = 0; i < pagevec_count(pvec); i++) {
+		page = pvec->pages[i];
+		page_cache_get(page);
+		page->mapping = mapping;
+		if (radix_tree_insert(&mapping->page_tree, page->index, page)) {
+			page->mapping = NULL;
+			page_cache_release(page);
+			pagevec_add(&failed, page);
+			continue;
+		}
+		mapping->nrpages++;
+		__inc_zone_page_state(page, NR_FILE_PAGES);
+		if (PageSwapBacked(page))
+			__inc_zone_page_state(page, NR_SHMEM);
+		pvec->pages[nr++] = page;
+	}
+	spin_unlock_irq(&mapping->tree_lock);
+	radix_tree_preload_end();
+	pvec->nr = nr;
+
+	for (i = 0; i < pagevec_count(&failed); i++) {
+		page = failed.pages[i];
+		mem_cgroup_uncharge_cache_page(page);
+		__clear_page_locked(page);
+		page_cache_release(page);
+	}
+
+	for (i = 0; i < nr; i++) {
+		page = pvec->pages[i];
+		if (page_is_file_cache(page))
+			lru_cache_add_file(page);
+		else
+			lru_cache_add_anon(page);
+	}
+	return nr;
+}
+EXPORT_SYMBOL_GPL(add_to_page_cache_lru_pagevec);
+
 #ifdef CONFIG_NUMA
 struct page *__page_cache_alloc(gfp_t gfp)
 {
@@ -109,7 +109,8 @@ EXPORT_SYMBOL(read_cache_pages);
 static int read_pages(struct address_space *mapping, struct file *filp,
 		struct list_head *pages, unsigned nr_pages)
 {
-	unsigned page_idx;
+	struct pagevec pvec;
+	unsigned page_idx, nr, i;
 	int ret;
 
 	if (mapping->a_ops->readpages) {
@@ -119,14 +120,21 @@ static int read_pages(struct address_space *mapping, struct file *filp,
 		goto out;
 	}
 
-	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
-		struct page *page = list_to_page(pages);
-		list_del(&page->lru);
-		if (!add_to_page_cache_lru(page, mapping,
-					page->index, GFP_KERNEL)) {
-			mapping->a_ops->readpage(filp, page);
+	pagevec_init(&pvec, 0);
+	for (page_idx = 0; page_idx < nr_pages; page_idx += nr) {
+		nr = min_t(unsigned, nr_pages - page_idx, PAGEVEC_SIZE);
+		for (i = 0; i < nr; i++) {
+			struct page *page = list_to_page(pages);
+			list_del(&page->lru);
+			pagevec_add(&pvec, page);
 		}
-		page_cache_release(page);
+
+		add_to_page_cache_lru_pagevec(&pvec, mapping, GFP_KERNEL);
+		for (i = 0; i < pagevec_count(&pvec); i++) {
+			mapping->a_ops->readpage(filp, pvec.pages[i]);
+			page_cache_release(pvec.pages[i]);
+		}
+		pagevec_reinit(&pvec);
 	}
 	ret = 0;
 out:
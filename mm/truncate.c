@@ -94,24 +94,53 @@ EXPORT_SYMBOL(cancel_dirty_page);
  * its lock, b) when a concurrent invalidate_mapping_pages got there first and
  * c) when tmpfs swizzles a page between a tmpfs inode and swapper_space.
  */
-static int
-truncate_complete_page(struct address_space *mapping, struct page *page)
+static void truncate_cleanup_page(struct page *page)
 {
-	if (page->mapping != mapping)
-		return -EIO;
-
 	if (page_has_private(page))
 		do_invalidatepage(page, 0);
 
 	cancel_dirty_page(page, PAGE_CACHE_SIZE);
 
 	clear_page_mlock(page);
+}
+
+static int
+truncate_complete_page(struct address_space *mapping, struct page *page)
+{
+	if (page->mapping != mapping)
+		return -EIO;
+
+	truncate_cleanup_page(page);
 	remove_from_page_cache(page);
 	ClearPageMappedToDisk(page);
 	page_cache_release(page);	/* pagecache ref */
 	return 0;
 }
 
+/*
+ * truncate_complete_page() for a pagevec of locked pages, already cleaned
+ * up, which leave the pagecache under a single hold of tree_lock.  The
+ * pages are unlocked and the pvec emptied.
+ */
+static void
+truncate_complete_pagevec(struct address_space *mapping, struct pagevec *pvec)
+{
+	int i;
+
+	if (!pagevec_count(pvec))
+		return;
+
+	remove_from_page_cache_pagevec(mapping, pvec);
+	for (i = 0; i < pagevec_count(pvec); i++) {
+		struct page *page = pvec->pages[i];
+
+		ClearPageMappedToDisk(page);
+		page_cache_release(page);	/* pagecache ref */
+		unlock_page(page);
+	}
+	pagevec_reinit(pvec);
+}
+
 /*
  * This is for invalidate_mapping_pages().  That function can be called at
  * any time, and is not supposed to throw away dirty pages.  But pages can
@@ -196,7 +225,7 @@ int invalidate_inode_page(struct page *page)
  * block on page locks and it will not block on writeback.  The second pass
  * will wait.  This is to prevent as much IO as possible in the affected region.
  * The first pass will remove most pages, so the search cost of the second pass
- * is low.
+ * is low.  It takes tree_lock once for each pagevec of pages it could lock.
  *
  * When looking at page->index outside the page lock we need to be careful to
  * copy it into a local to avoid races (it could change at any time).
@@ -212,6 +241,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	pgoff_t end;
 	const unsigned partial = lstart & (PAGE_CACHE_SIZE - 1);
 	struct pagevec pvec;
+	struct pagevec locked_pvec;
 	pgoff_t next;
 	int i;
 
@@ -222,6 +252,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	end = (lend >> PAGE_CACHE_SHIFT);
 
 	pagevec_init(&pvec, 0);
+	pagevec_init(&locked_pvec, 0);
 	next = start;
 	while (next <= end &&
 	       pagevec_lookup(&pvec, mapping, next, PAGEVEC_SIZE)) {
@@ -243,9 +274,19 @@ void truncate_inode_pages_range(struct address_space *mapping,
 				unlock_page(page);
 				continue;
 			}
-			truncate_inode_page(mapping, page);
-			unlock_page(page);
+			if (page_mapped(page)) {
+				unmap_mapping_range(mapping,
+					(loff_t)page_index << PAGE_CACHE_SHIFT,
+					PAGE_CACHE_SIZE, 0);
+			}
+			if (page->mapping != mapping) {
+				unlock_page(page);
+				continue;
+			}
+			truncate_cleanup_page(page);
+			pagevec_add(&locked_pvec, page);
 		}
+		truncate_complete_pagevec(mapping, &locked_pvec);
 		pagevec_release(&pvec);
 		cond_resched();
 	}
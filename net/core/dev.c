@@ -1909,7 +1909,11 @@ static inline void skb_orphan_try(struct sk_buff *skb)
 {
 	struct sock *sk = skb->sk;
 
-	if (sk && !skb_tx(skb)->flags) {
+	/* Only plain sock_wfree() charges are dropped early.  Owners with
+	 * their own destructor (e.g. TCP small queues) rely on it running
+	 * at tx completion to account bytes sitting in the device.
+	 */
+	if (sk && !skb_tx(skb)->flags && skb->destructor == sock_wfree) {
 		/* skb_tx_hash() wont be able to get sk.
 		 * We copy sk_hash into skb->rxhash
 		 */
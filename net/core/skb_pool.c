@@ -0,0 +1,417 @@
+/*
+ *	Per-device pools of recycled receive buffers.
+ *
+ *	Receive buffers come back to the driver through skb_pool_free()
+ *	once it is done with them, typically after copying the frames they
+ *	carry into fresh skbs with skb_pool_copy(), and are handed out again
+ *	by skb_pool_alloc().  Buffers which are still referenced elsewhere,
+ *	too small or nonlinear are freed as usual; see skb_recycle_check().
+ *
+ *	Hit rates are shown in debugfs, in skb_pool/<device>, which follows
+ *	the device when it is renamed.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/netdevice.h>
+#include <linux/skb_pool.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/mutex.h>
+
+/* skb_pool_copy() copies frames up to this size into the linear area;
+ * of longer frames only the first SKB_POOL_COPY_HEAD bytes go there,
+ * enough for the protocol headers, and the rest into a page fragment.
+ */
+#define SKB_POOL_COPY_LINEAR	256
+#define SKB_POOL_COPY_HEAD	128
+
+static struct dentry *skb_pool_debugfs;
+
+/* Pools with a debugfs entry, to rename it along with their device */
+static LIST_HEAD(skb_pool_list);
+static DEFINE_MUTEX(skb_pool_mutex);
+
+static int skb_pool_stats_show(struct seq_file *s, void *unused)
+{
+	struct skb_pool *pool = s->private;
+	struct skb_pool_stats st;
+	unsigned long flags, allocs;
+	unsigned int pooled;
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	st = pool->stats;
+	pooled = skb_queue_len(&pool->list);
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	allocs = st.alloc_hit + st.alloc_miss;
+	seq_printf(s, "size:         %u\n", pool->size);
+	seq_printf(s, "pooled:       %u/%u\n", pooled, pool->depth);
+	seq_printf(s, "alloc_hit:    %lu\n", st.alloc_hit);
+	seq_printf(s, "alloc_miss:   %lu\n", st.alloc_miss);
+	seq_printf(s, "hit_rate:     %lu%%\n",
+		   allocs ? st.alloc_hit * 100 / allocs : 0);
+	seq_printf(s, "recycled:     %lu\n", st.recycled);
+	seq_printf(s, "recycle_fail: %lu\n", st.recycle_fail);
+	seq_printf(s, "copies:       %lu\n", st.copies);
+	seq_printf(s, "frag_pages:   %lu\n", st.frag_pages);
+	return 0;
+}
+
+static int skb_pool_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, skb_pool_stats_show, inode->i_private);
+}
+
+static const struct file_operations skb_pool_stats_fops = {
+	.open		= skb_pool_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/**
+ *	skb_pool_create - create a pool of receive buffers for a device
+ *	@dev: network device the buffers are for
+ *	@size: data bytes each buffer has room for, as for netdev_alloc_skb()
+ *	@depth: number of free buffers the pool keeps at most
+ *
+ *	The pool starts out empty and fills with the buffers given back to
+ *	it.  Returns %NULL when out of memory.
+ */
+struct skb_pool *skb_pool_create(struct net_device *dev, unsigned int size,
+				 unsigned int depth)
+{
+	struct skb_pool *pool;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return NULL;
+
+	skb_queue_head_init(&pool->list);
+	pool->dev = dev;
+	pool->size = size;
+	pool->depth = depth;
+
+	if (skb_pool_debugfs) {
+		pool->dentry = debugfs_create_file(dev->name, S_IRUGO,
+						   skb_pool_debugfs, pool,
+						   &skb_pool_stats_fops);
+		if (IS_ERR(pool->dentry))
+			pool->dentry = NULL;
+	}
+	if (pool->dentry) {
+		mutex_lock(&skb_pool_mutex);
+		list_add(&pool->node, &skb_pool_list);
+		mutex_unlock(&skb_pool_mutex);
+	}
+	return pool;
+}
+EXPORT_SYMBOL(skb_pool_create);
+
+/**
+ *	skb_pool_destroy - free a pool and the buffers in it
+ *	@pool: pool to destroy
+ *
+ *	The caller makes sure no more buffers are allocated from or given
+ *	back to @pool.
+ */
+void skb_pool_destroy(struct skb_pool *pool)
+{
+	if (pool->dentry) {
+		mutex_lock(&skb_pool_mutex);
+		list_del(&pool->node);
+		mutex_unlock(&skb_pool_mutex);
+	}
+	debugfs_remove(pool->dentry);
+	skb_queue_purge(&pool->list);
+	if (pool->frag_page)
+		put_page(pool->frag_page);
+	kfree(pool);
+}
+EXPORT_SYMBOL(skb_pool_destroy);
+
+/**
+ *	skb_pool_alloc - allocate a receive buffer
+ *	@pool: pool to allocate from
+ *	@gfp_mask: allocation mask when the pool is empty
+ *
+ *	Returns an skb set up like netdev_alloc_skb(@pool->dev, @pool->size)
+ *	would, or %NULL.
+ */
+struct sk_buff *skb_pool_alloc(struct skb_pool *pool, gfp_t gfp_mask)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	skb = __skb_dequeue(&pool->list);
+	if (skb)
+		pool->stats.alloc_hit++;
+	else
+		pool->stats.alloc_miss++;
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	if (skb) {
+		skb->dev = pool->dev;
+		return skb;
+	}
+	return __netdev_alloc_skb(pool->dev, pool->size, gfp_mask);
+}
+EXPORT_SYMBOL(skb_pool_alloc);
+
+/**
+ *	skb_pool_alloc_bulk - allocate several receive buffers
+ *	@pool: pool to allocate from
+ *	@list: list the buffers are appended to
+ *	@n: number of buffers wanted
+ *	@gfp_mask: allocation mask for what the pool cannot provide
+ *
+ *	Takes the pool lock once for all buffers found in the pool.  Returns
+ *	the number of buffers added to @list, which the caller must lock
+ *	itself if it is shared.
+ */
+int skb_pool_alloc_bulk(struct skb_pool *pool, struct sk_buff_head *list,
+			int n, gfp_t gfp_mask)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
+	int i = 0;
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	while (i < n && (skb = __skb_dequeue(&pool->list)) != NULL) {
+		skb->dev = pool->dev;
+		__skb_queue_tail(list, skb);
+		i++;
+	}
+	pool->stats.alloc_hit += i;
+	pool->stats.alloc_miss += n - i;
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	for (; i < n; i++) {
+		skb = __netdev_alloc_skb(pool->dev, pool->size, gfp_mask);
+		if (!skb)
+			break;
+		__skb_queue_tail(list, skb);
+	}
+	return i;
+}
+EXPORT_SYMBOL(skb_pool_alloc_bulk);
+
+/**
+ *	skb_pool_recycle - give a buffer back to its pool
+ *	@pool: pool to give @skb to
+ *	@skb: buffer the caller is done with
+ *
+ *	Returns true if @skb went into the pool, false if the caller still
+ *	owns it: the pool is full, @skb is too small or not reusable.  Must
+ *	be called with interrupts enabled.
+ */
+bool skb_pool_recycle(struct skb_pool *pool, struct sk_buff *skb)
+{
+	unsigned long flags;
+	bool recycled = false;
+
+	if (skb_queue_len(&pool->list) < pool->depth &&
+	    skb_recycle_check(skb, pool->size))
+		recycled = true;
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	if (recycled && skb_queue_len(&pool->list) < pool->depth) {
+		__skb_queue_head(&pool->list, skb);
+		pool->stats.recycled++;
+	} else {
+		recycled = false;
+		pool->stats.recycle_fail++;
+	}
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+	return recycled;
+}
+EXPORT_SYMBOL(skb_pool_recycle);
+
+/**
+ *	skb_pool_free - recycle a buffer or free it
+ *	@pool: pool to give @skb to
+ *	@skb: buffer the caller is done with
+ */
+void skb_pool_free(struct skb_pool *pool, struct sk_buff *skb)
+{
+	if (!skb_pool_recycle(pool, skb))
+		dev_kfree_skb_any(skb);
+}
+EXPORT_SYMBOL(skb_pool_free);
+
+/**
+ *	skb_pool_free_bulk - recycle or free a list of buffers
+ *	@pool: pool to give the buffers to
+ *	@list: buffers the caller is done with, emptied on return
+ *
+ *	Like skb_pool_free() on each buffer but takes the pool lock once.
+ *	@list is not locked.
+ */
+void skb_pool_free_bulk(struct skb_pool *pool, struct sk_buff_head *list)
+{
+	struct sk_buff_head reuse;
+	struct sk_buff *skb;
+	unsigned long flags;
+	unsigned long fail = 0;
+
+	__skb_queue_head_init(&reuse);
+	while ((skb = __skb_dequeue(list)) != NULL) {
+		if (skb_recycle_check(skb, pool->size)) {
+			__skb_queue_tail(&reuse, skb);
+		} else {
+			dev_kfree_skb_any(skb);
+			fail++;
+		}
+	}
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	while (skb_queue_len(&pool->list) < pool->depth &&
+	       (skb = __skb_dequeue(&reuse)) != NULL) {
+		__skb_queue_head(&pool->list, skb);
+		pool->stats.recycled++;
+	}
+	pool->stats.recycle_fail += fail + skb_queue_len(&reuse);
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	__skb_queue_purge(&reuse);
+}
+EXPORT_SYMBOL(skb_pool_free_bulk);
+
+/*
+ * Carves size bytes out of the pool's current page, starting a new page
+ * when it is used up.  The fragment comes with its own page reference.
+ */
+static struct page *skb_pool_frag(struct skb_pool *pool, unsigned int size,
+				  unsigned int *offset, gfp_t gfp_mask)
+{
+	struct page *page, *old;
+	unsigned long flags;
+
+	size = ALIGN(size, SMP_CACHE_BYTES);
+	if (size > PAGE_SIZE)
+		return NULL;
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	page = pool->frag_page;
+	if (page && pool->frag_offset + size <= PAGE_SIZE) {
+		*offset = pool->frag_offset;
+		pool->frag_offset += size;
+		get_page(page);
+		spin_unlock_irqrestore(&pool->list.lock, flags);
+		return page;
+	}
+	old = pool->frag_page;
+	pool->frag_page = NULL;
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+
+	if (old)
+		put_page(old);
+
+	page = __netdev_alloc_page(pool->dev, gfp_mask);
+	if (!page)
+		return NULL;
+	*offset = 0;
+
+	/* One reference for the fragment, one for the pool. */
+	spin_lock_irqsave(&pool->list.lock, flags);
+	pool->stats.frag_pages++;
+	if (!pool->frag_page) {
+		get_page(page);
+		pool->frag_page = page;
+		pool->frag_offset = size;
+	}
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+	return page;
+}
+
+/**
+ *	skb_pool_copy - copy a received frame into a new skb
+ *	@pool: pool of the receiving device
+ *	@data: frame
+ *	@len: length of the frame
+ *	@gfp_mask: allocation mask
+ *
+ *	Lets a driver give the buffer @data lives in back to the pool right
+ *	away.  Short frames are copied into a small linear skb; longer ones
+ *	get their headers in the linear area and the payload in a page
+ *	fragment, so that the skb is charged for little more than its
+ *	length.  The data starts NET_IP_ALIGN bytes into the skb.
+ */
+struct sk_buff *skb_pool_copy(struct skb_pool *pool, const void *data,
+			      unsigned int len, gfp_t gfp_mask)
+{
+	unsigned int head = len, offset = 0;
+	struct page *page = NULL;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	if (len > SKB_POOL_COPY_LINEAR) {
+		page = skb_pool_frag(pool, len - SKB_POOL_COPY_HEAD, &offset,
+				     gfp_mask);
+		if (page)
+			head = SKB_POOL_COPY_HEAD;
+	}
+
+	skb = __netdev_alloc_skb(pool->dev, head + NET_IP_ALIGN, gfp_mask);
+	if (!skb) {
+		if (page)
+			put_page(page);
+		return NULL;
+	}
+	skb_reserve(skb, NET_IP_ALIGN);
+	memcpy(skb_put(skb, head), data, head);
+
+	if (page) {
+		memcpy(page_address(page) + offset, data + head, len - head);
+		skb_add_rx_frag(skb, 0, page, offset, len - head);
+	}
+
+	spin_lock_irqsave(&pool->list.lock, flags);
+	pool->stats.copies++;
+	spin_unlock_irqrestore(&pool->list.lock, flags);
+	return skb;
+}
+EXPORT_SYMBOL(skb_pool_copy);
+
+static int skb_pool_netdev_event(struct notifier_block *this,
+				 unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+	struct skb_pool *pool;
+
+	if (event != NETDEV_CHANGENAME)
+		return NOTIFY_DONE;
+
+	mutex_lock(&skb_pool_mutex);
+	list_for_each_entry(pool, &skb_pool_list, node) {
+		if (pool->dev == dev)
+			debugfs_rename(skb_pool_debugfs, pool->dentry,
+				       skb_pool_debugfs, dev->name);
+	}
+	mutex_unlock(&skb_pool_mutex);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block skb_pool_netdev_notifier = {
+	.notifier_call = skb_pool_netdev_event,
+};
+
+static int __init skb_pool_init(void)
+{
+	skb_pool_debugfs = debugfs_create_dir("skb_pool", NULL);
+	if (IS_ERR(skb_pool_debugfs))
+		skb_pool_debugfs = NULL;
+	if (skb_pool_debugfs)
+		register_netdevice_notifier(&skb_pool_netdev_notifier);
+	return 0;
+}
+subsys_initcall(skb_pool_init);
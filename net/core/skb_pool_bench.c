@@ -0,0 +1,194 @@
+/*
+ *	Receive path benchmark for skb pools.
+ *
+ *	Runs the buffer handling of a driver receiving count frames of each
+ *	length in lens, the way USB and SDIO network drivers do it:
+ *
+ *	  slab     rx buffer from netdev_alloc_skb(), handed to the stack
+ *	  copy     rx buffer from netdev_alloc_skb(), frame copied out into
+ *	           a right-sized skb, rx buffer freed
+ *	  pool     rx buffer from the pool, frame copied out with
+ *	           skb_pool_copy(), rx buffer recycled
+ *	  bulk     like pool, buffers allocated and recycled batch at a time
+ *
+ *	The stack is stood in for by freeing the frame.  Results go to the
+ *	kernel log; the module does not stay loaded:
+ *
+ *	  modprobe skb_pool_bench count=200000 lens=64,590,1514
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/ktime.h>
+#include <linux/etherdevice.h>
+#include <linux/skb_pool.h>
+
+#define BENCH_BATCH	16
+
+static unsigned int count = 100000;
+module_param(count, uint, 0);
+MODULE_PARM_DESC(count, "frames per run");
+
+static unsigned int bufsize = 2048;
+module_param(bufsize, uint, 0);
+MODULE_PARM_DESC(bufsize, "size of the driver's rx buffers");
+
+static unsigned int lens[8] = { 64, 590, 1514 };
+static unsigned int nr_lens = 3;
+module_param_array(lens, uint, &nr_lens, 0);
+MODULE_PARM_DESC(lens, "frame lengths to run");
+
+enum bench_mode { BENCH_SLAB, BENCH_COPY, BENCH_POOL, BENCH_BULK };
+
+static const char *bench_mode_name[] = { "slab", "copy", "pool", "bulk" };
+
+/* What the device's DMA would have put into the rx buffer. */
+static void bench_fill(struct sk_buff *skb, unsigned int len)
+{
+	memset(skb_put(skb, len), 0x5a, len);
+}
+
+static int bench_one(struct net_device *dev, struct skb_pool *pool,
+		     enum bench_mode mode, unsigned int len)
+{
+	struct sk_buff_head bufs;
+	struct sk_buff *skb, *frame;
+	unsigned int i, j;
+	ktime_t start;
+	u64 ns;
+
+	__skb_queue_head_init(&bufs);
+	start = ktime_get();
+
+	for (i = 0; i < count; i += j) {
+		j = 1;
+		switch (mode) {
+		case BENCH_SLAB:
+			skb = netdev_alloc_skb(dev, bufsize);
+			if (!skb)
+				return -ENOMEM;
+			bench_fill(skb, len);
+			kfree_skb(skb);
+			break;
+		case BENCH_COPY:
+			skb = netdev_alloc_skb(dev, bufsize);
+			if (!skb)
+				return -ENOMEM;
+			bench_fill(skb, len);
+			frame = netdev_alloc_skb_ip_align(dev, len);
+			if (!frame) {
+				kfree_skb(skb);
+				return -ENOMEM;
+			}
+			memcpy(skb_put(frame, len), skb->data, len);
+			kfree_skb(frame);
+			kfree_skb(skb);
+			break;
+		case BENCH_POOL:
+			skb = skb_pool_alloc(pool, GFP_KERNEL);
+			if (!skb)
+				return -ENOMEM;
+			bench_fill(skb, len);
+			frame = skb_pool_copy(pool, skb->data, len, GFP_KERNEL);
+			skb_pool_free(pool, skb);
+			if (!frame)
+				return -ENOMEM;
+			kfree_skb(frame);
+			break;
+		case BENCH_BULK:
+			j = min_t(unsigned int, BENCH_BATCH, count - i);
+			if (skb_pool_alloc_bulk(pool, &bufs, j, GFP_KERNEL) != j) {
+				__skb_queue_purge(&bufs);
+				return -ENOMEM;
+			}
+			skb_queue_walk(&bufs, skb) {
+				bench_fill(skb, len);
+				frame = skb_pool_copy(pool, skb->data, len,
+						      GFP_KERNEL);
+				if (!frame) {
+					__skb_queue_purge(&bufs);
+					return -ENOMEM;
+				}
+				kfree_skb(frame);
+			}
+			skb_pool_free_bulk(pool, &bufs);
+			break;
+		}
+		if ((i & 1023) == 0)
+			cond_resched();
+	}
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (!ns)
+		ns = 1;
+	printk(KERN_INFO "skb_pool_bench: %-4s len %4u: %u frames in %llu ns, "
+	       "%llu ns/frame, %llu kpps, %llu MB/s\n",
+	       bench_mode_name[mode], len, count, ns, div_u64(ns, count),
+	       div64_u64((u64)count * NSEC_PER_MSEC, ns),
+	       div64_u64((u64)count * len * 1000, ns));
+	return 0;
+}
+
+static int __init skb_pool_bench_init(void)
+{
+	struct net_device *dev;
+	struct skb_pool *pool;
+	struct skb_pool_stats st;
+	enum bench_mode mode;
+	unsigned int i;
+	int err = 0;
+
+	if (!count || bufsize < ETH_FRAME_LEN)
+		return -EINVAL;
+	for (i = 0; i < nr_lens; i++)
+		if (lens[i] < ETH_HLEN || lens[i] > bufsize)
+			return -EINVAL;
+
+	dev = alloc_etherdev(0);
+	if (!dev)
+		return -ENOMEM;
+	strlcpy(dev->name, "skb_pool_bench", IFNAMSIZ);
+
+	pool = skb_pool_create(dev, bufsize, BENCH_BATCH * 2);
+	if (!pool) {
+		free_netdev(dev);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nr_lens && !err; i++)
+		for (mode = BENCH_SLAB; mode <= BENCH_BULK && !err; mode++)
+			err = bench_one(dev, pool, mode, lens[i]);
+
+	st = pool->stats;
+	printk(KERN_INFO "skb_pool_bench: pool: %lu hits, %lu misses, "
+	       "%lu recycled, %lu not recycled, %lu frag pages\n",
+	       st.alloc_hit, st.alloc_miss, st.recycled, st.recycle_fail,
+	       st.frag_pages);
+
+	skb_pool_destroy(pool);
+	free_netdev(dev);
+
+	if (err) {
+		printk(KERN_ERR "skb_pool_bench: out of memory\n");
+		return err;
+	}
+	/* Nothing to keep loaded for. */
+	return -EAGAIN;
+}
+
+static void __exit skb_pool_bench_exit(void)
+{
+}
+
+module_init(skb_pool_bench_init);
+module_exit(skb_pool_bench_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("skb pool receive path benchmark");
@@ -919,9 +919,15 @@ static void nl_fib_lookup_exit(struct net *net)
 
 static void fib_disable_ip(struct net_device *dev, int force, int delay)
 {
-	if (fib_sync_down_dev(dev, force))
+	if (fib_sync_down_dev(dev, force)) {
 		fib_flush(dev_net(dev));
-	rt_cache_flush(dev_net(dev), delay);
+		rt_cache_flush(dev_net(dev), delay);
+	} else if (delay < 0) {
+		rt_cache_flush(dev_net(dev), delay);
+	} else {
+		/* No route used dev: routes via other devices stay valid. */
+		rt_cache_flush_dev(dev);
+	}
 	arp_ifdown(dev);
 }
 
@@ -981,7 +987,7 @@ static int fib_netdev_event(struct notifier_block *this, unsigned long event, vo
 		break;
 	case NETDEV_CHANGEMTU:
 	case NETDEV_CHANGE:
-		rt_cache_flush(dev_net(dev), 0);
+		rt_cache_flush_dev(dev);
 		break;
 	case NETDEV_UNREGISTER_BATCH:
 		rt_cache_flush_batch();
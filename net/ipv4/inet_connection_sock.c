@@ -15,6 +15,7 @@
 
 #include <linux/module.h>
 #include <linux/jhash.h>
+#include <linux/tcp.h>
 
 #include <net/inet_connection_sock.h>
 #include <net/inet_hashtables.h>
@@ -294,7 +295,10 @@ struct sock *inet_csk_accept(struct sock *sk, int flags, int *err)
 	}
 
 	newsk = reqsk_queue_get_child(&icsk->icsk_accept_queue, sk);
-	WARN_ON(newsk->sk_state == TCP_SYN_RECV);
+	/* TCP Fast Open queues children before their handshake completes. */
+	WARN_ON(newsk->sk_state == TCP_SYN_RECV &&
+		!(sk->sk_protocol == IPPROTO_TCP &&
+		  tcp_sk(newsk)->fastopen_rsk != NULL));
 out:
 	release_sock(sk);
 	return newsk;
@@ -450,6 +450,7 @@ struct inet_peer *inet_getpeer(__be32 daddr, int create)
 		atomic_set(&p->rid, 0);
 		atomic_set(&p->ip_id_count, secure_ip_id(daddr));
 		p->tcp_ts_stamp = 0;
+		memset(&p->tcp, 0, sizeof(p->tcp));
 		INIT_LIST_HEAD(&p->unused);
 
 
@@ -916,6 +916,47 @@ void rt_cache_flush_batch(void)
 	rt_do_flush(!in_softirq());
 }
 
+static inline int rt_uses_dev(const struct rtable *rth,
+			      const struct net_device *dev)
+{
+	return rth->dst.dev == dev ||
+	       rth->fl.iif == dev->ifindex ||
+	       rth->fl.oif == dev->ifindex;
+}
+
+/*
+ * Remove the entries going through or arriving on dev, for events which
+ * change this device but not the FIB (MTU, link state, hardware address).
+ * Unlike rt_cache_flush() the generation is left alone, so the cached
+ * routes of sockets talking over other interfaces remain valid.  Sockets
+ * holding one of the removed entries notice through dst_check().
+ */
+void rt_cache_flush_dev(struct net_device *dev)
+{
+	int process_context = !in_softirq();
+	struct rtable *rth, **rthp;
+	unsigned int i;
+
+	for (i = 0; i <= rt_hash_mask; i++) {
+		if (process_context && need_resched())
+			cond_resched();
+		if (!rt_hash_table[i].chain)
+			continue;
+
+		spin_lock_bh(rt_hash_lock_addr(i));
+		rthp = &rt_hash_table[i].chain;
+		while ((rth = *rthp) != NULL) {
+			if (rt_uses_dev(rth, dev) || rt_is_expired(rth)) {
+				*rthp = rth->dst.rt_next;
+				rt_free(rth);
+			} else {
+				rthp = &rth->dst.rt_next;
+			}
+		}
+		spin_unlock_bh(rt_hash_lock_addr(i));
+	}
+}
+
 static void rt_emergency_hash_rebuild(struct net *net)
 {
 	if (net_ratelimit())
@@ -1706,7 +1747,8 @@ static void ip_rt_update_pmtu(struct dst_entry *dst, u32 mtu)
 
 static struct dst_entry *ipv4_dst_check(struct dst_entry *dst, u32 cookie)
 {
-	if (rt_is_expired((struct rtable *)dst))
+	/* obsolete > 0: removed from the cache, e.g. by rt_cache_flush_dev() */
+	if (dst->obsolete > 0 || rt_is_expired((struct rtable *)dst))
 		return NULL;
 	return dst;
 }
@@ -0,0 +1,198 @@
+/*
+ * TCP Fast Open: server side.
+ *
+ * A client which holds a cookie for a server may carry data in its SYN.
+ * If the cookie is valid the server creates the child socket right away,
+ * queues that data to it and puts the child in the accept queue while it
+ * is still in SYN_RECV, so the application can read the request and
+ * start answering one round trip earlier.
+ *
+ * The cookie is a MAC of the client and server addresses, keyed with a
+ * secret chosen at boot. See draft-ietf-tcpm-fastopen.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cryptohash.h>
+#include <linux/random.h>
+#include <net/tcp.h>
+
+int sysctl_tcp_fastopen __read_mostly = TFO_CLIENT_ENABLE;
+
+static __u32 tcp_fastopen_secret[16 - 2] __read_mostly;
+
+static DEFINE_PER_CPU(__u32 [16 + 5 + SHA_WORKSPACE_WORDS],
+		      tcp_fastopen_scratch);
+
+static __init int tcp_fastopen_init(void)
+{
+	get_random_bytes(tcp_fastopen_secret, sizeof(tcp_fastopen_secret));
+	return 0;
+}
+late_initcall(tcp_fastopen_init);
+
+/* Computes the Fast Open cookie for the client address saddr talking to
+ * our address daddr.
+ */
+void tcp_fastopen_cookie_gen(__be32 saddr, __be32 daddr,
+			     struct tcp_fastopen_cookie *foc)
+{
+	__u32 *tmp = get_cpu_var(tcp_fastopen_scratch);
+
+	tmp[0] = (__force u32)saddr;
+	tmp[1] = (__force u32)daddr;
+	memcpy(tmp + 2, tcp_fastopen_secret, sizeof(tcp_fastopen_secret));
+	sha_init(tmp + 16);
+	sha_transform(tmp + 16, (__u8 *)tmp, tmp + 16 + 5);
+
+	BUILD_BUG_ON(TCP_FASTOPEN_COOKIE_SIZE > 5 * sizeof(__u32));
+	memcpy(foc->val, tmp + 16, TCP_FASTOPEN_COOKIE_SIZE);
+	foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+	put_cpu_var(tcp_fastopen_scratch);
+}
+
+/* Decides whether the SYN in skb may open the connection right away.
+ * Returns true when the Fast Open cookie in foc is valid; otherwise
+ * valid_foc is filled in with the cookie to send back in the SYN-ACK
+ * if the client asked for one or sent a stale one.
+ */
+bool tcp_fastopen_check(struct sock *sk, struct sk_buff *skb,
+			struct request_sock *req,
+			struct tcp_fastopen_cookie *foc,
+			struct tcp_fastopen_cookie *valid_foc)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	if ((sysctl_tcp_fastopen & TFO_SERVER_ENABLE) == 0 ||
+	    tp->fastopen_max_qlen == 0 || foc->len < 0)
+		return false;
+
+	tcp_fastopen_cookie_gen(ip_hdr(skb)->saddr, ip_hdr(skb)->daddr,
+				valid_foc);
+
+	if (foc->len == 0) {
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENCOOKIEREQD);
+		return false;
+	}
+
+	if (foc->len != valid_foc->len ||
+	    memcmp(foc->val, valid_foc->val, foc->len)) {
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
+		return false;
+	}
+
+	/* Bound the number of children which were created before their
+	 * handshake completed and still wait to be accepted.
+	 */
+	if (sk->sk_ack_backlog >= tp->fastopen_max_qlen) {
+		NET_INC_STATS_BH(sock_net(sk),
+				 LINUX_MIB_TCPFASTOPENLISTENOVERFLOW);
+		valid_foc->len = -1;
+		return false;
+	}
+
+	/* The client has the right cookie: no need to send it again, and
+	 * the SYN-ACK acknowledges the data in the SYN.
+	 */
+	valid_foc->len = -1;
+	tcp_rsk(req)->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVE);
+	return true;
+}
+
+/* Creates the child socket for the Fast Open request req, queues the
+ * data in the SYN to it and adds it to the accept queue of the listener
+ * sk. The SYN-ACK is sent afterwards, so it only acknowledges data the
+ * child really holds. Returns NULL on failure, in which case the caller
+ * answers with a SYN-ACK which does not acknowledge the data.
+ */
+struct sock *tcp_fastopen_create_child(struct sock *sk, struct sk_buff *skb,
+				       struct request_sock *req)
+{
+	struct request_sock *rsk;
+	struct tcp_sock *tp;
+	struct sock *child;
+	u32 end_seq;
+
+	/* The child keeps its own copy of the request to retransmit the
+	 * SYN-ACK; the listener consumes the original in accept().
+	 */
+	rsk = inet_reqsk_alloc(&tcp_request_sock_ops);
+	if (rsk == NULL)
+		return NULL;
+
+	child = inet_csk(sk)->icsk_af_ops->syn_recv_sock(sk, skb, req, NULL);
+	if (child == NULL) {
+		__reqsk_free(rsk);
+		return NULL;
+	}
+
+	tp = tcp_sk(child);
+
+	/* RFC1323: The window in SYN & SYN/ACK segments is never scaled. */
+	tp->snd_wnd = ntohs(tcp_hdr(skb)->window);
+
+	/* Activate the retrans timer so that SYNACK can be retransmitted.
+	 * The request socket is not added to the SYN table of the parent
+	 * because it's been added to the accept queue directly.
+	 */
+	inet_csk_reset_xmit_timer(child, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT, TCP_RTO_MAX);
+
+	/* Now finish processing the fastopen child socket. */
+	inet_csk(child)->icsk_af_ops->rebuild_header(child);
+	tcp_init_congestion_control(child);
+	tcp_mtup_init(child);
+	tcp_init_metrics(child);
+	tcp_init_buffer_space(child);
+
+	/* Queue the data carried in the SYN packet. It is cloned because
+	 * the caller frees skb. A valid cookie without data still opens
+	 * the connection early.
+	 */
+	end_seq = TCP_SKB_CB(skb)->end_seq;
+	if (end_seq != TCP_SKB_CB(skb)->seq + 1) {
+		struct sk_buff *skb2 = skb_clone(skb, GFP_ATOMIC);
+
+		if (likely(skb2 != NULL)) {
+			skb_dst_drop(skb2);
+			__skb_pull(skb2, tcp_hdrlen(skb));
+			skb_set_owner_r(skb2, child);
+			__skb_queue_tail(&child->sk_receive_queue, skb2);
+			tp->syn_data_acked = 1;
+		} else {
+			end_seq = TCP_SKB_CB(skb)->seq + 1;
+		}
+	}
+	tcp_rsk(req)->rcv_nxt = tp->rcv_nxt = end_seq;
+
+	/* syn_recv_sock() took the IP options over from req already. */
+	memcpy(rsk, req, req->rsk_ops->obj_size);
+	rsk->sk = NULL;
+	rsk->dl_next = NULL;
+	tp->fastopen_rsk = rsk;
+
+	inet_csk_reqsk_queue_add(sk, req, child);
+	sk->sk_data_ready(sk, 0);
+	bh_unlock_sock(child);
+	sock_put(child);
+	return child;
+}
+
+/* The passive Fast Open socket sk is done with its request: its SYN-ACK
+ * was acknowledged, or it is going away. Once this returns the retransmit
+ * timer is no longer used for the SYN-ACK; the caller rearms it for data
+ * if the socket lives on.
+ */
+void tcp_fastopen_remove_req(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+
+	reqsk_free(tp->fastopen_rsk);
+	tp->fastopen_rsk = NULL;
+}
@@ -1220,6 +1220,8 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 {
 	struct tcp_extend_values tmp_ext;
 	struct tcp_options_received tmp_opt;
+	struct tcp_fastopen_cookie foc = { .len = -1 };
+	struct tcp_fastopen_cookie valid_foc = { .len = -1 };
 	u8 *hash_location;
 	struct request_sock *req;
 	struct inet_request_sock *ireq;
@@ -1228,6 +1230,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	__be32 saddr = ip_hdr(skb)->saddr;
 	__be32 daddr = ip_hdr(skb)->daddr;
 	__u32 isn = TCP_SKB_CB(skb)->when;
+	bool do_fastopen = false;
 #ifdef CONFIG_SYN_COOKIES
 	int want_cookie = 0;
 #else
@@ -1272,7 +1275,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	tcp_clear_options(&tmp_opt);
 	tmp_opt.mss_clamp = TCP_MSS_DEFAULT;
 	tmp_opt.user_mss  = tp->rx_opt.user_mss;
-	tcp_parse_options(skb, &tmp_opt, &hash_location, 0);
+	tcp_parse_options(skb, &tmp_opt, &hash_location, 0, &foc);
 
 	if (tmp_opt.cookie_plus > 0 &&
 	    tmp_opt.saw_tstamp &&
@@ -1309,6 +1312,7 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 		goto drop_and_release;
 	}
 	tmp_ext.cookie_in_always = tp->rx_opt.cookie_in_always;
+	tmp_ext.fastopen_cookie = NULL;
 
 	if (want_cookie && !tmp_opt.saw_tstamp)
 		tcp_clear_options(&tmp_opt);
@@ -1378,10 +1382,32 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	}
 	tcp_rsk(req)->snt_isn = isn;
 
+	if (!want_cookie)
+		do_fastopen = tcp_fastopen_check(sk, skb, req, &foc, &valid_foc);
+	if (valid_foc.len > 0)
+		tmp_ext.fastopen_cookie = &valid_foc;
+
+	/* Hand the connection and the data in the SYN to the application
+	 * before the SYN-ACK acknowledges that data. If that fails, answer
+	 * as if there were no cookie; the client sends the data again.
+	 */
+	if (do_fastopen &&
+	    tcp_fastopen_create_child(sk, skb, req) == NULL) {
+		do_fastopen = false;
+		tcp_rsk(req)->rcv_nxt = tcp_rsk(req)->rcv_isn + 1;
+	}
+
 	if (tcp_v4_send_synack(sk, dst, req,
 			       (struct request_values *)&tmp_ext) ||
-	    want_cookie)
+	    want_cookie) {
+		/* The child retransmits its SYN-ACK from its own timer. */
+		if (do_fastopen)
+			return 0;
 		goto drop_and_free;
+	}
+
+	if (do_fastopen)
+		return 0;
 
 	inet_csk_reqsk_queue_hash_add(sk, req, TCP_TIMEOUT_INIT);
 	return 0;
@@ -1858,6 +1884,7 @@ static int tcp_v4_init_sock(struct sock *sk)
 	skb_queue_head_init(&tp->out_of_order_queue);
 	tcp_init_xmit_timers(sk);
 	tcp_prequeue_init(tp);
+	INIT_LIST_HEAD(&tp->tsq_node);
 
 	icsk->icsk_rto = TCP_TIMEOUT_INIT;
 	tp->mdev = TCP_TIMEOUT_INIT;
@@ -1963,6 +1990,13 @@ void tcp_v4_destroy_sock(struct sock *sk)
 		tp->cookie_values = NULL;
 	}
 
+	/* TCP Fast Open: aborted during connect or before the handshake
+	 * of a passive open completed.
+	 */
+	tcp_free_fastopen_req(tp);
+	if (tp->fastopen_rsk != NULL)
+		tcp_fastopen_remove_req(sk);
+
 	percpu_counter_dec(&tcp_sockets_allocated);
 }
 EXPORT_SYMBOL(tcp_v4_destroy_sock);
@@ -2601,6 +2635,7 @@ struct proto tcp_prot = {
 	.sendmsg		= tcp_sendmsg,
 	.sendpage		= tcp_sendpage,
 	.backlog_rcv		= tcp_v4_do_rcv,
+	.release_cb		= tcp_release_cb,
 	.hash			= inet_hash,
 	.unhash			= inet_unhash,
 	.get_port		= inet_csk_get_port,
@@ -0,0 +1,152 @@
+/*
+ * TCP per-destination metrics cache.
+ *
+ * Route metrics (RTT, RTT variance, ssthresh, cwnd, reordering) learned
+ * by tcp_update_metrics() live in the routing cache entry and are lost
+ * whenever that entry is flushed, which on a phone happens on every
+ * WLAN/3G handover.  The same values are mirrored into the inet_peer
+ * entry of the destination, which survives route flushes, and copied
+ * back into a fresh route before a new connection consults it.
+ *
+ * The peer entry also remembers the MSS the destination advertised and
+ * the TCP Fast Open cookie it handed out, so a client can put data in
+ * its next SYN.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/module.h>
+#include <linux/seqlock.h>
+#include <net/inetpeer.h>
+#include <net/route.h>
+#include <net/tcp.h>
+
+/* Cached values older than this are not used to seed new connections. */
+#define TCP_METRICS_TIMEOUT	(60 * 60 * HZ)
+
+static DEFINE_SEQLOCK(tcp_metrics_lock);
+
+static struct inet_peer *tcp_get_peer(struct sock *sk, struct dst_entry *dst)
+{
+	struct rtable *rt = (struct rtable *)dst;
+
+	/* inet_peer is keyed by IPv4 address only. */
+	if (!dst || sk->sk_family != AF_INET || dst->ops->family != AF_INET)
+		return NULL;
+
+	if (!rt->peer)
+		rt_bind_peer(rt, 1);
+	return rt->peer;
+}
+
+static void tcp_metric_fill(struct dst_entry *dst, int metric, u32 val)
+{
+	if (val && !dst_metric(dst, metric) && !dst_metric_locked(dst, metric))
+		dst->metrics[metric - 1] = val;
+}
+
+/* Refill route metrics which were lost with the routing cache entry
+ * from the destination's inet_peer.  Called before tcp_init_metrics()
+ * looks at them.
+ */
+void tcp_peer_metrics_load(struct sock *sk, struct dst_entry *dst)
+{
+	struct inet_peer *peer;
+	struct inet_peer_tcp_metrics m;
+	unsigned int seq;
+
+	if (sysctl_tcp_nometrics_save || !(dst->flags & DST_HOST))
+		return;
+
+	peer = tcp_get_peer(sk, dst);
+	if (!peer)
+		return;
+
+	do {
+		seq = read_seqbegin(&tcp_metrics_lock);
+		m = peer->tcp;
+	} while (read_seqretry(&tcp_metrics_lock, seq));
+
+	if (!m.stamp || time_after(jiffies, m.stamp + TCP_METRICS_TIMEOUT))
+		return;
+
+	if (!dst_metric(dst, RTAX_RTT) && !dst_metric_locked(dst, RTAX_RTT)) {
+		set_dst_metric_rtt(dst, RTAX_RTT, m.rtt);
+		if (!dst_metric_locked(dst, RTAX_RTTVAR))
+			set_dst_metric_rtt(dst, RTAX_RTTVAR, m.rttvar);
+	}
+	tcp_metric_fill(dst, RTAX_SSTHRESH, m.ssthresh);
+	tcp_metric_fill(dst, RTAX_CWND, m.cwnd);
+	tcp_metric_fill(dst, RTAX_REORDERING, m.reordering);
+}
+
+/* Mirror the route metrics just updated by tcp_update_metrics(). */
+void tcp_peer_metrics_save(struct sock *sk, struct dst_entry *dst)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct inet_peer *peer = tcp_get_peer(sk, dst);
+
+	if (!peer)
+		return;
+
+	write_seqlock_bh(&tcp_metrics_lock);
+	peer->tcp.rtt = dst_metric_rtt(dst, RTAX_RTT);
+	peer->tcp.rttvar = dst_metric_rtt(dst, RTAX_RTTVAR);
+	peer->tcp.ssthresh = dst_metric(dst, RTAX_SSTHRESH);
+	peer->tcp.cwnd = dst_metric(dst, RTAX_CWND);
+	peer->tcp.reordering = dst_metric(dst, RTAX_REORDERING);
+	if (tp->rx_opt.mss_clamp && tp->rx_opt.mss_clamp != tp->rx_opt.user_mss)
+		peer->tcp.mss = tp->rx_opt.mss_clamp;
+	peer->tcp.stamp = jiffies ? : 1;
+	write_sequnlock_bh(&tcp_metrics_lock);
+}
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	struct inet_peer *peer = tcp_get_peer(sk, __sk_dst_get(sk));
+	unsigned int seq;
+
+	cookie->len = 0;
+	if (!peer)
+		return;
+
+	do {
+		seq = read_seqbegin(&tcp_metrics_lock);
+		if (peer->tcp.mss)
+			*mss = peer->tcp.mss;
+		cookie->len = peer->tcp.fo_cookie_len;
+		if (cookie->len > 0)
+			memcpy(cookie->val, peer->tcp.fo_cookie, cookie->len);
+		*syn_loss = peer->tcp.fo_syn_loss;
+		*last_syn_loss = *syn_loss ? peer->tcp.fo_syn_loss_stamp : 0;
+	} while (read_seqretry(&tcp_metrics_lock, seq));
+}
+
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, bool syn_lost)
+{
+	struct inet_peer *peer = tcp_get_peer(sk, __sk_dst_get(sk));
+
+	if (!peer)
+		return;
+
+	write_seqlock_bh(&tcp_metrics_lock);
+	if (mss)
+		peer->tcp.mss = mss;
+	if (cookie->len > 0) {
+		peer->tcp.fo_cookie_len = cookie->len;
+		memcpy(peer->tcp.fo_cookie, cookie->val, cookie->len);
+	}
+	if (syn_lost) {
+		peer->tcp.fo_syn_loss++;
+		peer->tcp.fo_syn_loss_stamp = jiffies;
+	} else {
+		peer->tcp.fo_syn_loss = 0;
+	}
+	write_sequnlock_bh(&tcp_metrics_lock);
+}
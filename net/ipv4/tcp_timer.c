@@ -312,6 +312,34 @@ static void tcp_probe_timer(struct sock *sk)
 	}
 }
 
+/*
+ *	Timer for Fast Open socket to retransmit SYNACK. Note that the
+ *	sk here is the child socket, not the parent (listener) socket.
+ */
+void tcp_fastopen_synack_timer(struct sock *sk)
+{
+	struct inet_connection_sock *icsk = inet_csk(sk);
+	int max_retries = icsk->icsk_syn_retries ? :
+	    sysctl_tcp_synack_retries + 1; /* add one more retry for fastopen */
+	struct request_sock *req = tcp_sk(sk)->fastopen_rsk;
+
+	/* Give up and kill the child like an embryonic connection which
+	 * never completed its handshake.
+	 */
+	if (req->retrans >= max_retries) {
+		tcp_write_err(sk);
+		return;
+	}
+	/* The data in the SYN, if any, has been queued already; only the
+	 * SYN-ACK is repeated. Data we sent meanwhile is retransmitted by
+	 * the regular timer once the handshake completes.
+	 */
+	req->rsk_ops->rtx_syn_ack(sk, req, NULL);
+	req->retrans++;
+	inet_csk_reset_xmit_timer(sk, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT << req->retrans, TCP_RTO_MAX);
+}
+
 /*
  *	The TCP retransmit timer.
  */
@@ -472,7 +500,10 @@ static void tcp_write_timer(unsigned long data)
 
 	switch (event) {
 	case ICSK_TIME_RETRANS:
-		tcp_retransmit_timer(sk);
+		if (tcp_sk(sk)->fastopen_rsk)
+			tcp_fastopen_synack_timer(sk);
+		else
+			tcp_retransmit_timer(sk);
 		break;
 	case ICSK_TIME_PROBE0:
 		tcp_probe_timer(sk);
@@ -769,6 +769,79 @@ out:
 	return err;
 }
 
+/*
+ * An unconnected socket keeps the route of its last datagram in
+ * sk_dst_cache, keyed by the flow it was looked up for.  Applications
+ * like DNS resolvers send to the same few servers over and over, and
+ * reusing the route saves the route cache lookup and, after a route
+ * cache flush, the FIB lookup.  The route is validated like the one of
+ * a connected socket: dst_check() fails once the route cache generation
+ * changes or the entry was flushed.  Connected sockets use sk_dst_cache
+ * for their own route and never go through here, and neither do IPv6
+ * sockets sending to mapped addresses, whose sk_dst_cache holds IPv6
+ * routes.
+ */
+static int udp_dst_key_match(const struct udp_sock *up, const struct flowi *fl)
+{
+	return up->dst_key.daddr == fl->fl4_dst &&
+	       up->dst_key.saddr == fl->fl4_src &&
+	       up->dst_key.dport == fl->fl_ip_dport &&
+	       up->dst_key.tos == fl->fl4_tos &&
+	       up->dst_key.flags == fl->flags &&
+	       up->dst_key.oif == fl->oif &&
+	       up->dst_key.mark == fl->mark;
+}
+
+static struct rtable *udp_dst_cache_get(struct sock *sk, const struct flowi *fl)
+{
+	struct dst_entry *dst = NULL;
+
+	if (sk->sk_family != AF_INET)
+		return NULL;
+
+	spin_lock(&sk->sk_dst_lock);
+	if (sk->sk_state != TCP_ESTABLISHED &&
+	    udp_dst_key_match(udp_sk(sk), fl)) {
+		dst = rcu_dereference_raw(sk->sk_dst_cache);
+		if (dst)
+			dst_hold(dst);
+	}
+	spin_unlock(&sk->sk_dst_lock);
+
+	if (dst && dst->ops->check(dst, 0) == NULL) {
+		dst_release(dst);
+		return NULL;
+	}
+	return (struct rtable *)dst;
+}
+
+/*
+ * The route lookup filled in fl->fl4_src; saddr is the source address
+ * the lookup was asked for, which is what the next datagram's flow has.
+ */
+static void udp_dst_cache_set(struct sock *sk, const struct flowi *fl,
+			      __be32 saddr, struct rtable *rt)
+{
+	struct udp_sock *up = udp_sk(sk);
+
+	if (sk->sk_family != AF_INET)
+		return;
+
+	spin_lock(&sk->sk_dst_lock);
+	/* connect() installs its own route after changing sk_state. */
+	if (sk->sk_state != TCP_ESTABLISHED) {
+		up->dst_key.daddr = fl->fl4_dst;
+		up->dst_key.saddr = saddr;
+		up->dst_key.dport = fl->fl_ip_dport;
+		up->dst_key.tos = fl->fl4_tos;
+		up->dst_key.flags = fl->flags;
+		up->dst_key.oif = fl->oif;
+		up->dst_key.mark = fl->mark;
+		__sk_dst_set(sk, dst_clone(&rt->dst));
+	}
+	spin_unlock(&sk->sk_dst_lock);
+}
+
 int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		size_t len)
 {
@@ -779,6 +852,7 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 	struct rtable *rt = NULL;
 	int free = 0;
 	int connected = 0;
+	int new_route = 0;
 	__be32 daddr, faddr, saddr;
 	__be16 dport;
 	u8  tos;
@@ -902,11 +976,16 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 		struct net *net = sock_net(sk);
 
 		security_sk_classify_flow(sk, &fl);
-		err = ip_route_output_flow(net, &rt, &fl, sk, 1);
-		if (err) {
-			if (err == -ENETUNREACH)
-				IP_INC_STATS_BH(net, IPSTATS_MIB_OUTNOROUTES);
-			goto out;
+		if (!connected)
+			rt = udp_dst_cache_get(sk, &fl);
+		if (rt == NULL) {
+			err = ip_route_output_flow(net, &rt, &fl, sk, 1);
+			if (err) {
+				if (err == -ENETUNREACH)
+					IP_INC_STATS_BH(net, IPSTATS_MIB_OUTNOROUTES);
+				goto out;
+			}
+			new_route = 1;
 		}
 
 		err = -EACCES;
@@ -915,6 +994,8 @@ int udp_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
 			goto out;
 		if (connected)
 			sk_dst_set(sk, dst_clone(&rt->dst));
+		else if (new_route)
+			udp_dst_cache_set(sk, &fl, saddr, rt);
 	}
 
 	if (msg->msg_flags&MSG_CONFIRM)
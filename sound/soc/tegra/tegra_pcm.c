@@ -23,6 +23,17 @@
 #define PLAYBACK_STARTED true
 #define PLAYBACK_STOPPED false
 
+/* In ring mode each DMA request covers the whole buffer instead of one
+ * period, so there are two interrupts per trip round the buffer (half way
+ * and at the end) whatever the period size, and the position comes from the
+ * DMA controller.  That lets timer-scheduled clients run large buffers with
+ * few interrupts, while small buffers still give low latency.
+ */
+static int ring_mode;
+module_param(ring_mode, bool, S_IRUGO);
+MODULE_PARM_DESC(ring_mode, "run the DMA over the whole buffer and take the "
+		 "position from the DMA controller");
+
 static void tegra_pcm_play(struct tegra_runtime_data *prtd)
 {
 	struct snd_pcm_substream *substream = prtd->substream;
@@ -30,7 +41,9 @@ static void tegra_pcm_play(struct tegra_runtime_data *prtd)
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
 
 	if (runtime->dma_addr) {
-		prtd->size = frames_to_bytes(runtime, runtime->period_size);
+		prtd->size = frames_to_bytes(runtime, prtd->ring ?
+					     runtime->buffer_size :
+					     runtime->period_size);
 			if (prtd->dma_state != STATE_ABORT) {
 			prtd->dma_reqid_tail = (prtd->dma_reqid_tail + 1) % DMA_REQ_QCOUNT;
 			prtd->dma_req[prtd->dma_reqid_tail].source_addr = buf->addr +
@@ -41,6 +54,9 @@ static void tegra_pcm_play(struct tegra_runtime_data *prtd)
 		}
 	}
 
+	if (prtd->ring)
+		return;
+
 	prtd->dma_pos += runtime->period_size;
 	if (prtd->dma_pos >= runtime->buffer_size) {
 		prtd->dma_pos = 0;
@@ -55,7 +71,9 @@ static void tegra_pcm_capture(struct tegra_runtime_data *prtd)
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
 
 	if (runtime->dma_addr) {
-		prtd->size = frames_to_bytes(runtime, runtime->period_size);
+		prtd->size = frames_to_bytes(runtime, prtd->ring ?
+					     runtime->buffer_size :
+					     runtime->period_size);
 			if (prtd->dma_state != STATE_ABORT) {
 			prtd->dma_reqid_tail = (prtd->dma_reqid_tail + 1) % DMA_REQ_QCOUNT;
 			prtd->dma_req[prtd->dma_reqid_tail].dest_addr = buf->addr +
@@ -66,6 +84,9 @@ static void tegra_pcm_capture(struct tegra_runtime_data *prtd)
 		}
 	}
 
+	if (prtd->ring)
+		return;
+
 	prtd->dma_pos += runtime->period_size;
 	if (prtd->dma_pos >= runtime->buffer_size) {
 		prtd->dma_pos = 0;
@@ -94,6 +115,15 @@ static void dma_complete_callback (struct tegra_dma_req *req)
 	}
 }
 
+/* Half way through a ring pass; at least one period has gone by. */
+static void dma_threshold_callback(struct tegra_dma_req *req)
+{
+	struct tegra_runtime_data *prtd = (struct tegra_runtime_data *)req->dev;
+
+	if (prtd->dma_state != STATE_ABORT)
+		snd_pcm_period_elapsed(prtd->substream);
+}
+
 static const struct snd_pcm_hardware tegra_pcm_hardware = {
 	.info 	= SNDRV_PCM_INFO_INTERLEAVED | \
 			SNDRV_PCM_INFO_PAUSE | SNDRV_PCM_INFO_RESUME | \
@@ -109,6 +139,25 @@ static const struct snd_pcm_hardware tegra_pcm_hardware = {
 	.fifo_size 		= 4,
 };
 
+/*
+ * The whole buffer has to fit in one DMA request.  A restarted request always
+ * begins at the start of the buffer, so no pause or resume: the stream has to
+ * be prepared again from where the application has got to.
+ */
+static const struct snd_pcm_hardware tegra_pcm_ring_hardware = {
+	.info			= SNDRV_PCM_INFO_INTERLEAVED |
+				  SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID,
+	.formats		= SNDRV_PCM_FMTBIT_S16_LE,
+	.channels_min		= 1,
+	.channels_max		= 2,
+	.buffer_bytes_max	= TEGRA_DMA_MAX_TRANSFER_SIZE,
+	.period_bytes_min	= 128,
+	.period_bytes_max	= TEGRA_DMA_MAX_TRANSFER_SIZE / 2,
+	.periods_min		= 2,
+	.periods_max		= TEGRA_DMA_MAX_TRANSFER_SIZE / 128,
+	.fifo_size		= 4,
+};
+
 static int tegra_pcm_hw_params(struct snd_pcm_substream *substream,
 				struct snd_pcm_hw_params *params)
 {
@@ -207,6 +256,15 @@ static snd_pcm_uframes_t tegra_pcm_pointer(struct snd_pcm_substream *substream)
 	struct tegra_runtime_data *prtd = runtime->private_data;
 	int size;
 
+	if (prtd->ring) {
+		size = bytes_to_frames(runtime,
+				tegra_dma_get_transfer_count(
+					prtd->dma_chan,
+					&prtd->dma_req[prtd->dma_reqid_head],
+					false));
+		return size % runtime->buffer_size;
+	}
+
 	size = (prtd->period_index * runtime->period_size) +
 		 bytes_to_frames(runtime,
 				tegra_dma_get_transfer_count(
@@ -249,6 +307,7 @@ static int tegra_pcm_open(struct snd_pcm_substream *substream)
 	memset(prtd, 0, sizeof(*prtd));
 	runtime->private_data = prtd;
 	prtd->substream = substream;
+	prtd->ring = ring_mode;
 
 #ifdef CONFIG_MACH_N1
 	/* This code is intended to prevent pop noise when i2s port is closed */
@@ -281,6 +340,10 @@ static int tegra_pcm_open(struct snd_pcm_substream *substream)
 			prtd);
 	}
 #endif
+	if (prtd->ring)
+		for (i = 0; i < DMA_REQ_QCOUNT; i++)
+			prtd->dma_req[i].threshold = dma_threshold_callback;
+
 	prtd->dma_chan = tegra_dma_allocate_channel(TEGRA_DMA_MODE_CONTINUOUS_DOUBLE);
 	if (IS_ERR(prtd->dma_chan)) {
 		pr_err("%s: could not allocate DMA channel for I2S: %ld\n",
@@ -290,7 +353,9 @@ static int tegra_pcm_open(struct snd_pcm_substream *substream)
 	}
 
 	/* Set HW params now that initialization is complete */
-	snd_soc_set_runtime_hwparams(substream, &tegra_pcm_hardware);
+	snd_soc_set_runtime_hwparams(substream, prtd->ring ?
+				     &tegra_pcm_ring_hardware :
+				     &tegra_pcm_hardware);
 
 	goto end;
 
@@ -378,7 +443,8 @@ static int tegra_pcm_preallocate_dma_buffer(struct snd_pcm *pcm, int stream)
 {
 	struct snd_pcm_substream *substream = pcm->streams[stream].substream;
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
-	size_t size = tegra_pcm_hardware.buffer_bytes_max;
+	size_t size = ring_mode ? tegra_pcm_ring_hardware.buffer_bytes_max :
+				  tegra_pcm_hardware.buffer_bytes_max;
 
 	buf->dev.type = SNDRV_DMA_TYPE_DEV;
 	buf->dev.dev = pcm->card->dev;
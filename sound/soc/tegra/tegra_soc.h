@@ -92,6 +92,7 @@ struct tegra_runtime_data {
 	int period_index;
 	int dma_state;
 	struct tegra_dma_channel *dma_chan;
+	bool ring;
 };
 
 struct tegra_audio_data {
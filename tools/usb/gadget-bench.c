@@ -0,0 +1,585 @@
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o gadget-bench gadget-bench.c */
+
+/*
+ * Throughput benchmark for the Android MTP, ADB and mass storage gadget
+ * functions.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+/*
+ * Both ends run on the same machine, with dummy_hcd standing in for the
+ * device controller and the android gadget bound to it with the function
+ * to be measured enabled.  The gadget end is a child process driving
+ * /dev/mtp_usb (MTP_SEND_FILE or MTP_RECEIVE_FILE on a file) or
+ * /dev/android_adb (write() or read()).  The host end finds the function's
+ * interface through sysfs and keeps a number of bulk URBs in flight on it
+ * through usbfs, timing how long it takes for the given amount of data to
+ * go across:
+ *
+ *	gadget-bench -f mtp -d in -F /data/bench -m 64
+ *	gadget-bench -f adb -d out -m 64 -q 8 -b 65536
+ *
+ * "in" is from the gadget to the host and "out" the other way.  For MTP
+ * the file is read from, or written to, by the gadget; it must already be
+ * at least as large as the transfer for "in".  Request queue depths and
+ * sizes on the gadget end are the mtp_* parameters of f_mtp and the adb_*
+ * ones of f_adb, under /sys/module/f_mtp/parameters and
+ * /sys/module/f_adb/parameters.
+ *
+ * For mass storage, the file (a RAM disk such as /dev/ram0 takes the
+ * medium out of the measurement) is loaded into the LUN, and the host end
+ * reads or writes the disk usb-storage makes of it with O_DIRECT, in
+ * pieces of the URB size:
+ *
+ *	gadget-bench -f ums -d in -F /dev/ram0 -m 64 -b 131072
+ *
+ * Its buffers are the fsg_* parameters of f_mass_storage, under
+ * /sys/module/f_mass_storage/parameters.
+ */
+
+#define _GNU_SOURCE		/* O_DIRECT */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <glob.h>
+#include <limits.h>
+#include <signal.h>
+#include <dirent.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+
+#include <sys/ioctl.h>
+#include <linux/usbdevice_fs.h>
+
+/*-------------------------------------------------------------------------*/
+
+// FIXME these are in <linux/usb/f_mtp.h>, which is not exported
+
+struct mtp_file_range {
+	int		fd;
+	loff_t		offset;
+	int64_t		length;
+};
+
+#define MTP_SEND_FILE		_IOW('M', 0, struct mtp_file_range)
+#define MTP_RECEIVE_FILE	_IOW('M', 1, struct mtp_file_range)
+
+#define SYSFS_USB	"/sys/bus/usb/devices"
+#define MAX_URBS	64
+
+static const char *function = "mtp";
+static int to_host = 1;
+static const char *path = "/data/gadget-bench";
+static unsigned long long total = 64ULL << 20;
+static unsigned int urb_len = 16384;
+static unsigned int nr_urbs = 4;
+static const char *lun = "/sys/devices/platform/usb_mass_storage/lun0/file";
+
+struct bench_intf {
+	unsigned int	bus, dev, intf;
+	unsigned char	ep;
+	char		disk[PATH_MAX];		/* for mass storage */
+};
+
+/*-------------------------------------------------------------------------*/
+
+static int read_sysfs(const char *dir, const char *name, char *buf, size_t len)
+{
+	char file[PATH_MAX];
+	FILE *f;
+
+	snprintf(file, sizeof file, "%s/%s", dir, name);
+	f = fopen(file, "r");
+	if (!f)
+		return -1;
+	if (!fgets(buf, len, f)) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	buf[strcspn(buf, "\n")] = 0;
+	return 0;
+}
+
+static unsigned int sysfs_hex(const char *dir, const char *name)
+{
+	char buf[32];
+
+	if (read_sysfs(dir, name, buf, sizeof buf) < 0)
+		return ~0U;
+	return strtoul(buf, NULL, 16);
+}
+
+static int is_function(const char *dir)
+{
+	char buf[64];
+
+	if (!strcmp(function, "ums"))
+		return sysfs_hex(dir, "bInterfaceClass") == 0x08
+			&& sysfs_hex(dir, "bInterfaceSubClass") == 0x06
+			&& sysfs_hex(dir, "bInterfaceProtocol") == 0x50;
+	if (!strcmp(function, "adb"))
+		return sysfs_hex(dir, "bInterfaceClass") == 0xff
+			&& sysfs_hex(dir, "bInterfaceSubClass") == 0x42
+			&& sysfs_hex(dir, "bInterfaceProtocol") == 0x01;
+
+	return sysfs_hex(dir, "bInterfaceClass") == 0xff
+		&& sysfs_hex(dir, "bInterfaceSubClass") == 0xff
+		&& read_sysfs(dir, "interface", buf, sizeof buf) == 0
+		&& !strcmp(buf, "MTP");
+}
+
+/* The bulk endpoint going the way we measure, from its ep_XX directory. */
+static int find_endpoint(const char *dir, unsigned char *ep)
+{
+	char sub[PATH_MAX], buf[32];
+	struct dirent *de;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return -1;
+	while ((de = readdir(d))) {
+		if (strncmp(de->d_name, "ep_", 3))
+			continue;
+		if (snprintf(sub, sizeof sub, "%s/%s", dir, de->d_name)
+				>= (int)sizeof sub)
+			continue;
+		if (read_sysfs(sub, "type", buf, sizeof buf) < 0
+				|| strcmp(buf, "Bulk"))
+			continue;
+		if (read_sysfs(sub, "direction", buf, sizeof buf) < 0
+				|| strcmp(buf, to_host ? "in" : "out"))
+			continue;
+		*ep = strtoul(de->d_name + 3, NULL, 16);
+		closedir(d);
+		return 0;
+	}
+	closedir(d);
+	return -1;
+}
+
+/* The disk usb-storage made of the interface's LUN. */
+static int find_disk(const char *dir, char *disk, size_t len)
+{
+	char pattern[PATH_MAX];
+	glob_t g;
+
+	if (snprintf(pattern, sizeof pattern, "%s/host*/target*/*/block/*",
+		     dir) >= (int)sizeof pattern)
+		return -1;
+	if (glob(pattern, 0, NULL, &g) || !g.gl_pathc) {
+		globfree(&g);
+		return -1;
+	}
+	snprintf(disk, len, "/dev/%s", strrchr(g.gl_pathv[0], '/') + 1);
+	globfree(&g);
+	return 0;
+}
+
+static int find_interface(struct bench_intf *bi)
+{
+	char dir[PATH_MAX], parent[PATH_MAX], buf[32];
+	struct dirent *de;
+	DIR *d;
+
+	d = opendir(SYSFS_USB);
+	if (!d) {
+		perror(SYSFS_USB);
+		return -1;
+	}
+	while ((de = readdir(d))) {
+		/* interfaces are bus-port:config.interface */
+		if (!strchr(de->d_name, ':'))
+			continue;
+		snprintf(dir, sizeof dir, SYSFS_USB "/%s", de->d_name);
+		if (!is_function(dir))
+			continue;
+		if (!strcmp(function, "ums")) {
+			if (find_disk(dir, bi->disk, sizeof bi->disk) < 0)
+				continue;
+		} else if (find_endpoint(dir, &bi->ep) < 0) {
+			continue;
+		}
+
+		snprintf(parent, sizeof parent, SYSFS_USB "/%.*s",
+			 (int)strcspn(de->d_name, ":"), de->d_name);
+		if (read_sysfs(parent, "busnum", buf, sizeof buf) < 0)
+			continue;
+		bi->bus = atoi(buf);
+		if (read_sysfs(parent, "devnum", buf, sizeof buf) < 0)
+			continue;
+		bi->dev = atoi(buf);
+		bi->intf = sysfs_hex(dir, "bInterfaceNumber");
+		closedir(d);
+		return 0;
+	}
+	closedir(d);
+	return -1;
+}
+
+/*-------------------------------------------------------------------------*/
+
+static int gadget_mtp(void)
+{
+	struct mtp_file_range mfr;
+	int fd, file, ret;
+
+	file = open(path, to_host ? O_RDONLY : O_WRONLY | O_CREAT | O_TRUNC,
+		    0600);
+	if (file < 0) {
+		perror(path);
+		return 1;
+	}
+	fd = open("/dev/mtp_usb", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/mtp_usb");
+		return 1;
+	}
+
+	mfr.fd = file;
+	mfr.offset = 0;
+	mfr.length = total;
+	ret = ioctl(fd, to_host ? MTP_SEND_FILE : MTP_RECEIVE_FILE, &mfr);
+	if (ret < 0) {
+		perror(to_host ? "MTP_SEND_FILE" : "MTP_RECEIVE_FILE");
+		return 1;
+	}
+	close(fd);
+	close(file);
+	return 0;
+}
+
+static int gadget_adb(void)
+{
+	unsigned long long done = 0;
+	int enable, fd, ret;
+	char *buf;
+
+	/* the function is only there while this is held open */
+	enable = open("/dev/android_adb_enable", O_RDWR);
+	if (enable < 0) {
+		perror("/dev/android_adb_enable");
+		return 1;
+	}
+	fd = open("/dev/android_adb", O_RDWR);
+	if (fd < 0) {
+		perror("/dev/android_adb");
+		return 1;
+	}
+	buf = calloc(1, urb_len);
+	if (!buf)
+		return 1;
+
+	while (done < total) {
+		size_t len = total - done < urb_len ? total - done : urb_len;
+
+		ret = to_host ? write(fd, buf, len) : read(fd, buf, len);
+		if (ret <= 0) {
+			perror(to_host ? "adb write" : "adb read");
+			return 1;
+		}
+		done += ret;
+	}
+	free(buf);
+	close(fd);
+	close(enable);
+	return 0;
+}
+
+/*-------------------------------------------------------------------------*/
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int submit(int fd, struct usbdevfs_urb *urb, unsigned char ep,
+		  unsigned long long left)
+{
+	urb->type = USBDEVFS_URB_TYPE_BULK;
+	urb->endpoint = ep;
+	urb->buffer_length = left < urb_len ? left : urb_len;
+	urb->actual_length = 0;
+	urb->status = 0;
+	return ioctl(fd, USBDEVFS_SUBMITURB, urb);
+}
+
+static int host_bench(const struct bench_intf *bi, double *secs)
+{
+	struct usbdevfs_urb urbs[MAX_URBS], *urb;
+	unsigned long long queued = 0, done = 0;
+	unsigned int i, busy = 0, intf = bi->intf;
+	char name[64];
+	double start;
+	int fd, ret = 0;
+
+	snprintf(name, sizeof name, "/dev/bus/usb/%03u/%03u", bi->bus,
+		 bi->dev);
+	fd = open(name, O_RDWR);
+	if (fd < 0) {
+		perror(name);
+		return -1;
+	}
+	if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &intf) < 0) {
+		perror("USBDEVFS_CLAIMINTERFACE");
+		close(fd);
+		return -1;
+	}
+
+	memset(urbs, 0, sizeof urbs);
+	for (i = 0; i < nr_urbs; i++) {
+		urbs[i].buffer = calloc(1, urb_len);
+		if (!urbs[i].buffer) {
+			ret = -1;
+			goto out;
+		}
+	}
+
+	start = now();
+	for (i = 0; i < nr_urbs && queued < total; i++) {
+		if (submit(fd, &urbs[i], bi->ep, total - queued) < 0) {
+			perror("USBDEVFS_SUBMITURB");
+			ret = -1;
+			goto out;
+		}
+		queued += urbs[i].buffer_length;
+		busy++;
+	}
+
+	while (busy) {
+		if (ioctl(fd, USBDEVFS_REAPURB, &urb) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("USBDEVFS_REAPURB");
+			ret = -1;
+			goto out;
+		}
+		busy--;
+		if (urb->status) {
+			fprintf(stderr, "urb status %d\n", urb->status);
+			ret = -1;
+			goto out;
+		}
+		done += urb->actual_length;
+		/* a short packet from MTP or ADB only ever ends a transfer */
+		if (to_host && urb->actual_length < urb->buffer_length)
+			queued = total;
+		if (queued < total) {
+			if (submit(fd, urb, bi->ep, total - queued) < 0) {
+				perror("USBDEVFS_SUBMITURB");
+				ret = -1;
+				goto out;
+			}
+			queued += urb->buffer_length;
+			busy++;
+		}
+	}
+	*secs = now() - start;
+	if (done != total) {
+		fprintf(stderr, "%llu of %llu bytes went across\n", done,
+			total);
+		ret = -1;
+	}
+
+out:
+	/* leave nothing queued behind, such as the wait for an MTP ZLP */
+	for (i = 0; i < nr_urbs && busy; i++)
+		if (ioctl(fd, USBDEVFS_DISCARDURB, &urbs[i]) == 0
+				&& ioctl(fd, USBDEVFS_REAPURB, &urb) == 0)
+			busy--;
+	for (i = 0; i < nr_urbs; i++)
+		free(urbs[i].buffer);
+	ioctl(fd, USBDEVFS_RELEASEINTERFACE, &intf);
+	close(fd);
+	return ret;
+}
+
+static int ums_load(void)
+{
+	FILE *f;
+
+	f = fopen(lun, "w");
+	if (!f) {
+		perror(lun);
+		return -1;
+	}
+	fprintf(f, "%s\n", path);
+	if (fclose(f)) {
+		perror(lun);
+		return -1;
+	}
+	return 0;
+}
+
+/* The host end of mass storage is usb-storage, one command at a time. */
+static int ums_bench(const struct bench_intf *bi, double *secs)
+{
+	unsigned long long done;
+	double start;
+	void *buf;
+	ssize_t n;
+	int fd;
+
+	fd = open(bi->disk, (to_host ? O_RDONLY : O_WRONLY) | O_DIRECT);
+	if (fd < 0) {
+		perror(bi->disk);
+		return -1;
+	}
+	if (lseek(fd, 0, SEEK_END) < (off_t)total) {
+		fprintf(stderr, "%s is smaller than %llu MB\n", bi->disk,
+			total >> 20);
+		close(fd);
+		return -1;
+	}
+	if (posix_memalign(&buf, 4096, urb_len)) {
+		close(fd);
+		return -1;
+	}
+	memset(buf, 0x5a, urb_len);
+
+	start = now();
+	for (done = 0; done < total; done += n) {
+		size_t len = total - done < urb_len ? total - done : urb_len;
+
+		n = to_host ? pread(fd, buf, len, done)
+			    : pwrite(fd, buf, len, done);
+		if (n <= 0) {
+			perror(bi->disk);
+			break;
+		}
+	}
+	*secs = now() - start;
+	free(buf);
+	close(fd);
+	return done < total ? -1 : 0;
+}
+
+/*-------------------------------------------------------------------------*/
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-f mtp|adb|ums] [-d in|out] [-F file] "
+		"[-L lun_file_attr] [-m megabytes] [-q urbs] [-b urb_bytes]\n"
+		"gadget request queues: /sys/module/f_mtp/parameters, "
+		"/sys/module/f_adb/parameters,\n"
+		"\t/sys/module/f_mass_storage/parameters\n",
+		argv0);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_intf bi;
+	double secs = 0;
+	int c, status, ret;
+	pid_t child;
+
+	while ((c = getopt(argc, argv, "f:d:F:L:m:q:b:")) != -1) {
+		switch (c) {
+		case 'f':
+			function = optarg;
+			if (strcmp(function, "mtp") && strcmp(function, "adb")
+					&& strcmp(function, "ums"))
+				usage(argv[0]);
+			break;
+		case 'd':
+			if (!strcmp(optarg, "in"))
+				to_host = 1;
+			else if (!strcmp(optarg, "out"))
+				to_host = 0;
+			else
+				usage(argv[0]);
+			break;
+		case 'F':
+			path = optarg;
+			break;
+		case 'L':
+			lun = optarg;
+			break;
+		case 'm':
+			total = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'q':
+			nr_urbs = atoi(optarg);
+			break;
+		case 'b':
+			urb_len = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!total || !nr_urbs || nr_urbs > MAX_URBS || !urb_len)
+		usage(argv[0]);
+
+	if (!strcmp(function, "ums")) {
+		if (ums_load() < 0)
+			return 1;
+		for (c = 0; c < 50; c++) {
+			if (find_interface(&bi) == 0)
+				break;
+			usleep(100000);
+		}
+		if (c == 50) {
+			fprintf(stderr, "no disk found for %s, is the gadget "
+				"bound to dummy_hcd with mass storage "
+				"enabled?\n", path);
+			return 1;
+		}
+		if (ums_bench(&bi, &secs) < 0)
+			return 1;
+		printf("ums %s: %llu MB in %.3f s, %.1f MB/s (%u byte "
+		       "pieces)\n", to_host ? "in" : "out", total >> 20, secs,
+		       total / secs / (1 << 20), urb_len);
+		return 0;
+	}
+
+	/* adb only shows up once its device is opened */
+	child = fork();
+	if (child < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!child)
+		return !strcmp(function, "mtp") ? gadget_mtp() : gadget_adb();
+
+	ret = -1;
+	for (c = 0; c < 50 && ret < 0; c++) {
+		ret = find_interface(&bi);
+		if (ret < 0)
+			usleep(100000);
+	}
+	if (ret < 0)
+		fprintf(stderr, "no %s interface found, is the gadget bound "
+			"to dummy_hcd with %s enabled?\n", function, function);
+	else
+		ret = host_bench(&bi, &secs);
+	if (ret < 0)
+		kill(child, SIGKILL);
+
+	if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status)
+			|| WEXITSTATUS(status))
+		ret = -1;
+	if (ret < 0)
+		return 1;
+
+	printf("%s %s: %llu MB in %.3f s, %.1f MB/s (%u x %u byte urbs)\n",
+	       function, to_host ? "in" : "out", total >> 20, secs,
+	       total / secs / (1 << 20), nr_urbs, urb_len);
+	return 0;
+}